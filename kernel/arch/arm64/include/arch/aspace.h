@@ -33,6 +33,10 @@ public:
 
     zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) override;
 
+    // Block mappings are not split when only part of one is unmapped or
+    // protected, so none are asked for.
+    size_t LargePageSize() const override { return 0; }
+
     vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                      vaddr_t end, uint next_region_mmu_flags,
                      vaddr_t align, size_t size, uint mmu_flags) override;
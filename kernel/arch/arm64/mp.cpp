@@ -65,6 +65,18 @@ static uint arch_curr_cpu_num_slow() {
     return arm64_cpu_map[cluster][cpu];
 }
 
+cpu_mask_t arch_mp_cache_domain_mask(cpu_num_t cpu) {
+    // cpus within a cluster share the last level cache.
+    uint cluster = arch_cpu_num_to_cluster_id(cpu);
+    cpu_mask_t mask = 0;
+    for (cpu_num_t i = 0; i < arm_num_cpus; i++) {
+        if (arch_cpu_num_to_cluster_id(i) == cluster) {
+            mask |= cpu_num_to_mask(i);
+        }
+    }
+    return mask;
+}
+
 zx_status_t arch_mp_send_ipi(mp_ipi_target_t target, cpu_mask_t mask, mp_ipi_t ipi) {
     LTRACEF("target %d mask %#x, ipi %d\n", target, mask, ipi);
 
@@ -154,3 +154,11 @@ void x86_cpu_topology_decode(uint32_t apic_id, x86_cpu_topology_t *topo) {
     topo->core_id = (apic_id & core_mask) >> core_shift;
     topo->smt_id = apic_id & smt_mask;
 }
+
+bool x86_cpu_topology_same_cache_domain(uint32_t apic_id_a, uint32_t apic_id_b) {
+    // The last level cache is shared by every core in a package.
+    x86_cpu_topology_t a, b;
+    x86_cpu_topology_decode(apic_id_a, &a);
+    x86_cpu_topology_decode(apic_id_b, &b);
+    return a.package_id == b.package_id;
+}
@@ -226,6 +226,7 @@ void x86_feature_debug(void)
         { X86_FEATURE_RDRAND, "rdrand" },
         { X86_FEATURE_RDSEED, "rdseed" },
         { X86_FEATURE_PKU, "pku" },
+        { X86_FEATURE_PCID, "pcid" },
         { X86_FEATURE_SYSCALL, "syscall" },
         { X86_FEATURE_NX, "nx" },
         { X86_FEATURE_HUGE_PAGE, "huge" },
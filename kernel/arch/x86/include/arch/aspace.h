@@ -17,11 +17,13 @@
 #include <zircon/types.h>
 
 struct MappingCursor;
+class PendingTlbInvalidation;
 
 class X86ArchVmAspace final : public ArchVmAspaceInterface {
 public:
     template <typename PageTable>
-    static void UnmapEntry(X86ArchVmAspace* aspace, vaddr_t vaddr, volatile pt_entry_t* pte);
+    static void UnmapEntry(PendingTlbInvalidation* pending, vaddr_t vaddr,
+                           volatile pt_entry_t* pte);
 
     X86ArchVmAspace();
     virtual ~X86ArchVmAspace();
@@ -40,6 +42,8 @@ public:
 
     zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) override;
 
+    size_t LargePageSize() const override;
+
     vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                      vaddr_t end, uint next_region_mmu_flags,
                      vaddr_t align, size_t size, uint mmu_flags) override;
@@ -52,6 +56,12 @@ public:
 
     int active_cpus() { return active_cpus_.load(); }
 
+    // Number of batched TLB shootdowns issued on behalf of this aspace. Each
+    // Map/Unmap/Protect issues at most one, costing at most one IPI round.
+    uint64_t tlb_shootdowns() const { return tlb_shootdowns_; }
+
+    uint16_t pcid() const { return pcid_; }
+
     IoBitmap& io_bitmap() { return io_bitmap_; }
 
     static void ContextSwitch(X86ArchVmAspace* from, X86ArchVmAspace* to);
@@ -82,31 +92,37 @@ private:
     template <typename PageTable>
     zx_status_t AddMapping(volatile pt_entry_t* table, uint mmu_flags,
                            const MappingCursor& start_cursor,
-                           MappingCursor* new_cursor) TA_REQ(lock_);
+                           MappingCursor* new_cursor,
+                           PendingTlbInvalidation* pending) TA_REQ(lock_);
 
     template <typename PageTable>
     zx_status_t AddMappingL0(volatile pt_entry_t* table, uint mmu_flags,
                              const MappingCursor& start_cursor,
-                             MappingCursor* new_cursor) TA_REQ(lock_);
+                             MappingCursor* new_cursor,
+                             PendingTlbInvalidation* pending) TA_REQ(lock_);
 
     template <typename PageTable>
     bool RemoveMapping(volatile pt_entry_t* table,
                        const MappingCursor& start_cursor,
-                       MappingCursor* new_cursor) TA_REQ(lock_);
+                       MappingCursor* new_cursor,
+                       PendingTlbInvalidation* pending) TA_REQ(lock_);
     template <typename PageTable>
     bool RemoveMappingL0(volatile pt_entry_t* table,
                          const MappingCursor& start_cursor,
-                         MappingCursor* new_cursor) TA_REQ(lock_);
+                         MappingCursor* new_cursor,
+                         PendingTlbInvalidation* pending) TA_REQ(lock_);
 
     template <typename PageTable>
     zx_status_t UpdateMapping(volatile pt_entry_t* table, uint mmu_flags,
                               const MappingCursor& start_cursor,
-                              MappingCursor* new_cursor) TA_REQ(lock_);
+                              MappingCursor* new_cursor,
+                              PendingTlbInvalidation* pending) TA_REQ(lock_);
 
     template <typename PageTable>
     zx_status_t UpdateMappingL0(volatile pt_entry_t* table, uint mmu_flags,
                                 const MappingCursor& start_cursor,
-                                MappingCursor* new_cursor) TA_REQ(lock_);
+                                MappingCursor* new_cursor,
+                                PendingTlbInvalidation* pending) TA_REQ(lock_);
 
     template <typename PageTable>
     zx_status_t GetMapping(volatile pt_entry_t* table, vaddr_t vaddr,
@@ -120,10 +136,14 @@ private:
 
     template <typename PageTable>
     void UpdateEntry(vaddr_t vaddr, volatile pt_entry_t* pte, paddr_t paddr,
-                     arch_flags_t flags) TA_REQ(lock_);
+                     arch_flags_t flags, PendingTlbInvalidation* pending) TA_REQ(lock_);
 
     template <typename PageTable>
-    zx_status_t SplitLargePage(vaddr_t vaddr, volatile pt_entry_t* pte) TA_REQ(lock_);
+    zx_status_t SplitLargePage(vaddr_t vaddr, volatile pt_entry_t* pte,
+                               PendingTlbInvalidation* pending) TA_REQ(lock_);
+
+    // Issues the invalidations gathered in |pending| with a single shootdown.
+    void FlushTlb(PendingTlbInvalidation* pending) TA_REQ(lock_);
 
     fbl::Canary<fbl::magic("VAAS")> canary_;
     IoBitmap io_bitmap_;
@@ -147,6 +167,19 @@ private:
     // CPUs that are currently executing in this aspace.
     // Actually an mp_cpu_mask_t, but header dependencies.
     fbl::atomic_int active_cpus_{0};
+
+    uint64_t tlb_shootdowns_ = 0;
+
+    // Process-context identifier tagging this aspace's TLB entries, or 0 if
+    // PCIDs are unavailable and every switch to the aspace flushes the TLB.
+    uint16_t pcid_ = 0;
+
+    // With a PCID, a CPU keeps this aspace's TLB entries after switching away,
+    // so shootdowns that skip inactive CPUs bump |tlb_generation_| instead. A
+    // CPU switching in flushes the PCID if the generation it last saw,
+    // |cpu_tlb_generation_[cpu]|, is stale.
+    fbl::atomic<uint64_t> tlb_generation_{1};
+    uint64_t cpu_tlb_generation_[SMP_MAX_CPUS] = {};
 };
 
 using ArchVmAspace = X86ArchVmAspace;
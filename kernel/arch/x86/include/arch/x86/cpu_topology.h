@@ -21,4 +21,7 @@ typedef struct {
 void x86_cpu_topology_init(void);
 void x86_cpu_topology_decode(uint32_t apic_id, x86_cpu_topology_t *topo);
 
+/* Returns true if the two logical processors share a last level cache. */
+bool x86_cpu_topology_same_cache_domain(uint32_t apic_id_a, uint32_t apic_id_b);
+
 __END_CDECLS
@@ -118,6 +118,12 @@
 #define PAGE_OFFSET_MASK_LARGE  ((1ul << PD_SHIFT) - 1)
 #define PAGE_OFFSET_MASK_HUGE   ((1ul << PDP_SHIFT) - 1)
 
+/* cr3 layout with CR4.PCIDE set, see Intel 3A section 4.10.1 */
+#define X86_CR3_PCID_MASK       (0x0000000000000ffful)
+#define X86_CR3_BASE_MASK       X86_PG_FRAME
+#define X86_CR3_NOFLUSH         (1ul << 63)     /* keep the PCID's TLB entries on load */
+#define X86_NUM_PCIDS           4096
+
 #define VADDR_TO_PML4_INDEX(vaddr) ((vaddr) >> PML4_SHIFT) & ((1ul << ADDR_OFFSET) - 1)
 #define VADDR_TO_PDP_INDEX(vaddr)  ((vaddr) >> PDP_SHIFT) & ((1ul << ADDR_OFFSET) - 1)
 
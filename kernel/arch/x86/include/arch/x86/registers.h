@@ -22,6 +22,7 @@
 #define X86_CR4_OSXMMEXPT               0x00000400 /* os supports xmm exception */
 #define X86_CR4_VMXE                    0x00002000 /* enable vmx */
 #define X86_CR4_FSGSBASE                0x00010000 /* enable {rd,wr}{fs,gs}base */
+#define X86_CR4_PCIDE                   0x00020000 /* process-context identifiers */
 #define X86_CR4_OSXSAVE                 0x00040000 /* os supports xsave */
 #define X86_CR4_SMEP                    0x00100000 /* SMEP protection enabling */
 #define X86_CR4_SMAP                    0x00200000 /* SMAP protection enabling */
@@ -21,7 +21,10 @@
 #include <vm/physmap.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
+#include <bitmap/raw-bitmap.h>
+#include <bitmap/storage.h>
 #include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
@@ -120,53 +123,138 @@ static void x86_tlb_global_invalidate() {
     }
 }
 
-/* Task used for invalidating a TLB entry on each CPU */
-struct tlb_invalidate_page_context {
+/* Whether aspaces are tagged with process-context identifiers (PCIDs) */
+static bool use_pcid = false;
+
+/* PCIDs in use by user aspaces. PCID 0 is reserved for the kernel aspace and
+ * for any aspace created once the other PCIDs have run out. */
+static fbl::Mutex pcid_lock;
+static bitmap::RawBitmapGeneric<bitmap::FixedStorage<X86_NUM_PCIDS>> pcid_bitmap
+    TA_GUARDED(pcid_lock);
+
+static uint16_t x86_pcid_alloc() {
+    if (!use_pcid)
+        return 0;
+
+    fbl::AutoLock a(&pcid_lock);
+    size_t first_unset;
+    if (pcid_bitmap.Get(0, X86_NUM_PCIDS, &first_unset))
+        return 0;
+    pcid_bitmap.SetOne(first_unset);
+    return static_cast<uint16_t>(first_unset);
+}
+
+static void x86_pcid_free(uint16_t pcid) {
+    if (pcid == 0)
+        return;
+
+    fbl::AutoLock a(&pcid_lock);
+    DEBUG_ASSERT(pcid_bitmap.GetOne(pcid));
+    pcid_bitmap.ClearOne(pcid);
+}
+
+/**
+ * @brief Invalidations gathered over a single Map/Unmap/Protect operation
+ *
+ * Page table updates queue the addresses whose TLB entries they made stale,
+ * and the operation issues them all with one shootdown at the end. Past
+ * kMaxPages entries, the shootdown flushes the whole TLB instead.
+ *
+ * Page table pages unlinked by the operation are held here too: other CPUs
+ * may keep walking them through their paging-structure caches until the
+ * shootdown, so they are only returned to the pmm after it.
+ */
+class PendingTlbInvalidation {
+public:
+    static constexpr size_t kMaxPages = 32;
+
+    struct Item {
+        vaddr_t vaddr;
+        page_table_levels level;
+        bool global_page;
+    };
+
+    PendingTlbInvalidation() = default;
+    ~PendingTlbInvalidation() {
+        DEBUG_ASSERT(empty());
+        DEBUG_ASSERT(list_is_empty(&freed_pages));
+    }
+
+    void enqueue(vaddr_t vaddr, page_table_levels level, bool global_page) {
+        contains_global |= global_page;
+        /* Entries above the page directory pointer table cover 512GB each;
+         * it is cheaper to flush everything than to walk them. */
+        if (level == PML4_L || count == kMaxPages) {
+            full_shootdown = true;
+            return;
+        }
+        items[count++] = { .vaddr = vaddr, .level = level, .global_page = global_page };
+    }
+
+    bool empty() const { return count == 0 && !full_shootdown; }
+
+    void clear() {
+        count = 0;
+        full_shootdown = false;
+        contains_global = false;
+    }
+
+    void free_page(vm_page_t* page) {
+        list_add_tail(&freed_pages, &page->free.node);
+    }
+
+    size_t count = 0;
+    bool full_shootdown = false;
+    bool contains_global = false;
+    Item items[kMaxPages];
+    list_node freed_pages = LIST_INITIAL_VALUE(freed_pages);
+};
+
+/* Task used for invalidating a set of TLB entries on each CPU */
+struct tlb_invalidate_context {
     ulong target_cr3;
-    vaddr_t vaddr;
-    enum page_table_levels level;
-    bool global_page;
+    const PendingTlbInvalidation* pending;
 };
-static void tlb_invalidate_page_task(void* raw_context) {
+static void tlb_invalidate_task(void* raw_context) {
     DEBUG_ASSERT(arch_ints_disabled());
-    tlb_invalidate_page_context* context = (tlb_invalidate_page_context*)raw_context;
+    tlb_invalidate_context* context = (tlb_invalidate_context*)raw_context;
+    const PendingTlbInvalidation* pending = context->pending;
 
-    ulong cr3 = x86_get_cr3();
-    if (context->target_cr3 != cr3 && !context->global_page) {
+    ulong cr3 = x86_get_cr3() & X86_CR3_BASE_MASK;
+    bool same_aspace = (context->target_cr3 == cr3);
+    if (!same_aspace && !pending->contains_global) {
         /* This invalidation doesn't apply to this CPU, ignore it */
         return;
     }
 
-    switch (context->level) {
-    case PML4_L:
-        x86_tlb_global_invalidate();
-        break;
-    case PDP_L:
-    case PD_L:
-    case PT_L:
-        __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)context->vaddr));
-        break;
+    if (pending->full_shootdown) {
+        if (pending->contains_global) {
+            x86_tlb_global_invalidate();
+        } else {
+            /* Reloading cr3 without the no-flush bit drops the current
+             * PCID's non-global entries. */
+            x86_set_cr3(x86_get_cr3() & ~X86_CR3_NOFLUSH);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < pending->count; ++i) {
+        const PendingTlbInvalidation::Item& item = pending->items[i];
+        if (!same_aspace && !item.global_page)
+            continue;
+        __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)item.vaddr));
     }
 }
 
 /**
- * @brief Invalidate a single page at a given page table level
- *
- * @param aspace The aspace we're invalidating for (if NULL, assume for current one)
- * @param vaddr The virtual address we are invalidating the TLB entry for
- * @param level The page table level that maps this vaddr
- * @param global_page True if we are invalidating a global mapping
+ * @brief Issue a batch of TLB invalidations on every CPU they apply to
  *
- * TODO(ZX-979): Optimize this.  This is horribly inefficient.
- * We should also change this to pool invalidations from a single
- * "transaction" and then only execute a single mp_sync_exec for that
- * transaction, rather than one per page.
+ * @param aspace The aspace we're invalidating for
+ * @param pending The invalidations to perform
  */
-static void x86_tlb_invalidate_page(X86ArchVmAspace* aspace, vaddr_t vaddr,
-                                    enum page_table_levels level, bool global_page) {
-    ulong cr3 = aspace ? aspace->pt_phys() : x86_get_cr3();
-    struct tlb_invalidate_page_context task_context = {
-        .target_cr3 = cr3, .vaddr = vaddr, .level = level, .global_page = global_page,
+static void x86_tlb_invalidate(X86ArchVmAspace* aspace, const PendingTlbInvalidation* pending) {
+    struct tlb_invalidate_context task_context = {
+        .target_cr3 = aspace->pt_phys(), .pending = pending,
     };
 
     /* Target only CPUs this aspace is active on.  It may be the case that some
@@ -176,14 +264,14 @@ static void x86_tlb_invalidate_page(X86ArchVmAspace* aspace, vaddr_t vaddr,
      * case, it will get a spurious request to flush. */
     mp_ipi_target_t target;
     cpu_mask_t target_mask = 0;
-    if (global_page || aspace == nullptr) {
+    if (pending->contains_global) {
         target = MP_IPI_TARGET_ALL;
     } else {
         target = MP_IPI_TARGET_MASK;
         target_mask = aspace->active_cpus();
     }
 
-    mp_sync_exec(target, target_mask, tlb_invalidate_page_task, &task_context);
+    mp_sync_exec(target, target_mask, tlb_invalidate_task, &task_context);
 }
 
 template <int Level>
@@ -371,10 +459,11 @@ struct PageTable : PageTableBase<Level> {
     }
 
     /**
-     * @brief Invalidate a single page at a given page table level
+     * @brief Queue the invalidation of a single page at a given page table level
      */
-    static void tlb_invalidate_page(X86ArchVmAspace* aspace, vaddr_t vaddr, bool global_page) {
-        x86_tlb_invalidate_page(aspace, vaddr, Base::level, global_page);
+    static void tlb_invalidate_page(PendingTlbInvalidation* pending, vaddr_t vaddr,
+                                    bool global_page) {
+        pending->enqueue(vaddr, Base::level, global_page);
     }
 };
 
@@ -423,9 +512,10 @@ struct ExtendedPageTable : PageTableBase<Level> {
     }
 
     /**
-     * @brief Invalidate a single page at a given page table level
+     * @brief Queue the invalidation of a single page at a given page table level
      */
-    static void tlb_invalidate_page(X86ArchVmAspace* aspace, vaddr_t vaddr, bool global_page) {
+    static void tlb_invalidate_page(PendingTlbInvalidation* pending, vaddr_t vaddr,
+                                    bool global_page) {
         // TODO(ZX-981): Implement this.
     }
 };
@@ -522,7 +612,7 @@ public:
 
 template <typename PageTable>
 void X86ArchVmAspace::UpdateEntry(vaddr_t vaddr, volatile pt_entry_t* pte, paddr_t paddr,
-                                  arch_flags_t flags) {
+                                  arch_flags_t flags, PendingTlbInvalidation* pending) {
     DEBUG_ASSERT(pte);
     DEBUG_ASSERT(IS_PAGE_ALIGNED(paddr));
 
@@ -533,12 +623,13 @@ void X86ArchVmAspace::UpdateEntry(vaddr_t vaddr, volatile pt_entry_t* pte, paddr
 
     /* attempt to invalidate the page */
     if (IS_PAGE_PRESENT(olde)) {
-        PageTable::tlb_invalidate_page(this, vaddr, is_kernel_address(vaddr));
+        PageTable::tlb_invalidate_page(pending, vaddr, is_kernel_address(vaddr));
     }
 }
 
 template <typename PageTable>
-void X86ArchVmAspace::UnmapEntry(X86ArchVmAspace* aspace, vaddr_t vaddr, volatile pt_entry_t* pte) {
+void X86ArchVmAspace::UnmapEntry(PendingTlbInvalidation* pending, vaddr_t vaddr,
+                                 volatile pt_entry_t* pte) {
     DEBUG_ASSERT(pte);
 
     pt_entry_t olde = *pte;
@@ -547,7 +638,7 @@ void X86ArchVmAspace::UnmapEntry(X86ArchVmAspace* aspace, vaddr_t vaddr, volatil
 
     /* attempt to invalidate the page */
     if (IS_PAGE_PRESENT(olde)) {
-        PageTable::tlb_invalidate_page(aspace, vaddr, is_kernel_address(vaddr));
+        PageTable::tlb_invalidate_page(pending, vaddr, is_kernel_address(vaddr));
     }
 }
 
@@ -571,7 +662,8 @@ static volatile pt_entry_t* _map_alloc_page(void) {
  * @brief Split the given large page into smaller pages
  */
 template <typename PageTable>
-zx_status_t X86ArchVmAspace::SplitLargePage(vaddr_t vaddr, volatile pt_entry_t* pte) {
+zx_status_t X86ArchVmAspace::SplitLargePage(vaddr_t vaddr, volatile pt_entry_t* pte,
+                                            PendingTlbInvalidation* pending) {
     static_assert(PageTable::level != PT_L, "tried splitting PT_L");
     LTRACEF_LEVEL(2, "splitting table %p at level %d\n", pte, PageTable::level);
 
@@ -592,14 +684,14 @@ zx_status_t X86ArchVmAspace::SplitLargePage(vaddr_t vaddr, volatile pt_entry_t*
         volatile pt_entry_t* e = m + i;
         // If this is a PDP_L (i.e. huge page), flags will include the
         // PS bit still, so the new PD entries will be large pages.
-        UpdateEntry<typename PageTable::LowerTable>(new_vaddr, e, new_paddr, flags);
+        UpdateEntry<typename PageTable::LowerTable>(new_vaddr, e, new_paddr, flags, pending);
         new_vaddr += ps;
         new_paddr += ps;
     }
     DEBUG_ASSERT(new_vaddr == vaddr + PageTable::page_size());
 
     flags = PageTable::intermediate_arch_flags();
-    UpdateEntry<PageTable>(vaddr, pte, X86_VIRT_TO_PHYS(m), flags);
+    UpdateEntry<PageTable>(vaddr, pte, X86_VIRT_TO_PHYS(m), flags, pending);
     pt_pages_++;
     return ZX_OK;
 }
@@ -702,7 +794,8 @@ zx_status_t X86ArchVmAspace::GetMappingL0(volatile pt_entry_t* table, vaddr_t va
 template <typename PageTable>
 bool X86ArchVmAspace::RemoveMapping(volatile pt_entry_t* table,
                                     const MappingCursor& start_cursor,
-                                    MappingCursor* new_cursor) {
+                                    MappingCursor* new_cursor,
+                                    PendingTlbInvalidation* pending) {
     DEBUG_ASSERT(table);
     LTRACEF("L: %d, %016" PRIxPTR " %016zx\n", PageTable::level, start_cursor.vaddr,
             start_cursor.size);
@@ -727,7 +820,7 @@ bool X86ArchVmAspace::RemoveMapping(volatile pt_entry_t* table,
             bool vaddr_level_aligned = PageTable::page_aligned(new_cursor->vaddr);
             // If the request covers the entire large page, just unmap it
             if (vaddr_level_aligned && new_cursor->size >= ps) {
-                UnmapEntry<PageTable>(this, new_cursor->vaddr, e);
+                UnmapEntry<PageTable>(pending, new_cursor->vaddr, e);
                 unmapped = true;
 
                 new_cursor->vaddr += ps;
@@ -737,11 +830,11 @@ bool X86ArchVmAspace::RemoveMapping(volatile pt_entry_t* table,
             }
             // Otherwise, we need to split it
             vaddr_t page_vaddr = new_cursor->vaddr & ~(ps - 1);
-            zx_status_t status = SplitLargePage<PageTable>(page_vaddr, e);
+            zx_status_t status = SplitLargePage<PageTable>(page_vaddr, e, pending);
             if (status != ZX_OK) {
                 // If split fails, just unmap the whole thing, and let a
                 // subsequent page fault clean it up.
-                UnmapEntry<PageTable>(this, new_cursor->vaddr, e);
+                UnmapEntry<PageTable>(pending, new_cursor->vaddr, e);
                 unmapped = true;
 
                 new_cursor->SkipEntry<PageTable>();
@@ -753,7 +846,7 @@ bool X86ArchVmAspace::RemoveMapping(volatile pt_entry_t* table,
         MappingCursor cursor;
         volatile pt_entry_t* next_table = get_next_table_from_entry(pt_val);
         bool lower_unmapped = RemoveMapping<typename PageTable::LowerTable>(
-            next_table, *new_cursor, &cursor);
+            next_table, *new_cursor, &cursor, pending);
 
         // If we were requesting to unmap everything in the lower page table,
         // we know we can unmap the lower level page table.  Otherwise, if
@@ -777,7 +870,7 @@ bool X86ArchVmAspace::RemoveMapping(volatile pt_entry_t* table,
             LTRACEF("L: %d free pt v %#" PRIxPTR " phys %#" PRIxPTR "\n",
                     PageTable::level, (uintptr_t)next_table, ptable_phys);
 
-            UnmapEntry<PageTable>(this, new_cursor->vaddr, e);
+            UnmapEntry<PageTable>(pending, new_cursor->vaddr, e);
             vm_page_t* page = paddr_to_vm_page(ptable_phys);
 
             DEBUG_ASSERT(page);
@@ -785,7 +878,7 @@ bool X86ArchVmAspace::RemoveMapping(volatile pt_entry_t* table,
                              "page %p state %u, paddr %#" PRIxPTR "\n", page, page->state,
                              X86_VIRT_TO_PHYS(next_table));
 
-            pmm_free_page(page);
+            pending->free_page(page);
             pt_pages_--;
             unmapped = true;
         }
@@ -801,22 +894,26 @@ bool X86ArchVmAspace::RemoveMapping(volatile pt_entry_t* table,
 template <>
 bool X86ArchVmAspace::RemoveMapping<PageTable<PT_L>>(volatile pt_entry_t* table,
                                                      const MappingCursor& start_cursor,
-                                                     MappingCursor* new_cursor) {
-    return RemoveMappingL0<PageTable<PT_L>>(table, start_cursor, new_cursor);
+                                                     MappingCursor* new_cursor,
+                                                     PendingTlbInvalidation* pending) {
+    return RemoveMappingL0<PageTable<PT_L>>(table, start_cursor, new_cursor, pending);
 }
 
 template <>
 bool X86ArchVmAspace::RemoveMapping<ExtendedPageTable<PT_L>>(volatile pt_entry_t* table,
                                                              const MappingCursor& start_cursor,
-                                                             MappingCursor* new_cursor) {
-    return RemoveMappingL0<ExtendedPageTable<PT_L>>(table, start_cursor, new_cursor);
+                                                             MappingCursor* new_cursor,
+                                                             PendingTlbInvalidation* pending) {
+    return RemoveMappingL0<ExtendedPageTable<PT_L>>(table, start_cursor, new_cursor,
+                                                    pending);
 }
 
 // Base case of RemoveMapping for smallest page size.
 template <typename PageTable>
 bool X86ArchVmAspace::RemoveMappingL0(volatile pt_entry_t* table,
                                       const MappingCursor& start_cursor,
-                                      MappingCursor* new_cursor) {
+                                      MappingCursor* new_cursor,
+                                      PendingTlbInvalidation* pending) {
     static_assert(PageTable::level == PT_L, "RemoveMappingL0 used with wrong level");
     LTRACEF("%016" PRIxPTR " %016zx\n", start_cursor.vaddr, start_cursor.size);
     DEBUG_ASSERT(IS_PAGE_ALIGNED(start_cursor.size));
@@ -828,7 +925,7 @@ bool X86ArchVmAspace::RemoveMappingL0(volatile pt_entry_t* table,
     for (; index != NO_OF_PT_ENTRIES && new_cursor->size != 0; ++index) {
         volatile pt_entry_t* e = table + index;
         if (IS_PAGE_PRESENT(*e)) {
-            UnmapEntry<PageTable>(this, new_cursor->vaddr, e);
+            UnmapEntry<PageTable>(pending, new_cursor->vaddr, e);
             unmapped = true;
         }
 
@@ -857,7 +954,8 @@ bool X86ArchVmAspace::RemoveMappingL0(volatile pt_entry_t* table,
 template <typename PageTable>
 zx_status_t X86ArchVmAspace::AddMapping(volatile pt_entry_t* table, uint mmu_flags,
                                         const MappingCursor& start_cursor,
-                                        MappingCursor* new_cursor) {
+                                        MappingCursor* new_cursor,
+                                        PendingTlbInvalidation* pending) {
     DEBUG_ASSERT(table);
     DEBUG_ASSERT(x86_mmu_check_vaddr(start_cursor.vaddr));
     DEBUG_ASSERT(x86_mmu_check_paddr(start_cursor.paddr));
@@ -888,7 +986,7 @@ zx_status_t X86ArchVmAspace::AddMapping(volatile pt_entry_t* table, uint mmu_fla
 
             UpdateEntry<PageTable>(new_cursor->vaddr, table + index,
                                    new_cursor->paddr,
-                                   arch_flags | X86_MMU_PG_PS);
+                                   arch_flags | X86_MMU_PG_PS, pending);
 
             new_cursor->paddr += ps;
             new_cursor->vaddr += ps;
@@ -906,14 +1004,14 @@ zx_status_t X86ArchVmAspace::AddMapping(volatile pt_entry_t* table, uint mmu_fla
                 LTRACEF_LEVEL(2, "new table %p at level %d\n", m, PageTable::level);
 
                 UpdateEntry<PageTable>(new_cursor->vaddr, e,
-                                       X86_VIRT_TO_PHYS(m), interm_arch_flags);
+                                       X86_VIRT_TO_PHYS(m), interm_arch_flags, pending);
                 pt_val = *e;
                 pt_pages_++;
             }
 
             MappingCursor cursor;
             ret = AddMapping<typename PageTable::LowerTable>(
-                get_next_table_from_entry(pt_val), mmu_flags, *new_cursor, &cursor);
+                get_next_table_from_entry(pt_val), mmu_flags, *new_cursor, &cursor, pending);
             *new_cursor = cursor;
             DEBUG_ASSERT(new_cursor->size <= start_cursor.size);
             if (ret != ZX_OK) {
@@ -929,7 +1027,7 @@ err:
         // new_cursor->size should be how much is left to be mapped still
         cursor.size -= new_cursor->size;
         if (cursor.size > 0) {
-            RemoveMapping<typename PageTable::TopTable>(table, cursor, &result);
+            RemoveMapping<typename PageTable::TopTable>(table, cursor, &result, pending);
             DEBUG_ASSERT(result.size == 0);
         }
     }
@@ -939,24 +1037,27 @@ err:
 template <>
 zx_status_t X86ArchVmAspace::AddMapping<PageTable<PT_L>>(
     volatile pt_entry_t* table, uint mmu_flags,
-    const MappingCursor& start_cursor, MappingCursor* new_cursor) {
+    const MappingCursor& start_cursor, MappingCursor* new_cursor,
+    PendingTlbInvalidation* pending) {
     return AddMappingL0<PageTable<PT_L>>(table, mmu_flags, start_cursor,
-                                         new_cursor);
+                                         new_cursor, pending);
 }
 
 template <>
 zx_status_t X86ArchVmAspace::AddMapping<ExtendedPageTable<PT_L>>(
     volatile pt_entry_t* table, uint mmu_flags,
-    const MappingCursor& start_cursor, MappingCursor* new_cursor) {
+    const MappingCursor& start_cursor, MappingCursor* new_cursor,
+    PendingTlbInvalidation* pending) {
     return AddMappingL0<ExtendedPageTable<PT_L>>(table, mmu_flags, start_cursor,
-                                                 new_cursor);
+                                                 new_cursor, pending);
 }
 
 // Base case of AddMapping for smallest page size.
 template <typename PageTable>
 zx_status_t X86ArchVmAspace::AddMappingL0(volatile pt_entry_t* table, uint mmu_flags,
                                           const MappingCursor& start_cursor,
-                                          MappingCursor* new_cursor) {
+                                          MappingCursor* new_cursor,
+                                          PendingTlbInvalidation* pending) {
     static_assert(PageTable::level == PT_L, "AddMappingL0 used with wrong level");
     DEBUG_ASSERT(IS_PAGE_ALIGNED(start_cursor.size));
 
@@ -971,7 +1072,7 @@ zx_status_t X86ArchVmAspace::AddMappingL0(volatile pt_entry_t* table, uint mmu_f
             return ZX_ERR_ALREADY_EXISTS;
         }
 
-        UpdateEntry<PageTable>(new_cursor->vaddr, e, new_cursor->paddr, arch_flags);
+        UpdateEntry<PageTable>(new_cursor->vaddr, e, new_cursor->paddr, arch_flags, pending);
 
         new_cursor->paddr += PAGE_SIZE;
         new_cursor->vaddr += PAGE_SIZE;
@@ -997,7 +1098,8 @@ template <typename PageTable>
 zx_status_t X86ArchVmAspace::UpdateMapping(volatile pt_entry_t* table,
                                            uint mmu_flags,
                                            const MappingCursor& start_cursor,
-                                           MappingCursor* new_cursor) {
+                                           MappingCursor* new_cursor,
+                                           PendingTlbInvalidation* pending) {
     DEBUG_ASSERT(table);
     LTRACEF("L: %d, %016" PRIxPTR " %016zx\n", PageTable::level, start_cursor.vaddr,
             start_cursor.size);
@@ -1026,7 +1128,7 @@ zx_status_t X86ArchVmAspace::UpdateMapping(volatile pt_entry_t* table,
             if (vaddr_level_aligned && new_cursor->size >= ps) {
                 UpdateEntry<PageTable>(new_cursor->vaddr, e,
                                        PageTable::paddr_from_pte(pt_val),
-                                       arch_flags | X86_MMU_PG_PS);
+                                       arch_flags | X86_MMU_PG_PS, pending);
 
                 new_cursor->vaddr += ps;
                 new_cursor->size -= ps;
@@ -1035,7 +1137,7 @@ zx_status_t X86ArchVmAspace::UpdateMapping(volatile pt_entry_t* table,
             }
             // Otherwise, we need to split it
             vaddr_t page_vaddr = new_cursor->vaddr & ~(ps - 1);
-            ret = SplitLargePage<PageTable>(page_vaddr, e);
+            ret = SplitLargePage<PageTable>(page_vaddr, e, pending);
             if (ret != ZX_OK) {
                 // If we failed to split the table, just unmap it.  Subsequent
                 // page faults will bring it back in.
@@ -1044,7 +1146,7 @@ zx_status_t X86ArchVmAspace::UpdateMapping(volatile pt_entry_t* table,
                 cursor.size = ps;
 
                 MappingCursor tmp_cursor;
-                RemoveMapping<PageTable>(table, cursor, &tmp_cursor);
+                RemoveMapping<PageTable>(table, cursor, &tmp_cursor, pending);
 
                 new_cursor->SkipEntry<PageTable>();
             }
@@ -1054,7 +1156,7 @@ zx_status_t X86ArchVmAspace::UpdateMapping(volatile pt_entry_t* table,
         MappingCursor cursor;
         volatile pt_entry_t* next_table = get_next_table_from_entry(pt_val);
         ret = UpdateMapping<typename PageTable::LowerTable>(next_table, mmu_flags,
-                                                            *new_cursor, &cursor);
+                                                            *new_cursor, &cursor, pending);
         *new_cursor = cursor;
         if (ret != ZX_OK) {
             // Currently this can't happen
@@ -1070,17 +1172,19 @@ zx_status_t X86ArchVmAspace::UpdateMapping(volatile pt_entry_t* table,
 template <>
 zx_status_t X86ArchVmAspace::UpdateMapping<PageTable<PT_L>>(
     volatile pt_entry_t* table, uint mmu_flags,
-    const MappingCursor& start_cursor, MappingCursor* new_cursor) {
+    const MappingCursor& start_cursor, MappingCursor* new_cursor,
+    PendingTlbInvalidation* pending) {
     return UpdateMappingL0<PageTable<PT_L>>(table, mmu_flags,
-                                            start_cursor, new_cursor);
+                                            start_cursor, new_cursor, pending);
 }
 
 template <>
 zx_status_t X86ArchVmAspace::UpdateMapping<ExtendedPageTable<PT_L>>(
     volatile pt_entry_t* table, uint mmu_flags,
-    const MappingCursor& start_cursor, MappingCursor* new_cursor) {
+    const MappingCursor& start_cursor, MappingCursor* new_cursor,
+    PendingTlbInvalidation* pending) {
     return UpdateMappingL0<ExtendedPageTable<PT_L>>(table, mmu_flags,
-                                                    start_cursor, new_cursor);
+                                                    start_cursor, new_cursor, pending);
 }
 
 // Base case of UpdateMapping for smallest page size.
@@ -1088,7 +1192,8 @@ template <typename PageTable>
 zx_status_t X86ArchVmAspace::UpdateMappingL0(volatile pt_entry_t* table,
                                              uint mmu_flags,
                                              const MappingCursor& start_cursor,
-                                             MappingCursor* new_cursor) {
+                                             MappingCursor* new_cursor,
+                                             PendingTlbInvalidation* pending) {
     static_assert(PageTable::level == PT_L, "UpdateMappingL0 used with wrong level");
     LTRACEF("%016" PRIxPTR " %016zx\n", start_cursor.vaddr, start_cursor.size);
     DEBUG_ASSERT(IS_PAGE_ALIGNED(start_cursor.size));
@@ -1105,7 +1210,7 @@ zx_status_t X86ArchVmAspace::UpdateMappingL0(volatile pt_entry_t* table,
         if (IS_PAGE_PRESENT(pt_val)) {
             UpdateEntry<PageTable>(new_cursor->vaddr, e,
                                    PageTable::paddr_from_pte(pt_val),
-                                   arch_flags);
+                                   arch_flags, pending);
         }
 
         new_cursor->vaddr += PAGE_SIZE;
@@ -1116,6 +1221,27 @@ zx_status_t X86ArchVmAspace::UpdateMappingL0(volatile pt_entry_t* table,
     return ZX_OK;
 }
 
+void X86ArchVmAspace::FlushTlb(PendingTlbInvalidation* pending) {
+    if (!pending->empty()) {
+        /* CPUs that have left this aspace may still hold its entries under
+         * its PCID.  Make them flush on their way back in; this must be
+         * ordered after the page table writes and before active_cpus() is
+         * sampled. */
+        if (pcid_ != 0) {
+            tlb_generation_.fetch_add(1);
+        }
+
+        x86_tlb_invalidate(this, pending);
+        tlb_shootdowns_++;
+        pending->clear();
+    }
+
+    /* No CPU can reach the unlinked page tables any more. */
+    if (!list_is_empty(&pending->freed_pages)) {
+        pmm_free(&pending->freed_pages);
+    }
+}
+
 template <template <int> class PageTable>
 zx_status_t X86ArchVmAspace::UnmapPages(vaddr_t vaddr, const size_t count,
                                         size_t* unmapped) {
@@ -1137,7 +1263,9 @@ zx_status_t X86ArchVmAspace::UnmapPages(vaddr_t vaddr, const size_t count,
     };
 
     MappingCursor result;
-    RemoveMapping<PageTable<MAX_PAGING_LEVEL>>(pt_virt_, start, &result);
+    PendingTlbInvalidation pending;
+    RemoveMapping<PageTable<MAX_PAGING_LEVEL>>(pt_virt_, start, &result, &pending);
+    FlushTlb(&pending);
     DEBUG_ASSERT(result.size == 0);
 
     if (unmapped)
@@ -1183,8 +1311,10 @@ zx_status_t X86ArchVmAspace::MapPages(vaddr_t vaddr, paddr_t paddr,
         .paddr = paddr, .vaddr = vaddr, .size = count * PAGE_SIZE,
     };
     MappingCursor result;
+    PendingTlbInvalidation pending;
     zx_status_t status = AddMapping<PageTable<MAX_PAGING_LEVEL>>(pt_virt_, mmu_flags,
-                                                              start, &result);
+                                                              start, &result, &pending);
+    FlushTlb(&pending);
     if (status != ZX_OK) {
         dprintf(SPEW, "Add mapping failed with err=%d\n", status);
         return status;
@@ -1231,8 +1361,10 @@ zx_status_t X86ArchVmAspace::ProtectPages(vaddr_t vaddr, size_t count, uint mmu_
         .paddr = 0, .vaddr = vaddr, .size = count * PAGE_SIZE,
     };
     MappingCursor result;
+    PendingTlbInvalidation pending;
     zx_status_t status = UpdateMapping<PageTable<MAX_PAGING_LEVEL>>(
-        pt_virt_, mmu_flags, start, &result);
+        pt_virt_, mmu_flags, start, &result, &pending);
+    FlushTlb(&pending);
     if (status != ZX_OK) {
         return status;
     }
@@ -1253,11 +1385,22 @@ zx_status_t X86ArchVmAspace::Protect(vaddr_t vaddr, size_t count, uint mmu_flags
 }
 
 void x86_mmu_early_init() {
+    use_pcid = x86_feature_test(X86_FEATURE_PCID);
+    if (use_pcid) {
+        fbl::AutoLock a(&pcid_lock);
+        pcid_bitmap.Reset(X86_NUM_PCIDS);
+        pcid_bitmap.SetOne(0);
+    }
+
     x86_mmu_mem_type_init();
     x86_mmu_percpu_init();
 
-    // Unmap the lower identity mapping.
-    X86ArchVmAspace::UnmapEntry<PageTable<PML4_L>>(nullptr, 0, &pml4[0]);
+    // Unmap the lower identity mapping.  Its entries may be global, and no
+    // other CPU is running yet, so just flush everything locally.
+    PendingTlbInvalidation pending;
+    X86ArchVmAspace::UnmapEntry<PageTable<PML4_L>>(&pending, 0, &pml4[0]);
+    pending.clear();
+    x86_tlb_global_invalidate();
 
     /* get the address width from the CPU */
     uint8_t vaddr_width = x86_linear_address_width();
@@ -1332,7 +1475,10 @@ zx_status_t X86ArchVmAspace::Init(vaddr_t base, size_t size, uint mmu_flags) {
                const_cast<pt_entry_t*>(&KERNEL_PT[NO_OF_PT_ENTRIES / 2]),
                sizeof(pt_entry_t) * NO_OF_PT_ENTRIES / 2);
 
-        LTRACEF("user aspace: pt phys %#" PRIxPTR ", virt %p\n", pt_phys_, pt_virt_);
+        pcid_ = x86_pcid_alloc();
+
+        LTRACEF("user aspace: pt phys %#" PRIxPTR ", virt %p, pcid %u\n",
+                pt_phys_, pt_virt_, pcid_);
     }
     pt_pages_ = 1;
     fbl::atomic_init(&active_cpus_, 0);
@@ -1367,6 +1513,9 @@ zx_status_t X86ArchVmAspace::DestroyAspace() {
     pmm_free_page(paddr_to_vm_page(pt_phys_));
     pt_phys_ = 0;
 
+    x86_pcid_free(pcid_);
+    pcid_ = 0;
+
     return ZX_OK;
 }
 
@@ -1380,16 +1529,32 @@ zx_status_t X86ArchVmAspace::Destroy() {
 }
 
 void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace* aspace) {
-    cpu_mask_t cpu_bit = cpu_num_to_mask(arch_curr_cpu_num());
+    cpu_num_t cpu = arch_curr_cpu_num();
+    cpu_mask_t cpu_bit = cpu_num_to_mask(cpu);
     if (aspace != nullptr) {
         aspace->canary_.Assert();
-        LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, aspace->pt_phys_);
-        x86_set_cr3(aspace->pt_phys_);
+        LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR " pcid %u\n",
+                      aspace, aspace->pt_phys_, aspace->pcid_);
+
+        // Mark ourselves active before sampling the TLB generation, so that
+        // any shootdown that bumps it after the sample also targets us.
+        aspace->active_cpus_.fetch_or(cpu_bit);
+
+        ulong cr3 = aspace->pt_phys_;
+        if (aspace->pcid_ != 0) {
+            cr3 |= aspace->pcid_;
+            uint64_t generation = aspace->tlb_generation_.load();
+            if (aspace->cpu_tlb_generation_[cpu] == generation) {
+                cr3 |= X86_CR3_NOFLUSH;
+            } else {
+                aspace->cpu_tlb_generation_[cpu] = generation;
+            }
+        }
+        x86_set_cr3(cr3);
 
         if (old_aspace != nullptr) {
             old_aspace->active_cpus_.fetch_and(~cpu_bit);
         }
-        aspace->active_cpus_.fetch_or(cpu_bit);
     } else {
         LTRACEF_LEVEL(3, "switching to kernel aspace, pt %#" PRIxPTR "\n", kernel_pt_phys);
         x86_set_cr3(kernel_pt_phys);
@@ -1472,6 +1637,12 @@ zx_status_t X86ArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flag
     }
 }
 
+size_t X86ArchVmAspace::LargePageSize() const {
+    // Both page table formats can map a page directory entry directly, and
+    // split it again on a partial unmap or protect.
+    return 1UL << PD_SHIFT;
+}
+
 void x86_mmu_percpu_init(void) {
     ulong cr0 = x86_get_cr0();
     /* Set write protect bit in CR0*/
@@ -1486,6 +1657,10 @@ void x86_mmu_percpu_init(void) {
         cr4 |= X86_CR4_SMEP;
     if (x86_feature_test(X86_FEATURE_SMAP))
         cr4 |= X86_CR4_SMAP;
+    // PCIDE may only be set while cr3's PCID is 0, which holds for the
+    // kernel aspace we are running on here.
+    if (use_pcid)
+        cr4 |= X86_CR4_PCIDE;
     x86_set_cr4(cr4);
 
     // Set NXE bit in X86_MSR_IA32_EFER.
@@ -149,6 +149,52 @@ static bool mmu_tests(void* context) {
         EXPECT_EQ(err, ZX_OK, "destroy aspace");
     }
 
+    unittest_printf("unmap and protect issue a single TLB shootdown each\n");
+    {
+        ArchVmAspace aspace;
+        vaddr_t base = 1UL << 20;
+        size_t size = (1UL << 47) - base - (1UL << 20);
+        zx_status_t err = aspace.Init(1UL << 20, size, 0);
+        EXPECT_EQ(err, ZX_OK, "init aspace");
+
+        const uint arch_rw_flags = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE;
+
+        // Stay on 4k pages so that every page needs its own invalidation.
+        vaddr_t va = (1UL << PDP_SHIFT) + PAGE_SIZE;
+        static const size_t few_pages = 16;
+        static const size_t many_pages = 256;
+
+        size_t mapped;
+        err = aspace.Map(va, 0, many_pages, arch_rw_flags, &mapped);
+        EXPECT_EQ(err, ZX_OK, "map pages");
+        EXPECT_EQ(aspace.tlb_shootdowns(), 0u, "mapping fresh entries needs no shootdown");
+
+        uint64_t shootdowns = aspace.tlb_shootdowns();
+        err = aspace.Protect(va, many_pages, ARCH_MMU_FLAG_PERM_READ);
+        EXPECT_EQ(err, ZX_OK, "protect pages");
+        EXPECT_EQ(aspace.tlb_shootdowns() - shootdowns, 1u, "protect: one shootdown");
+
+        shootdowns = aspace.tlb_shootdowns();
+        size_t unmapped;
+        err = aspace.Unmap(va, few_pages, &unmapped);
+        EXPECT_EQ(err, ZX_OK, "unmap a few pages");
+        EXPECT_EQ(aspace.tlb_shootdowns() - shootdowns, 1u, "small unmap: one shootdown");
+
+        shootdowns = aspace.tlb_shootdowns();
+        err = aspace.Unmap(va + few_pages * PAGE_SIZE, many_pages - few_pages, &unmapped);
+        EXPECT_EQ(err, ZX_OK, "unmap the rest");
+        EXPECT_EQ(aspace.tlb_shootdowns() - shootdowns, 1u, "large unmap: one shootdown");
+        EXPECT_EQ(aspace.pt_pages(), 1u, "unmap everything");
+
+        shootdowns = aspace.tlb_shootdowns();
+        err = aspace.Unmap(va, many_pages, &unmapped);
+        EXPECT_EQ(err, ZX_OK, "unmap unmapped region");
+        EXPECT_EQ(aspace.tlb_shootdowns() - shootdowns, 0u, "nothing unmapped: no shootdown");
+
+        err = aspace.Destroy();
+        EXPECT_EQ(err, ZX_OK, "destroy aspace");
+    }
+
     unittest_printf("done with mmu tests\n");
     END_TEST;
 }
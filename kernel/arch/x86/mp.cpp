@@ -203,6 +203,34 @@ int x86_apic_id_to_cpu_num(uint32_t apic_id)
     return -1;
 }
 
+static uint32_t cpu_num_to_apic_id(cpu_num_t cpu)
+{
+    if (cpu == 0) {
+        return bp_percpu.apic_id;
+    }
+    if (cpu < x86_num_cpus) {
+        return ap_percpus[cpu - 1].apic_id;
+    }
+    return INVALID_APIC_ID;
+}
+
+cpu_mask_t arch_mp_cache_domain_mask(cpu_num_t cpu)
+{
+    uint32_t apic_id = cpu_num_to_apic_id(cpu);
+    if (apic_id == INVALID_APIC_ID) {
+        return cpu_num_to_mask(cpu);
+    }
+
+    cpu_mask_t mask = 0;
+    for (cpu_num_t i = 0; i < x86_num_cpus; ++i) {
+        uint32_t other = cpu_num_to_apic_id(i);
+        if (other != INVALID_APIC_ID && x86_cpu_topology_same_cache_domain(apic_id, other)) {
+            mask |= cpu_num_to_mask(i);
+        }
+    }
+    return mask;
+}
+
 zx_status_t arch_mp_send_ipi(mp_ipi_target_t target, cpu_mask_t mask, mp_ipi_t ipi)
 {
     uint8_t vector = 0;
@@ -42,4 +42,8 @@ zx_status_t arch_mp_cpu_unplug(cpu_num_t cpu_id);
 
 void arch_mp_init_percpu(void);
 
+/* Returns the mask of cpus which share a last level cache with |cpu|, including
+ * |cpu| itself. The scheduler prefers to move threads within this mask. */
+cpu_mask_t arch_mp_cache_domain_mask(cpu_num_t cpu);
+
 __END_CDECLS
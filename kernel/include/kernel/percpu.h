@@ -25,6 +25,11 @@ struct percpu {
     /* per cpu run queue and bitmap to indicate which queues are non empty */
     struct list_node run_queue[NUM_PRIORITIES];
     uint32_t run_queue_bitmap;
+    uint run_queue_len; /* number of threads queued, used to find work to steal */
+
+    /* rotor used by the scheduler to round robin between cpus, only
+     * touched by this cpu */
+    uint rand_cpu_rotor;
 
     /* timestamp of the last reschedule IPI sent to this cpu */
     /* 0 means no pending IPI */
@@ -29,3 +29,8 @@ bool sched_unblock(thread_t* t) __WARN_UNUSED_RESULT;
 bool sched_unblock_list(struct list_node* list) __WARN_UNUSED_RESULT;
 
 void sched_transition_off_cpu(cpu_num_t old_cpu);
+
+/* set the thread's inherited priority, requeueing it if it is waiting to run.
+ * returns true if the current cpu should reschedule */
+bool sched_inherit_priority(thread_t* t, int priority) __WARN_UNUSED_RESULT;
+int sched_effective_priority(const thread_t* t);
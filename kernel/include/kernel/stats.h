@@ -20,6 +20,10 @@ struct cpu_stats {
     ulong preempts;
     ulong yields;
 
+    /* load balancing */
+    ulong steals;     /* threads this cpu pulled from another cpu's run queue */
+    ulong stolen;     /* threads other cpus pulled from this cpu's run queue */
+
     /* cpu level interrupts and exceptions */
     ulong interrupts;  /* hardware interrupts, minus timer interrupts or inter-processor interrupts */
     ulong timer_ints;  /* timer interrupts */
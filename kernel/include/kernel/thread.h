@@ -92,6 +92,7 @@ typedef struct thread {
 
     int base_priority;
     int priority_boost;
+    int inherited_priority; /* floor on the effective priority, from threads waiting on us */
 
     /* current cpu the thread is either running on or in the ready queue, undefined otherwise */
     cpu_num_t curr_cpu;
@@ -202,6 +203,14 @@ void thread_set_cpu_affinity(thread_t* t, cpu_mask_t mask);
 /* migrates the current thread to the CPU identified by target_cpu */
 void thread_migrate_to_cpu(cpu_num_t target_cpuid);
 
+/* priority inheritance: run |t| at no less than |priority| until changed again, on
+ * behalf of higher priority threads waiting for a lock it holds. passing
+ * LOWEST_PRIORITY drops any inherited priority. */
+void thread_set_inherited_priority(thread_t* t, int priority);
+
+/* the priority the scheduler currently runs |t| at, including boosts and inheritance */
+int thread_get_effective_priority(const thread_t* t);
+
 zx_status_t thread_detach(thread_t* t);
 zx_status_t thread_join(thread_t* t, int* retcode, zx_time_t deadline);
 zx_status_t thread_detach_and_resume(thread_t* t);
@@ -128,6 +128,8 @@ static int cmd_threadstats(int argc, const cmd_args* argv, uint32_t flags) {
         printf("\tcontext_switches: %lu\n", percpu[i].stats.context_switches);
         printf("\tpreempts: %lu\n", percpu[i].stats.preempts);
         printf("\tyields: %lu\n", percpu[i].stats.yields);
+        printf("\tsteals: %lu\n", percpu[i].stats.steals);
+        printf("\tstolen: %lu\n", percpu[i].stats.stolen);
         printf("\tinterrupts: %lu\n", percpu[i].stats.interrupts);
         printf("\ttimer interrupts: %lu\n", percpu[i].stats.timer_ints);
         printf("\ttimers: %lu\n", percpu[i].stats.timers);
@@ -146,7 +148,8 @@ static enum handler_return threadload(struct timer* t, zx_time_t now, void* arg)
            "    pf"
            "  sysc"
            " ints (hw  tmr tmr_cb)"
-           " ipi (rs  gen)\n");
+           " ipi (rs  gen)"
+           " steal (in out)\n");
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
         /* dont display time for inactive cpus */
         if (!mp_is_cpu_active(i))
@@ -172,6 +175,7 @@ static enum handler_return threadload(struct timer* t, zx_time_t now, void* arg)
                " %5lu"
                " %8lu %4lu %6lu"
                " %8lu %4lu"
+               " %9lu %3lu"
                "\n",
                i,
                busypercent / 100, busypercent % 100,
@@ -186,7 +190,9 @@ static enum handler_return threadload(struct timer* t, zx_time_t now, void* arg)
                percpu[i].stats.timer_ints - old_stats[i].timer_ints,
                percpu[i].stats.timers - old_stats[i].timers,
                percpu[i].stats.reschedule_ipis - old_stats[i].reschedule_ipis,
-               percpu[i].stats.generic_ipis - old_stats[i].generic_ipis);
+               percpu[i].stats.generic_ipis - old_stats[i].generic_ipis,
+               percpu[i].stats.steals - old_stats[i].steals,
+               percpu[i].stats.stolen - old_stats[i].stolen);
 
         old_stats[i] = percpu[i].stats;
         last_idle_time[i] = idle_time;
@@ -9,6 +9,7 @@
 #include <assert.h>
 #include <debug.h>
 #include <err.h>
+#include <arch/mp.h>
 #include <inttypes.h>
 #include <kernel/mp.h>
 #include <kernel/percpu.h>
@@ -57,6 +58,9 @@ static bool local_migrate_if_needed(thread_t* curr_thread);
 /* compute the effective priority of a thread */
 static int effec_priority(const thread_t* t) {
     int ep = t->base_priority + t->priority_boost;
+    /* a thread holding a lock runs at least at the priority of its highest waiter */
+    if (unlikely(t->inherited_priority > ep))
+        ep = t->inherited_priority;
     DEBUG_ASSERT(ep >= LOWEST_PRIORITY && ep <= HIGHEST_PRIORITY);
     return ep;
 }
@@ -123,15 +127,15 @@ static cpu_mask_t rand_cpu(cpu_mask_t mask) {
     cpu_num_t highest_cpu = highest_cpu_set(mask);
 
     /* not very random, round robins a bit through the mask until it gets a hit */
+    /* the rotor is per cpu and interrupts are disabled, so it is safe to use non atomically */
+    DEBUG_ASSERT(arch_ints_disabled());
+    uint* rot = &get_local_percpu()->rand_cpu_rotor;
     for (;;) {
-        /* protected by THREAD_LOCK, safe to use non atomically */
-        static uint rot = 0;
-
-        if (++rot > highest_cpu)
-            rot = 0;
+        if (++*rot > highest_cpu)
+            *rot = 0;
 
-        if ((1u << rot) & mask)
-            return (1u << rot);
+        if ((1u << *rot) & mask)
+            return (1u << *rot);
     }
 }
 
@@ -196,29 +200,51 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
 
 /* run queue manipulation */
 static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) {
+    DEBUG_ASSERT(arch_ints_disabled());
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
     int ep = effec_priority(t);
 
-    list_add_head(&percpu[cpu].run_queue[ep], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << ep);
+    struct percpu* c = &percpu[cpu];
+    list_add_head(&c->run_queue[ep], &t->queue_node);
+    c->run_queue_bitmap |= (1u << ep);
+    c->run_queue_len++;
 
     /* mark the cpu as busy since the run queue now has at least one item in it */
     mp_set_cpu_busy(cpu);
 }
 
 static void insert_in_run_queue_tail(cpu_num_t cpu, thread_t* t) {
+    DEBUG_ASSERT(arch_ints_disabled());
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
     int ep = effec_priority(t);
 
-    list_add_tail(&percpu[cpu].run_queue[ep], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << ep);
+    struct percpu* c = &percpu[cpu];
+    list_add_tail(&c->run_queue[ep], &t->queue_node);
+    c->run_queue_bitmap |= (1u << ep);
+    c->run_queue_len++;
 
     /* mark the cpu as busy since the run queue now has at least one item in it */
     mp_set_cpu_busy(cpu);
 }
 
+/* remove a ready thread from the run queue of the cpu it is waiting on */
+static void remove_from_run_queue(thread_t* t) {
+    DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
+
+    struct percpu* c = &percpu[t->curr_cpu];
+    int pri = effec_priority(t);
+
+    DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
+    list_delete(&t->queue_node);
+    if (list_is_empty(&c->run_queue[pri])) {
+        c->run_queue_bitmap &= ~(1u << pri);
+    }
+    c->run_queue_len--;
+}
+
 static thread_t* sched_get_top_thread(cpu_num_t cpu) {
     /* pop the head of the highest priority queue with any threads
      * queued up on the passed in cpu.
@@ -238,6 +264,7 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) {
 
         if (list_is_empty(&c->run_queue[highest_queue]))
             c->run_queue_bitmap &= ~(1u << highest_queue);
+        c->run_queue_len--;
 
         LOCAL_KTRACE2("sched_get_top", newthread->priority_boost, newthread->base_priority);
 
@@ -248,6 +275,107 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) {
     return &c->idle_thread;
 }
 
+/* load balancing */
+/* returns the cpu in |mask| with the most threads waiting in its run queue, or INVALID_CPU
+ * if none of them have any.
+ */
+static cpu_num_t find_busiest_cpu(cpu_mask_t mask) {
+    cpu_num_t busiest = INVALID_CPU;
+    uint busiest_len = 0;
+    while (mask) {
+        cpu_num_t i = lowest_cpu_set(mask);
+        mask &= ~cpu_num_to_mask(i);
+
+        uint len = __atomic_load_n(&percpu[i].run_queue_len, __ATOMIC_RELAXED);
+        if (len > busiest_len) {
+            busiest = i;
+            busiest_len = len;
+        }
+    }
+    return busiest;
+}
+
+/* pull the highest priority thread that is allowed to run on |cpu| out of |victim|'s
+ * run queue, or return NULL if there is none.
+ */
+static thread_t* steal_from_cpu(cpu_num_t cpu, cpu_num_t victim) {
+    struct percpu* c = &percpu[victim];
+    cpu_mask_t cpu_mask = cpu_num_to_mask(cpu);
+
+    uint32_t bitmap = c->run_queue_bitmap;
+    while (bitmap) {
+        uint pri = HIGHEST_PRIORITY - __builtin_clz(bitmap) -
+                   (sizeof(bitmap) * CHAR_BIT - NUM_PRIORITIES);
+        bitmap &= ~(1u << pri);
+
+        thread_t* t;
+        list_for_every_entry (&c->run_queue[pri], t, thread_t, queue_node) {
+            if (!(t->cpu_affinity & cpu_mask))
+                continue;
+
+            list_delete(&t->queue_node);
+            if (list_is_empty(&c->run_queue[pri]))
+                c->run_queue_bitmap &= ~(1u << pri);
+            c->run_queue_len--;
+            return t;
+        }
+    }
+    return NULL;
+}
+
+/* called by a cpu about to go idle: take a waiting thread from the busiest run queue,
+ * looking first at the cpus sharing our last level cache and then at everyone else.
+ * returns true if a thread was moved onto this cpu's run queue.
+ */
+static bool steal_work(cpu_num_t cpu) {
+    cpu_mask_t others = mp_get_active_mask() & ~cpu_num_to_mask(cpu);
+    if (others == 0)
+        return false;
+
+    cpu_mask_t domain = arch_mp_cache_domain_mask(cpu) & others;
+    cpu_mask_t candidates[2] = {domain, others & ~domain};
+
+    for (uint i = 0; i < countof(candidates); i++) {
+        cpu_mask_t mask = candidates[i];
+        cpu_num_t victim;
+        while ((victim = find_busiest_cpu(mask)) != INVALID_CPU) {
+            mask &= ~cpu_num_to_mask(victim);
+
+            thread_t* t = steal_from_cpu(cpu, victim);
+            if (!t)
+                continue;
+
+            LOCAL_KTRACE2("sched_steal", victim, (uint32_t)t->user_tid);
+            CPU_STATS_INC(steals);
+            __atomic_fetch_add(&percpu[victim].stats.stolen, 1u, __ATOMIC_RELAXED);
+
+            t->curr_cpu = cpu;
+            insert_in_run_queue_head(cpu, t);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* called periodically by a busy cpu: if threads are waiting here while some other cpu
+ * they could run on sits idle, kick that cpu so it comes and steals one of them.
+ */
+static void balance_load(cpu_num_t cpu) {
+    if (__atomic_load_n(&percpu[cpu].run_queue_len, __ATOMIC_RELAXED) == 0)
+        return;
+
+    cpu_mask_t idle = mp_get_idle_mask() & mp_get_active_mask() & ~cpu_num_to_mask(cpu);
+    if (idle == 0)
+        return;
+
+    /* prefer waking a cpu which shares our cache */
+    cpu_mask_t target = idle & arch_mp_cache_domain_mask(cpu);
+    if (target == 0)
+        target = idle;
+
+    mp_reschedule(MP_IPI_TARGET_MASK, cpu_num_to_mask(lowest_cpu_set(target)), 0);
+}
+
 void sched_block(void) {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
@@ -402,6 +530,9 @@ void sched_preempt(void) {
             insert_in_run_queue_head(curr_cpu, current_thread);
         } else {
             insert_in_run_queue_tail(curr_cpu, current_thread);
+
+            /* the quantum expired, a good time to see if other cpus should share the load */
+            balance_load(curr_cpu);
         }
     }
 
@@ -440,6 +571,55 @@ void sched_reschedule(void) {
     sched_resched_internal();
 }
 
+int sched_effective_priority(const thread_t* t) {
+    return effec_priority(t);
+}
+
+/* change the priority a thread inherits from its waiters. a thread sitting in a run queue
+ * is moved to the queue for its new priority, and the cpu it waits on is kicked if it
+ * now deserves to run sooner. otherwise the change takes effect the next time it is queued.
+ */
+bool sched_inherit_priority(thread_t* t, int priority) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    if (priority < LOWEST_PRIORITY)
+        priority = LOWEST_PRIORITY;
+    if (priority > HIGHEST_PRIORITY)
+        priority = HIGHEST_PRIORITY;
+    if (t->inherited_priority == priority)
+        return false;
+
+    LOCAL_KTRACE2("sched_inherit", (uint32_t)t->user_tid, priority);
+
+    int old_ep = effec_priority(t);
+    bool queued = (t->state == THREAD_READY) && list_in_list(&t->queue_node);
+    if (queued)
+        remove_from_run_queue(t);
+
+    t->inherited_priority = priority;
+
+    if (!queued)
+        return false;
+
+    cpu_num_t cpu = t->curr_cpu;
+    if (t->remaining_time_slice > 0) {
+        insert_in_run_queue_head(cpu, t);
+    } else {
+        insert_in_run_queue_tail(cpu, t);
+    }
+
+    int new_ep = effec_priority(t);
+    if (new_ep <= old_ep)
+        return false;
+
+    if (cpu == arch_curr_cpu_num())
+        return new_ep > effec_priority(get_current_thread());
+
+    mp_reschedule(MP_IPI_TARGET_MASK, cpu_num_to_mask(cpu), 0);
+    return false;
+}
+
 /* migrate the current thread to a new cpu and locally reschedule to seal the deal */
 static void migrate_current_thread(thread_t* current_thread) {
     bool local_resched = false;
@@ -522,16 +702,7 @@ void sched_migrate(thread_t* t) {
         }
 
         // it's sitting in a run queue somewhere, so pull it out of that one and find a new home
-        DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
-        list_delete(&t->queue_node);
-
-        DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
-
-        struct percpu* c = &percpu[t->curr_cpu];
-        int pri = effec_priority(t);
-        if (list_is_empty(&c->run_queue[pri])) {
-            c->run_queue_bitmap &= ~(1u << pri);
-        }
+        remove_from_run_queue(t);
 
         find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
         break;
@@ -606,6 +777,10 @@ void sched_resched_internal(void) {
 
     CPU_STATS_INC(reschedules);
 
+    /* about to go idle, see if another cpu has threads waiting that we could run instead */
+    if (percpu[cpu].run_queue_bitmap == 0 && mp_is_cpu_active(cpu))
+        steal_work(cpu);
+
     /* pick a new thread to run */
     thread_t* newthread = sched_get_top_thread(cpu);
 
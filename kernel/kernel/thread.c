@@ -635,6 +635,21 @@ void thread_migrate_to_cpu(const cpu_num_t target_cpu) {
     thread_set_cpu_affinity(get_current_thread(), cpu_num_to_mask(target_cpu));
 }
 
+void thread_set_inherited_priority(thread_t* t, int priority) {
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    THREAD_LOCK(state);
+
+    if (t->state != THREAD_DEATH && sched_inherit_priority(t, priority))
+        sched_reschedule();
+
+    THREAD_UNLOCK(state);
+}
+
+int thread_get_effective_priority(const thread_t* t) {
+    return sched_effective_priority(t);
+}
+
 // thread_lock must be held when calling this function.  This function will
 // not return if it decides to kill the thread.
 static void check_kill_signal(thread_t* current_thread,
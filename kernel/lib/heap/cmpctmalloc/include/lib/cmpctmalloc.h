@@ -19,6 +19,15 @@ void* cmpct_realloc(void*, size_t);
 void cmpct_free(void*);
 void* cmpct_memalign(size_t size, size_t alignment);
 
+// Allocates up to |count| non-large areas of |size| bytes under a single
+// acquisition of the heap lock. Returns the number allocated.
+size_t cmpct_alloc_batch(size_t size, void** out, size_t count);
+// Frees |count| areas under a single acquisition of the heap lock.
+void cmpct_free_batch(void** payloads, size_t count);
+// Returns the number of usable bytes in an allocated area, which may be more
+// than was asked for.
+size_t cmpct_usable_size(const void* payload);
+
 void cmpct_init(void);
 void cmpct_dump(bool panic_time);
 void cmpct_get_info(size_t* size_bytes, size_t* free_bytes);
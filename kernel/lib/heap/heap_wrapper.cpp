@@ -14,7 +14,9 @@
 #include <string.h>
 #include <err.h>
 #include <list.h>
+#include <inttypes.h>
 #include <arch/ops.h>
+#include <kernel/auto_lock.h>
 #include <kernel/spinlock.h>
 #include <vm/vm.h>
 #include <vm/pmm.h>
@@ -38,6 +40,235 @@ static bool heap_trace = false;
 #define heap_trace (false)
 #endif
 
+/* Per-cpu slab caches in front of cmpctmalloc.
+ *
+ * Small allocations are rounded up to one of HEAP_SLAB_CLASSES size classes
+ * and served from a per-cpu magazine of previously freed objects of that
+ * class, so the common malloc/free pair does not touch the global heap mutex.
+ * Magazines are refilled from and spilled back to cmpctmalloc in batches of
+ * HEAP_SLAB_BATCH objects under a single acquisition of its lock.
+ *
+ * Every cached object is an ordinary cmpctmalloc allocation, so objects can
+ * flow freely between the two layers: realloc and the heap's own free path
+ * work on them unchanged. The class of an object being freed is recovered
+ * from its cmpctmalloc header.
+ *
+ * The caches are disabled when cmpctmalloc is doing its debug fill checks,
+ * since cached objects bypass them.
+ */
+#ifndef HEAP_SLAB_ENABLE
+#if defined(DEBUG) || LK_DEBUGLEVEL > 2
+#define HEAP_SLAB_ENABLE 0
+#else
+#define HEAP_SLAB_ENABLE 1
+#endif
+#endif
+
+/* 16 byte steps up to 128 bytes, then 4 classes per power of two up to 1KB.
+ * All class sizes are also cmpctmalloc bucket sizes, so no space is lost to
+ * rounding twice. */
+#define HEAP_SLAB_CLASSES 20u
+#define HEAP_SLAB_MAX_SIZE 1024u
+#define HEAP_SLAB_MAGAZINE 32u
+#define HEAP_SLAB_BATCH 16u
+/* cmpctmalloc may hand out a little more than was asked for when the remainder
+ * is too small to split off; such objects still go in the top class. */
+#define HEAP_SLAB_MAX_SLACK 64u
+
+static_assert(HEAP_SLAB_BATCH <= HEAP_SLAB_MAGAZINE, "");
+
+namespace {
+
+struct HeapMagazine {
+    size_t count = 0;
+    void* objs[HEAP_SLAB_MAGAZINE] = {};
+
+    // statistics
+    uint64_t alloc_hits = 0;   // allocations served from the magazine
+    uint64_t alloc_misses = 0; // allocations that had to refill from the heap
+    uint64_t free_hits = 0;    // frees absorbed by the magazine
+    uint64_t free_spills = 0;  // times the magazine was spilled to the heap
+};
+
+struct HeapSlabCpu {
+    // protects all of the magazines
+    SpinLock lock;
+
+    HeapMagazine mags[HEAP_SLAB_CLASSES];
+} __CPU_ALIGN;
+
+} // namespace
+
+static HeapSlabCpu heap_slab[SMP_MAX_CPUS];
+
+/* smallest class that holds |size| bytes, 0 < size <= HEAP_SLAB_MAX_SIZE */
+static inline uint heap_slab_class(size_t size)
+{
+    if (size <= 128)
+        return (uint)((size + 15) / 16 - 1);
+
+    uint order = (uint)(sizeof(unsigned long) * 8 - 1 - __builtin_clzl(size - 1));
+    uint step_shift = order - 2;
+    return 8 + (order - 7) * 4 + (uint)(((size - 1) - (1ul << order)) >> step_shift);
+}
+
+static inline size_t heap_slab_class_size(uint c)
+{
+    if (c < 8)
+        return (c + 1) * 16;
+
+    uint order = 7 + (c - 8) / 4;
+    return (1ul << order) + (((c - 8) % 4) + 1) * (1ul << (order - 2));
+}
+
+/* returns true and the class to cache a freed object in, based on the number of
+ * usable bytes it has. Objects are cached in the largest class they can satisfy. */
+static inline bool heap_slab_class_for_free(size_t usable, uint* c)
+{
+    if (usable < 16 || usable > HEAP_SLAB_MAX_SIZE + HEAP_SLAB_MAX_SLACK)
+        return false;
+
+    if (usable >= HEAP_SLAB_MAX_SIZE) {
+        *c = HEAP_SLAB_CLASSES - 1;
+        return true;
+    }
+
+    uint cl = heap_slab_class(usable);
+    if (heap_slab_class_size(cl) > usable)
+        cl--;
+    *c = cl;
+    return true;
+}
+
+static void *heap_slab_alloc(uint c)
+{
+    HeapSlabCpu* cpu = &heap_slab[arch_curr_cpu_num()];
+    HeapMagazine* mag = &cpu->mags[c];
+    {
+        AutoSpinLockIrqSave guard(&cpu->lock);
+        if (mag->count > 0) {
+            mag->alloc_hits++;
+            return mag->objs[--mag->count];
+        }
+        mag->alloc_misses++;
+    }
+
+    /* refill outside of the spinlock, the heap lock is a mutex */
+    void* batch[HEAP_SLAB_BATCH];
+    size_t count = cmpct_alloc_batch(heap_slab_class_size(c), batch, HEAP_SLAB_BATCH);
+    if (count == 0)
+        return NULL;
+
+    size_t i = 1;
+    {
+        AutoSpinLockIrqSave guard(&cpu->lock);
+        for (; i < count && mag->count < HEAP_SLAB_MAGAZINE; i++) {
+            mag->objs[mag->count++] = batch[i];
+        }
+    }
+    /* someone else filled the magazine while we were refilling */
+    if (i < count)
+        cmpct_free_batch(&batch[i], count - i);
+
+    return batch[0];
+}
+
+static bool heap_slab_free(void *ptr)
+{
+    uint c;
+    if (!heap_slab_class_for_free(cmpct_usable_size(ptr), &c))
+        return false;
+
+    HeapSlabCpu* cpu = &heap_slab[arch_curr_cpu_num()];
+    HeapMagazine* mag = &cpu->mags[c];
+    void* spill[HEAP_SLAB_BATCH];
+    {
+        AutoSpinLockIrqSave guard(&cpu->lock);
+        if (mag->count < HEAP_SLAB_MAGAZINE) {
+            mag->free_hits++;
+            mag->objs[mag->count++] = ptr;
+            return true;
+        }
+
+        /* full, spill the oldest half of the magazine back to the heap */
+        mag->free_spills++;
+        memcpy(spill, mag->objs, sizeof(spill));
+        memmove(mag->objs, &mag->objs[HEAP_SLAB_BATCH],
+                (HEAP_SLAB_MAGAZINE - HEAP_SLAB_BATCH) * sizeof(void*));
+        mag->count -= HEAP_SLAB_BATCH;
+        mag->objs[mag->count++] = ptr;
+    }
+    cmpct_free_batch(spill, HEAP_SLAB_BATCH);
+    return true;
+}
+
+/* returns every cached object to the heap */
+static void heap_slab_drain_all(void)
+{
+    for (auto& cpu : heap_slab) {
+        for (auto& mag : cpu.mags) {
+            void* drain[HEAP_SLAB_MAGAZINE];
+            size_t count;
+            {
+                AutoSpinLockIrqSave guard(&cpu.lock);
+                count = mag.count;
+                memcpy(drain, mag.objs, count * sizeof(void*));
+                mag.count = 0;
+            }
+            if (count > 0)
+                cmpct_free_batch(drain, count);
+        }
+    }
+}
+
+static size_t heap_slab_cached_bytes(void)
+{
+    size_t bytes = 0;
+    for (const auto& cpu : heap_slab) {
+        for (uint c = 0; c < HEAP_SLAB_CLASSES; c++) {
+            bytes += __atomic_load_n(&cpu.mags[c].count, __ATOMIC_RELAXED) *
+                     heap_slab_class_size(c);
+        }
+    }
+    return bytes;
+}
+
+/* No lock here in the panic case, the counters are only read. */
+static void heap_slab_dump(bool panic_time)
+{
+    printf("slab caches (%s):\n", HEAP_SLAB_ENABLE ? "enabled" : "disabled");
+    for (uint c = 0; c < HEAP_SLAB_CLASSES; c++) {
+        size_t cached = 0;
+        uint64_t alloc_hits = 0, alloc_misses = 0, free_hits = 0, free_spills = 0;
+        for (uint i = 0; i < arch_max_num_cpus(); i++) {
+            HeapSlabCpu* cpu = &heap_slab[i];
+            spin_lock_saved_state_t state;
+            if (!panic_time)
+                cpu->lock.AcquireIrqSave(state);
+            const HeapMagazine& mag = cpu->mags[c];
+            cached += mag.count;
+            alloc_hits += mag.alloc_hits;
+            alloc_misses += mag.alloc_misses;
+            free_hits += mag.free_hits;
+            free_spills += mag.free_spills;
+            if (!panic_time)
+                cpu->lock.ReleaseIrqRestore(state);
+        }
+        printf("\tsize %4zu: cached %4zu alloc hits %" PRIu64 " misses %" PRIu64
+               " free hits %" PRIu64 " spills %" PRIu64 "\n",
+               heap_slab_class_size(c), cached, alloc_hits, alloc_misses,
+               free_hits, free_spills);
+    }
+}
+
+static void *heap_alloc(size_t size)
+{
+    if (HEAP_SLAB_ENABLE && size != 0 && size <= HEAP_SLAB_MAX_SIZE)
+        return heap_slab_alloc(heap_slab_class(size));
+
+    return cmpct_alloc(size);
+}
+
 void heap_init(void)
 {
     cmpct_init();
@@ -45,6 +276,7 @@ void heap_init(void)
 
 void heap_trim(void)
 {
+    heap_slab_drain_all();
     cmpct_trim();
 }
 
@@ -54,7 +286,7 @@ void *malloc(size_t size)
 
     LTRACEF("size %zu\n", size);
 
-    void *ptr = cmpct_alloc(size);
+    void *ptr = heap_alloc(size);
     if (unlikely(heap_trace))
         printf("caller %p malloc %zu -> %p\n", __GET_CALLER(), size, ptr);
 
@@ -90,7 +322,7 @@ void *calloc(size_t count, size_t size)
 
     size_t realsize = count * size;
 
-    void *ptr = cmpct_alloc(realsize);
+    void *ptr = heap_alloc(realsize);
     if (likely(ptr))
         memset(ptr, 0, realsize);
     if (unlikely(heap_trace))
@@ -123,16 +355,22 @@ void free(void *ptr)
     if (unlikely(heap_trace))
         printf("caller %p free %p\n", __GET_CALLER(), ptr);
 
+    if (HEAP_SLAB_ENABLE && ptr && heap_slab_free(ptr))
+        return;
+
     cmpct_free(ptr);
 }
 
 static void heap_dump(bool panic_time)
 {
     cmpct_dump(panic_time);
+    heap_slab_dump(panic_time);
 }
 
 void heap_get_info(size_t *size_bytes, size_t *free_bytes) {
     cmpct_get_info(size_bytes, free_bytes);
+    /* objects sitting in the slab caches are free as far as callers care */
+    *free_bytes += heap_slab_cached_bytes();
 }
 
 static void heap_test(void)
@@ -189,6 +427,7 @@ usage:
         if (!(flags & CMD_FLAG_PANIC)) {
             printf("\t%s trace\n", argv[0].str);
             printf("\t%s trim\n", argv[0].str);
+            printf("\t%s drain_slab\n", argv[0].str);
             printf("\t%s alloc <size> [alignment]\n", argv[0].str);
             printf("\t%s realloc <ptr> <size>\n", argv[0].str);
             printf("\t%s free <address>\n", argv[0].str);
@@ -205,6 +444,8 @@ usage:
         printf("heap trace is now %s\n", heap_trace ? "on" : "off");
     } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "trim") == 0) {
         heap_trim();
+    } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "drain_slab") == 0) {
+        heap_slab_drain_all();
     } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "alloc") == 0) {
         if (argc < 3) goto notenoughargs;
 
@@ -29,7 +29,8 @@ FutexContext::~FutexContext() {
     DEBUG_ASSERT(futex_table_.is_empty());
 }
 
-zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline) {
+zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int current_value,
+                                    fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline) {
     LTRACE_ENTRY;
 
     uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
@@ -60,10 +61,20 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     ThreadDispatcher* thread = ThreadDispatcher::GetCurrent();
     node = thread->futex_node();
     node->set_hash_key(futex_key);
+    node->set_thread(get_current_thread());
     node->SetAsSingletonList();
 
     QueueNodesLocked(node);
 
+    if (owner) {
+        // Lend our priority to the owner before we block, so that it cannot
+        // be starved by threads of intermediate priority while we wait.
+        int priority = thread->effective_priority();
+        if (priority > owner->inherited_priority())
+            owner->SetInheritedPriority(priority);
+        node->set_pi_owner(fbl::move(owner));
+    }
+
     // Block current thread.  This releases lock_ and does not reacquire it.
     result = node->BlockThread(&lock_, deadline);
     if (result == ZX_OK) {
@@ -80,6 +91,9 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     // queue, because FutexWake() probably didn't do that.
     AutoLock lock(&lock_);
     if (UnqueueNodeLocked(node)) {
+        fbl::RefPtr<ThreadDispatcher> pi_owner = node->take_pi_owner();
+        if (pi_owner)
+            UpdateInheritedPriorityLocked(pi_owner.get());
         return result;
     }
     // The current thread was not found on the wait queue.  This means
@@ -123,6 +137,14 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
     }
     DEBUG_ASSERT(node->GetKey() == futex_key);
 
+    // For a priority-inheriting futex, handing the lock to a single waiter
+    // makes that waiter the owner that the remaining waiters boost.  This
+    // must be looked up before WakeThreads(), which may free |node|.
+    fbl::RefPtr<ThreadDispatcher> old_owner = node->pi_owner();
+    fbl::RefPtr<ThreadDispatcher> new_owner;
+    if (old_owner && count == 1)
+        new_owner = fbl::WrapRefPtr(reinterpret_cast<ThreadDispatcher*>(node->thread()->user_thread));
+
     bool any_woken = false;
     FutexNode* remaining_waiters =
         FutexNode::WakeThreads(node, count, futex_key, &any_woken);
@@ -130,8 +152,21 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
     if (remaining_waiters) {
         DEBUG_ASSERT(remaining_waiters->GetKey() == futex_key);
         futex_table_.insert(remaining_waiters);
+        if (new_owner) {
+            FutexNode::SetListPiOwner(remaining_waiters, new_owner);
+            UpdateInheritedPriorityLocked(new_owner.get());
+        }
     }
 
+    if (old_owner)
+        UpdateInheritedPriorityLocked(old_owner.get());
+
+    // The waker usually is the owner; if it was lent a priority for a lock
+    // it has now released, drop it even if the waiters named a stale owner.
+    ThreadDispatcher* current = ThreadDispatcher::GetCurrent();
+    if (current != old_owner.get() && current->inherited_priority() != LOWEST_PRIORITY)
+        UpdateInheritedPriorityLocked(current);
+
     if (any_woken) {
         lock.release();
         thread_reschedule();
@@ -169,6 +204,8 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
         return ZX_OK;
     }
 
+    fbl::RefPtr<ThreadDispatcher> old_owner = node->pi_owner();
+
     bool any_woken = false;
     if (wake_count > 0) {
         node = FutexNode::WakeThreads(node, wake_count, wake_key, &any_woken);
@@ -182,6 +219,11 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
             node = FutexNode::RemoveFromHead(node, requeue_count,
                                              wake_key, requeue_key);
 
+            // Requeued waiters no longer wait on the lock they named an
+            // owner for, so they stop boosting it.
+            if (requeue_head->pi_owner())
+                FutexNode::SetListPiOwner(requeue_head, nullptr);
+
             // now requeue our nodes to requeue_ptr mutex
             DEBUG_ASSERT(requeue_head->GetKey() == requeue_key);
             QueueNodesLocked(requeue_head);
@@ -194,6 +236,12 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
         futex_table_.insert(node);
     }
 
+    if (old_owner)
+        UpdateInheritedPriorityLocked(old_owner.get());
+    ThreadDispatcher* current = ThreadDispatcher::GetCurrent();
+    if (current != old_owner.get() && current->inherited_priority() != LOWEST_PRIORITY)
+        UpdateInheritedPriorityLocked(current);
+
     if (any_woken) {
         lock.release();
         thread_reschedule();
@@ -237,3 +285,17 @@ bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
         futex_table_.insert(new_head);
     return true;
 }
+
+void FutexContext::UpdateInheritedPriorityLocked(ThreadDispatcher* owner) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // Waiters of one futex normally name the same owner, but a thread may
+    // own several locks, so every active futex has to be considered.
+    int priority = LOWEST_PRIORITY;
+    for (auto& head : futex_table_) {
+        int waiter_priority = FutexNode::MaxPiWaiterPriority(&head, owner);
+        if (waiter_priority > priority)
+            priority = waiter_priority;
+    }
+    owner->SetInheritedPriority(priority);
+}
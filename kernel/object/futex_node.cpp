@@ -9,6 +9,7 @@
 #include <assert.h>
 #include <err.h>
 #include <fbl/mutex.h>
+#include <object/thread_dispatcher.h>
 #include <platform.h>
 #include <trace.h>
 #include <zircon/types.h>
@@ -87,6 +88,8 @@ FutexNode* FutexNode::WakeThreads(FutexNode* node, uint32_t count,
         DEBUG_ASSERT(node->GetKey() == old_hash_key);
         // Clear this field to avoid any possible confusion.
         node->set_hash_key(0);
+        // A woken waiter no longer lends its priority to the lock owner.
+        node->pi_owner_.reset();
 
         const bool is_last_node = (node == list_end);
         FutexNode* next = node->queue_next_;
@@ -146,6 +149,37 @@ FutexNode* FutexNode::RemoveFromHead(FutexNode* list_head, uint32_t count,
     return node;
 }
 
+void FutexNode::set_pi_owner(fbl::RefPtr<ThreadDispatcher> owner) {
+    pi_owner_ = fbl::move(owner);
+}
+
+fbl::RefPtr<ThreadDispatcher> FutexNode::take_pi_owner() {
+    return fbl::move(pi_owner_);
+}
+
+void FutexNode::SetListPiOwner(FutexNode* list_head,
+                               const fbl::RefPtr<ThreadDispatcher>& owner) {
+    FutexNode* node = list_head;
+    do {
+        node->pi_owner_ = owner;
+        node = node->queue_next_;
+    } while (node != list_head);
+}
+
+int FutexNode::MaxPiWaiterPriority(FutexNode* list_head, const ThreadDispatcher* owner) {
+    int max_priority = -1;
+    FutexNode* node = list_head;
+    do {
+        if (node->pi_owner_.get() == owner) {
+            int priority = thread_get_effective_priority(node->thread_);
+            if (priority > max_priority)
+                max_priority = priority;
+        }
+        node = node->queue_next_;
+    } while (node != list_head);
+    return max_priority;
+}
+
 // This blocks the current thread.  This releases the given mutex (which
 // must be held when BlockThread() is called).  To reduce contention, it
 // does not reclaim the mutex on return.
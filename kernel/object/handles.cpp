@@ -11,14 +11,21 @@
 
 #include <object/handles.h>
 
+#include <inttypes.h>
 #include <pow2.h>
+#include <string.h>
 #include <trace.h>
 
+#include <arch/ops.h>
+#include <kernel/auto_lock.h>
+#include <kernel/spinlock.h>
+
 #include <object/diagnostics.h>
 #include <object/dispatcher.h>
 #include <object/handle.h>
 
 #include <fbl/arena.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/mutex.h>
 
@@ -33,13 +40,46 @@ constexpr size_t kMaxHandleCount = 256 * 1024u;
 // there are this many outstanding handles.
 constexpr size_t kHighHandleCount = (kMaxHandleCount * 7) / 8;
 
-// The handle arena and its mutex. It also guards Dispatcher::handle_count_.
+// The handle arena and its mutex.
 static fbl::Mutex handle_mutex;
 static fbl::Arena TA_GUARDED(handle_mutex) handle_arena;
 
+// Per-cpu shards of free handle slots in front of |handle_arena|. Handle
+// creation and destruction take slots from and return slots to the current
+// cpu's shard without touching |handle_mutex|; shards are refilled from and
+// spilled back to the arena in batches of kHandleShardBatch slots.
+//
+// Slots sitting in a shard are free: TearDownHandle has already stashed their
+// last base_value, so generation numbers carry over exactly as they would
+// through the arena's own free list.
+constexpr size_t kHandleShardMax = 64u;
+constexpr size_t kHandleShardBatch = 32u;
+static_assert(kHandleShardBatch <= kHandleShardMax, "");
+
+namespace {
+
+struct HandleShard {
+    // protects all of the fields below
+    SpinLock lock;
+
+    size_t count = 0;
+    void* slots[kHandleShardMax] = {};
+
+    // statistics
+    uint64_t alloc_hits = 0;   // slots handed out of the shard
+    uint64_t alloc_misses = 0; // allocations that had to go to the arena
+    uint64_t free_spills = 0;  // times the shard was spilled to the arena
+} __CPU_ALIGN;
+
+} // namespace
+
+static HandleShard handle_shards[SMP_MAX_CPUS];
+
+// The number of live handles. Slots cached in the shards are not counted.
+static fbl::atomic<size_t> outstanding_handle_count;
+
 size_t diagnostics::OutstandingHandles() {
-    AutoLock lock(&handle_mutex);
-    return handle_arena.DiagnosticCount();
+    return outstanding_handle_count.load();
 }
 
 // Masks for building a Handle's base_value, which ProcessDispatcher
@@ -70,7 +110,10 @@ static_assert(((3 << 30) ^ kHandleGenerationMask ^ kHandleIndexMask) ==
 // Returns a new |base_value| based on the value stored in the free
 // |handle_arena| slot pointed to by |addr|. The new value will be different
 // from the last |base_value| used by this slot.
-static uint32_t GetNewHandleBaseValue(void* addr) TA_REQ(handle_mutex) {
+//
+// The caller must own the slot; the start of the arena does not change after
+// HandleTableInit, so no lock is needed.
+static uint32_t GetNewHandleBaseValue(void* addr) TA_NO_THREAD_SAFETY_ANALYSIS {
     // Get the index of this slot within handle_arena.
     auto va = reinterpret_cast<Handle*>(addr) -
               reinterpret_cast<Handle*>(handle_arena.start());
@@ -119,58 +162,136 @@ void internal::TearDownHandle(Handle* handle) TA_EXCL(handle_mutex) {
 
 static void high_handle_count(size_t count) {
     // TODO: Avoid calling this for every handle after kHighHandleCount;
-    // printfs are slow and |handle_mutex| is held by our caller.
+    // printfs are slow.
     printf("WARNING: High handle count: %zu handles\n", count);
 }
 
-Handle* MakeHandle(fbl::RefPtr<Dispatcher> dispatcher, zx_rights_t rights) {
-    void* addr;
-    uint32_t base_value;
+// Returns free slots to the arena.
+static void FreeHandleSlots(void** slots, size_t count) {
+    AutoLock lock(&handle_mutex);
+    for (size_t i = 0; i < count; i++) {
+        handle_arena.Free(slots[i]);
+    }
+}
+
+// Returns every slot cached in every shard to the arena.
+static void DrainHandleShards() {
+    for (auto& shard : handle_shards) {
+        void* drain[kHandleShardMax];
+        size_t count;
+        {
+            AutoSpinLockIrqSave guard(&shard.lock);
+            count = shard.count;
+            memcpy(drain, shard.slots, count * sizeof(void*));
+            shard.count = 0;
+        }
+        if (count > 0)
+            FreeHandleSlots(drain, count);
+    }
+}
+
+// Allocates a free slot, preferring the current cpu's shard.
+static void* AllocHandleSlot() {
+    HandleShard* shard = &handle_shards[arch_curr_cpu_num()];
+    {
+        AutoSpinLockIrqSave guard(&shard->lock);
+        if (shard->count > 0) {
+            shard->alloc_hits++;
+            return shard->slots[--shard->count];
+        }
+        shard->alloc_misses++;
+    }
 
+    void* batch[kHandleShardBatch];
+    size_t count = 0;
     {
         AutoLock lock(&handle_mutex);
-        addr = handle_arena.Alloc();
-        const size_t outstanding_handles = handle_arena.DiagnosticCount();
-        if (addr == nullptr) {
-            lock.release();
-            printf("WARNING: Could not allocate new handle (%zu outstanding)\n",
-                   outstanding_handles);
-            return nullptr;
+        while (count < kHandleShardBatch) {
+            void* addr = handle_arena.Alloc();
+            if (addr == nullptr)
+                break;
+            batch[count++] = addr;
         }
-        if (outstanding_handles > kHighHandleCount)
-            high_handle_count(outstanding_handles);
+    }
 
-        dispatcher->increment_handle_count();
+    if (count == 0) {
+        // The arena is exhausted, but other cpus may be sitting on free
+        // slots. Pull them back and try once more.
+        DrainHandleShards();
+        AutoLock lock(&handle_mutex);
+        return handle_arena.Alloc();
+    }
 
-        base_value = GetNewHandleBaseValue(addr);
+    size_t i = 1;
+    {
+        AutoSpinLockIrqSave guard(&shard->lock);
+        for (; i < count && shard->count < kHandleShardMax; i++) {
+            shard->slots[shard->count++] = batch[i];
+        }
     }
+    if (i < count)
+        FreeHandleSlots(&batch[i], count - i);
 
-    return new (addr) Handle(fbl::move(dispatcher), rights, base_value);
+    return batch[0];
 }
 
-Handle* DupHandle(Handle* source, zx_rights_t rights) {
-    fbl::RefPtr<Dispatcher> dispatcher(source->dispatcher());
-    void* addr;
-    uint32_t base_value;
-
+// Frees a slot into the current cpu's shard, spilling the oldest half of the
+// shard to the arena if it is full.
+static void FreeHandleSlot(void* addr) {
+    HandleShard* shard = &handle_shards[arch_curr_cpu_num()];
+    void* spill[kHandleShardBatch];
     {
-        AutoLock lock(&handle_mutex);
-        addr = handle_arena.Alloc();
-        const size_t outstanding_handles = handle_arena.DiagnosticCount();
-        if (addr == nullptr) {
-            lock.release();
-            printf("WARNING: Could not allocate duplicate handle (%zu outstanding)\n",
-                   outstanding_handles);
-            return nullptr;
+        AutoSpinLockIrqSave guard(&shard->lock);
+        if (shard->count < kHandleShardMax) {
+            shard->slots[shard->count++] = addr;
+            return;
         }
-        if (outstanding_handles > kHighHandleCount)
-            high_handle_count(outstanding_handles);
 
-        dispatcher->increment_handle_count();
+        shard->free_spills++;
+        memcpy(spill, shard->slots, sizeof(spill));
+        memmove(shard->slots, &shard->slots[kHandleShardBatch],
+                (kHandleShardMax - kHandleShardBatch) * sizeof(void*));
+        shard->count -= kHandleShardBatch;
+        shard->slots[shard->count++] = addr;
+    }
+    FreeHandleSlots(spill, kHandleShardBatch);
+}
 
-        base_value = GetNewHandleBaseValue(addr);
+// Allocates a slot for a new handle to |dispatcher| and returns its
+// base_value, or nullptr if the handle table is full.
+static void* NewHandleSlot(Dispatcher* dispatcher, const char* what, uint32_t* base_value) {
+    void* addr = AllocHandleSlot();
+    if (addr == nullptr) {
+        printf("WARNING: Could not allocate %s handle (%zu outstanding)\n",
+               what, outstanding_handle_count.load());
+        return nullptr;
     }
 
+    const size_t outstanding_handles = outstanding_handle_count.fetch_add(1u) + 1u;
+    if (outstanding_handles > kHighHandleCount)
+        high_handle_count(outstanding_handles);
+
+    dispatcher->increment_handle_count();
+
+    *base_value = GetNewHandleBaseValue(addr);
+    return addr;
+}
+
+Handle* MakeHandle(fbl::RefPtr<Dispatcher> dispatcher, zx_rights_t rights) {
+    uint32_t base_value;
+    void* addr = NewHandleSlot(dispatcher.get(), "new", &base_value);
+    if (addr == nullptr)
+        return nullptr;
+
+    return new (addr) Handle(fbl::move(dispatcher), rights, base_value);
+}
+
+Handle* DupHandle(Handle* source, zx_rights_t rights) {
+    uint32_t base_value;
+    void* addr = NewHandleSlot(source->dispatcher().get(), "duplicate", &base_value);
+    if (addr == nullptr)
+        return nullptr;
+
     return new (addr) Handle(source, rights, base_value);
 }
 
@@ -186,14 +307,9 @@ void DeleteHandle(Handle* handle) {
     // base_value for reuse the next time this slot is allocated.
     internal::TearDownHandle(handle);
 
-    bool zero_handles = false;
-    {
-        AutoLock lock(&handle_mutex);
-
-        zero_handles = dispatcher->decrement_handle_count();
-
-        handle_arena.Free(handle);
-    }
+    bool zero_handles = dispatcher->decrement_handle_count();
+    outstanding_handle_count.fetch_sub(1u);
+    FreeHandleSlot(handle);
 
     if (zero_handles) {
         dispatcher->on_zero_handles();
@@ -205,7 +321,6 @@ void DeleteHandle(Handle* handle) {
 }
 
 uint32_t GetHandleCount(const fbl::RefPtr<const Dispatcher>& dispatcher) {
-    AutoLock lock(&handle_mutex);
     return dispatcher->current_handle_count();
 }
 
@@ -222,8 +337,25 @@ Handle* MapU32ToHandle(uint32_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
 }
 
 void diagnostics::DumpHandleTableInfo() {
-    AutoLock lock(&handle_mutex);
-    handle_arena.Dump();
+    {
+        AutoLock lock(&handle_mutex);
+        handle_arena.Dump();
+    }
+    for (uint i = 0; i < arch_max_num_cpus(); i++) {
+        HandleShard* shard = &handle_shards[i];
+        size_t count;
+        uint64_t alloc_hits, alloc_misses, free_spills;
+        {
+            AutoSpinLockIrqSave guard(&shard->lock);
+            count = shard->count;
+            alloc_hits = shard->alloc_hits;
+            alloc_misses = shard->alloc_misses;
+            free_spills = shard->free_spills;
+        }
+        printf("cpu %2u: cached %2zu alloc hits %" PRIu64 " misses %" PRIu64
+               " spills %" PRIu64 "\n",
+               i, count, alloc_hits, alloc_misses, free_spills);
+    }
 }
 
 void HandleTableInit() TA_NO_THREAD_SAFETY_ANALYSIS {
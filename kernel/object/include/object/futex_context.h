@@ -9,8 +9,11 @@
 #include <lib/user_copy/user_ptr.h>
 #include <zircon/types.h>
 #include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
 #include <object/futex_node.h>
 
+class ThreadDispatcher;
+
 // FutexContext is a class that encapsulates support for futex operations.
 // FutexContext uses a hash table keyed on the futex address (a pointer to integer in userspace)
 // to contain all active futexes.
@@ -33,7 +36,14 @@ public:
     // Otherwise it will block the current thread until the |deadline| passes,
     // or until the thread is woken by a FutexWake or FutexRequeue operation
     // on the same |value_ptr| futex.
-    zx_status_t FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline);
+    //
+    // If |owner| is non-null the futex is treated as a priority-inheriting
+    // lock held by |owner|: while the current thread waits, |owner| runs at
+    // no less than the current thread's priority.  When a single waiter is
+    // woken from such a futex, it becomes the owner on behalf of the
+    // remaining waiters.
+    zx_status_t FutexWait(user_in_ptr<const int> value_ptr, int current_value,
+                          fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline);
 
     // FutexWake will wake up to |count| number of threads blocked on the |value_ptr| futex.
     zx_status_t FutexWake(user_in_ptr<const int> value_ptr, uint32_t count);
@@ -55,6 +65,10 @@ private:
 
     bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
 
+    // Recomputes the priority |owner| inherits from the threads waiting on
+    // futexes it owns in this context.
+    void UpdateInheritedPriorityLocked(ThreadDispatcher* owner) TA_REQ(lock_);
+
     // protects futex_table_
     fbl::Mutex lock_;
 
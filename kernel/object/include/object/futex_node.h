@@ -12,6 +12,9 @@
 #include <zircon/types.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+
+class ThreadDispatcher;
 
 // Node for linked list of threads blocked on a futex
 // Intended to be embedded within a ThreadDispatcher Instance
@@ -48,6 +51,24 @@ public:
         hash_key_ = key;
     }
 
+    void set_thread(thread_t* thread) { thread_ = thread; }
+    thread_t* thread() const { return thread_; }
+
+    // Priority inheritance.  The PI owner is the thread that the waiter
+    // named as the holder of the lock it is blocked on; it is null for
+    // ordinary futex waits.
+    void set_pi_owner(fbl::RefPtr<ThreadDispatcher> owner);
+    fbl::RefPtr<ThreadDispatcher> take_pi_owner();
+    const fbl::RefPtr<ThreadDispatcher>& pi_owner() const { return pi_owner_; }
+
+    // Sets |owner| as the PI owner of every node in the list |list_head|.
+    static void SetListPiOwner(FutexNode* list_head,
+                               const fbl::RefPtr<ThreadDispatcher>& owner);
+
+    // Returns the highest effective priority of the threads in the list
+    // |list_head| that are waiting on |owner|, or -1 if there are none.
+    static int MaxPiWaiterPriority(FutexNode* list_head, const ThreadDispatcher* owner);
+
     // Trait implementation for fbl::HashTable
     uintptr_t GetKey() const { return hash_key_; }
     static size_t GetHash(uintptr_t key) { return (key >> 3); }
@@ -78,4 +99,11 @@ private:
     //  * When the thread is not waiting on a futex, queue_next_ is null.
     FutexNode* queue_prev_ = nullptr;
     FutexNode* queue_next_ = nullptr;
+
+    // The thread blocked on this node, set while it waits.
+    thread_t* thread_ = nullptr;
+
+    // Holds a reference to the lock owner while this node waits on a
+    // priority-inheriting futex.
+    fbl::RefPtr<ThreadDispatcher> pi_owner_;
 };
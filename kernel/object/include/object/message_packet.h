@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <list.h>
 #include <stdint.h>
 
 #include <lib/user_copy/user_ptr.h>
@@ -38,9 +39,13 @@ public:
 
     // Copies the packet's |data_size()| bytes to |buf|.
     // Returns an error if |buf| points to a bad user address.
-    zx_status_t CopyDataTo(user_out_ptr<void> buf) const {
-        return buf.copy_array_to_user(data(), data_size_);
-    }
+    zx_status_t CopyDataTo(user_out_ptr<void> buf) const;
+
+    // Like CopyDataTo(), but for the last use of the packet: when |buf| is
+    // page aligned, whole pages of a large payload may be moved into the VMO
+    // mapped at |buf| instead of being copied. The packet's data is undefined
+    // afterwards.
+    zx_status_t MoveDataTo(user_out_ptr<void> buf);
 
     uint32_t num_handles() const { return num_handles_; }
     Handle* const* handles() const { return handles_; }
@@ -54,7 +59,7 @@ public:
         if (data_size_ < sizeof(zx_txid_t)) {
             return 0;
         } else {
-            return *(reinterpret_cast<const zx_txid_t*>(data()));
+            return *(reinterpret_cast<const zx_txid_t*>(first_data_chunk()));
         }
     }
 
@@ -67,17 +72,35 @@ private:
     static zx_status_t NewPacket(uint32_t data_size, uint32_t num_handles,
                                  fbl::unique_ptr<MessagePacket>* msg);
 
+    // Returns true if the payload is large enough to be stored in whole
+    // pages rather than in the packet's heap allocation.
+    static bool IsPaged(uint32_t data_size);
+
     // Create() uses malloc(), so we must delete using free().
     static void operator delete(void* ptr) {
         free(ptr);
     }
     friend class fbl::unique_ptr<MessagePacket>;
 
-    // Handles and data are stored in the same buffer: num_handles_ Handle*
-    // entries first, then the data buffer.
+    // Small payloads: handles and data are stored in the same buffer:
+    // num_handles_ Handle* entries first, then the data buffer.
+    // Large payloads: the buffer holds only the handles, and the data
+    // is spread across |pages_| in order, a page at a time.
     void* data() const { return static_cast<void*>(handles_ + num_handles_); }
+    const void* first_data_chunk() const;
+
+    // Invokes |func(void* chunk, size_t offset, size_t len)| for each
+    // contiguous piece of the payload, stopping at the first error.
+    template <typename F>
+    zx_status_t ForEachDataChunk(F func) const;
+
+    // Hands the first |count| pages of the payload to the current process's
+    // mapping at |va|. Returns false, keeping the pages, if that isn't
+    // possible.
+    bool MovePagesTo(vaddr_t va, size_t count);
 
     Handle** const handles_;
+    mutable list_node pages_ = LIST_INITIAL_CLEARED_VALUE;
     const uint32_t data_size_;
     const uint16_t num_handles_;
     bool owns_handles_;
@@ -0,0 +1,63 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/mutex.h>
+#include <object/dispatcher.h>
+#include <object/port_dispatcher.h>
+#include <vm/page_source.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+
+// A pager creates VMOs whose pages are supplied by userspace. When one of the
+// VMOs is missing a page, a ZX_PKT_TYPE_PAGE_REQUEST packet is queued on the
+// port the VMO was created with, and the faulting thread blocks until the
+// pager supplies the page with zx_pager_supply_pages().
+class PagerDispatcher final : public Dispatcher {
+public:
+    static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                              zx_rights_t* rights);
+
+    ~PagerDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_PAGER; }
+    void on_zero_handles() final;
+
+    // Creates a VMO of |size| bytes whose page requests are delivered to
+    // |port| with |key|.
+    zx_status_t CreateVmo(fbl::RefPtr<PortDispatcher> port, uint64_t key, uint64_t size,
+                          fbl::RefPtr<VmObject>* vmo);
+
+    // Copies the pages in [offset, offset + len) of |vmo| from |aux_vmo| at
+    // |aux_offset|. |vmo| must have been created by this pager.
+    zx_status_t SupplyPages(const fbl::RefPtr<VmObject>& vmo, uint64_t offset, uint64_t len,
+                            const fbl::RefPtr<VmObject>& aux_vmo, uint64_t aux_offset);
+
+    // Fails the page requests for [offset, offset + len) of |vmo| with
+    // |error|. |vmo| must have been created by this pager.
+    zx_status_t FailPages(const fbl::RefPtr<VmObject>& vmo, uint64_t offset, uint64_t len,
+                          zx_status_t error);
+
+private:
+    class PortPageSource;
+
+    // Returns whether |vmo|'s pages come from this pager.
+    bool OwnsVmo(const fbl::RefPtr<VmObject>& vmo);
+
+    PagerDispatcher();
+
+    // Called by a source when it is closed, either because its VMO was
+    // destroyed or because the pager was.
+    void RemoveSource(PortPageSource* source);
+
+    fbl::Canary<fbl::magic("PGRD")> canary_;
+
+    fbl::Mutex lock_;
+    bool zero_handles_ TA_GUARDED(lock_) = false;
+    fbl::DoublyLinkedList<fbl::RefPtr<PortPageSource>> sources_ TA_GUARDED(lock_);
+};
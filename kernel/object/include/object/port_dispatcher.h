@@ -152,6 +152,14 @@ public:
     zx_status_t QueueUser(const zx_port_packet_t& packet);
     zx_status_t Dequeue(zx_time_t deadline, zx_port_packet_t* packet);
 
+    // Batched variants of QueueUser() and Dequeue() which move up to |count|
+    // packets with a single acquisition of |lock_|. QueueUserMany() queues
+    // either all of |packets| or none of them. DequeueMany() blocks until at
+    // least one packet is available and returns the number dequeued in |actual|.
+    zx_status_t QueueUserMany(const zx_port_packet_t* packets, size_t count);
+    zx_status_t DequeueMany(zx_time_t deadline, zx_port_packet_t* packets, size_t count,
+                            size_t* actual);
+
     // Decides who is going to destroy the observer. If it returns |true| it
     // is the duty of the caller. If it is false it is the duty of the port.
     bool CanReap(PortObserver* observer, PortPacket* port_packet);
@@ -168,6 +176,9 @@ private:
 
     explicit PortDispatcher(uint32_t options);
 
+    // Unlinks a dequeued packet and releases whatever owns it.
+    void FreeDequeuedLocked(PortPacket* port_packet) TA_REQ(lock_);
+
     // Adopts a RefPtr to |eport|, and adds it to |eports_|.
     // Called by ExceptionPort.
     void LinkExceptionPort(ExceptionPort* eport);
@@ -109,6 +109,12 @@ public:
     ProcessDispatcher* process() const { return process_.get(); }
 
     FutexNode* futex_node() { return &futex_node_; }
+
+    // Priority inheritance for futexes.  Lends |priority| to the thread
+    // while it holds a lock that higher priority threads wait on.
+    void SetInheritedPriority(int priority);
+    int inherited_priority() const { return thread_.inherited_priority; }
+    int effective_priority() const { return thread_get_effective_priority(&thread_); }
     zx_status_t set_name(const char* name, size_t len) final;
     void get_name(char out_name[ZX_MAX_NAME_LEN]) const final;
     uint64_t runtime_ns() const { return thread_runtime(&thread_); }
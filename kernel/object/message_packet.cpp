@@ -10,8 +10,26 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <fbl/algorithm.h>
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+#include <vm/vm.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_aspace.h>
 #include <zxcpp/new.h>
 #include <object/handle_reaper.h>
+#include <object/process_dispatcher.h>
+
+// Payloads of at least this many bytes are stored in pages taken directly
+// from the pmm. Copies in and out then go straight between the user buffer
+// and the physmap, without a large contiguous heap allocation per message,
+// and whole pages can be handed to the reader's VMO by MoveDataTo().
+static constexpr uint32_t kPagedMessageThreshold = 4u * PAGE_SIZE;
+
+// static
+bool MessagePacket::IsPaged(uint32_t data_size) {
+    return data_size >= kPagedMessageThreshold;
+}
 
 // static
 zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
@@ -28,10 +46,23 @@ zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
     // TODO(dbort): Use mbuf-style memory for data_size, ideally allocating from
     // somewhere other than the heap. Lets us better track and isolate channel
     // memory usage.
+    const bool paged = IsPaged(data_size);
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    if (paged) {
+        const size_t page_count = ROUNDUP_PAGE_SIZE(data_size) / PAGE_SIZE;
+        if (pmm_alloc_pages(page_count, 0, &pages) != page_count) {
+            pmm_free(&pages);
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+
     char* ptr = static_cast<char*>(malloc(sizeof(MessagePacket) +
                                           num_handles * sizeof(Handle*) +
-                                          data_size));
+                                          (paged ? 0u : data_size)));
     if (ptr == nullptr) {
+        if (paged) {
+            pmm_free(&pages);
+        }
         return ZX_ERR_NO_MEMORY;
     }
 
@@ -42,9 +73,80 @@ zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
     msg->reset(new (ptr) MessagePacket(
         data_size, num_handles,
         reinterpret_cast<Handle**>(ptr + sizeof(MessagePacket))));
+    if (paged) {
+        list_initialize(&(*msg)->pages_);
+        list_move(&pages, &(*msg)->pages_);
+    }
+    return ZX_OK;
+}
+
+template <typename F>
+zx_status_t MessagePacket::ForEachDataChunk(F func) const {
+    if (!IsPaged(data_size_)) {
+        return func(data(), 0u, static_cast<size_t>(data_size_));
+    }
+
+    size_t offset = 0;
+    vm_page_t* page;
+    list_for_every_entry (&pages_, page, vm_page_t, free.node) {
+        if (offset >= data_size_) {
+            break;
+        }
+        const size_t len = fbl::min(static_cast<size_t>(data_size_) - offset,
+                                    static_cast<size_t>(PAGE_SIZE));
+        zx_status_t status = func(paddr_to_physmap(vm_page_to_paddr(page)), offset, len);
+        if (status != ZX_OK) {
+            return status;
+        }
+        offset += len;
+    }
     return ZX_OK;
 }
 
+const void* MessagePacket::first_data_chunk() const {
+    if (!IsPaged(data_size_)) {
+        return data();
+    }
+    vm_page_t* page = list_peek_head_type(&pages_, vm_page_t, free.node);
+    return paddr_to_physmap(vm_page_to_paddr(page));
+}
+
+zx_status_t MessagePacket::CopyDataTo(user_out_ptr<void> buf) const {
+    return ForEachDataChunk([buf](void* chunk, size_t offset, size_t len) {
+        return buf.byte_offset(offset).copy_array_to_user(chunk, len);
+    });
+}
+
+bool MessagePacket::MovePagesTo(vaddr_t va, size_t count) {
+    fbl::RefPtr<VmAddressRegionOrMapping> region =
+        ProcessDispatcher::GetCurrent()->aspace()->FindRegion(va);
+    if (!region) {
+        return false;
+    }
+    fbl::RefPtr<VmMapping> mapping = region->as_vm_mapping();
+    if (!mapping) {
+        return false;
+    }
+    return mapping->ReplacePages(va, &pages_, count) == ZX_OK;
+}
+
+zx_status_t MessagePacket::MoveDataTo(user_out_ptr<void> buf) {
+    const vaddr_t va = reinterpret_cast<vaddr_t>(buf.get());
+    const size_t whole_pages = data_size_ / PAGE_SIZE;
+    if (!IsPaged(data_size_) || !IS_PAGE_ALIGNED(va) || !MovePagesTo(va, whole_pages)) {
+        return CopyDataTo(buf);
+    }
+
+    // Only the partial last page, if any, is left to copy.
+    const size_t offset = whole_pages * PAGE_SIZE;
+    if (offset == data_size_) {
+        return ZX_OK;
+    }
+    vm_page_t* page = list_peek_head_type(&pages_, vm_page_t, free.node);
+    return buf.byte_offset(offset).copy_array_to_user(
+        paddr_to_physmap(vm_page_to_paddr(page)), data_size_ - offset);
+}
+
 // static
 zx_status_t MessagePacket::Create(user_in_ptr<const void> data, uint32_t data_size,
                                   uint32_t num_handles,
@@ -54,7 +156,10 @@ zx_status_t MessagePacket::Create(user_in_ptr<const void> data, uint32_t data_si
         return status;
     }
     if (data_size > 0u) {
-        if (data.copy_array_from_user((*msg)->data(), data_size) != ZX_OK) {
+        status = (*msg)->ForEachDataChunk([data](void* chunk, size_t offset, size_t len) {
+            return data.byte_offset(offset).copy_array_from_user(chunk, len);
+        });
+        if (status != ZX_OK) {
             msg->reset();
             return ZX_ERR_INVALID_ARGS;
         }
@@ -71,7 +176,11 @@ zx_status_t MessagePacket::Create(const void* data, uint32_t data_size,
         return status;
     }
     if (data_size > 0u) {
-        memcpy((*msg)->data(), data, data_size);
+        const char* src = static_cast<const char*>(data);
+        (*msg)->ForEachDataChunk([src](void* chunk, size_t offset, size_t len) {
+            memcpy(chunk, src + offset, len);
+            return ZX_OK;
+        });
     }
     return ZX_OK;
 }
@@ -82,6 +191,9 @@ MessagePacket::~MessagePacket() {
         // destruction behavior.
         ReapHandles(handles_, num_handles_);
     }
+    if (IsPaged(data_size_)) {
+        pmm_free(&pages_);
+    }
 }
 
 MessagePacket::MessagePacket(uint32_t data_size,
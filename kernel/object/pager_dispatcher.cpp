@@ -0,0 +1,163 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/pager_dispatcher.h>
+
+#include <err.h>
+#include <trace.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <vm/vm_object_paged.h>
+#include <zircon/rights.h>
+#include <zircon/syscalls/port.h>
+
+#define LOCAL_TRACE 0
+
+using fbl::AutoLock;
+
+// Forwards a VMO's page requests to a port.
+class PagerDispatcher::PortPageSource final
+    : public PageSource,
+      public fbl::DoublyLinkedListable<fbl::RefPtr<PortPageSource>> {
+public:
+    PortPageSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                   uint64_t key)
+        : pager_(fbl::move(pager)), port_(fbl::move(port)), key_(key) {}
+
+protected:
+    zx_status_t SendRequest(uint64_t offset, uint64_t len) final {
+        auto port_packet = PortDispatcher::DefaultPortAllocator()->Alloc();
+        if (!port_packet)
+            return ZX_ERR_NO_MEMORY;
+
+        port_packet->packet.key = key_;
+        port_packet->packet.type = ZX_PKT_TYPE_PAGE_REQUEST;
+        port_packet->packet.status = ZX_OK;
+        port_packet->packet.page_request.offset = offset;
+        port_packet->packet.page_request.length = len;
+        port_packet->packet.page_request.reserved0 = 0;
+        port_packet->packet.page_request.reserved1 = 0;
+
+        zx_status_t status = port_->Queue(port_packet, 0, 0);
+        if (status != ZX_OK)
+            port_packet->Free();
+        return status;
+    }
+
+    void OnClose() final {
+        pager_->RemoveSource(this);
+    }
+
+private:
+    const fbl::RefPtr<PagerDispatcher> pager_;
+    const fbl::RefPtr<PortDispatcher> port_;
+    const uint64_t key_;
+};
+
+zx_status_t PagerDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                                    zx_rights_t* rights) {
+    if (options != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) PagerDispatcher();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    *rights = ZX_DEFAULT_PAGER_RIGHTS;
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+PagerDispatcher::PagerDispatcher() {}
+
+PagerDispatcher::~PagerDispatcher() {
+    DEBUG_ASSERT(sources_.is_empty());
+}
+
+zx_status_t PagerDispatcher::CreateVmo(fbl::RefPtr<PortDispatcher> port, uint64_t key,
+                                       uint64_t size, fbl::RefPtr<VmObject>* vmo) {
+    canary_.Assert();
+
+    fbl::AllocChecker ac;
+    auto source = fbl::AdoptRef(new (&ac) PortPageSource(fbl::WrapRefPtr(this),
+                                                         fbl::move(port), key));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    {
+        AutoLock lock(&lock_);
+        if (zero_handles_)
+            return ZX_ERR_BAD_STATE;
+        sources_.push_back(source);
+    }
+
+    zx_status_t status = VmObjectPaged::CreateWithSource(source, size, vmo);
+    if (status != ZX_OK)
+        source->Close();
+    return status;
+}
+
+zx_status_t PagerDispatcher::SupplyPages(const fbl::RefPtr<VmObject>& vmo, uint64_t offset,
+                                         uint64_t len, const fbl::RefPtr<VmObject>& aux_vmo,
+                                         uint64_t aux_offset) {
+    canary_.Assert();
+
+    // only the pager that created a vmo may supply its pages
+    if (!OwnsVmo(vmo))
+        return ZX_ERR_INVALID_ARGS;
+
+    return vmo->SupplyPages(offset, len, aux_vmo.get(), aux_offset);
+}
+
+zx_status_t PagerDispatcher::FailPages(const fbl::RefPtr<VmObject>& vmo, uint64_t offset,
+                                       uint64_t len, zx_status_t error) {
+    canary_.Assert();
+
+    if (!OwnsVmo(vmo))
+        return ZX_ERR_INVALID_ARGS;
+
+    return vmo->FailPages(offset, len, error);
+}
+
+bool PagerDispatcher::OwnsVmo(const fbl::RefPtr<VmObject>& vmo) {
+    auto source = vmo->page_source();
+    if (!source)
+        return false;
+
+    AutoLock lock(&lock_);
+    auto iter = sources_.find_if([&source](const PortPageSource& s) {
+        return &s == source.get();
+    });
+    return iter.IsValid();
+}
+
+void PagerDispatcher::RemoveSource(PortPageSource* source) {
+    // drop the list's reference outside of the lock
+    fbl::RefPtr<PortPageSource> ref;
+    {
+        AutoLock lock(&lock_);
+        if (source->InContainer())
+            ref = sources_.erase(*source);
+    }
+}
+
+void PagerDispatcher::on_zero_handles() {
+    canary_.Assert();
+
+    // with the pager gone, nothing can supply pages; fail the requests of
+    // any remaining vmos instead of leaving their faulting threads blocked
+    fbl::DoublyLinkedList<fbl::RefPtr<PortPageSource>> sources;
+    {
+        AutoLock lock(&lock_);
+        zero_handles_ = true;
+        sources.swap(sources_);
+    }
+
+    while (!sources.is_empty())
+        sources.pop_front()->Close();
+}
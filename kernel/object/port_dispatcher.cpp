@@ -204,19 +204,47 @@ void PortDispatcher::on_zero_handles() {
 }
 
 zx_status_t PortDispatcher::QueueUser(const zx_port_packet_t& packet) {
+    return QueueUserMany(&packet, 1u);
+}
+
+zx_status_t PortDispatcher::QueueUserMany(const zx_port_packet_t* packets, size_t count) {
     canary_.Assert();
 
-    auto port_packet = port_allocator.Alloc();
-    if (!port_packet)
-        return ZX_ERR_NO_MEMORY;
+    DEBUG_ASSERT(count > 0u && count <= ZX_PORT_MAX_BATCH);
 
-    port_packet->packet = packet;
-    port_packet->packet.type = ZX_PKT_TYPE_USER;
+    // Allocate every packet up front so that the batch is queued atomically.
+    fbl::DoublyLinkedList<PortPacket*> batch;
+    for (size_t ix = 0; ix != count; ++ix) {
+        auto port_packet = port_allocator.Alloc();
+        if (!port_packet) {
+            while (!batch.is_empty())
+                batch.pop_front()->Free();
+            return ZX_ERR_NO_MEMORY;
+        }
+        port_packet->packet = packets[ix];
+        port_packet->packet.type = ZX_PKT_TYPE_USER;
+        batch.push_back(port_packet);
+    }
 
-    auto status = Queue(port_packet, 0u, 0u);
-    if (status < 0)
-        port_packet->Free();
-    return status;
+    int wake_count = 0;
+    {
+        AutoLock al(&lock_);
+        if (zero_handles_) {
+            while (!batch.is_empty())
+                batch.pop_front()->Free();
+            return ZX_ERR_BAD_STATE;
+        }
+
+        while (!batch.is_empty()) {
+            packets_.push_back(batch.pop_front());
+            wake_count += sema_.Post();
+        }
+    }
+
+    if (wake_count)
+        thread_reschedule();
+
+    return ZX_OK;
 }
 
 zx_status_t PortDispatcher::Queue(PortPacket* port_packet, zx_signals_t observed, uint64_t count) {
@@ -249,30 +277,37 @@ zx_status_t PortDispatcher::Queue(PortPacket* port_packet, zx_signals_t observed
 }
 
 zx_status_t PortDispatcher::Dequeue(zx_time_t deadline, zx_port_packet_t* out_packet) {
+    size_t actual;
+    return DequeueMany(deadline, out_packet, 1u, &actual);
+}
+
+zx_status_t PortDispatcher::DequeueMany(zx_time_t deadline, zx_port_packet_t* out_packets,
+                                        size_t count, size_t* actual) {
     canary_.Assert();
 
+    DEBUG_ASSERT(count > 0u);
+
     while (true) {
         {
             AutoLock al(&lock_);
 
-            PortPacket* port_packet = packets_.pop_front();
-            if (port_packet == nullptr)
-                goto wait;
-
-            if (out_packet != nullptr)
-                *out_packet = port_packet->packet;
+            size_t dequeued = 0;
+            while (dequeued != count) {
+                PortPacket* port_packet = packets_.pop_front();
+                if (port_packet == nullptr)
+                    break;
 
-            PortObserver* observer = port_packet->observer;
+                if (out_packets != nullptr)
+                    out_packets[dequeued] = port_packet->packet;
 
-            if (observer) {
-                // Deleting the observer under the lock is fine because
-                // the reference that holds to this PortDispatcher is by
-                // construction not the last one. We need to do this under
-                // the lock because another thread can call CanReap().
-                delete observer;
-            } else if (port_packet->is_ephemeral()) {
-                port_packet->Free();
+                FreeDequeuedLocked(port_packet);
+                ++dequeued;
             }
+
+            if (dequeued == 0)
+                goto wait;
+
+            *actual = dequeued;
         }
 
         return ZX_OK;
@@ -284,6 +319,20 @@ wait:
     }
 }
 
+void PortDispatcher::FreeDequeuedLocked(PortPacket* port_packet) {
+    PortObserver* observer = port_packet->observer;
+
+    if (observer) {
+        // Deleting the observer under the lock is fine because
+        // the reference that holds to this PortDispatcher is by
+        // construction not the last one. We need to do this under
+        // the lock because another thread can call CanReap().
+        delete observer;
+    } else if (port_packet->is_ephemeral()) {
+        port_packet->Free();
+    }
+}
+
 bool PortDispatcher::CanReap(PortObserver* observer, PortPacket* port_packet) {
     canary_.Assert();
 
@@ -495,6 +495,8 @@ zx_status_t ProcessDispatcher::GetStats(zx_info_task_stats_t* stats) {
     stats->mem_private_bytes = usage.private_pages * PAGE_SIZE;
     stats->mem_shared_bytes = usage.shared_pages * PAGE_SIZE;
     stats->mem_scaled_shared_bytes = usage.scaled_shared_bytes;
+    stats->page_faults = aspace_->page_faults();
+    stats->pages_faulted_around = aspace_->pages_faulted_around();
     return ZX_OK;
 }
 
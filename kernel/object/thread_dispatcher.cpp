@@ -302,6 +302,16 @@ zx_status_t ThreadDispatcher::Start(uintptr_t entry, uintptr_t sp,
     return ZX_OK;
 }
 
+void ThreadDispatcher::SetInheritedPriority(int priority) {
+    canary_.Assert();
+
+    AutoLock lock(&state_lock_);
+
+    // Only a started thread that has not exited has a scheduler entry.
+    if (state_ == State::RUNNING || state_ == State::SUSPENDED || state_ == State::DYING)
+        thread_set_inherited_priority(&thread_, priority);
+}
+
 // called in the context of our thread
 void ThreadDispatcher::Exit() {
     canary_.Assert();
@@ -32,6 +32,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/syscalls_zircon.cpp \
     $(LOCAL_DIR)/syscalls_object.cpp \
     $(LOCAL_DIR)/syscalls_object_wait.cpp \
+    $(LOCAL_DIR)/syscalls_pager.cpp \
     $(LOCAL_DIR)/syscalls_port.cpp \
     $(LOCAL_DIR)/syscalls_resource.cpp \
     $(LOCAL_DIR)/syscalls_socket.cpp \
@@ -128,7 +128,7 @@ zx_status_t sys_channel_read(zx_handle_t handle_value, uint32_t options,
         return result;
 
     if (num_bytes > 0u) {
-        if (msg->CopyDataTo(bytes) != ZX_OK)
+        if (msg->MoveDataTo(bytes) != ZX_OK)
             return ZX_ERR_INVALID_ARGS;
     }
 
@@ -162,7 +162,7 @@ static zx_status_t channel_read_out(ProcessDispatcher* up,
     }
 
     if (num_bytes > 0u) {
-        if (reply->CopyDataTo(make_user_out_ptr(args->rd_bytes)) != ZX_OK) {
+        if (reply->MoveDataTo(make_user_out_ptr(args->rd_bytes)) != ZX_OK) {
             return ZX_ERR_INVALID_ARGS;
         }
     }
@@ -7,6 +7,7 @@
 #include <trace.h>
 
 #include <object/process_dispatcher.h>
+#include <object/thread_dispatcher.h>
 #include <zircon/types.h>
 
 #include "syscalls_priv.h"
@@ -17,7 +18,27 @@ zx_status_t sys_futex_wait(user_in_ptr<const zx_futex_t> value_ptr, int current_
     LTRACEF("futex %p current %d\n", value_ptr.get(), current_value);
 
     return ProcessDispatcher::GetCurrent()->futex_context()->FutexWait(
-        value_ptr, current_value, deadline);
+        value_ptr, current_value, nullptr, deadline);
+}
+
+zx_status_t sys_futex_wait_owner(user_in_ptr<const zx_futex_t> value_ptr, int current_value,
+                                 zx_handle_t owner, zx_time_t deadline) {
+    LTRACEF("futex %p current %d owner %x\n", value_ptr.get(), current_value, owner);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ThreadDispatcher> thread;
+    zx_status_t status = up->GetDispatcher(owner, &thread);
+    if (status != ZX_OK)
+        return status;
+
+    // Priority can only be lent within the process, and waiting on a lock
+    // we own ourselves would deadlock.
+    if (thread->process() != up || thread.get() == ThreadDispatcher::GetCurrent())
+        return ZX_ERR_INVALID_ARGS;
+
+    return up->futex_context()->FutexWait(
+        value_ptr, current_value, fbl::move(thread), deadline);
 }
 
 zx_status_t sys_futex_wake(user_in_ptr<const zx_futex_t> value_ptr, uint32_t count) {
@@ -583,6 +583,17 @@ zx_status_t sys_object_get_property(zx_handle_t handle_value, uint32_t property,
             }
             return ZX_OK;
         }
+        case ZX_PROP_VMAR_FAULT_AROUND: {
+            if (size < sizeof(uint32_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto vmar = DownCastDispatcher<VmAddressRegionDispatcher>(&dispatcher);
+            if (!vmar)
+                return ZX_ERR_WRONG_TYPE;
+            uint32_t value = vmar->vmar()->FaultAroundPages();
+            if (_value.reinterpret<uint32_t>().copy_to_user(value) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+            return ZX_OK;
+        }
         default:
             return ZX_ERR_INVALID_ARGS;
     }
@@ -661,6 +672,17 @@ zx_status_t sys_object_set_property(zx_handle_t handle_value, uint32_t property,
             return job->set_importance(
                 static_cast<zx_job_importance_t>(value));
         }
+        case ZX_PROP_VMAR_FAULT_AROUND: {
+            if (size < sizeof(uint32_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto vmar = DownCastDispatcher<VmAddressRegionDispatcher>(&dispatcher);
+            if (!vmar)
+                return ZX_ERR_WRONG_TYPE;
+            uint32_t value = 0;
+            if (_value.reinterpret<const uint32_t>().copy_from_user(&value) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+            return vmar->vmar()->SetFaultAroundPages(value);
+        }
     }
 
     return ZX_ERR_INVALID_ARGS;
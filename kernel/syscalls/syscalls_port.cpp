@@ -19,6 +19,7 @@
 #include <fbl/ref_ptr.h>
 
 #include <zircon/syscalls/policy.h>
+#include <zircon/syscalls/port.h>
 #include <zircon/types.h>
 
 #include "syscalls_priv.h"
@@ -61,11 +62,13 @@ zx_status_t sys_port_create(uint32_t options, user_out_ptr<zx_handle_t> out) {
     return ZX_OK;
 }
 
-zx_status_t sys_port_queue(zx_handle_t handle, user_in_ptr<const zx_port_packet_t> packet_in, size_t count) {
-    LTRACEF("handle %x\n", handle);
+zx_status_t sys_port_queue(zx_handle_t handle, user_in_ptr<const zx_port_packet_t> packets_in, size_t count) {
+    LTRACEF("handle %x count %zu\n", handle, count);
 
     // TODO(ZX-1291) Disallow 0u here.
-    if (count != 0u && count != 1u)
+    if (count == 0u)
+        count = 1u;
+    if (count > ZX_PORT_MAX_BATCH)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -75,11 +78,11 @@ zx_status_t sys_port_queue(zx_handle_t handle, user_in_ptr<const zx_port_packet_
     if (status != ZX_OK)
         return status;
 
-    zx_port_packet_t packet;
-    if (packet_in.copy_from_user(&packet) != ZX_OK)
+    zx_port_packet_t packets[ZX_PORT_MAX_BATCH];
+    if (packets_in.copy_array_from_user(packets, count) != ZX_OK)
         return ZX_ERR_INVALID_ARGS;
 
-    return port->QueueUser(packet);
+    return port->QueueUserMany(packets, count);
 }
 
 zx_status_t sys_port_wait(zx_handle_t handle, zx_time_t deadline,
@@ -113,6 +116,40 @@ zx_status_t sys_port_wait(zx_handle_t handle, zx_time_t deadline,
     return ZX_OK;
 }
 
+zx_status_t sys_port_wait_many(zx_handle_t handle, zx_time_t deadline,
+                               user_out_ptr<zx_port_packet_t> packets_out, size_t count,
+                               user_out_ptr<size_t> actual_out) {
+    LTRACEF("handle %x count %zu\n", handle, count);
+
+    if (count == 0u || count > ZX_PORT_MAX_BATCH)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<PortDispatcher> port;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &port);
+    if (status != ZX_OK)
+        return status;
+
+    ktrace(TAG_PORT_WAIT, (uint32_t)port->get_koid(), 0, 0, 0);
+
+    zx_port_packet_t packets[ZX_PORT_MAX_BATCH];
+    size_t actual = 0u;
+    zx_status_t st = port->DequeueMany(deadline, packets, count, &actual);
+
+    ktrace(TAG_PORT_WAIT_DONE, (uint32_t)port->get_koid(), st, 0, 0);
+
+    if (st != ZX_OK)
+        return st;
+
+    if (packets_out.copy_array_to_user(packets, actual) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    if (actual_out.copy_to_user(actual) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    return ZX_OK;
+}
+
 zx_status_t sys_port_cancel(zx_handle_t handle, zx_handle_t source, uint64_t key) {
     auto up = ProcessDispatcher::GetCurrent();
 
@@ -235,6 +235,38 @@ __NO_INLINE static void bench_mutex() {
     printf("%" PRIu64 " cycles to acquire/release uncontended mutex %u times (%" PRIu64 " cycles per)\n", c, count, c / count);
 }
 
+__NO_INLINE static void bench_malloc_small() {
+    static const uint count = 4 * 1024 * 1024;
+    static const uint batch = 64;
+    void* ptrs[batch];
+
+    // test 1: back to back malloc/free of one small object
+    uint64_t c = arch_cycle_count();
+    for (size_t i = 0; i < count; i++) {
+        void* ptr = malloc(64);
+        __asm__ volatile("" :: "r"(ptr));
+        free(ptr);
+    }
+    c = arch_cycle_count() - c;
+
+    printf("%" PRIu64 " cycles to malloc/free 64 bytes %u times (%" PRIu64 " cycles per)\n", c, count, c / count);
+
+    // test 2: allocate a batch of mixed size objects, then free them all
+    c = arch_cycle_count();
+    for (size_t i = 0; i < count / batch; i++) {
+        for (size_t j = 0; j < batch; j++) {
+            ptrs[j] = malloc(16 + (j % 8) * 48);
+        }
+        for (size_t j = 0; j < batch; j++) {
+            free(ptrs[j]);
+        }
+    }
+    c = arch_cycle_count() - c;
+
+    printf("%" PRIu64 " cycles to malloc/free batches of %u mixed size objects %u times (%" PRIu64 " cycles per)\n",
+           c, batch, count / batch, c / count);
+}
+
 void benchmarks() {
     bench_set_overhead();
     bench_memcpy();
@@ -251,4 +283,6 @@ void benchmarks() {
 
     bench_spinlock();
     bench_mutex();
+
+    bench_malloc_small();
 }
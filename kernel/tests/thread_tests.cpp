@@ -359,6 +359,74 @@ static void preempt_test(void) {
     printf("done with real-time preempt test, above time stamps should be 1 second apart\n");
 }
 
+static volatile int pi_owner_progress;
+static volatile bool pi_test_done;
+
+static int pi_owner_thread(void* arg) {
+    while (!pi_test_done)
+        atomic_add(&pi_owner_progress, 1);
+    return 0;
+}
+
+static int pi_spinner_thread(void* arg) {
+    while (!pi_test_done)
+        ;
+    return 0;
+}
+
+// Returns how far the owner gets in |duration|.
+static int pi_owner_progress_over(zx_duration_t duration) {
+    int start = atomic_load(&pi_owner_progress);
+    thread_sleep_relative(duration);
+    return atomic_load(&pi_owner_progress) - start;
+}
+
+static void priority_inheritance_test(void) {
+    /* a low priority lock owner sharing a cpu with a spinning default priority
+     * thread only runs while it inherits a higher priority from a waiter, the
+     * way a futex owner does in zx_futex_wait_owner(). */
+    printf("testing priority inheritance\n");
+
+    cpu_mask_t online = mp_get_online_mask();
+    if (!(online & cpu_num_to_mask(0)) || !(online & cpu_num_to_mask(1))) {
+        printf("aborting test, not enough online cpus\n");
+        return;
+    }
+
+    /* stay off the cpu under test, so we can run while the owner is boosted */
+    thread_migrate_to_cpu(1);
+
+    pi_owner_progress = 0;
+    pi_test_done = false;
+    thread_t* owner = thread_create("pi owner", &pi_owner_thread, NULL, LOW_PRIORITY,
+                                    DEFAULT_STACK_SIZE);
+    thread_t* spinner = thread_create("pi spinner", &pi_spinner_thread, NULL, DEFAULT_PRIORITY,
+                                      DEFAULT_STACK_SIZE);
+    thread_set_cpu_affinity(owner, cpu_num_to_mask(0));
+    thread_set_cpu_affinity(spinner, cpu_num_to_mask(0));
+    thread_resume(spinner);
+    thread_resume(owner);
+
+    thread_sleep_relative(ZX_MSEC(20));
+    ASSERT(pi_owner_progress_over(ZX_MSEC(100)) == 0);
+
+    thread_set_inherited_priority(owner, HIGH_PRIORITY);
+    ASSERT(thread_get_effective_priority(owner) >= HIGH_PRIORITY);
+    ASSERT(pi_owner_progress_over(ZX_MSEC(100)) > 0);
+
+    thread_set_inherited_priority(owner, LOWEST_PRIORITY);
+    ASSERT(thread_get_effective_priority(owner) < DEFAULT_PRIORITY);
+    thread_sleep_relative(ZX_MSEC(20));
+    ASSERT(pi_owner_progress_over(ZX_MSEC(100)) == 0);
+
+    pi_test_done = true;
+    thread_join(owner, NULL, ZX_TIME_INFINITE);
+    thread_join(spinner, NULL, ZX_TIME_INFINITE);
+    thread_set_cpu_affinity(get_current_thread(), CPU_MASK_ALL);
+
+    printf("done with priority inheritance test\n");
+}
+
 static int join_tester(void* arg) {
     int val = (int)(uintptr_t)arg;
 
@@ -707,6 +775,8 @@ int thread_tests(void) {
 
     preempt_test();
 
+    priority_inheritance_test();
+
     join_test();
 
     affinity_test();
@@ -48,6 +48,11 @@ public:
 
     virtual zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) = 0;
 
+    // The size of the large pages Map() uses for runs aligned to it in both
+    // address spaces, and which Unmap() and Protect() split again when asked
+    // for part of one; 0 if the aspace does not do both.
+    virtual size_t LargePageSize() const = 0;
+
     virtual vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                              vaddr_t end, uint next_region_mmu_flags,
                              vaddr_t align, size_t size, uint mmu_flags) = 0;
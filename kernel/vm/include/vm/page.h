@@ -17,11 +17,17 @@ class VmObject;
 #define VM_PAGE_OBJECT_PIN_COUNT_BITS 5
 #define VM_PAGE_OBJECT_MAX_PIN_COUNT ((1ul << VM_PAGE_OBJECT_PIN_COUNT_BITS) - 1)
 
+#define VM_PAGE_ARENA_INDEX_BITS 6
+// arena_index of the pages of arenas added past the end of the pmm's table
+#define VM_PAGE_ARENA_INDEX_OVERFLOW ((1u << VM_PAGE_ARENA_INDEX_BITS) - 1)
+
 // core per page structure
 typedef struct vm_page {
     struct {
         uint32_t flags : 8;
         uint32_t state : 3;
+        // index of the pmm arena holding the page, set once at boot
+        uint32_t arena_index : VM_PAGE_ARENA_INDEX_BITS;
     };
     uint32_t map_count;
 
@@ -0,0 +1,96 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/canary.h>
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_counted.h>
+#include <fbl/ref_ptr.h>
+#include <kernel/event.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+// A PageSource supplies the contents of a VmObjectPaged's pages on demand,
+// for example on behalf of a filesystem (see PagerDispatcher).
+//
+// When a VMO with a page source is missing a page, GetPageLocked() asks the
+// source for it and returns ZX_ERR_SHOULD_WAIT instead of zero filling. The
+// faulting thread drops its locks, waits in WaitForPage(), and retries. The
+// provider answers by adding the page to the VMO and calling
+// OnPagesSupplied().
+class PageSource : public fbl::RefCounted<PageSource> {
+public:
+    PageSource();
+    virtual ~PageSource();
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageSource);
+
+    // Asks the provider for the page at |offset|, unless a request for it is
+    // already outstanding. Called with the owning VMO's lock held.
+    // Returns ZX_ERR_SHOULD_WAIT, or an error if the request cannot be made,
+    // e.g. ZX_ERR_BAD_STATE once the source has been closed.
+    zx_status_t GetPage(uint64_t offset);
+
+    // Blocks until the page at |offset| has been supplied or failed, the
+    // source is closed, or |deadline| passes. Must not be called with VMO or
+    // aspace locks held.
+    zx_status_t WaitForPage(uint64_t offset, zx_time_t deadline);
+
+    // Completes the requests for pages in [offset, offset + len).
+    void OnPagesSupplied(uint64_t offset, uint64_t len);
+
+    // Completes the requests for pages in [offset, offset + len) with
+    // |error|. A failed request stays outstanding until a waiter has seen
+    // it, so a fault that raced with the provider's answer still fails
+    // rather than asking again; the next fault after that asks again.
+    void OnPagesFailed(uint64_t offset, uint64_t len, zx_status_t error);
+
+    // Fails all outstanding and future requests. Idempotent.
+    void Close();
+
+protected:
+    // Sends a request for the pages in [offset, offset + len) to the
+    // provider. Called with the source's lock held; must not block.
+    virtual zx_status_t SendRequest(uint64_t offset, uint64_t len) = 0;
+
+    // Called once, without the source's lock held, when the source is
+    // closed.
+    virtual void OnClose() {}
+
+private:
+    struct Request : public fbl::RefCounted<Request>,
+                     public fbl::WAVLTreeContainable<fbl::RefPtr<Request>> {
+        explicit Request(uint64_t offset);
+        ~Request();
+
+        uint64_t GetKey() const { return offset; }
+
+        const uint64_t offset;
+        event_t event;
+        zx_status_t status = ZX_OK;
+    };
+
+    // Wakes the request's waiters; returns whether there were any.
+    bool CompleteRequestLocked(fbl::RefPtr<Request> request, zx_status_t status) TA_REQ(lock_);
+
+    fbl::Canary<fbl::magic("PGSR")> canary_;
+
+    fbl::Mutex lock_;
+    bool closed_ TA_GUARDED(lock_) = false;
+
+    // Outstanding requests, keyed by page offset.
+    fbl::WAVLTree<uint64_t, fbl::RefPtr<Request>> requests_ TA_GUARDED(lock_);
+};
+
+// Filled in by a page fault that returned ZX_ERR_SHOULD_WAIT, naming the page
+// to wait for once the faulting thread has dropped its locks.
+struct PageRequest {
+    fbl::RefPtr<PageSource> source;
+    uint64_t offset = 0;
+};
@@ -115,7 +115,9 @@ public:
 
     // Page fault in an address within the region.  Recursively traverses
     // the regions to find the target mapping, if it exists.
-    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags) = 0;
+    // Returns ZX_ERR_SHOULD_WAIT and fills in |page_request| if the page
+    // must first be supplied by the VMO's page source.
+    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) = 0;
 
     // WAVL tree key function
     vaddr_t GetKey() const { return base(); }
@@ -235,7 +237,18 @@ public:
     bool is_mapping() const override { return false; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
+
+    // Find the mapping containing |va| in this region or any of its
+    // subregions, if there is one.  |aspace_->lock()| must be held.
+    fbl::RefPtr<VmMapping> FindMappingLocked(vaddr_t va);
+
+    // The number of pages, aligned within the mapping, that a fault in one
+    // of this region's mappings maps at once from the pages its VMO already
+    // holds.  Subregions inherit the value when they are created.  |pages|
+    // must be 0 or a power of two no larger than ZX_VMAR_FAULT_AROUND_MAX.
+    uint32_t FaultAroundPages();
+    zx_status_t SetFaultAroundPages(uint32_t pages);
 
 protected:
     // constructor for use in creating a VmAddressRegionDummy
@@ -330,6 +343,9 @@ private:
     ChildList subregions_;
 
     const char name_[32] = {};
+
+    // see FaultAroundPages(); guarded by the aspace lock
+    uint32_t fault_around_pages_;
 };
 
 // A VmAddressRegion that always returns errors.  This is used to break a
@@ -368,7 +384,7 @@ public:
         return;
     }
 
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override {
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override {
         // We should never be trying to page fault on this...
         ASSERT(false);
         return ZX_ERR_BAD_STATE;
@@ -414,6 +430,12 @@ public:
     // offset modification and locking.
     zx_status_t DecommitRange(size_t offset, size_t len, size_t* decommitted);
 
+    // Convenience wrapper for vmo()->ReplacePages() on the pages mapped at
+    // [va, va + count * PAGE_SIZE), with the necessary locking.  Fails unless
+    // the range is mapped writable and cached, so that the new pages are
+    // exactly what a write through the mapping could have produced.
+    zx_status_t ReplacePages(vaddr_t va, list_node* pages, size_t count);
+
     // Map in pages from the underlying vm object, optionally committing pages as it goes
     zx_status_t MapRange(size_t offset, size_t len, bool commit);
 
@@ -432,7 +454,17 @@ public:
     bool is_mapping() const override { return true; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
+
+    // Check that a fault at |va| with |pf_flags| is permitted by this mapping
+    // and compute the offset of the faulting page in the VMO.
+    // |aspace_->lock()| must be held.
+    zx_status_t CheckFaultLocked(vaddr_t va, uint pf_flags, uint64_t* vmo_offset) const;
+
+    // If a fault at |va| with |pf_flags| may be resolved by mapping a whole
+    // large page, return the page's size and the offset of its run in the
+    // VMO; otherwise return 0.  |aspace_->lock()| must be held.
+    size_t LargePageForFaultLocked(vaddr_t va, uint pf_flags, uint64_t* vmo_offset) const;
 
 protected:
     ~VmMapping() override;
@@ -467,9 +499,25 @@ private:
     // Implementation for Protect().  This does not acquire the aspace lock.
     zx_status_t ProtectLocked(vaddr_t base, size_t size, uint new_arch_mmu_flags);
 
+    // Implementation for MapRange().  This does not acquire the aspace lock.
+    // When committing a page must be waited for, returns ZX_ERR_SHOULD_WAIT
+    // with the bytes of the range already mapped in |mapped|.
+    zx_status_t MapRangeLocked(size_t offset, size_t len, bool commit, size_t* mapped,
+                               PageRequest* page_request);
+
     // Version of AllocatedPages() that does not acquire the aspace lock
     size_t AllocatedPagesLocked() const override;
 
+    // Map the large page containing |va| if the vmo holds its whole run, or
+    // for a write fault can commit it.  Both the aspace lock and the object_
+    // lock must be held.
+    zx_status_t FaultLargePageLocked(vaddr_t va, uint pf_flags);
+
+    // Map the pages around a newly faulted |va| that the vmo already holds,
+    // as configured by the parent region.  Both the aspace lock and the
+    // object_ lock must be held.
+    void FaultAroundLocked(vaddr_t va, uint pf_flags, uint mmu_flags);
+
     void Activate() override;
 
     // Version of Activate that does not take the object_ lock.
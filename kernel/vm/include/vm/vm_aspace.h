@@ -9,6 +9,7 @@
 #include <arch/aspace.h>
 #include <arch/mmu.h>
 #include <assert.h>
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_wavl_tree.h>
@@ -112,6 +113,11 @@ public:
 
     size_t AllocatedPages() const;
 
+    // The number of page faults taken in the aspace, and the number of pages
+    // mapped around the faulting pages by them.
+    uint64_t page_faults() const { return page_faults_.load(); }
+    uint64_t pages_faulted_around() const { return pages_faulted_around_.load(); }
+
     // Convenience method for traversing the tree of VMARs to find the deepest
     // VMAR in the tree that includes *va*.
     fbl::RefPtr<VmAddressRegionOrMapping> FindRegion(vaddr_t va);
@@ -187,9 +193,14 @@ private:
     char name_[32];
     bool aspace_destroyed_ = false;
     bool aslr_enabled_ = false;
+    bool large_pages_enabled_ = false;
 
     mutable mutex_t lock_ = MUTEX_INITIAL_VALUE(lock_);
 
+    // fault counters, updated without the lock
+    fbl::atomic<uint64_t> page_faults_{0};
+    fbl::atomic<uint64_t> pages_faulted_around_{0};
+
     // root of virtual address space
     // Access to this reference is guarded by lock_.
     fbl::RefPtr<VmAddressRegion> root_vmar_;
@@ -19,6 +19,7 @@
 #include <list.h>
 #include <stdint.h>
 #include <vm/page.h>
+#include <vm/page_source.h>
 #include <vm/vm.h>
 #include <vm/vm_page_list.h>
 #include <zircon/thread_annotations.h>
@@ -163,6 +164,36 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // The source a VMO's missing pages are requested from, if any. When a
+    // fault returns ZX_ERR_SHOULD_WAIT, the caller waits on this source after
+    // dropping its locks and retries.
+    virtual fbl::RefPtr<PageSource> page_source() const { return nullptr; }
+
+    // After a lookup at |offset| returned ZX_ERR_SHOULD_WAIT, names the page
+    // to wait for, which for a clone belongs to the ancestor with the source.
+    virtual void GetPageRequestLocked(uint64_t offset, PageRequest* request) TA_REQ(lock_) {}
+
+    // Fills the missing pages in [offset, offset + len) with the contents of
+    // |src| starting at |src_offset|, completing any page requests for them.
+    virtual zx_status_t SupplyPages(uint64_t offset, uint64_t len,
+                                    VmObject* src, uint64_t src_offset) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // Fails the page requests for [offset, offset + len) with |error|, for
+    // when the source cannot produce those pages.
+    virtual zx_status_t FailPages(uint64_t offset, uint64_t len, zx_status_t error) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // Takes the first |count| pages off |pages|, which must be allocated but
+    // not yet owned by anything, and puts them in place of the committed pages
+    // at [offset, offset + count * PAGE_SIZE), freeing those.  On failure
+    // |pages| is untouched.
+    virtual zx_status_t ReplacePages(uint64_t offset, list_node* pages, size_t count) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // Returns true if this VMO was created via CloneCOW().
     // TODO: If more types of clones appear, replace this with a method that
     // returns an enum rather than adding a new method for each clone type.
@@ -175,6 +206,24 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // execute lookup_fn on each page in the range that the object itself holds,
+    // without faulting any in or looking in a parent.
+    virtual zx_status_t LookupResidentLocked(uint64_t offset, uint64_t len,
+                                             vmo_lookup_fn_t lookup_fn, void* context)
+        TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // get the physical address of the run of |size| bytes at |offset|, both a
+    // power of two multiple of the page size and |offset| aligned to it, when
+    // the object itself holds every page of the run, contiguously and equally
+    // aligned.  If |commit| is set and none of the run is committed yet, try
+    // to commit it that way.
+    virtual zx_status_t GetLargePageLocked(uint64_t offset, size_t size, bool commit,
+                                           paddr_t* pa) TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     fbl::Mutex* lock() TA_RET_CAP(lock_) { return &lock_; }
     fbl::Mutex& lock_ref() TA_RET_CAP(lock_) { return lock_; }
 
@@ -31,6 +31,11 @@ public:
 
     static zx_status_t CreateFromROData(const void* data, size_t size, fbl::RefPtr<VmObject>* vmo);
 
+    // Creates a VMO whose pages are supplied on demand by |source|, instead
+    // of being zero filled. Such VMOs cannot be resized or cloned.
+    static zx_status_t CreateWithSource(fbl::RefPtr<PageSource> source, uint64_t size,
+                                        fbl::RefPtr<VmObject>* vmo);
+
     zx_status_t Resize(uint64_t size) override;
     zx_status_t ResizeLocked(uint64_t size) override TA_REQ(lock_);
     uint64_t size() const override
@@ -64,6 +69,15 @@ public:
 
     void Dump(uint depth, bool verbose) override;
 
+    fbl::RefPtr<PageSource> page_source() const override { return page_source_; }
+    void GetPageRequestLocked(uint64_t offset, PageRequest* request) override
+        // Reads the ancestors, which share our lock, confusing analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+    zx_status_t SupplyPages(uint64_t offset, uint64_t len,
+                            VmObject* src, uint64_t src_offset) override;
+    zx_status_t FailPages(uint64_t offset, uint64_t len, zx_status_t error) override;
+    zx_status_t ReplacePages(uint64_t offset, list_node* pages, size_t count) override;
+
     zx_status_t InvalidateCache(const uint64_t offset, const uint64_t len) override;
     zx_status_t CleanCache(const uint64_t offset, const uint64_t len) override;
     zx_status_t CleanInvalidateCache(const uint64_t offset, const uint64_t len) override;
@@ -74,6 +88,13 @@ public:
         // Calls a Locked method of the parent, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
 
+    zx_status_t LookupResidentLocked(uint64_t offset, uint64_t len,
+                                     vmo_lookup_fn_t lookup_fn, void* context) override
+        TA_REQ(lock_);
+
+    zx_status_t GetLargePageLocked(uint64_t offset, size_t size, bool commit,
+                                   paddr_t* pa) override TA_REQ(lock_);
+
     zx_status_t CloneCOW(uint64_t offset, uint64_t size, bool copy_name,
                          fbl::RefPtr<VmObject>* clone_vmo) override
         // Calls a Locked method of the child, which confuses analysis.
@@ -85,7 +106,8 @@ public:
 
 private:
     // private constructor (use Create())
-    explicit VmObjectPaged(uint32_t pmm_alloc_flags, fbl::RefPtr<VmObject> parent);
+    VmObjectPaged(uint32_t pmm_alloc_flags, fbl::RefPtr<VmObject> parent,
+                  fbl::RefPtr<PageSource> page_source = nullptr);
 
     // private destructor, only called from refptr
     ~VmObjectPaged() override;
@@ -110,6 +132,11 @@ private:
     zx_status_t PinLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
     void UnpinLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
 
+    // internal part of Lookup() between waits for a page source
+    zx_status_t LookupFromLocked(uint64_t* next_off, uint64_t start_page_offset,
+                                 uint64_t end_page_offset, uint pf_flags,
+                                 vmo_lookup_fn_t lookup_fn, void* context) TA_REQ(lock_);
+
     // internal check if any pages in a range are pinned
     bool AnyPagesPinnedLocked(uint64_t offset, size_t len) TA_REQ(lock_);
 
@@ -121,14 +148,33 @@ private:
     // set our offset within our parent
     zx_status_t SetParentOffsetLocked(uint64_t o) TA_REQ(lock_);
 
+    // merge any ancestors that only this vmo can still see into it
+    void CollapseParentLocked()
+        // Modifies the parent, which shares our lock, confusing analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // whether we or an ancestor supply missing pages from a page source
+    bool HasPageSourceLocked() const
+        // Reads the ancestors, which share our lock, confusing analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
     // maximum size of a VMO is one page less than the full 64bit range
     static const uint64_t MAX_SIZE = ROUNDDOWN(UINT64_MAX, PAGE_SIZE);
 
     // members
     uint64_t size_ TA_GUARDED(lock_) = 0;
     uint64_t parent_offset_ TA_GUARDED(lock_) = 0;
+    // offsets in the parent at or beyond this are not visible to us
+    uint64_t parent_limit_ TA_GUARDED(lock_) = UINT64_MAX;
     uint32_t pmm_alloc_flags_ TA_GUARDED(lock_) = PMM_ALLOC_FLAG_ANY;
 
     // a tree of pages
     VmPageList page_list_ TA_GUARDED(lock_);
+
+    // pages taken over from merged hidden parents, which sit between
+    // page_list_ and parent_; never written or decommitted through us
+    VmPageList inherited_pages_ TA_GUARDED(lock_);
+
+    // provides missing pages, in place of zero fill
+    const fbl::RefPtr<PageSource> page_source_;
 };
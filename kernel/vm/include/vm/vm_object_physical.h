@@ -39,6 +39,8 @@ public:
 
     zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
                               vm_page_t**, paddr_t* pa) override TA_REQ(lock_);
+    zx_status_t GetLargePageLocked(uint64_t offset, size_t size, bool commit,
+                                   paddr_t* pa) override TA_REQ(lock_);
 
     zx_status_t GetMappingCachePolicy(uint32_t* cache_policy) override;
     zx_status_t SetMappingCachePolicy(const uint32_t cache_policy) override;
@@ -192,6 +192,10 @@ public:
     zx_status_t FreePage(uint64_t offset);
     size_t FreeAllPages();
 
+    // Puts |p| in place of the page at |offset| and returns the old page, or
+    // returns nullptr without adding |p| if there is no page at |offset|.
+    vm_page* ReplacePage(vm_page* p, uint64_t offset);
+
 private:
     fbl::WAVLTree<uint64_t, fbl::unique_ptr<VmPageListNode>> list_;
 };
@@ -0,0 +1,156 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/page_source.h>
+
+#include "vm_priv.h"
+
+#include <assert.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <inttypes.h>
+#include <kernel/thread.h>
+#include <trace.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+using fbl::AutoLock;
+
+PageSource::Request::Request(uint64_t offset)
+    : offset(offset) {
+    event_init(&event, false, 0);
+}
+
+PageSource::Request::~Request() {
+    event_destroy(&event);
+}
+
+PageSource::PageSource() {
+    LTRACEF("%p\n", this);
+}
+
+PageSource::~PageSource() {
+    LTRACEF("%p\n", this);
+    DEBUG_ASSERT(requests_.is_empty());
+}
+
+zx_status_t PageSource::GetPage(uint64_t offset) {
+    canary_.Assert();
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+
+    AutoLock a(&lock_);
+
+    if (closed_)
+        return ZX_ERR_BAD_STATE;
+
+    // Someone else already faulted on this page; just wait with them.
+    if (requests_.find(offset).IsValid())
+        return ZX_ERR_SHOULD_WAIT;
+
+    fbl::AllocChecker ac;
+    fbl::RefPtr<Request> request = fbl::AdoptRef(new (&ac) Request(offset));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    zx_status_t status = SendRequest(offset, PAGE_SIZE);
+    if (status != ZX_OK) {
+        LTRACEF("failed to send request for offset %#" PRIx64 ": %d\n", offset, status);
+        return status;
+    }
+
+    LTRACEF("requested offset %#" PRIx64 "\n", offset);
+    requests_.insert(fbl::move(request));
+    return ZX_ERR_SHOULD_WAIT;
+}
+
+zx_status_t PageSource::WaitForPage(uint64_t offset, zx_time_t deadline) {
+    canary_.Assert();
+
+    fbl::RefPtr<Request> request;
+    {
+        AutoLock a(&lock_);
+        auto iter = requests_.find(offset);
+        if (!iter.IsValid()) {
+            // Already supplied, unless we were closed in the meantime.
+            return closed_ ? ZX_ERR_BAD_STATE : ZX_OK;
+        }
+        request = iter.CopyPointer();
+    }
+
+    zx_status_t status = event_wait_deadline(&request->event, deadline, true);
+    if (status != ZX_OK)
+        return status;
+
+    status = request->status;
+    if (status != ZX_OK) {
+        // The first waiter to see a failure retires the request.
+        AutoLock a(&lock_);
+        if (request->InContainer())
+            requests_.erase(*request);
+    }
+    return status;
+}
+
+bool PageSource::CompleteRequestLocked(fbl::RefPtr<Request> request, zx_status_t status) {
+    request->status = status;
+    return event_signal(&request->event, false) > 0;
+}
+
+void PageSource::OnPagesSupplied(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+
+    bool woken = false;
+    {
+        AutoLock a(&lock_);
+
+        auto iter = requests_.lower_bound(offset);
+        while (iter.IsValid() && iter->offset - offset < len) {
+            auto request = requests_.erase(iter++);
+            woken |= CompleteRequestLocked(fbl::move(request), ZX_OK);
+        }
+    }
+
+    if (woken)
+        thread_reschedule();
+}
+
+void PageSource::OnPagesFailed(uint64_t offset, uint64_t len, zx_status_t error) {
+    canary_.Assert();
+    DEBUG_ASSERT(error != ZX_OK);
+
+    bool woken = false;
+    {
+        AutoLock a(&lock_);
+
+        for (auto iter = requests_.lower_bound(offset);
+             iter.IsValid() && iter->offset - offset < len; ++iter) {
+            woken |= CompleteRequestLocked(iter.CopyPointer(), error);
+        }
+    }
+
+    if (woken)
+        thread_reschedule();
+}
+
+void PageSource::Close() {
+    canary_.Assert();
+
+    bool woken = false;
+    {
+        AutoLock a(&lock_);
+        if (closed_)
+            return;
+        closed_ = true;
+
+        while (!requests_.is_empty())
+            woken |= CompleteRequestLocked(requests_.pop_front(), ZX_ERR_BAD_STATE);
+    }
+
+    OnClose();
+
+    if (woken)
+        thread_reschedule();
+}
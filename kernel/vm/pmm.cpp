@@ -10,7 +10,9 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/auto_lock.h>
 #include <kernel/mp.h>
+#include <kernel/spinlock.h>
 #include <kernel/timer.h>
 #include <lib/console.h>
 #include <lk/init.h>
@@ -42,6 +44,62 @@ static fbl::Mutex arena_lock;
 static fbl::DoublyLinkedList<PmmArena*> arena_list TA_GUARDED(arena_lock);
 static size_t arena_cumulative_size TA_GUARDED(arena_lock);
 
+// Tables translating between vm_page_t and physical addresses in constant
+// time. Each page records the index of its arena in |arena_table|. For the
+// other direction, physical memory is divided into sections of
+// 1 << PMM_SECTION_SHIFT bytes, each recording the one arena it overlaps.
+// Addresses in sections shared by several arenas, or past the end of the
+// table, fall back to walking the arena list.
+//
+// Arenas added once |arena_table| is full are still used; their pages record
+// VM_PAGE_ARENA_INDEX_OVERFLOW and their sections are marked shared, so both
+// directions find them by walking the arena list.
+//
+// Both are only written while arenas are added during early boot, so they
+// are read without holding |arena_lock|.
+#define PMM_MAX_ARENAS VM_PAGE_ARENA_INDEX_OVERFLOW
+#define PMM_SECTION_SHIFT 26
+#define PMM_MAX_SECTIONS 16384u // 1TB of physical address space
+#define PMM_SECTION_NONE 0u
+#define PMM_SECTION_SHARED UINT8_MAX
+
+static PmmArena* arena_table[PMM_MAX_ARENAS];
+static size_t arena_count;
+// arena index + 1, PMM_SECTION_NONE or PMM_SECTION_SHARED
+static uint8_t section_table[PMM_MAX_SECTIONS];
+
+// Per-cpu caches of free pages that sit in front of the arenas. Single page
+// allocations and frees are satisfied out of the current cpu's cache without
+// touching |arena_lock|; the caches are refilled from and drained back to the
+// arenas in batches of PMM_PCPU_BATCH pages.
+//
+// Only pages belonging to KMAP arenas are cached, so a cached page satisfies
+// any set of allocation flags. Caching is disabled when free fill checking is
+// enabled, since cached pages bypass the arena's fill logic.
+#define PMM_PCPU_CACHE_ENABLE (!PMM_ENABLE_FREE_FILL)
+#define PMM_PCPU_CACHE_MAX 64u
+#define PMM_PCPU_BATCH 16u
+
+namespace {
+
+struct PmmPcpuCache {
+    // protects all of the fields below
+    SpinLock lock;
+
+    list_node free_list = LIST_INITIAL_VALUE(free_list);
+    size_t free_count = 0;
+
+    // statistics
+    uint64_t alloc_hits = 0;   // pages handed out of the cache
+    uint64_t alloc_misses = 0; // allocations that had to go to the arenas
+    uint64_t free_hits = 0;    // pages freed into the cache
+    uint64_t free_spills = 0;  // times the cache was drained back to the arenas
+} __CPU_ALIGN;
+
+} // namespace
+
+static PmmPcpuCache pcpu_cache[SMP_MAX_CPUS];
+
 #if PMM_ENABLE_FREE_FILL
 static void pmm_enforce_fill(uint level) {
     for (auto& a : arena_list) {
@@ -53,12 +111,26 @@ LK_INIT_HOOK(pmm_fill, &pmm_enforce_fill, LK_INIT_LEVEL_VM);
 
 // We don't need to hold the arena lock while executing this, since it is
 // only accesses values that are set once during system initialization.
-paddr_t vm_page_to_paddr(const vm_page_t* page) TA_NO_THREAD_SAFETY_ANALYSIS {
-    for (const auto& a : arena_list) {
-        // LTRACEF("testing page %p against arena %p\n", page, &a);
-        if (a.page_belongs_to_arena(page)) {
-            return a.page_address_from_arena(page);
+static PmmArena* page_to_arena(const vm_page_t* page) TA_NO_THREAD_SAFETY_ANALYSIS {
+    if (page->arena_index == VM_PAGE_ARENA_INDEX_OVERFLOW) {
+        for (auto& a : arena_list) {
+            if (a.page_belongs_to_arena(page)) {
+                return &a;
+            }
         }
+        return nullptr;
+    }
+    if (page->arena_index >= arena_count) {
+        return nullptr;
+    }
+    PmmArena* a = arena_table[page->arena_index];
+    return a->page_belongs_to_arena(page) ? a : nullptr;
+}
+
+paddr_t vm_page_to_paddr(const vm_page_t* page) {
+    const PmmArena* a = page_to_arena(page);
+    if (a) {
+        return a->page_address_from_arena(page);
     }
     return -1;
 }
@@ -66,6 +138,18 @@ paddr_t vm_page_to_paddr(const vm_page_t* page) TA_NO_THREAD_SAFETY_ANALYSIS {
 // We don't need to hold the arena lock while executing this, since it is
 // only accesses values that are set once during system initialization.
 vm_page_t* paddr_to_vm_page(paddr_t addr) TA_NO_THREAD_SAFETY_ANALYSIS {
+    const size_t section = addr >> PMM_SECTION_SHIFT;
+    if (section < PMM_MAX_SECTIONS && section_table[section] != PMM_SECTION_SHARED) {
+        if (section_table[section] == PMM_SECTION_NONE) {
+            return nullptr;
+        }
+        PmmArena* a = arena_table[section_table[section] - 1];
+        if (!a->address_in_arena(addr)) {
+            return nullptr;
+        }
+        return a->get_page((addr - a->base()) / PAGE_SIZE);
+    }
+
     for (auto& a : arena_list) {
         if (a.address_in_arena(addr)) {
             size_t index = (addr - a.base()) / PAGE_SIZE;
@@ -75,6 +159,18 @@ vm_page_t* paddr_to_vm_page(paddr_t addr) TA_NO_THREAD_SAFETY_ANALYSIS {
     return nullptr;
 }
 
+// Records |arena|, the arena at |index| in |arena_table|, in the sections it
+// overlaps. The sections of an overflow arena are marked shared.
+static void pmm_add_arena_sections(size_t index, const PmmArena* arena) {
+    const size_t first = arena->base() >> PMM_SECTION_SHIFT;
+    const size_t last = (arena->base() + arena->size() - 1) >> PMM_SECTION_SHIFT;
+    for (size_t s = first; s <= last && s < PMM_MAX_SECTIONS; s++) {
+        section_table[s] = (section_table[s] == PMM_SECTION_NONE &&
+                            index != VM_PAGE_ARENA_INDEX_OVERFLOW)
+                               ? static_cast<uint8_t>(index + 1) : PMM_SECTION_SHARED;
+    }
+}
+
 // We disable thread safety analysis here, since this function is only called
 // during early boot before threading exists.
 zx_status_t pmm_add_arena(const pmm_arena_info_t* info) TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -105,14 +201,223 @@ zx_status_t pmm_add_arena(const pmm_arena_info_t* info) TA_NO_THREAD_SAFETY_ANAL
 
 done_add:
     // tell the arena to allocate a page array
-    arena->BootAllocArray();
+    size_t index;
+    if (arena_count < PMM_MAX_ARENAS) {
+        index = arena_count++;
+        arena_table[index] = arena;
+    } else {
+        // past the end of the table, found by walking the arena list
+        index = VM_PAGE_ARENA_INDEX_OVERFLOW;
+    }
+    arena->BootAllocArray(static_cast<unsigned int>(index));
+    pmm_add_arena_sections(index, arena);
 
     arena_cumulative_size += info->size;
 
     return ZX_OK;
 }
 
+// Pulls up to |count| pages out of the KMAP arenas for use by a per-cpu cache.
+static size_t pmm_pcpu_cache_fill(size_t count, list_node* list) {
+    AutoLock al(&arena_lock);
+
+    size_t filled = 0;
+    for (auto& a : arena_list) {
+        if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+            continue;
+
+        filled += a.AllocCachePages(count - filled, list);
+        if (filled == count)
+            break;
+    }
+
+    return filled;
+}
+
+// Returns a list of cached pages to their arenas.
+static void pmm_pcpu_cache_return(list_node* list) {
+    AutoLock al(&arena_lock);
+
+    vm_page_t* page;
+    while ((page = list_remove_head_type(list, vm_page_t, free.node)) != nullptr) {
+        PmmArena* a = page_to_arena(page);
+        DEBUG_ASSERT(a);
+        a->FreeCachePage(page);
+    }
+}
+
+// Takes a page out of a cache, converting it to an allocated page.
+static vm_page_t* pmm_pcpu_cache_take_locked(PmmPcpuCache* cache) {
+    vm_page_t* page = list_remove_head_type(&cache->free_list, vm_page_t, free.node);
+    if (!page)
+        return nullptr;
+
+    DEBUG_ASSERT(cache->free_count > 0);
+    DEBUG_ASSERT(page_is_free(page) && page_is_pcpu_cached(page));
+
+    cache->free_count--;
+    cache->alloc_hits++;
+
+    page->flags = 0;
+    page->state = VM_PAGE_STATE_ALLOC;
+    return page;
+}
+
+// Allocates up to |count| pages out of the current cpu's cache, refilling it
+// from the arenas once if it runs dry. Returns the number of pages allocated.
+static size_t pmm_pcpu_cache_alloc(size_t count, list_node* list) {
+    if (!PMM_PCPU_CACHE_ENABLE)
+        return 0;
+
+    // The thread may migrate after sampling the cpu number; that only costs
+    // locality, since every cache is protected by its own lock.
+    PmmPcpuCache* cache = &pcpu_cache[arch_curr_cpu_num()];
+
+    size_t allocated = 0;
+    {
+        AutoSpinLockIrqSave guard(&cache->lock);
+        vm_page_t* page;
+        while (allocated < count && (page = pmm_pcpu_cache_take_locked(cache)) != nullptr) {
+            list_add_tail(list, &page->free.node);
+            allocated++;
+        }
+        if (allocated == count)
+            return allocated;
+
+        cache->alloc_misses++;
+    }
+
+    // Large requests go straight to the arenas rather than churning the cache.
+    if (count - allocated > PMM_PCPU_BATCH)
+        return allocated;
+
+    list_node fill = LIST_INITIAL_VALUE(fill);
+    if (pmm_pcpu_cache_fill(PMM_PCPU_BATCH, &fill) == 0)
+        return allocated;
+
+    list_node spill = LIST_INITIAL_VALUE(spill);
+    {
+        AutoSpinLockIrqSave guard(&cache->lock);
+        vm_page_t* page;
+        while ((page = list_remove_head_type(&fill, vm_page_t, free.node)) != nullptr) {
+            list_add_tail(&cache->free_list, &page->free.node);
+            cache->free_count++;
+        }
+        while (allocated < count && (page = pmm_pcpu_cache_take_locked(cache)) != nullptr) {
+            list_add_tail(list, &page->free.node);
+            allocated++;
+        }
+        // Another thread on this cpu may have refilled the cache concurrently.
+        while (cache->free_count > PMM_PCPU_CACHE_MAX) {
+            page = list_remove_head_type(&cache->free_list, vm_page_t, free.node);
+            list_add_tail(&spill, &page->free.node);
+            cache->free_count--;
+        }
+    }
+    if (!list_is_empty(&spill))
+        pmm_pcpu_cache_return(&spill);
+
+    return allocated;
+}
+
+// Tries to free |page| into the current cpu's cache. Returns false if the page
+// is not cacheable and must be returned to its arena directly.
+static bool pmm_pcpu_cache_free(vm_page_t* page) {
+    if (!PMM_PCPU_CACHE_ENABLE)
+        return false;
+
+    const PmmArena* a = page_to_arena(page);
+    if (!a || (a->flags() & PMM_ARENA_FLAG_KMAP) == 0)
+        return false;
+
+    DEBUG_ASSERT(page->state != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
+
+    page->state = VM_PAGE_STATE_FREE;
+    page->flags = VM_PAGE_FLAG_PCPU_CACHED;
+
+    PmmPcpuCache* cache = &pcpu_cache[arch_curr_cpu_num()];
+
+    list_node spill = LIST_INITIAL_VALUE(spill);
+    {
+        AutoSpinLockIrqSave guard(&cache->lock);
+        list_add_head(&cache->free_list, &page->free.node);
+        cache->free_count++;
+        cache->free_hits++;
+
+        // Over the high water mark, hand the coldest batch back to the arenas.
+        if (cache->free_count > PMM_PCPU_CACHE_MAX) {
+            for (size_t i = 0; i < PMM_PCPU_BATCH; i++) {
+                vm_page_t* p = list_remove_tail_type(&cache->free_list, vm_page_t, free.node);
+                list_add_tail(&spill, &p->free.node);
+            }
+            cache->free_count -= PMM_PCPU_BATCH;
+            cache->free_spills++;
+        }
+    }
+    if (!list_is_empty(&spill))
+        pmm_pcpu_cache_return(&spill);
+
+    return true;
+}
+
+// Returns every page in every per-cpu cache to the arenas. Used when an
+// allocation needs specific or contiguous pages that may be cached.
+static void pmm_pcpu_cache_drain_all() {
+    for (auto& cache : pcpu_cache) {
+        list_node drain = LIST_INITIAL_VALUE(drain);
+        {
+            AutoSpinLockIrqSave guard(&cache.lock);
+            if (cache.free_count == 0)
+                continue;
+            list_move(&cache.free_list, &drain);
+            cache.free_count = 0;
+            cache.free_spills++;
+        }
+        pmm_pcpu_cache_return(&drain);
+    }
+}
+
+static size_t pmm_pcpu_cache_count_free() {
+    size_t free = 0;
+    for (const auto& cache : pcpu_cache) {
+        free += __atomic_load_n(&cache.free_count, __ATOMIC_RELAXED);
+    }
+    return free;
+}
+
+// No lock here in the panic case, the counters are only read.
+static void pmm_pcpu_cache_dump(bool is_panic) {
+    for (uint i = 0; i < arch_max_num_cpus(); i++) {
+        PmmPcpuCache* cache = &pcpu_cache[i];
+        spin_lock_saved_state_t state;
+        if (!is_panic) {
+            cache->lock.AcquireIrqSave(state);
+        }
+        size_t free_count = cache->free_count;
+        uint64_t alloc_hits = cache->alloc_hits;
+        uint64_t alloc_misses = cache->alloc_misses;
+        uint64_t free_hits = cache->free_hits;
+        uint64_t free_spills = cache->free_spills;
+        if (!is_panic) {
+            cache->lock.ReleaseIrqRestore(state);
+        }
+        printf("cpu %2u: cached %3zu alloc hits %" PRIu64 " misses %" PRIu64
+               " free hits %" PRIu64 " spills %" PRIu64 "\n",
+               i, free_count, alloc_hits, alloc_misses, free_hits, free_spills);
+    }
+}
+
 vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
+    list_node list = LIST_INITIAL_VALUE(list);
+    if (pmm_pcpu_cache_alloc(1, &list) == 1) {
+        vm_page_t* page = list_remove_head_type(&list, vm_page_t, free.node);
+        if (pa) {
+            *pa = vm_page_to_paddr(page);
+        }
+        LTRACEF("allocating cached page %p\n", page);
+        return page;
+    }
+
     AutoLock al(&arena_lock);
 
     /* walk the arenas in order until we find one with a free page */
@@ -142,10 +447,14 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
     if (count == 0)
         return 0;
 
+    /* try the local cache first */
+    size_t allocated = pmm_pcpu_cache_alloc(count, list);
+    if (allocated == count)
+        return allocated;
+
     AutoLock al(&arena_lock);
 
     /* walk the arenas in order, allocating as many pages as we can from each */
-    size_t allocated = 0;
     for (auto& a : arena_list) {
         DEBUG_ASSERT(count > allocated);
 
@@ -165,16 +474,9 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
     return allocated;
 }
 
-size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
-    LTRACEF("address %#" PRIxPTR ", count %zu\n", address, count);
-
-    uint allocated = 0;
-    if (count == 0)
-        return 0;
-
-    address = ROUNDDOWN(address, PAGE_SIZE);
-
-    AutoLock al(&arena_lock);
+static size_t pmm_alloc_range_locked(paddr_t address, size_t count, struct list_node* list)
+    TA_REQ(arena_lock) {
+    size_t allocated = 0;
 
     /* walk through the arenas, looking to see if the physical page belongs to it */
     for (auto& a : arena_list) {
@@ -197,17 +499,33 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
     return allocated;
 }
 
-size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_log2, paddr_t* pa,
-                            struct list_node* list) {
-    LTRACEF("count %zu, align %u\n", count, alignment_log2);
+size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
+    LTRACEF("address %#" PRIxPTR ", count %zu\n", address, count);
 
     if (count == 0)
         return 0;
-    if (alignment_log2 < PAGE_SIZE_SHIFT)
-        alignment_log2 = PAGE_SIZE_SHIFT;
 
-    AutoLock al(&arena_lock);
+    address = ROUNDDOWN(address, PAGE_SIZE);
+
+    size_t allocated;
+    {
+        AutoLock al(&arena_lock);
+        allocated = pmm_alloc_range_locked(address, count, list);
+    }
+    if (allocated < count && PMM_PCPU_CACHE_ENABLE) {
+        // some of the range may be sitting in per-cpu caches
+        pmm_pcpu_cache_drain_all();
+
+        AutoLock al(&arena_lock);
+        allocated += pmm_alloc_range_locked(address + allocated * PAGE_SIZE,
+                                            count - allocated, list);
+    }
+
+    return allocated;
+}
 
+static size_t pmm_alloc_contiguous_locked(size_t count, uint alloc_flags, uint8_t alignment_log2,
+                                          paddr_t* pa, struct list_node* list) TA_REQ(arena_lock) {
     for (auto& a : arena_list) {
         /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
         if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
@@ -222,10 +540,37 @@ size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_lo
         }
     }
 
-    LTRACEF("couldn't find run\n");
     return 0;
 }
 
+size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_log2, paddr_t* pa,
+                            struct list_node* list) {
+    LTRACEF("count %zu, align %u\n", count, alignment_log2);
+
+    if (count == 0)
+        return 0;
+    if (alignment_log2 < PAGE_SIZE_SHIFT)
+        alignment_log2 = PAGE_SIZE_SHIFT;
+
+    size_t allocated;
+    {
+        AutoLock al(&arena_lock);
+        allocated = pmm_alloc_contiguous_locked(count, alloc_flags, alignment_log2, pa, list);
+    }
+    if (allocated == 0 && PMM_PCPU_CACHE_ENABLE) {
+        // cached pages may be fragmenting an otherwise suitable run
+        pmm_pcpu_cache_drain_all();
+
+        AutoLock al(&arena_lock);
+        allocated = pmm_alloc_contiguous_locked(count, alloc_flags, alignment_log2, pa, list);
+    }
+
+    if (allocated == 0) {
+        LTRACEF("couldn't find run\n");
+    }
+    return allocated;
+}
+
 /* physically allocate a run from arenas marked as KMAP */
 void* pmm_alloc_kpages(size_t count, struct list_node* list, paddr_t* _pa) {
     LTRACEF("count %zu\n", count);
@@ -300,20 +645,32 @@ size_t pmm_free(struct list_node* list) {
 
     DEBUG_ASSERT(list);
 
+    uint count = 0;
+
+    /* single page frees are the common case, try to keep them off the arena lock */
+    if (!list_is_empty(list) && list->next == list->prev) {
+        vm_page_t* page = list_peek_head_type(list, vm_page_t, free.node);
+
+        DEBUG_ASSERT_MSG(!page_is_free(page), "page %p state %u\n", page, page->state);
+
+        list_delete(&page->free.node);
+        if (pmm_pcpu_cache_free(page)) {
+            return 1;
+        }
+        list_add_head(list, &page->free.node);
+    }
+
     AutoLock al(&arena_lock);
 
-    uint count = 0;
     while (!list_is_empty(list)) {
         vm_page_t* page = list_remove_head_type(list, vm_page_t, free.node);
 
         DEBUG_ASSERT_MSG(!page_is_free(page), "page %p state %u\n", page, page->state);
 
         /* see which arena this page belongs to and add it */
-        for (auto& a : arena_list) {
-            if (a.FreePage(page) >= 0) {
-                count++;
-                break;
-            }
+        PmmArena* a = page_to_arena(page);
+        if (a && a->FreePage(page) >= 0) {
+            count++;
         }
     }
 
@@ -341,11 +698,11 @@ static size_t pmm_count_free_pages_locked() TA_REQ(arena_lock) {
 
 size_t pmm_count_free_pages() {
     AutoLock al(&arena_lock);
-    return pmm_count_free_pages_locked();
+    return pmm_count_free_pages_locked() + pmm_pcpu_cache_count_free();
 }
 
 static void pmm_dump_free() TA_REQ(arena_lock) {
-    auto megabytes_free = pmm_count_free_pages_locked() / 256u;
+    auto megabytes_free = (pmm_count_free_pages_locked() + pmm_pcpu_cache_count_free()) / 256u;
     printf(" %zu free MBs\n", megabytes_free);
 }
 
@@ -395,6 +752,7 @@ static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
     usage:
         printf("usage:\n");
         printf("%s arenas\n", argv[0].str);
+        printf("%s cache\n", argv[0].str);
         if (!is_panic) {
             printf("%s alloc <count>\n", argv[0].str);
             printf("%s alloc_range <address> <count>\n", argv[0].str);
@@ -403,6 +761,7 @@ static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
             printf("%s dump_alloced\n", argv[0].str);
             printf("%s free_alloced\n", argv[0].str);
             printf("%s free\n", argv[0].str);
+            printf("%s drain_cache\n", argv[0].str);
         }
         return ZX_ERR_INTERNAL;
     }
@@ -411,10 +770,14 @@ static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
 
     if (!strcmp(argv[1].str, "arenas")) {
         arena_dump(is_panic);
+    } else if (!strcmp(argv[1].str, "cache")) {
+        pmm_pcpu_cache_dump(is_panic);
     } else if (is_panic) {
         // No other operations will work during a panic.
-        printf("Only the \"arenas\" command is available during a panic.\n");
+        printf("Only the \"arenas\" and \"cache\" commands are available during a panic.\n");
         goto usage;
+    } else if (!strcmp(argv[1].str, "drain_cache")) {
+        pmm_pcpu_cache_drain_all();
     } else if (!strcmp(argv[1].str, "free")) {
         static bool show_mem = false;
         static timer_t timer;
@@ -49,7 +49,7 @@ void PmmArena::CheckFreeFill(vm_page_t* page) {
 }
 #endif // PMM_ENABLE_FREE_FILL
 
-void PmmArena::BootAllocArray() {
+void PmmArena::BootAllocArray(unsigned int index) {
     /* allocate an array of pages to back this one */
     size_t page_count = size() / PAGE_SIZE;
     size_t size = page_count * VM_PAGE_STRUCT_SIZE;
@@ -66,6 +66,7 @@ void PmmArena::BootAllocArray() {
     for (size_t i = 0; i < page_count; i++) {
         auto& p = page_array_[i];
 
+        p.arena_index = index & ((1u << VM_PAGE_ARENA_INDEX_BITS) - 1);
         list_add_tail(&free_list_, &p.free.node);
     }
 
@@ -108,7 +109,7 @@ vm_page_t* PmmArena::AllocSpecific(paddr_t pa) {
     DEBUG_ASSERT(index < size() / PAGE_SIZE);
 
     vm_page_t* page = get_page(index);
-    if (!page_is_free(page)) {
+    if (!page_is_free(page) || page_is_pcpu_cached(page)) {
         /* we hit an allocated page */
         return nullptr;
     }
@@ -173,7 +174,7 @@ retry:
     while ((start < size() / PAGE_SIZE) && ((start + count) <= size() / PAGE_SIZE)) {
         vm_page_t* p = &page_array_[start];
         for (uint i = 0; i < count; i++) {
-            if (!page_is_free(p)) {
+            if (!page_is_free(p) || page_is_pcpu_cached(p)) {
                 /* this run is broken, break out of the inner loop.
                  * start over at the next alignment boundary
                  */
@@ -235,6 +236,40 @@ zx_status_t PmmArena::FreePage(vm_page_t* page) {
     return ZX_OK;
 }
 
+size_t PmmArena::AllocCachePages(size_t count, list_node* list) {
+    size_t moved = 0;
+
+    while (moved < count) {
+        vm_page_t* page = list_remove_head_type(&free_list_, vm_page_t, free.node);
+        if (!page)
+            break;
+
+        DEBUG_ASSERT(free_count_ > 0);
+        DEBUG_ASSERT(page_is_free(page));
+        DEBUG_ASSERT(!page_is_pcpu_cached(page));
+
+        free_count_--;
+
+        page->flags |= VM_PAGE_FLAG_PCPU_CACHED;
+        list_add_tail(list, &page->free.node);
+
+        moved++;
+    }
+
+    return moved;
+}
+
+void PmmArena::FreeCachePage(vm_page_t* page) {
+    DEBUG_ASSERT(page_belongs_to_arena(page));
+    DEBUG_ASSERT(page_is_free(page));
+    DEBUG_ASSERT(page_is_pcpu_cached(page));
+
+    page->flags = 0;
+
+    list_add_head(&free_list_, &page->free.node);
+    free_count_++;
+}
+
 void PmmArena::CountStates(size_t state_count[_VM_PAGE_STATE_COUNT]) const {
     for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
         state_count[page_array_[i].state]++;
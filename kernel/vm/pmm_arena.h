@@ -15,6 +15,15 @@
 #define PMM_ENABLE_FREE_FILL 0
 #define PMM_FREE_FILL_BYTE 0x42
 
+// Set in vm_page::flags while a free page is parked in a per-cpu page cache
+// instead of on its arena's free list. Such pages stay in the FREE state so
+// page statistics remain accurate, but the arena must not hand them out.
+#define VM_PAGE_FLAG_PCPU_CACHED (1u << 0)
+
+static inline bool page_is_pcpu_cached(const vm_page_t* page) {
+    return (page->flags & VM_PAGE_FLAG_PCPU_CACHED) != 0;
+}
+
 class PmmArena : public fbl::DoublyLinkedListable<PmmArena*> {
 public:
     PmmArena(const pmm_arena_info_t* info);
@@ -22,8 +31,9 @@ public:
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(PmmArena);
 
-    // set up the per page structures, allocated out of the boot time allocator
-    void BootAllocArray();
+    // set up the per page structures, allocated out of the boot time allocator,
+    // recording |index| as the arena index of each page
+    void BootAllocArray(unsigned int index);
 
 #if PMM_ENABLE_FREE_FILL
     void EnforceFill();
@@ -54,6 +64,13 @@ public:
     size_t AllocContiguous(size_t count, uint8_t alignment_log2, paddr_t* pa, struct list_node* list);
     zx_status_t FreePage(vm_page_t* page);
 
+    // per-cpu page cache support
+    // Moves up to |count| pages off the free list onto |list|, leaving them in
+    // the FREE state and marked as cached. Returns the number of pages moved.
+    size_t AllocCachePages(size_t count, list_node* list);
+    // Returns a page previously handed out by AllocCachePages to the free list.
+    void FreeCachePage(vm_page_t* page);
+
     // helpers
     bool page_belongs_to_arena(const vm_page* page) const {
         uintptr_t page_addr = reinterpret_cast<uintptr_t>(page);
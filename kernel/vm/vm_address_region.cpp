@@ -18,6 +18,7 @@
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
 #include <vm/vm_object.h>
+#include <zircon/syscalls/object.h>
 #include <zircon/types.h>
 
 #if WITH_LIB_VDSO
@@ -28,9 +29,14 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+// The fault-around window of root regions: enough to take sequential reads of
+// a resident file or library a trap per 64KB rather than per page.
+static const uint32_t kDefaultFaultAroundPages = 16;
+
 VmAddressRegion::VmAddressRegion(VmAspace& aspace, vaddr_t base, size_t size, uint32_t vmar_flags)
     : VmAddressRegionOrMapping(base, size, vmar_flags | VMAR_CAN_RWX_FLAGS,
-                               &aspace, nullptr) {
+                               &aspace, nullptr),
+      fault_around_pages_(kDefaultFaultAroundPages) {
 
     // We add in CAN_RWX_FLAGS above, since an address space can't usefully
     // contain a process without all of these.
@@ -42,7 +48,8 @@ VmAddressRegion::VmAddressRegion(VmAspace& aspace, vaddr_t base, size_t size, ui
 VmAddressRegion::VmAddressRegion(VmAddressRegion& parent, vaddr_t base, size_t size,
                                  uint32_t vmar_flags, const char* name)
     : VmAddressRegionOrMapping(base, size, vmar_flags, parent.aspace_.get(),
-                               &parent) {
+                               &parent),
+      fault_around_pages_(parent.fault_around_pages_) {
 
     strlcpy(const_cast<char*>(name_), name, sizeof(name_));
     LTRACEF("%p '%s'\n", this, name_);
@@ -57,7 +64,8 @@ VmAddressRegion::VmAddressRegion(VmAspace& kernel_aspace)
 }
 
 VmAddressRegion::VmAddressRegion()
-    : VmAddressRegionOrMapping(0, 0, 0, nullptr, nullptr) {
+    : VmAddressRegionOrMapping(0, 0, 0, nullptr, nullptr),
+      fault_around_pages_(0) {
 
     strlcpy(const_cast<char*>(name_), "dummy", sizeof(name_));
     LTRACEF("%p '%s'\n", this, name_);
@@ -380,7 +388,18 @@ size_t VmAddressRegion::AllocatedPagesLocked() const {
     return sum;
 }
 
-zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
+zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) {
+    canary_.Assert();
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+
+    fbl::RefPtr<VmMapping> mapping = FindMappingLocked(va);
+    if (!mapping)
+        return ZX_ERR_NOT_FOUND;
+
+    return mapping->PageFault(va, pf_flags, page_request);
+}
+
+fbl::RefPtr<VmMapping> VmAddressRegion::FindMappingLocked(vaddr_t va) {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
@@ -388,10 +407,32 @@ zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
          auto next = vmar->FindRegionLocked(va);
          vmar = next->as_vm_address_region()) {
         if (next->is_mapping())
-            return next->PageFault(va, pf_flags);
+            return next->as_vm_mapping();
     }
 
-    return ZX_ERR_NOT_FOUND;
+    return nullptr;
+}
+
+uint32_t VmAddressRegion::FaultAroundPages() {
+    canary_.Assert();
+
+    AutoLock guard(aspace_->lock());
+    return fault_around_pages_;
+}
+
+zx_status_t VmAddressRegion::SetFaultAroundPages(uint32_t pages) {
+    canary_.Assert();
+
+    if (pages > ZX_VMAR_FAULT_AROUND_MAX || (pages & (pages - 1)) != 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    AutoLock guard(aspace_->lock());
+    if (state_ != LifeCycleState::ALIVE) {
+        return ZX_ERR_BAD_STATE;
+    }
+    fault_around_pages_ = pages;
+    return ZX_OK;
 }
 
 bool VmAddressRegion::IsRangeAvailableLocked(vaddr_t base, size_t size) {
@@ -159,6 +159,10 @@ zx_status_t VmAspace::Init() {
 
     InitializeAslr();
 
+    // only user mappings get large pages transparently
+    large_pages_enabled_ = is_user() && arch_aspace_.LargePageSize() != 0 &&
+                           cmdline_get_bool("kernel.vm.large-pages", true);
+
     if (likely(!root_vmar_)) {
         return VmAddressRegion::CreateRoot(*this, VMAR_FLAG_CAN_MAP_SPECIFIC, &root_vmar_);
     }
@@ -544,12 +548,64 @@ zx_status_t VmAspace::PageFault(vaddr_t va, uint flags) {
         flags |= VMM_PF_FLAG_GUEST;
     }
 
-    // for now, hold the aspace lock across the page fault operation,
-    // which stops any other operations on the address space from moving
-    // the region out from underneath it
-    AutoLock a(&lock_);
+    page_faults_.fetch_add(1);
+
+    for (;;) {
+        PageRequest page_request;
+        zx_status_t status;
+
+        // The aspace lock is only needed to find the mapping; the VMO then
+        // faults the page in (allocating, zeroing or copying it) under its
+        // own lock alone, so that threads faulting on different pages do
+        // that work in parallel rather than one at a time.
+        fbl::RefPtr<VmObject> vmo;
+        uint64_t vmo_offset;
+        uint64_t large_offset;
+        size_t large_size;
+        {
+            AutoLock a(&lock_);
+
+            fbl::RefPtr<VmMapping> mapping = root_vmar_->FindMappingLocked(va);
+            if (!mapping)
+                return ZX_ERR_NOT_FOUND;
+            status = mapping->CheckFaultLocked(va, flags, &vmo_offset);
+            if (status != ZX_OK)
+                return status;
+            large_size = mapping->LargePageForFaultLocked(va, flags, &large_offset);
+            vmo = mapping->vmo();
+        }
+        {
+            AutoLock al(vmo->lock());
+
+            // commit a whole large page at once where the mapping could use
+            // one; faulting a single page in would rule it out
+            paddr_t pa;
+            if (large_size == 0 ||
+                vmo->GetLargePageLocked(large_offset, large_size,
+                                        flags & VMM_PF_FLAG_WRITE, &pa) != ZX_OK) {
+                status = vmo->GetPageLocked(vmo_offset, flags, nullptr, nullptr, &pa);
+            }
+            if (status == ZX_ERR_SHOULD_WAIT)
+                vmo->GetPageRequestLocked(vmo_offset, &page_request);
+        }
+        if (status == ZX_OK) {
+            // the mapping may have been unmapped, protected or replaced while
+            // the aspace lock was dropped, so look it up and check it again
+            // before touching the page tables. The page is normally resident
+            // by now; if it was decommitted meanwhile it is faulted in again.
+            AutoLock a(&lock_);
+
+            status = root_vmar_->PageFault(va, flags, &page_request);
+        }
+        if (status != ZX_ERR_SHOULD_WAIT)
+            return status;
 
-    return root_vmar_->PageFault(va, flags);
+        // the page is being supplied by a pager; wait for it without holding
+        // any locks, then look the mapping up again since it may have changed
+        status = page_request.source->WaitForPage(page_request.offset, ZX_TIME_INFINITE);
+        if (status != ZX_OK)
+            return status;
+    }
 }
 
 void VmAspace::Dump(bool verbose) const {
@@ -9,6 +9,7 @@
 #include "vm_priv.h"
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
@@ -394,7 +395,32 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
         return ZX_ERR_INVALID_ARGS;
     }
 
-    AutoLock guard(aspace_->lock());
+    for (;;) {
+        PageRequest page_request;
+        size_t mapped = 0;
+        zx_status_t status;
+        {
+            AutoLock guard(aspace_->lock());
+            status = MapRangeLocked(offset, len, commit, &mapped, &page_request);
+        }
+        if (status != ZX_ERR_SHOULD_WAIT)
+            return status;
+
+        // a page being committed is coming from a pager; wait for it without
+        // holding any locks and carry on from it, checking the mapping again
+        status = page_request.source->WaitForPage(page_request.offset, ZX_TIME_INFINITE);
+        if (status != ZX_OK)
+            return status;
+        offset += mapped;
+        len -= mapped;
+    }
+}
+
+zx_status_t VmMapping::MapRangeLocked(size_t offset, size_t len, bool commit, size_t* mapped,
+                                      PageRequest* page_request) {
+    canary_.Assert();
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+
     if (state_ != LifeCycleState::ALIVE) {
         return ZX_ERR_BAD_STATE;
     }
@@ -420,6 +446,12 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
     currently_faulting_ = true;
     auto ac = fbl::MakeAutoCall([&]() { currently_faulting_ = false; });
 
+    // aligned runs of the range the vmo can back with a large page are
+    // mapped with one
+    const size_t large_size = (aspace_->large_pages_enabled_ &&
+                               (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_RWX_MASK))
+                                  ? aspace_->arch_aspace().LargePageSize() : 0;
+
     // iterate through the range, grabbing a page from the underlying object and
     // mapping it in
     size_t o;
@@ -428,7 +460,35 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
 
         zx_status_t status;
         paddr_t pa;
+        if (large_size != 0 && IS_ALIGNED(base_ + o, large_size) &&
+            IS_ALIGNED(vmo_offset, large_size) && offset + len - o >= large_size &&
+            object_->GetLargePageLocked(vmo_offset, large_size, commit, &pa) == ZX_OK) {
+            vaddr_t va = base_ + o;
+            LTRACEF_LEVEL(2, "mapping large page pa %#" PRIxPTR " to va %#" PRIxPTR "\n", pa, va);
+
+            status = aspace_->arch_aspace().Unmap(va, large_size / PAGE_SIZE, nullptr);
+            if (status != ZX_OK)
+                return status;
+            size_t mapped;
+            status = aspace_->arch_aspace().Map(va, pa, large_size / PAGE_SIZE,
+                                                arch_mmu_flags_, &mapped);
+            if (status != ZX_OK) {
+                TRACEF("error %d mapping large page at va %#" PRIxPTR " pa %#" PRIxPTR "\n",
+                       status, va, pa);
+                return status;
+            }
+            DEBUG_ASSERT(mapped == large_size / PAGE_SIZE);
+            o += large_size - PAGE_SIZE;
+            continue;
+        }
+
         status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT && commit) {
+            // the caller waits for the page without our locks held
+            object_->GetPageRequestLocked(vmo_offset, page_request);
+            *mapped = o - offset;
+            return status;
+        }
         if (status < 0) {
             // no page to map
             if (commit) {
@@ -476,6 +536,34 @@ zx_status_t VmMapping::DecommitRange(size_t offset, size_t len,
     return object_->DecommitRange(object_offset_ + offset, len, decommitted);
 }
 
+zx_status_t VmMapping::ReplacePages(vaddr_t va, list_node* pages, size_t count) {
+    canary_.Assert();
+    LTRACEF("%p [%#zx+%#zx], va %#" PRIxPTR ", count %zu\n",
+            this, base_, size_, va, count);
+
+    if (!IS_PAGE_ALIGNED(va) || count > SIZE_MAX / PAGE_SIZE) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const size_t len = count * PAGE_SIZE;
+
+    AutoLock guard(aspace_->lock());
+    if (state_ != LifeCycleState::ALIVE) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (va < base_ || va + len < va || va + len > base_ + size_) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    if (!(arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_WRITE)) {
+        return ZX_ERR_ACCESS_DENIED;
+    }
+    if ((arch_mmu_flags_ & ARCH_MMU_FLAG_CACHE_MASK) != ARCH_MMU_FLAG_CACHED) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    // VmObject::ReplacePages will call back into our instance's
+    // VmMapping::UnmapVmoRangeLocked to drop the old pages.
+    return object_->ReplacePages(object_offset_ + (va - base_), pages, count);
+}
+
 zx_status_t VmMapping::DestroyLocked() {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
@@ -526,18 +614,19 @@ zx_status_t VmMapping::DestroyLocked() {
     return ZX_OK;
 }
 
-zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
+zx_status_t VmMapping::CheckFaultLocked(vaddr_t va, const uint pf_flags,
+                                        uint64_t* vmo_offset) const {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
     DEBUG_ASSERT(va >= base_ && va <= base_ + size_ - 1);
 
     va = ROUNDDOWN(va, PAGE_SIZE);
-    uint64_t vmo_offset = va - base_ + object_offset_;
+    *vmo_offset = va - base_ + object_offset_;
 
     __UNUSED char pf_string[5];
     LTRACEF("%p va %#" PRIxPTR " vmo_offset %#" PRIx64 ", pf_flags %#x (%s)\n",
-            this, va, vmo_offset, pf_flags,
+            this, va, *vmo_offset, pf_flags,
             vmm_pf_flags_to_string(pf_flags, pf_string));
 
     // make sure we have permission to continue
@@ -561,6 +650,19 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
         LTRACEF("permission failure: execute fault on no execute region\n");
         return ZX_ERR_ACCESS_DENIED;
     }
+    return ZX_OK;
+}
+
+zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* page_request) {
+    canary_.Assert();
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+
+    uint64_t vmo_offset;
+    zx_status_t status = CheckFaultLocked(va, pf_flags, &vmo_offset);
+    if (status != ZX_OK) {
+        return status;
+    }
+    va = ROUNDDOWN(va, PAGE_SIZE);
 
     // grab the lock for the vmo
     AutoLock al(object_->lock());
@@ -573,10 +675,21 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     currently_faulting_ = true;
     auto ac = fbl::MakeAutoCall([&]() { currently_faulting_ = false; });
 
+    // map a whole large page instead, where the vmo has one for us
+    if (FaultLargePageLocked(va, pf_flags) == ZX_OK) {
+        return ZX_OK;
+    }
+
     // fault in or grab an existing page
     paddr_t new_pa;
     vm_page_t* page;
-    zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, &page, &new_pa);
+    status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, &page, &new_pa);
+    if (status == ZX_ERR_SHOULD_WAIT) {
+        // the vmo's page source has been asked for the page; the caller
+        // waits for it without our locks held and faults again
+        object_->GetPageRequestLocked(vmo_offset, page_request);
+        return status;
+    }
     if (status < 0) {
         TRACEF("ERROR: failed to fault in or grab existing page\n");
         TRACEF("%p vmo_offset %#" PRIx64 ", pf_flags %#x\n", this, vmo_offset, pf_flags);
@@ -657,6 +770,9 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
             return ZX_ERR_NO_MEMORY;
         }
         DEBUG_ASSERT(mapped == 1);
+
+        // a fault here is likely to be followed by faults on its neighbors
+        FaultAroundLocked(va, pf_flags, mmu_flags);
     }
 
 // TODO: figure out what to do with this
@@ -670,6 +786,113 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     return ZX_OK;
 }
 
+size_t VmMapping::LargePageForFaultLocked(vaddr_t va, uint pf_flags,
+                                          uint64_t* vmo_offset) const {
+    canary_.Assert();
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+
+    if (!aspace_->large_pages_enabled_ || (pf_flags & VMM_PF_FLAG_GUEST))
+        return 0;
+
+    // the whole large page must lie in the mapping, equally aligned in the vmo
+    const size_t size = aspace_->arch_aspace().LargePageSize();
+    const vaddr_t large_va = ROUNDDOWN(va, size);
+    if (large_va < base_ || size_ < size || large_va - base_ > size_ - size)
+        return 0;
+    const uint64_t offset = large_va - base_ + object_offset_;
+    if (!IS_ALIGNED(offset, size))
+        return 0;
+
+    *vmo_offset = offset;
+    return size;
+}
+
+zx_status_t VmMapping::FaultLargePageLocked(vaddr_t va, uint pf_flags) {
+    canary_.Assert();
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+
+    uint64_t vmo_offset;
+    const size_t size = LargePageForFaultLocked(va, pf_flags, &vmo_offset);
+    if (size == 0)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    paddr_t pa;
+    zx_status_t status = object_->GetLargePageLocked(vmo_offset, size,
+                                                     pf_flags & VMM_PF_FLAG_WRITE, &pa);
+    if (status != ZX_OK)
+        return status;
+
+    // the pages are the vmo's own, so they are mapped with the full
+    // permissions of the mapping, replacing any small pages mapped before
+    const vaddr_t large_va = ROUNDDOWN(va, size);
+    LTRACEF("mapping large page pa %#" PRIxPTR " to va %#" PRIxPTR "\n", pa, large_va);
+
+    status = aspace_->arch_aspace().Unmap(large_va, size / PAGE_SIZE, nullptr);
+    if (status != ZX_OK)
+        return status;
+    size_t mapped;
+    status = aspace_->arch_aspace().Map(large_va, pa, size / PAGE_SIZE, arch_mmu_flags_, &mapped);
+    if (status != ZX_OK) {
+        // fall back to mapping just the faulting page; the rest fault again
+        TRACEF("failed to map large page at va %#" PRIxPTR "\n", large_va);
+        return status;
+    }
+    DEBUG_ASSERT(mapped == size / PAGE_SIZE);
+
+#if ARCH_ARM64
+    if (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE)
+        arch_sync_cache_range(large_va, size);
+#endif
+    return ZX_OK;
+}
+
+void VmMapping::FaultAroundLocked(vaddr_t va, uint pf_flags, uint mmu_flags) {
+    canary_.Assert();
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+
+    const size_t window = static_cast<size_t>(parent_->fault_around_pages_) * PAGE_SIZE;
+    if (window <= PAGE_SIZE || (pf_flags & VMM_PF_FLAG_GUEST))
+        return;
+
+    // only pages the vmo already holds are mapped: faulting in others, or
+    // mapping a parent's pages or the zero page, is left to their own faults
+    struct Context {
+        VmMapping* mapping;
+        vaddr_t va;
+        uint mmu_flags;
+        size_t mapped;
+    } context = {this, va, mmu_flags, 0};
+    const size_t start = ROUNDDOWN(va - base_, window);
+    object_->LookupResidentLocked(
+        object_offset_ + start, fbl::min(window, size_ - start),
+        [](void* ctx, size_t offset, size_t index, paddr_t pa) -> zx_status_t {
+            Context* c = static_cast<Context*>(ctx);
+            VmMapping* m = c->mapping;
+            vaddr_t page_va = m->base_ + (offset - m->object_offset_);
+            paddr_t cur_pa;
+            uint cur_flags;
+            if (page_va == c->va ||
+                m->aspace_->arch_aspace().Query(page_va, &cur_pa, &cur_flags) == ZX_OK) {
+                return ZX_OK;
+            }
+            size_t mapped;
+            if (m->aspace_->arch_aspace().Map(page_va, pa, 1, c->mmu_flags, &mapped) == ZX_OK) {
+#if ARCH_ARM64
+                if (m->arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE)
+                    arch_sync_cache_range(page_va, PAGE_SIZE);
+#endif
+                c->mapped += mapped;
+            }
+            return ZX_OK;
+        },
+        &context);
+
+    LTRACEF("mapped %zu pages around va %#" PRIxPTR "\n", context.mapped, va);
+    aspace_->pages_faulted_around_.fetch_add(context.mapped);
+}
+
 // We disable thread safety analysis here because one of the common uses of this
 // function is for splitting one mapping object into several that will be backed
 // by the same VmObject.  In that case, object_->lock() gets aliased across all
@@ -15,6 +15,7 @@
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
 #include <lib/console.h>
+#include <pow2.h>
 #include <safeint/safe_math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -52,8 +53,10 @@ void InitializeVmPage(vm_page_t* p) {
 
 } // namespace
 
-VmObjectPaged::VmObjectPaged(uint32_t pmm_alloc_flags, fbl::RefPtr<VmObject> parent)
-    : VmObject(fbl::move(parent)), pmm_alloc_flags_(pmm_alloc_flags) {
+VmObjectPaged::VmObjectPaged(uint32_t pmm_alloc_flags, fbl::RefPtr<VmObject> parent,
+                             fbl::RefPtr<PageSource> page_source)
+    : VmObject(fbl::move(parent)), pmm_alloc_flags_(pmm_alloc_flags),
+      page_source_(fbl::move(page_source)) {
     LTRACEF("%p\n", this);
 }
 
@@ -73,6 +76,11 @@ VmObjectPaged::~VmObjectPaged() {
 
     // free all of the pages attached to us
     page_list_.FreeAllPages();
+    inherited_pages_.FreeAllPages();
+
+    // nobody is left to fault on the source's pages
+    if (page_source_)
+        page_source_->Close();
 }
 
 zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject>* obj) {
@@ -94,6 +102,30 @@ zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::CreateWithSource(fbl::RefPtr<PageSource> source, uint64_t size,
+                                            fbl::RefPtr<VmObject>* obj) {
+    // there's a max size to keep indexes within range
+    if (size > MAX_SIZE)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    auto vmo = fbl::AdoptRef<VmObjectPaged>(
+        new (&ac) VmObjectPaged(PMM_ALLOC_FLAG_ANY, nullptr, fbl::move(source)));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    {
+        AutoLock a(&vmo->lock_);
+        auto err = vmo->ResizeLocked(size);
+        if (err != ZX_OK)
+            return err;
+    }
+
+    *obj = fbl::move(vmo);
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::CloneCOW(uint64_t offset, uint64_t size, bool copy_name, fbl::RefPtr<VmObject>* clone_vmo) {
     LTRACEF("vmo %p offset %#" PRIx64 " size %#" PRIx64 "\n", this, offset, size);
 
@@ -106,6 +138,10 @@ zx_status_t VmObjectPaged::CloneCOW(uint64_t offset, uint64_t size, bool copy_na
 
     AutoLock a(&lock_);
 
+    // the clone will fault through our ancestors, so drop any that only we
+    // can see first
+    CollapseParentLocked();
+
     // add it as a child to us
     AddChildLocked(vmo.get());
 
@@ -290,6 +326,15 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
     // if we have a parent see if they have a page for us
     if (parent_) {
+        CollapseParentLocked();
+    }
+    zx_status_t status = ZX_ERR_NOT_FOUND;
+    p = inherited_pages_.GetPage(offset);
+    if (p) {
+        // a page from a merged parent stands in for one from parent_
+        pa = vm_page_to_paddr(p);
+        status = ZX_OK;
+    } else if (parent_ && parent_offset_ + offset < parent_limit_) {
         safeint::CheckedNumeric<uint64_t> parent_offset = parent_offset_;
         parent_offset += offset;
         DEBUG_ASSERT(parent_offset.IsValid());
@@ -297,68 +342,84 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         // make sure we don't cause the parent to fault in new pages, just ask for any that already exist
         uint parent_pf_flags = pf_flags & ~(VMM_PF_FLAG_FAULT_MASK);
 
-        zx_status_t status = parent_->GetPageLocked(parent_offset.ValueOrDie(), parent_pf_flags,
-                                                    nullptr, &p, &pa);
-        if (status == ZX_OK) {
-            // we have a page from them. if we're read-only faulting, return that page so they can map
-            // or read from it directly
-            if ((pf_flags & VMM_PF_FLAG_WRITE) == 0) {
-                if (page_out)
-                    *page_out = p;
-                if (pa_out)
-                    *pa_out = pa;
+        status = parent_->GetPageLocked(parent_offset.ValueOrDie(), parent_pf_flags,
+                                        nullptr, &p, &pa);
+
+        // an ancestor with a page source has to be asked for missing pages
+        // rather than have us zero fill them; a read fault of the parent
+        // returns the page once it is there
+        if (status == ZX_ERR_NOT_FOUND && (pf_flags & VMM_PF_FLAG_FAULT_MASK) &&
+            HasPageSourceLocked()) {
+            status = parent_->GetPageLocked(parent_offset.ValueOrDie(), VMM_PF_FLAG_SW_FAULT,
+                                            nullptr, &p, &pa);
+            if (status == ZX_ERR_SHOULD_WAIT)
+                return status;
+        }
+    }
+    if (status == ZX_OK) {
+        // we have a page from them. if we're read-only faulting, return that page so they can map
+        // or read from it directly
+        if ((pf_flags & VMM_PF_FLAG_WRITE) == 0) {
+            if (page_out)
+                *page_out = p;
+            if (pa_out)
+                *pa_out = pa;
 
-                LTRACEF("read only faulting in page %p, pa %#" PRIxPTR " from parent\n", p, pa);
+            LTRACEF("read only faulting in page %p, pa %#" PRIxPTR " from parent\n", p, pa);
 
-                return ZX_OK;
-            }
+            return ZX_OK;
+        }
 
-            // if we're write faulting, we need to clone it and return the new page
-            paddr_t pa_clone;
-            vm_page_t* p_clone = nullptr;
-            if (free_list) {
-                p_clone = list_remove_head_type(free_list, vm_page_t, free.node);
-                if (p_clone) {
-                    pa_clone = vm_page_to_paddr(p_clone);
-                }
-            }
-            if (!p_clone) {
-                p_clone = pmm_alloc_page(pmm_alloc_flags_, &pa_clone);
-            }
-            if (!p_clone) {
-                return ZX_ERR_NO_MEMORY;
+        // if we're write faulting, we need to clone it and return the new page
+        paddr_t pa_clone;
+        vm_page_t* p_clone = nullptr;
+        if (free_list) {
+            p_clone = list_remove_head_type(free_list, vm_page_t, free.node);
+            if (p_clone) {
+                pa_clone = vm_page_to_paddr(p_clone);
             }
+        }
+        if (!p_clone) {
+            p_clone = pmm_alloc_page(pmm_alloc_flags_, &pa_clone);
+        }
+        if (!p_clone) {
+            return ZX_ERR_NO_MEMORY;
+        }
 
-            InitializeVmPage(p_clone);
+        InitializeVmPage(p_clone);
 
-            // do a direct copy of the two pages
-            const void* src = paddr_to_physmap(pa);
-            void* dst = paddr_to_physmap(pa_clone);
+        // do a direct copy of the two pages
+        const void* src = paddr_to_physmap(pa);
+        void* dst = paddr_to_physmap(pa_clone);
 
-            DEBUG_ASSERT(src && dst);
+        DEBUG_ASSERT(src && dst);
 
-            memcpy(dst, src, PAGE_SIZE);
+        memcpy(dst, src, PAGE_SIZE);
 
-            // add the new page and return it
-            status = AddPageLocked(p_clone, offset);
-            DEBUG_ASSERT(status == ZX_OK);
+        // add the new page and return it
+        status = AddPageLocked(p_clone, offset);
+        DEBUG_ASSERT(status == ZX_OK);
 
-            LTRACEF("copy-on-write faulted in page %p, pa %#" PRIxPTR " copied from %p, pa %#" PRIxPTR "\n",
-                    p, pa, p_clone, pa_clone);
+        LTRACEF("copy-on-write faulted in page %p, pa %#" PRIxPTR " copied from %p, pa %#" PRIxPTR "\n",
+                p, pa, p_clone, pa_clone);
 
-            if (page_out)
-                *page_out = p_clone;
-            if (pa_out)
-                *pa_out = pa_clone;
+        if (page_out)
+            *page_out = p_clone;
+        if (pa_out)
+            *pa_out = pa_clone;
 
-            return ZX_OK;
-        }
+        return ZX_OK;
     }
 
     // if we're not being asked to sw or hw fault in the page, return not found
     if ((pf_flags & VMM_PF_FLAG_FAULT_MASK) == 0)
         return ZX_ERR_NOT_FOUND;
 
+    // pages of an externally sourced vmo are never zero filled; ask the source
+    // for it and let the caller wait for it to arrive
+    if (page_source_)
+        return page_source_->GetPage(ROUNDDOWN(offset, PAGE_SIZE));
+
     // if we're read faulting, we don't already have a page, and the parent doesn't have it,
     // return the single global zero page
     if ((pf_flags & VMM_PF_FLAG_WRITE) == 0) {
@@ -389,7 +450,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     // TODO: remove once pmm returns zeroed pages
     ZeroPage(pa);
 
-    zx_status_t status = AddPageLocked(p, offset);
+    status = AddPageLocked(p, offset);
     DEBUG_ASSERT(status == ZX_OK);
 
     // other mappings may have covered this offset into the vmo, so unmap those ranges
@@ -412,6 +473,10 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     if (committed)
         *committed = 0;
 
+    // only the page source can provide our pages
+    if (page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+
     AutoLock a(&lock_);
 
     // trim the size
@@ -499,8 +564,8 @@ zx_status_t VmObjectPaged::CommitRangeContiguous(uint64_t offset, uint64_t len,
 
     AutoLock a(&lock_);
 
-    // This function does not support cloned VMOs.
-    if (unlikely(parent_)) {
+    // This function does not support cloned or externally sourced VMOs.
+    if (unlikely(parent_ || page_source_)) {
         return ZX_ERR_NOT_SUPPORTED;
     }
 
@@ -786,6 +851,10 @@ zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
 }
 
 zx_status_t VmObjectPaged::Resize(uint64_t s) {
+    // the page source defines our contents, and with them our size
+    if (page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+
     AutoLock a(&lock_);
 
     return ResizeLocked(s);
@@ -811,6 +880,98 @@ zx_status_t VmObjectPaged::SetParentOffsetLocked(uint64_t offset) {
     return ZX_OK;
 }
 
+// A clone's parent stays alive as long as the clone does, even once nothing
+// else can reach it, and every miss in the clone walks through it.  Merge
+// such hidden parents into us: take over the pages of theirs we can see,
+// free the rest and move up to their parent.  The root of a clone tree owns
+// the lock the whole tree shares, so it is never merged.
+void VmObjectPaged::CollapseParentLocked() {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    while (parent_) {
+        DEBUG_ASSERT(parent_->is_paged());
+        auto parent = static_cast<VmObjectPaged*>(parent_.get());
+
+        // our reference is the only way to reach the parent when it is the
+        // only one, and we hold the lock needed to copy it, so the count
+        // can't rise under us.  A parent holding pinned pages stays, as
+        // pins refer to it.
+        if (!parent->parent_ || parent->children_list_len_ != 1 ||
+            parent->ref_count_debug() != 1 ||
+            parent->AnyPagesPinnedLocked(0, ROUNDUP_PAGE_SIZE(parent->size_))) {
+            return;
+        }
+
+        safeint::CheckedNumeric<uint64_t> new_offset = parent_offset_;
+        new_offset += parent->parent_offset_;
+        if (!new_offset.IsValid())
+            return;
+
+        LTRACEF("vmo %p merging parent %p\n", this, parent);
+
+        // the part of the parent we can see, in its offsets.  Its pages join
+        // our inherited layer rather than page_list_, so that decommitting
+        // our own copies still reveals them.  Layers nearer to us win.
+        const uint64_t start = parent_offset_;
+        const uint64_t end = ROUNDUP_PAGE_SIZE(fbl::min(fbl::min(parent->size_, parent_limit_),
+                                                        ROUNDUP_PAGE_SIZE(parent_offset_ + size_)));
+        auto inherit = [this, start](vm_page*& p, uint64_t offset) {
+            if (inherited_pages_.GetPage(offset - start))
+                return ZX_ERR_NEXT;
+
+            auto status = inherited_pages_.AddPage(p, offset - start);
+            DEBUG_ASSERT(status == ZX_OK);
+            p = nullptr;
+            return ZX_ERR_NEXT;
+        };
+        if (start < end) {
+            parent->page_list_.ForEveryPageInRange(inherit, start, end);
+            parent->inherited_pages_.ForEveryPageInRange(inherit, start, end);
+        }
+
+        // the parent's own view of its parent bounds ours
+        const uint64_t new_limit = fbl::min(parent->parent_limit_,
+                                            parent->parent_offset_ +
+                                                fbl::min(parent->size_, parent_limit_));
+
+        fbl::RefPtr<VmObject> hidden = fbl::move(parent_);
+        hidden->RemoveChildLocked(this);
+        parent_ = parent->parent_;
+        parent_->AddChildLocked(this);
+        parent_offset_ = new_offset.ValueOrDie();
+        parent_limit_ = new_limit;
+
+        // drop the last reference, freeing the pages we didn't take
+        hidden.reset();
+    }
+}
+
+bool VmObjectPaged::HasPageSourceLocked() const {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    for (auto vmo = this; vmo; vmo = static_cast<const VmObjectPaged*>(vmo->parent_.get())) {
+        DEBUG_ASSERT(vmo->is_paged());
+        if (vmo->page_source_)
+            return true;
+    }
+    return false;
+}
+
+void VmObjectPaged::GetPageRequestLocked(uint64_t offset, PageRequest* request) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // the request was made by the nearest ancestor with a source, at the
+    // offset our page has in it
+    auto vmo = this;
+    while (!vmo->page_source_ && vmo->parent_) {
+        offset += vmo->parent_offset_;
+        vmo = static_cast<VmObjectPaged*>(vmo->parent_.get());
+    }
+    request->source = vmo->page_source_;
+    request->offset = ROUNDDOWN(offset, PAGE_SIZE);
+}
+
 // perform some sort of copy in/out on a range of the object using a passed in lambda
 // for the copy routine
 template <typename T>
@@ -843,6 +1004,18 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, size_t
         auto status = GetPageLocked(src_offset,
                                     VMM_PF_FLAG_SW_FAULT | (write ? VMM_PF_FLAG_WRITE : 0),
                                     nullptr, nullptr, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            // wait for the page source without holding our lock, then retry.
+            // a clone may shrink meanwhile, which the retry reports.
+            PageRequest page_request;
+            GetPageRequestLocked(src_offset, &page_request);
+            lock_.Release();
+            status = page_request.source->WaitForPage(page_request.offset, ZX_TIME_INFINITE);
+            lock_.Acquire();
+            if (status != ZX_OK)
+                return status;
+            continue;
+        }
         if (status < 0)
             return status;
 
@@ -864,6 +1037,139 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, size_t
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::SupplyPages(uint64_t offset, uint64_t len,
+                                       VmObject* src, uint64_t src_offset) {
+    canary_.Assert();
+    LTRACEF("vmo %p offset %#" PRIx64 " len %#" PRIx64 " src %p\n", this, offset, len, src);
+
+    if (!page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len))
+        return ZX_ERR_INVALID_ARGS;
+
+    {
+        AutoLock a(&lock_);
+        uint64_t new_len;
+        if (!TrimRange(offset, len, size_, &new_len) || new_len != len)
+            return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // fill the new pages before taking our lock, since reading |src| may
+    // take its lock and fault in its own pages
+    const size_t count = len / PAGE_SIZE;
+    list_node page_list;
+    list_initialize(&page_list);
+    if (pmm_alloc_pages(count, pmm_alloc_flags_, &page_list) != count) {
+        pmm_free(&page_list);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    vm_page_t* p;
+    uint64_t o = 0;
+    list_for_every_entry (&page_list, p, vm_page_t, free.node) {
+        void* ptr = paddr_to_physmap(vm_page_to_paddr(p));
+        size_t actual;
+        zx_status_t status = src->Read(ptr, src_offset + o, PAGE_SIZE, &actual);
+        if (status == ZX_OK && actual != PAGE_SIZE)
+            status = ZX_ERR_OUT_OF_RANGE;
+        if (status != ZX_OK) {
+            pmm_free(&page_list);
+            return status;
+        }
+        o += PAGE_SIZE;
+    }
+
+    {
+        AutoLock a(&lock_);
+
+        // pages that were supplied by an earlier call keep their contents
+        for (o = 0; o < len; o += PAGE_SIZE) {
+            p = list_remove_head_type(&page_list, vm_page_t, free.node);
+            if (page_list_.GetPage(offset + o)) {
+                pmm_free_page(p);
+                continue;
+            }
+            InitializeVmPage(p);
+            zx_status_t status = AddPageLocked(p, offset + o);
+            if (status != ZX_OK) {
+                pmm_free_page(p);
+                pmm_free(&page_list);
+                return status;
+            }
+        }
+    }
+
+    page_source_->OnPagesSupplied(offset, len);
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::FailPages(uint64_t offset, uint64_t len, zx_status_t error) {
+    canary_.Assert();
+    LTRACEF("vmo %p offset %#" PRIx64 " len %#" PRIx64 " error %d\n", this, offset, len, error);
+
+    if (!page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len))
+        return ZX_ERR_INVALID_ARGS;
+
+    {
+        AutoLock a(&lock_);
+        uint64_t new_len;
+        if (!TrimRange(offset, len, size_, &new_len) || new_len != len)
+            return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    page_source_->OnPagesFailed(offset, len, error);
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::ReplacePages(uint64_t offset, list_node* pages, size_t count) {
+    canary_.Assert();
+    LTRACEF("vmo %p offset %#" PRIx64 " count %zu\n", this, offset, count);
+
+    if (!IS_PAGE_ALIGNED(offset) || count == 0 || count > SIZE_MAX / PAGE_SIZE)
+        return ZX_ERR_INVALID_ARGS;
+    const uint64_t len = count * PAGE_SIZE;
+
+    AutoLock a(&lock_);
+
+    uint64_t new_len;
+    if (!TrimRange(offset, len, size_, &new_len) || new_len != len)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    // Pages owned by a source or allocated under constraints can't be
+    // swapped for arbitrary ones, and pinned pages can't move at all.
+    if (HasPageSourceLocked() || pmm_alloc_flags_ != PMM_ALLOC_FLAG_ANY)
+        return ZX_ERR_NOT_SUPPORTED;
+    if (AnyPagesPinnedLocked(offset, len))
+        return ZX_ERR_BAD_STATE;
+
+    // Only committed pages are replaced, which needs no page list memory and
+    // so can't fail halfway through.
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        if (!page_list_.GetPage(o))
+            return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // unmap the old pages from every mapping, including our children's
+    RangeChangeUpdateLocked(offset, len);
+
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        vm_page_t* p = list_remove_head_type(pages, vm_page_t, free.node);
+        DEBUG_ASSERT(p);
+        InitializeVmPage(p);
+        vm_page_t* old = page_list_.ReplacePage(p, o);
+        DEBUG_ASSERT(old);
+        pmm_free_page(old);
+    }
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::Read(void* _ptr, uint64_t offset, size_t len, size_t* bytes_read) {
     canary_.Assert();
     // test to make sure this is a kernel pointer
@@ -916,6 +1222,36 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
     const uint64_t end_page_offset = ROUNDUP(offset + len, PAGE_SIZE);
 
     uint64_t expected_next_off = start_page_offset;
+    for (;;) {
+        zx_status_t status = LookupFromLocked(&expected_next_off, start_page_offset,
+                                              end_page_offset, pf_flags, lookup_fn, context);
+        if (status != ZX_ERR_SHOULD_WAIT)
+            return status;
+
+        // wait for the page source without holding our lock, then carry on
+        // from the page we waited for. a clone may shrink meanwhile.
+        PageRequest page_request;
+        GetPageRequestLocked(expected_next_off, &page_request);
+        lock_.Release();
+        status = page_request.source->WaitForPage(page_request.offset, ZX_TIME_INFINITE);
+        lock_.Acquire();
+        if (status != ZX_OK)
+            return status;
+        if (unlikely(!InRange(offset, len, size_)))
+            return ZX_ERR_OUT_OF_RANGE;
+    }
+}
+
+// Hands the pages from *|next_off| to |end_page_offset| to |lookup_fn|, advancing
+// *|next_off| past each one.  Returns ZX_ERR_SHOULD_WAIT with *|next_off| at a
+// page that a page source has been asked for.
+zx_status_t VmObjectPaged::LookupFromLocked(uint64_t* next_off, uint64_t start_page_offset,
+                                            uint64_t end_page_offset, uint pf_flags,
+                                            vmo_lookup_fn_t lookup_fn, void* context) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    uint64_t& expected_next_off = *next_off;
     zx_status_t status = page_list_.ForEveryPageInRange(
         [&expected_next_off, this, pf_flags, lookup_fn, context,
          start_page_offset](const auto p, uint64_t off) {
@@ -928,6 +1264,9 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
                 paddr_t pa;
                 zx_status_t status = this->GetPageLocked(missing_off, pf_flags, nullptr,
                                                          nullptr, &pa);
+                if (status == ZX_ERR_SHOULD_WAIT) {
+                    return status;
+                }
                 if (status != ZX_OK) {
                     return ZX_ERR_NO_MEMORY;
                 }
@@ -939,6 +1278,7 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
                     }
                     return status;
                 }
+                expected_next_off = missing_off + PAGE_SIZE;
             }
 
             const size_t index = (off - start_page_offset) / PAGE_SIZE;
@@ -954,20 +1294,23 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
             expected_next_off = off + PAGE_SIZE;
             return ZX_ERR_NEXT;
         },
-        start_page_offset, end_page_offset);
+        expected_next_off, end_page_offset);
     if (status != ZX_OK) {
         return status;
     }
 
     // If expected_next_off isn't at the end, there's a gap to process
-    for (uint64_t off = expected_next_off; off < end_page_offset; off += PAGE_SIZE) {
+    for (; expected_next_off < end_page_offset; expected_next_off += PAGE_SIZE) {
         paddr_t pa;
-        zx_status_t status = GetPageLocked(off, pf_flags, nullptr, nullptr, &pa);
+        zx_status_t status = GetPageLocked(expected_next_off, pf_flags, nullptr, nullptr, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            return status;
+        }
         if (status != ZX_OK) {
             return ZX_ERR_NO_MEMORY;
         }
-        const size_t index = (off - start_page_offset) / PAGE_SIZE;
-        status = lookup_fn(context, off, index, pa);
+        const size_t index = (expected_next_off - start_page_offset) / PAGE_SIZE;
+        status = lookup_fn(context, expected_next_off, index, pa);
         if (status != ZX_OK) {
             return status;
         }
@@ -999,6 +1342,97 @@ zx_status_t VmObjectPaged::WriteUser(user_in_ptr<const void> ptr, uint64_t offse
     return ReadWriteInternal(offset, len, bytes_written, true, write_routine);
 }
 
+zx_status_t VmObjectPaged::LookupResidentLocked(uint64_t offset, uint64_t len,
+                                                vmo_lookup_fn_t lookup_fn, void* context) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(len));
+
+    if (unlikely(!InRange(offset, len, size_)))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    return page_list_.ForEveryPageInRange(
+        [offset, lookup_fn, context](const auto p, uint64_t off) {
+            const size_t index = (off - offset) / PAGE_SIZE;
+            zx_status_t status = lookup_fn(context, off, index, vm_page_to_paddr(p));
+            if (status != ZX_OK) {
+                if (unlikely(status == ZX_ERR_NEXT || status == ZX_ERR_STOP)) {
+                    status = ZX_ERR_INTERNAL;
+                }
+                return status;
+            }
+            return ZX_ERR_NEXT;
+        },
+        offset, offset + len);
+}
+
+zx_status_t VmObjectPaged::GetLargePageLocked(uint64_t offset, size_t size, bool commit,
+                                              paddr_t* pa) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(size >= PAGE_SIZE && (size & (size - 1)) == 0 && IS_ALIGNED(offset, size));
+
+    if (offset >= size_ || size_ - offset < size)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    // look for a contiguous run of pages, aligned in physical memory
+    const size_t count = size / PAGE_SIZE;
+    size_t resident = 0;
+    paddr_t base = 0;
+    page_list_.ForEveryPageInRange(
+        [offset, &resident, &base](const auto p, uint64_t off) {
+            const paddr_t page_pa = vm_page_to_paddr(p);
+            if (resident == 0) {
+                base = page_pa - (off - offset);
+            } else if (page_pa != base + (off - offset)) {
+                return ZX_ERR_STOP;
+            }
+            resident++;
+            return ZX_ERR_NEXT;
+        },
+        offset, offset + size);
+    if (resident == count && IS_ALIGNED(base, size)) {
+        *pa = base;
+        return ZX_OK;
+    }
+
+    // commit one if nothing is here yet.  Cloned and externally sourced vmos
+    // take their pages one at a time from elsewhere.
+    if (!commit || resident != 0 || parent_ || page_source_)
+        return ZX_ERR_NOT_FOUND;
+
+    list_node page_list;
+    list_initialize(&page_list);
+
+    size_t allocated = pmm_alloc_contiguous(count, pmm_alloc_flags_,
+                                            static_cast<uint8_t>(log2_ulong_floor(size)),
+                                            &base, &page_list);
+    if (allocated < count) {
+        LTRACEF("failed to allocate a large page (asked for %zu, got %zu)\n", count, allocated);
+        pmm_free(&page_list);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // unmap the zero page from any mapping of the run
+    RangeChangeUpdateLocked(offset, size);
+
+    for (uint64_t o = offset; o < offset + size; o += PAGE_SIZE) {
+        vm_page_t* p = list_remove_head_type(&page_list, vm_page_t, free.node);
+        ASSERT(p);
+
+        InitializeVmPage(p);
+
+        // TODO: remove once pmm returns zeroed pages
+        ZeroPage(p);
+
+        auto status = page_list_.AddPage(p, o);
+        DEBUG_ASSERT(status == ZX_OK);
+    }
+
+    *pa = base;
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::LookupUser(uint64_t offset, uint64_t len, user_inout_ptr<paddr_t> buffer,
                                       size_t buffer_size) {
     canary_.Assert();
@@ -88,6 +88,22 @@ zx_status_t VmObjectPhysical::GetPageLocked(uint64_t offset, uint pf_flags, list
     return ZX_OK;
 }
 
+zx_status_t VmObjectPhysical::GetLargePageLocked(uint64_t offset, size_t size, bool commit,
+                                                 paddr_t* pa) {
+    canary_.Assert();
+
+    if (offset >= size_ || size_ - offset < size)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    uint64_t large_pa = base_ + offset;
+    if (large_pa > UINTPTR_MAX || !IS_ALIGNED(large_pa, size))
+        return ZX_ERR_NOT_FOUND;
+
+    *pa = (paddr_t)large_pa;
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPhysical::LookupUser(uint64_t offset, uint64_t len, user_inout_ptr<paddr_t> buffer,
                                          size_t buffer_size) {
     canary_.Assert();
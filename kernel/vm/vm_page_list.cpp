@@ -141,6 +141,29 @@ zx_status_t VmPageList::FreePage(uint64_t offset) {
     return ZX_OK;
 }
 
+vm_page* VmPageList::ReplacePage(vm_page* p, uint64_t offset) {
+    uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
+    size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
+
+    LTRACEF_LEVEL(2, "%p page %p, offset %#" PRIx64 " node_offset %#" PRIx64 " index %zu\n", this, p, offset,
+                  node_offset, index);
+
+    // lookup the tree node that holds this page
+    auto pln = list_.find(node_offset);
+    if (!pln.IsValid()) {
+        return nullptr;
+    }
+
+    // swap within the node, so that the node never becomes empty
+    auto old = pln->RemovePage(index);
+    if (old) {
+        __UNUSED auto status = pln->AddPage(p, index);
+        DEBUG_ASSERT(status == ZX_OK);
+    }
+
+    return old;
+}
+
 size_t VmPageList::FreeAllPages() {
     LTRACEF("%p\n", this);
 
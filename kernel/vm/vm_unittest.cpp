@@ -8,6 +8,8 @@
 #include <err.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
+#include <inttypes.h>
+#include <platform.h>
 #include <unittest.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
@@ -72,6 +74,86 @@ static bool pmm_oversized_alloc_test(void* context) {
     END_TEST;
 }
 
+// Frees a single page, which may leave it in a per-cpu page cache, and makes
+// sure it can still be allocated by physical address.
+static bool pmm_cached_page_alloc_range_test(void* context) {
+    BEGIN_TEST;
+    paddr_t pa;
+
+    vm_page_t* page = pmm_alloc_page(0, &pa);
+    REQUIRE_NE(nullptr, page, "pmm_alloc single page");
+
+    auto ret = pmm_free_page(page);
+    EXPECT_EQ(1u, ret, "pmm_free_page on single page");
+
+    list_node list = LIST_INITIAL_VALUE(list);
+    auto count = pmm_alloc_range(pa, 1, &list);
+    EXPECT_EQ(1u, count, "pmm_alloc_range on a freed page");
+    EXPECT_EQ(page, list_peek_head_type(&list, vm_page_t, free.node),
+              "pmm_alloc_range returned the freed page");
+
+    ret = pmm_free(&list);
+    EXPECT_EQ(count, ret, "pmm_free on the reallocated page");
+    END_TEST;
+}
+
+// Translates a bunch of pages to physical addresses and back, and reports how
+// long each translation takes.
+static bool pmm_page_paddr_lookup_test(void* context) {
+    BEGIN_TEST;
+    list_node list = LIST_INITIAL_VALUE(list);
+
+    static const size_t alloc_count = 1024;
+    static const size_t rounds = 64;
+
+    auto count = pmm_alloc_pages(alloc_count, 0, &list);
+    REQUIRE_EQ(alloc_count, count, "pmm_alloc_pages a bunch of pages count");
+
+    fbl::AllocChecker ac;
+    fbl::Array<vm_page_t*> pages(new (&ac) vm_page_t*[alloc_count], alloc_count);
+    REQUIRE_TRUE(ac.check(), "");
+    fbl::Array<paddr_t> addrs(new (&ac) paddr_t[alloc_count], alloc_count);
+    REQUIRE_TRUE(ac.check(), "");
+
+    size_t i = 0;
+    vm_page_t* page;
+    list_for_every_entry (&list, page, vm_page_t, free.node) {
+        pages[i] = page;
+        addrs[i] = vm_page_to_paddr(page);
+        EXPECT_NE(static_cast<paddr_t>(-1), addrs[i], "vm_page_to_paddr on allocated page");
+        EXPECT_EQ(page, paddr_to_vm_page(addrs[i]), "paddr_to_vm_page round trip");
+        EXPECT_EQ(page, paddr_to_vm_page(addrs[i] + PAGE_SIZE - 1),
+                  "paddr_to_vm_page on last byte of page");
+        i++;
+    }
+
+    paddr_t sum = 0;
+    zx_time_t t = current_time();
+    for (size_t r = 0; r < rounds; r++) {
+        for (i = 0; i < alloc_count; i++) {
+            sum += vm_page_to_paddr(pages[i]);
+        }
+    }
+    zx_duration_t to_paddr = current_time() - t;
+
+    t = current_time();
+    for (size_t r = 0; r < rounds; r++) {
+        for (i = 0; i < alloc_count; i++) {
+            sum += reinterpret_cast<uintptr_t>(paddr_to_vm_page(addrs[i]));
+        }
+    }
+    zx_duration_t to_page = current_time() - t;
+    EXPECT_NE(0u, sum, "");
+
+    unittest_printf("vm_page_to_paddr %" PRIu64 " nsecs, paddr_to_vm_page %" PRIu64
+                    " nsecs per lookup\n",
+                    to_paddr / (rounds * alloc_count), to_page / (rounds * alloc_count));
+
+    auto ret = pmm_free(&list);
+    EXPECT_EQ(alloc_count, ret, "pmm_free_page on a list of pages");
+    END_TEST;
+}
+
 static uint32_t test_rand(uint32_t seed) {
     return (seed = seed * 1664525 + 1013904223);
 }
@@ -894,6 +976,8 @@ UNITTEST_START_TESTCASE(vm_tests)
 VM_UNITTEST(pmm_smoke_test)
 VM_UNITTEST(pmm_large_alloc_test)
 VM_UNITTEST(pmm_oversized_alloc_test)
+VM_UNITTEST(pmm_cached_page_alloc_range_test)
+VM_UNITTEST(pmm_page_paddr_lookup_test)
 VM_UNITTEST(vmm_alloc_smoke_test)
 VM_UNITTEST(vmm_alloc_contiguous_smoke_test)
 VM_UNITTEST(multiple_regions_test)
@@ -10,6 +10,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <zircon/misc/fnv1hash.h>
 
 #include "dnode.h"
 #include "memfs-private.h"
@@ -43,6 +44,7 @@ void Dnode::RemoveFromParent() {
 
     // Detach from parent
     if (parent_) {
+        parent_->names_.erase(*this);
         parent_->children_.erase(*this);
         if (IsDirectory()) {
             // '..' no longer references parent.
@@ -85,20 +87,19 @@ void Dnode::AddChild(fbl::RefPtr<Dnode> parent, fbl::RefPtr<Dnode> child) {
     } else {
         child->ordering_token_ = parent->children_.back().ordering_token_ + 1;
     }
-    parent->children_.push_back(fbl::move(child));
+    parent->names_.insert(child.get());
+    parent->children_.insert(fbl::move(child));
     parent->vnode_->UpdateModified();
 }
 
 zx_status_t Dnode::Lookup(fbl::StringPiece name, fbl::RefPtr<Dnode>* out) const {
-    auto dn = children_.find_if([&name](const Dnode& elem) -> bool {
-        return elem.NameMatch(name);
-    });
-    if (dn == children_.end()) {
+    auto dn = names_.find(DnodeNameKey{NameHash(name), name});
+    if (dn == names_.end()) {
         return ZX_ERR_NOT_FOUND;
     }
 
     if (out != nullptr) {
-        *out = dn.CopyPointer();
+        *out = fbl::RefPtr<Dnode>(dn.CopyPointer());
     }
     return ZX_OK;
 }
@@ -150,16 +151,13 @@ void Dnode::Readdir(fs::DirentFiller* df, void* cookie) const {
         }
     }
 
-    for (const auto& dn : children_) {
-        if (dn.ordering_token_ < c->order) {
-            continue;
-        }
-        uint32_t vtype = dn.IsDirectory() ? V_TYPE_DIR : V_TYPE_FILE;
-        if ((r = df->Next(fbl::StringPiece(dn.name_.get(), dn.NameLen()),
+    for (auto dn = children_.lower_bound(c->order); dn != children_.end(); ++dn) {
+        uint32_t vtype = dn->IsDirectory() ? V_TYPE_DIR : V_TYPE_FILE;
+        if ((r = df->Next(fbl::StringPiece(dn->name_.get(), dn->NameLen()),
                           VTYPE_TO_DTYPE(vtype))) != ZX_OK) {
             return;
         }
-        c->order = dn.ordering_token_ + 1;
+        c->order = dn->ordering_token_ + 1;
     }
 }
 
@@ -182,14 +180,18 @@ fbl::unique_ptr<char[]> Dnode::TakeName() {
 }
 
 void Dnode::PutName(fbl::unique_ptr<char[]> name, size_t len) {
+    ZX_DEBUG_ASSERT(parent_ == nullptr);
     flags_ = static_cast<uint32_t>((flags_ & ~kDnodeNameMax) | len);
     name_ = fbl::move(name);
+    name_hash_ = NameHash(fbl::StringPiece(name_.get(), len));
 }
 
 bool Dnode::IsDirectory() const { return vnode_->IsDirectory(); }
 
 Dnode::Dnode(fbl::RefPtr<VnodeMemfs> vn, fbl::unique_ptr<char[]> name, uint32_t flags) :
-    vnode_(fbl::move(vn)), parent_(nullptr), ordering_token_(0), flags_(flags), name_(fbl::move(name)) {
+    vnode_(fbl::move(vn)), parent_(nullptr), ordering_token_(0), flags_(flags),
+    name_hash_(NameHash(fbl::StringPiece(name.get(), flags & kDnodeNameMax))),
+    name_(fbl::move(name)) {
 };
 
 size_t Dnode::NameLen() const {
@@ -200,4 +202,8 @@ bool Dnode::NameMatch(fbl::StringPiece name) const {
     return name == fbl::StringPiece(name_.get(), NameLen());
 }
 
+uint32_t Dnode::NameHash(fbl::StringPiece name) {
+    return fnv1a32(name.data(), name.length());
+}
+
 } // namespace memfs
@@ -11,6 +11,7 @@
 #include <fs/vnode.h>
 #include <fdio/vfs.h>
 #include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_wavl_tree.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
@@ -26,21 +27,59 @@ static_assert(NAME_MAX == 255, "NAME_MAX must be 255");
 static_assert(((kDnodeNameMax + 1) & kDnodeNameMax) == 0,
               "Expected kDnodeNameMax to be one less than a power of two");
 
+// Key of a child within its parent's name index. Children are ordered by the
+// hash of their name first, so that most comparisons during a lookup are a
+// single integer compare rather than a string compare.
+struct DnodeNameKey {
+    uint32_t hash;
+    fbl::StringPiece name;
+};
+
 class Dnode : public fbl::RefCounted<Dnode> {
 public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Dnode);
     using NodeState = fbl::DoublyLinkedListNodeState<fbl::RefPtr<Dnode>>;
+    using TreeNodeState = fbl::WAVLTreeNodeState<fbl::RefPtr<Dnode>>;
+    using NameNodeState = fbl::WAVLTreeNodeState<Dnode*>;
 
     // ChildTraits is the state used for a Dnode to appear as the child
-    // of another dnode.
-    struct TypeChildTraits { static NodeState& node_state(Dnode& dn) { return dn.type_child_state_; }};
+    // of another dnode, in the order the children were added.
+    struct TypeChildTraits {
+        static TreeNodeState& node_state(Dnode& dn) { return dn.type_child_state_; }
+    };
+    struct ChildKeyTraits {
+        static size_t GetKey(const Dnode& dn) { return dn.ordering_token_; }
+        static bool LessThan(size_t a, size_t b) { return a < b; }
+        static bool EqualTo(size_t a, size_t b) { return a == b; }
+    };
+    // NameTraits is the state used for a Dnode to appear in the name index
+    // of its parent.
+    struct TypeNameTraits {
+        static NameNodeState& node_state(Dnode& dn) { return dn.type_name_state_; }
+    };
+    struct NameKeyTraits {
+        static DnodeNameKey GetKey(const Dnode& dn) {
+            return DnodeNameKey{dn.name_hash_, fbl::StringPiece(dn.name_.get(), dn.NameLen())};
+        }
+        static bool LessThan(const DnodeNameKey& a, const DnodeNameKey& b) {
+            if (a.hash != b.hash) {
+                return a.hash < b.hash;
+            }
+            return a.name.compare(b.name) < 0;
+        }
+        static bool EqualTo(const DnodeNameKey& a, const DnodeNameKey& b) {
+            return a.hash == b.hash && a.name == b.name;
+        }
+    };
     // DeviceTraits it the state used by devices to effectively create
     // multiple hard links to a single device vnode. This is used
     // extensively by the device manager to make the "same" device
     // vnode appear in multiple locations within "/dev".
     struct TypeDeviceTraits { static NodeState& node_state(Dnode& dn) { return dn.type_device_state_; }};
 
-    using ChildList = fbl::DoublyLinkedList<fbl::RefPtr<Dnode>, Dnode::TypeChildTraits>;
+    using ChildList = fbl::WAVLTree<size_t, fbl::RefPtr<Dnode>, ChildKeyTraits,
+                                    TypeChildTraits>;
+    using NameIndex = fbl::WAVLTree<DnodeNameKey, Dnode*, NameKeyTraits, TypeNameTraits>;
     using DeviceList = fbl::DoublyLinkedList<fbl::RefPtr<Dnode>, Dnode::TypeDeviceTraits>;
 
     // Allocates a dnode, attached to a vnode
@@ -81,6 +120,8 @@ public:
     // Read dirents (up to len bytes worth) into data.
     // ReaddirStart reads the canned "." and ".." entries that should appear
     // at the beginning of a directory.
+    // The cookie records the ordering token of the next child to read, so a
+    // resumed Readdir seeks straight to it.
     // On success, return the number of bytes read.
     static zx_status_t ReaddirStart(fs::DirentFiller* df, void* cookie);
     void Readdir(fs::DirentFiller* df, void* cookie) const;
@@ -96,6 +137,9 @@ public:
 
 private:
     friend struct TypeChildTraits;
+    friend struct ChildKeyTraits;
+    friend struct TypeNameTraits;
+    friend struct NameKeyTraits;
     friend struct TypeDeviceTraits;
 
     Dnode(fbl::RefPtr<VnodeMemfs> vn, fbl::unique_ptr<char[]> name, uint32_t flags);
@@ -103,14 +147,21 @@ private:
     size_t NameLen() const;
     bool NameMatch(fbl::StringPiece name) const;
 
-    NodeState type_child_state_;
+    static uint32_t NameHash(fbl::StringPiece name);
+
+    TreeNodeState type_child_state_;
+    NameNodeState type_name_state_;
     NodeState type_device_state_;
     fbl::RefPtr<VnodeMemfs> vnode_;
     fbl::RefPtr<Dnode> parent_;
     // Used to impose an absolute order on dnodes within a directory.
     size_t ordering_token_;
+    // Children by ordering token; holds the references to them.
     ChildList children_;
+    // The same children, by name.
+    NameIndex names_;
     uint32_t flags_;
+    uint32_t name_hash_;
     fbl::unique_ptr<char[]> name_;
 };
 
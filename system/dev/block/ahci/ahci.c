@@ -190,6 +190,10 @@ static bool cmd_is_queued(uint8_t cmd) {
     return (cmd == SATA_CMD_READ_FPDMA_QUEUED) || (cmd == SATA_CMD_WRITE_FPDMA_QUEUED);
 }
 
+static bool cmd_is_flush(uint8_t cmd) {
+    return (cmd == SATA_CMD_FLUSH_CACHE) || (cmd == SATA_CMD_FLUSH_CACHE_EXT);
+}
+
 static void ahci_port_complete_txn(ahci_device_t* dev, ahci_port_t* port, zx_status_t status) {
     mtx_lock(&port->lock);
     uint32_t sact = ahci_read(&port->regs->sact);
@@ -208,14 +212,19 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
     assert(!ahci_port_cmd_busy(port, slot));
 
     sata_pdata_t* pdata = sata_iotxn_pdata(txn);
-    zx_status_t status = iotxn_physmap(txn);
-    if (status != ZX_OK) {
-        iotxn_complete(txn, status, 0);
-        completion_signal(&dev->worker_completion);
-        return status;
-    }
+    zx_status_t status;
     iotxn_phys_iter_t iter;
-    iotxn_phys_iter_init(&iter, txn, AHCI_PRD_MAX_SIZE);
+    // Non-data commands (flushes) have nothing to map.
+    bool has_data = !cmd_is_flush(pdata->cmd);
+    if (has_data) {
+        status = iotxn_physmap(txn);
+        if (status != ZX_OK) {
+            iotxn_complete(txn, status, 0);
+            completion_signal(&dev->worker_completion);
+            return status;
+        }
+        iotxn_phys_iter_init(&iter, txn, AHCI_PRD_MAX_SIZE);
+    }
 
     if (dev->cap & AHCI_CAP_NCQ) {
         if (pdata->cmd == SATA_CMD_READ_DMA_EXT) {
@@ -268,7 +277,7 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
     ahci_prd_t* prd = (ahci_prd_t*)((void*)port->ct[slot] + sizeof(ahci_ct_t));
     size_t length;
     zx_paddr_t paddr;
-    for (;;) {
+    while (has_data) {
         length = iotxn_phys_iter_next(&iter, &paddr);
         if (length == 0) {
             break;
@@ -317,7 +326,10 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
 
     // set the watchdog
     // TODO: general timeout mechanism
-    pdata->timeout = zx_time_get(ZX_CLOCK_MONOTONIC) + ZX_SEC(1);
+    // A flush writes back the whole drive cache, which may take far longer
+    // than a single transfer.
+    pdata->timeout = zx_time_get(ZX_CLOCK_MONOTONIC) +
+                     (cmd_is_flush(pdata->cmd) ? ZX_SEC(30) : ZX_SEC(1));
     completion_signal(&dev->watchdog_completion);
     return ZX_OK;
 }
@@ -429,7 +441,7 @@ static void ahci_iotxn_queue(void* ctx, iotxn_t* txn) {
             port->nr, txn, txn->offset, txn->length);
 
     // complete empty txns immediately
-    if (txn->length == 0) {
+    if ((txn->length == 0) && !cmd_is_flush(pdata->cmd)) {
         iotxn_complete(txn, ZX_OK, txn->length);
         return;
     }
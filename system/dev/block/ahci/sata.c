@@ -171,6 +171,23 @@ static zx_protocol_device_t sata_device_proto;
 static void sata_iotxn_queue(void* ctx, iotxn_t* txn) {
     sata_device_t* device = ctx;
 
+    if (txn->opcode == IOTXN_OP_FLUSH) {
+        // The drive flushes the writes it has completed; the queue must be
+        // drained first, and nothing may overtake the flush.
+        sata_pdata_t* pdata = sata_iotxn_pdata(txn);
+        pdata->cmd = (device->flags & SATA_FLAG_LBA48) ? SATA_CMD_FLUSH_CACHE_EXT :
+                                                         SATA_CMD_FLUSH_CACHE;
+        pdata->device = 0x40;
+        pdata->lba = 0;
+        pdata->count = 0;
+        pdata->max_cmd = device->max_cmd;
+        pdata->port = device->port;
+        txn->flags |= IOTXN_SYNC_BEFORE | IOTXN_SYNC_AFTER;
+        txn->length = 0;
+        iotxn_queue(device->parent, txn);
+        return;
+    }
+
     // offset must be aligned to block size
     if (txn->offset % device->sector_sz) {
         iotxn_complete(txn, ZX_ERR_INVALID_ARGS, 0);
@@ -235,7 +252,7 @@ static zx_status_t sata_ioctl(void* ctx, uint32_t op, const void* cmd, size_t cm
             return status;
         }
         completion_t completion = COMPLETION_INIT;
-        txn->opcode = IOTXN_OP_READ;
+        txn->opcode = IOTXN_OP_FLUSH;
         txn->flags = IOTXN_SYNC_BEFORE;
         txn->offset = 0;
         txn->length = 0;
@@ -326,11 +343,30 @@ static void sata_block_write(void* ctx, zx_handle_t vmo, uint64_t length,
     sata_block_txn(ctx, IOTXN_OP_WRITE, vmo, length, vmo_offset, dev_offset, cookie);
 }
 
+static void sata_block_flush(void* ctx, void* cookie) {
+    sata_device_t* dev = ctx;
+    zx_status_t status;
+    iotxn_t* txn;
+    if ((status = iotxn_alloc(&txn, IOTXN_ALLOC_POOL, 0)) != ZX_OK) {
+        dev->callbacks->complete(cookie, status);
+        return;
+    }
+    txn->opcode = IOTXN_OP_FLUSH;
+    txn->offset = 0;
+    txn->length = 0;
+    txn->complete_cb = sata_block_complete;
+    txn->cookie = cookie;
+    memcpy(txn->extra, &dev, sizeof(sata_device_t*));
+
+    iotxn_queue(dev->zxdev, txn);
+}
+
 static block_protocol_ops_t sata_block_ops = {
     .set_callbacks = sata_block_set_callbacks,
     .get_info = sata_block_get_info,
     .read = sata_block_read,
     .write = sata_block_write,
+    .flush = sata_block_flush,
 };
 
 zx_status_t sata_bind(zx_device_t* dev, int port) {
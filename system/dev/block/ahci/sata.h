@@ -13,6 +13,8 @@
 #define SATA_CMD_WRITE_DMA            0xca
 #define SATA_CMD_WRITE_DMA_EXT        0x35
 #define SATA_CMD_WRITE_FPDMA_QUEUED   0x61
+#define SATA_CMD_FLUSH_CACHE          0xe7
+#define SATA_CMD_FLUSH_CACHE_EXT      0xea
 
 #define SATA_DEVINFO_SERIAL              10
 #define SATA_DEVINFO_FW_REV              23
@@ -31,25 +31,35 @@ typedef struct blkdev {
     bool dead; // Release has been called; we should free memory and leave.
 } blkdev_t;
 
-static int blockserver_thread_serve(blkdev_t* bdev) TA_REL(bdev->lock) {
-    BlockServer* bs = bdev->bs;
-    bdev->threadcount++;
-    mtx_unlock(&bdev->lock);
+// Each queue of a blockserver is served by a thread of its own.
+typedef struct blkserver_thread_args {
+    blkdev_t* bdev;
+    BlockServer* bs;
+    uint32_t queue;
+} blkserver_thread_args_t;
+
+static int blockserver_thread(void* arg) {
+    blkserver_thread_args_t* args = arg;
+    blkdev_t* bdev = args->bdev;
+    BlockServer* bs = args->bs;
+    uint32_t queue = args->queue;
+    free(args);
 
-    blockserver_serve(bs);
+    blockserver_serve(bs, queue);
 
     mtx_lock(&bdev->lock);
     if (bdev->bs == bs) {
         // Only nullify 'bs' if no one has replaced it yet. This is the
-        // case when the blockserver shuts itself down because the fifo
-        // has closed.
+        // case when the blockserver shuts itself down because a fifo
+        // has closed; the other queues go down with it.
+        blockserver_shutdown(bs);
         bdev->bs = NULL;
     }
     bdev->threadcount--;
     bool cleanup = bdev->dead & (bdev->threadcount == 0);
     mtx_unlock(&bdev->lock);
 
-    blockserver_free(bs);
+    blockserver_release(bs);
 
     if (cleanup) {
         free(bdev);
@@ -57,15 +67,33 @@ static int blockserver_thread_serve(blkdev_t* bdev) TA_REL(bdev->lock) {
     return 0;
 }
 
-static int blockserver_thread(void* arg) TA_REL(((blkdev_t*)arg)->lock) {
-    return blockserver_thread_serve((blkdev_t*)arg);
+// Starts a thread serving 'queue'. On failure, the reference the thread
+// would have held to the server is dropped.
+static zx_status_t blkdev_start_queue_locked(blkdev_t* bdev, BlockServer* bs, uint32_t queue)
+    TA_REQ(bdev->lock) {
+    blkserver_thread_args_t* args = malloc(sizeof(blkserver_thread_args_t));
+    if (args == NULL) {
+        blockserver_release(bs);
+        return ZX_ERR_NO_MEMORY;
+    }
+    args->bdev = bdev;
+    args->bs = bs;
+    args->queue = queue;
+
+    thrd_t thread;
+    if (thrd_create(&thread, blockserver_thread, args) != thrd_success) {
+        free(args);
+        blockserver_release(bs);
+        return ZX_ERR_NO_MEMORY;
+    }
+    thrd_detach(thread);
+    // Counted before the lock is dropped, so release cannot free 'bdev'
+    // underneath the new thread.
+    bdev->threadcount++;
+    return ZX_OK;
 }
 
-// This function conditionally acquires bdev->lock, and the code
-// responsible for unlocking in the success case is on another
-// thread. The analysis is not up to reasoning about this.
-static zx_status_t blkdev_get_fifos(blkdev_t* bdev, void* out_buf, size_t out_len)
-    TA_NO_THREAD_SAFETY_ANALYSIS {
+static zx_status_t blkdev_get_fifos(blkdev_t* bdev, void* out_buf, size_t out_len) {
     if (out_len < sizeof(zx_handle_t)) {
         return ZX_ERR_INVALID_ARGS;
     }
@@ -77,24 +105,46 @@ static zx_status_t blkdev_get_fifos(blkdev_t* bdev, void* out_buf, size_t out_le
     }
 
     BlockServer* bs;
-    if ((status = blockserver_create(&bdev->proto, out_buf, &bs)) != ZX_OK) {
+    zx_handle_t fifo;
+    if ((status = blockserver_create(&bdev->proto, &fifo, &bs)) != ZX_OK) {
         goto done;
     }
-
-    // As soon as we launch a thread, the background thread is responsible
-    // for the blockserver in the bdev->bs field.
+    if ((status = blkdev_start_queue_locked(bdev, bs, 0)) != ZX_OK) {
+        zx_handle_close(fifo);
+        goto done;
+    }
+    // The background thread is now responsible for the blockserver.
     bdev->bs = bs;
-    thrd_t thread;
-    if (thrd_create(&thread, blockserver_thread, bdev) != thrd_success) {
-        blockserver_free(bs);
-        bdev->bs = NULL;
-        status = ZX_ERR_NO_MEMORY;
+    *(zx_handle_t*)out_buf = fifo;
+    status = sizeof(zx_handle_t);
+done:
+    mtx_unlock(&bdev->lock);
+    return status;
+}
+
+static zx_status_t blkdev_add_fifo(blkdev_t* bdev, void* out_buf, size_t out_len) {
+    if (out_len < sizeof(zx_handle_t)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    zx_status_t status;
+    mtx_lock(&bdev->lock);
+    if (bdev->bs == NULL) {
+        status = ZX_ERR_BAD_STATE;
         goto done;
     }
-    thrd_detach(thread);
 
-    // On success, the blockserver thread holds the lock.
-    return sizeof(zx_handle_t);
+    zx_handle_t fifo;
+    uint32_t queue;
+    if ((status = blockserver_add_queue(bdev->bs, &fifo, &queue)) != ZX_OK) {
+        goto done;
+    }
+    if ((status = blkdev_start_queue_locked(bdev, bdev->bs, queue)) != ZX_OK) {
+        // The queue stays behind, unserved, until the server shuts down.
+        zx_handle_close(fifo);
+        goto done;
+    }
+    *(zx_handle_t*)out_buf = fifo;
+    status = sizeof(zx_handle_t);
 done:
     mtx_unlock(&bdev->lock);
     return status;
@@ -188,6 +238,8 @@ static zx_status_t blkdev_ioctl(void* ctx, uint32_t op, const void* cmd,
     switch (op) {
     case IOCTL_BLOCK_GET_FIFOS:
         return blkdev_get_fifos(blkdev, reply, max);
+    case IOCTL_BLOCK_ADD_FIFO:
+        return blkdev_add_fifo(blkdev, reply, max);
     case IOCTL_BLOCK_ATTACH_VMO:
         return blkdev_attach_vmo(blkdev, cmd, cmdlen, reply, max, out_actual);
     case IOCTL_BLOCK_ALLOC_TXN:
@@ -41,16 +41,15 @@ static void OutOfBandErrorRespond(const zx::fifo& fifo, zx_status_t status, txni
     }
 }
 
-BlockTransaction::BlockTransaction(zx_handle_t fifo, txnid_t txnid, block_protocol_t* proto,
-                                   uint32_t max_xfer) :
-    fifo_(fifo), proto_(proto), max_xfer_(max_xfer), flags_(0), goal_(0) {
+BlockTransaction::BlockTransaction(txnid_t txnid, block_protocol_t* proto, uint32_t max_xfer) :
+    proto_(proto), max_xfer_(max_xfer), fifo_(ZX_HANDLE_INVALID), flags_(0), goal_(0) {
     memset(&response_, 0, sizeof(response_));
     response_.txnid = txnid;
 }
 
 BlockTransaction::~BlockTransaction() {}
 
-zx_status_t BlockTransaction::Enqueue(bool do_respond, block_msg_t** msg_out) {
+zx_status_t BlockTransaction::Enqueue(zx_handle_t fifo, bool do_respond, block_msg_t** msg_out) {
     fbl::AutoLock lock(&lock_);
     if (flags_ & kTxnFlagRespond) {
         // Can't get more than one response for a txn
@@ -62,13 +61,17 @@ zx_status_t BlockTransaction::Enqueue(bool do_respond, block_msg_t** msg_out) {
         // clear the current block transaction.
         do_respond = true;
     }
+    if (goal_ == 0) {
+        // Respond on the queue which started the transaction.
+        fifo_ = fifo;
+    }
     ZX_DEBUG_ASSERT(goal_ < MAX_TXN_MESSAGES); // Avoid overflowing msgs
     *msg_out = &msgs_[goal_++];
     flags_ |= do_respond ? kTxnFlagRespond : 0;
     return ZX_OK;
 fail:
     if (do_respond) {
-        OutOfBandErrorRespond(zx::unowned_fifo::wrap(fifo_), ZX_ERR_IO, response_.txnid);
+        OutOfBandErrorRespond(zx::unowned_fifo::wrap(fifo), ZX_ERR_IO, response_.txnid);
     }
     return ZX_ERR_IO;
 }
@@ -137,15 +140,15 @@ zx_status_t IoBuffer::ValidateVmoHack(uint64_t length, uint64_t vmo_offset) {
     return ZX_OK;
 }
 
-zx_status_t BlockServer::Read(block_fifo_request_t* requests, uint32_t* count) {
+zx_status_t BlockServer::Read(Queue* queue, block_fifo_request_t* requests, uint32_t* count) {
     // Keep trying to read messages from the fifo until we have a reason to
     // terminate
     while (true) {
-        zx_status_t status = fifo_.read(requests, sizeof(block_fifo_request_t), count);
+        zx_status_t status = queue->fifo.read(requests, sizeof(block_fifo_request_t), count);
         if (status == ZX_ERR_SHOULD_WAIT) {
             zx_signals_t waitfor = ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED | kSignalFifoTerminate;
             zx_signals_t observed;
-            if ((status = fifo_.wait_one(waitfor, ZX_TIME_INFINITE, &observed)) != ZX_OK) {
+            if ((status = queue->fifo.wait_one(waitfor, ZX_TIME_INFINITE, &observed)) != ZX_OK) {
                 return status;
             }
             if ((observed & ZX_FIFO_PEER_CLOSED) || (observed & kSignalFifoTerminate)) {
@@ -200,8 +203,7 @@ zx_status_t BlockServer::AllocateTxn(txnid_t* out) {
         if (txns_[i] == nullptr) {
             txnid_t txnid = static_cast<txnid_t>(i);
             fbl::AllocChecker ac;
-            txns_[i] = fbl::AdoptRef(new (&ac) BlockTransaction(fifo_.get(),
-                                                                txnid, proto_,
+            txns_[i] = fbl::AdoptRef(new (&ac) BlockTransaction(txnid, proto_,
                                                                 info_.max_transfer_size));
             if (!ac.check()) {
                 return ZX_ERR_NO_MEMORY;
@@ -222,6 +224,61 @@ void BlockServer::FreeTxn(txnid_t txnid) {
     txns_[txnid] = nullptr;
 }
 
+void blockserver_fifo_complete(void* cookie, zx_status_t status) {
+    block_msg_t* msg = static_cast<block_msg_t*>(cookie);
+    // Since iobuf is a RefPtr, it lives at least as long as the txn,
+    // and is not discarded underneath the block device driver.
+    ZX_DEBUG_ASSERT(msg->iobuf != nullptr || msg->opcode == BLOCKIO_SYNC);
+    ZX_DEBUG_ASSERT(msg->txn != nullptr);
+    // Complete may reissue the remainder of a large message, or recycle 'msg'
+    // entirely; decide whether the operation is finished beforehand.
+    BlockServer* server = msg->server;
+    uint32_t queue = msg->queue;
+    bool finished = (status != ZX_OK) || (msg->len_remaining == 0);
+    // Hold an extra copy of the 'txn' refptr; if we don't, and 'msg->txn' is
+    // the last copy, then when we nullify 'msg->txn' in Complete we end up
+    // trying to unlock a lock in a deleted BlockTxn.
+    auto txn = msg->txn;
+    // Pass msg to complete so 'msg->txn' can be nullified while protected
+    // by the BlockTransaction's lock.
+    txn->Complete(msg, status);
+    if (finished) {
+        server->OperationCompleted(queue);
+    }
+}
+
+static block_callbacks_t cb = {
+    blockserver_fifo_complete,
+};
+
+zx_status_t BlockServer::AddQueueLocked(zx::fifo* fifo_out, uint32_t* queue_out) {
+    if (queue_count_ == MAX_BLOCK_FIFOS) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Queue> queue(new (&ac) Queue());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_status_t status;
+    if ((status = zx::fifo::create(BLOCK_FIFO_MAX_DEPTH, BLOCK_FIFO_ESIZE, 0,
+                                   fifo_out, &queue->fifo)) != ZX_OK) {
+        return status;
+    }
+    queue->in_flight = 0;
+    completion_signal(&queue->idle);
+
+    *queue_out = queue_count_;
+    queues_[queue_count_++] = fbl::move(queue);
+    refs_++;
+    return ZX_OK;
+}
+
+zx_status_t BlockServer::AddQueue(zx::fifo* fifo_out, uint32_t* queue_out) {
+    fbl::AutoLock server_lock(&server_lock_);
+    return AddQueueLocked(fifo_out, queue_out);
+}
+
 zx_status_t BlockServer::Create(block_protocol_t* proto, zx::fifo* fifo_out, BlockServer** out) {
     fbl::AllocChecker ac;
     BlockServer* bs = new (&ac) BlockServer(proto);
@@ -230,88 +287,130 @@ zx_status_t BlockServer::Create(block_protocol_t* proto, zx::fifo* fifo_out, Blo
     }
 
     zx_status_t status;
-    if ((status = zx::fifo::create(BLOCK_FIFO_MAX_DEPTH, BLOCK_FIFO_ESIZE, 0,
-                                   fifo_out, &bs->fifo_)) != ZX_OK) {
+    uint32_t queue;
+    if ((status = bs->AddQueue(fifo_out, &queue)) != ZX_OK) {
         delete bs;
         return status;
     }
 
+    // Every server uses the same callbacks; completions find their way back
+    // through the message.
+    block_set_callbacks(proto, &cb);
     *out = bs;
     return ZX_OK;
 }
 
-void blockserver_fifo_complete(void* cookie, zx_status_t status) {
-    block_msg_t* msg = static_cast<block_msg_t*>(cookie);
-    // Since iobuf is a RefPtr, it lives at least as long as the txn,
-    // and is not discarded underneath the block device driver.
-    ZX_DEBUG_ASSERT(msg->iobuf != nullptr);
-    ZX_DEBUG_ASSERT(msg->txn != nullptr);
-    // Hold an extra copy of the 'txn' refptr; if we don't, and 'msg->txn' is
-    // the last copy, then when we nullify 'msg->txn' in Complete we end up
-    // trying to unlock a lock in a deleted BlockTxn.
-    auto txn = msg->txn;
-    // Pass msg to complete so 'msg->txn' can be nullified while protected
-    // by the BlockTransaction's lock.
-    txn->Complete(msg, status);
+void BlockServer::OperationStarted(Queue* queue) {
+    fbl::AutoLock lock(&queue->idle_lock);
+    if (queue->in_flight++ == 0) {
+        completion_reset(&queue->idle);
+    }
 }
 
-static block_callbacks_t cb = {
-    blockserver_fifo_complete,
-};
+void BlockServer::OperationCompleted(uint32_t queue) {
+    Queue* q = queues_[queue].get();
+    fbl::AutoLock lock(&q->idle_lock);
+    ZX_DEBUG_ASSERT(q->in_flight > 0);
+    if (--q->in_flight == 0) {
+        completion_signal(&q->idle);
+    }
+}
+
+void BlockServer::WaitIdle(Queue* queue) {
+    // Only the thread serving a queue issues operations on it, so once idle,
+    // the queue stays idle until that thread issues another.
+    completion_wait(&queue->idle, ZX_TIME_INFINITE);
+}
+
+void BlockServer::Barrier(Queue* queue, block_msg_t* msg) {
+    // Everything read from the fifo before the barrier must complete before
+    // the device is asked to make it durable. Other queues are not ordered
+    // against this one; a flush only covers what they have completed.
+    WaitIdle(queue);
+    OperationStarted(queue);
+    if (proto_->ops->flush == nullptr) {
+        // The device has no volatile write cache; completed writes are
+        // already durable.
+        cb.complete(msg, ZX_OK);
+    } else {
+        block_flush(proto_, msg);
+    }
+    // Nothing read after the barrier may start before the flush completes.
+    WaitIdle(queue);
+}
 
-zx_status_t BlockServer::Serve() {
-    block_set_callbacks(proto_, &cb);
+zx_status_t BlockServer::Serve(uint32_t queue) {
+    Queue* q = queues_[queue].get();
+    zx_handle_t fifo = q->fifo.get();
 
     zx_status_t status;
     block_fifo_request_t requests[BLOCK_FIFO_MAX_DEPTH];
     uint32_t count;
     while (true) {
-        if ((status = Read(requests, &count) != ZX_OK)) {
+        if ((status = Read(q, requests, &count) != ZX_OK)) {
             return status;
         }
 
         for (size_t i = 0; i < count; i++) {
             bool wants_reply = requests[i].opcode & BLOCKIO_TXN_END;
+            uint32_t opcode = requests[i].opcode & BLOCKIO_OP_MASK;
             txnid_t txnid = requests[i].txnid;
             vmoid_t vmoid = requests[i].vmoid;
 
-            fbl::AutoLock server_lock(&server_lock_);
-            auto iobuf = tree_.find(vmoid);
-            if (!iobuf.IsValid()) {
+            // Other queues share the VMO and txn tables; only hold the lock
+            // while looking them up.
+            fbl::RefPtr<IoBuffer> iobuf;
+            fbl::RefPtr<BlockTransaction> txn;
+            {
+                fbl::AutoLock server_lock(&server_lock_);
+                auto iter = tree_.find(vmoid);
+                if (iter.IsValid()) {
+                    iobuf = iter.CopyPointer();
+                }
+                if (txnid < MAX_TXN_COUNT) {
+                    txn = txns_[txnid];
+                }
+            }
+            if ((iobuf == nullptr) && (opcode != BLOCKIO_SYNC)) {
                 // Operation which is not accessing a valid vmo
                 if (wants_reply) {
-                    OutOfBandErrorRespond(fifo_, ZX_ERR_IO, txnid);
+                    OutOfBandErrorRespond(q->fifo, ZX_ERR_IO, txnid);
                 }
                 continue;
             }
-            if (txnid >= MAX_TXN_COUNT || txns_[txnid] == nullptr) {
+            if (txn == nullptr) {
                 // Operation which is not accessing a valid txn
                 if (wants_reply) {
-                    OutOfBandErrorRespond(fifo_, ZX_ERR_IO, txnid);
+                    OutOfBandErrorRespond(q->fifo, ZX_ERR_IO, txnid);
                 }
                 continue;
             }
 
-            switch (requests[i].opcode & BLOCKIO_OP_MASK) {
+            switch (opcode) {
             case BLOCKIO_READ:
             case BLOCKIO_WRITE: {
                 if (requests[i].length > fbl::numeric_limits<uint32_t>::max()) {
                     // Operation which is too large
                     if (wants_reply) {
-                        OutOfBandErrorRespond(fifo_, ZX_ERR_INVALID_ARGS, txnid);
+                        OutOfBandErrorRespond(q->fifo, ZX_ERR_INVALID_ARGS, txnid);
                     }
                     continue;
                 }
 
                 block_msg_t* msg;
-                status = txns_[txnid]->Enqueue(wants_reply, &msg);
+                status = txn->Enqueue(fifo, wants_reply, &msg);
                 if (status != ZX_OK) {
                     break;
                 }
                 ZX_DEBUG_ASSERT(msg->txn == nullptr);
-                msg->txn = txns_[txnid];
+                msg->txn = fbl::move(txn);
                 ZX_DEBUG_ASSERT(msg->iobuf == nullptr);
-                msg->iobuf = iobuf.CopyPointer();
+                msg->iobuf = iobuf;
+                msg->server = this;
+                msg->queue = queue;
+                msg->len_remaining = 0;
+                msg->opcode = opcode;
+                OperationStarted(q);
 
                 // Hack to ensure that the vmo is valid.
                 // In the future, this code will be responsible for pinning VMO pages,
@@ -329,10 +428,7 @@ zx_status_t BlockServer::Serve() {
                     msg->vmo_offset = requests[i].vmo_offset + max_xfer;
                     msg->dev_offset = requests[i].dev_offset + max_xfer;
                     length = max_xfer;
-                } else {
-                    msg->len_remaining = 0;
                 }
-                msg->opcode = requests[i].opcode & BLOCKIO_OP_MASK;
 
                 if (msg->opcode == BLOCKIO_READ) {
                     block_read(proto_, iobuf->vmo(), length,
@@ -344,14 +440,28 @@ zx_status_t BlockServer::Serve() {
                 break;
             }
             case BLOCKIO_SYNC: {
-                // TODO(smklein): It might be more useful to have this on a per-vmo basis
-                fprintf(stderr, "Warning: BLOCKIO_SYNC is currently unimplemented\n");
+                block_msg_t* msg;
+                status = txn->Enqueue(fifo, wants_reply, &msg);
+                if (status != ZX_OK) {
+                    break;
+                }
+                ZX_DEBUG_ASSERT(msg->txn == nullptr);
+                msg->txn = fbl::move(txn);
+                ZX_DEBUG_ASSERT(msg->iobuf == nullptr);
+                msg->server = this;
+                msg->queue = queue;
+                msg->len_remaining = 0;
+                msg->opcode = BLOCKIO_SYNC;
+                Barrier(q, msg);
                 break;
             }
             case BLOCKIO_CLOSE_VMO: {
-                tree_.erase(*iobuf);
+                {
+                    fbl::AutoLock server_lock(&server_lock_);
+                    tree_.erase(vmoid);
+                }
                 if (wants_reply) {
-                    OutOfBandErrorRespond(fifo_, ZX_OK, txnid);
+                    OutOfBandErrorRespond(q->fifo, ZX_OK, txnid);
                 }
                 break;
             }
@@ -364,18 +474,40 @@ zx_status_t BlockServer::Serve() {
     }
 }
 
-BlockServer::BlockServer(block_protocol_t* proto) : proto_(proto), last_id_(VMOID_INVALID + 1) {
+BlockServer::BlockServer(block_protocol_t* proto)
+    : proto_(proto), last_id_(VMOID_INVALID + 1), queue_count_(0), refs_(0) {
     block_get_info(proto_, &info_);
 }
 
 BlockServer::~BlockServer() {
     ShutDown();
+    // Operations still in flight refer back to the server when they complete.
+    for (uint32_t i = 0; i < fbl::count_of(queues_); i++) {
+        if (queues_[i] != nullptr) {
+            WaitIdle(queues_[i].get());
+        }
+    }
 }
 
 void BlockServer::ShutDown() {
     // Identify that the server should stop reading and return,
-    // implicitly closing the fifo.
-    fifo_.signal(0, kSignalFifoTerminate);
+    // implicitly closing the fifos.
+    fbl::AutoLock server_lock(&server_lock_);
+    for (uint32_t i = 0; i < queue_count_; i++) {
+        queues_[i]->fifo.signal(0, kSignalFifoTerminate);
+    }
+}
+
+void BlockServer::Release() {
+    bool last;
+    {
+        fbl::AutoLock server_lock(&server_lock_);
+        ZX_DEBUG_ASSERT(refs_ > 0);
+        last = (--refs_ == 0);
+    }
+    if (last) {
+        delete this;
+    }
 }
 
 // C declarations
@@ -385,14 +517,20 @@ zx_status_t blockserver_create(block_protocol_t* proto, zx_handle_t* fifo_out, B
     *fifo_out = fifo.release();
     return status;
 }
+zx_status_t blockserver_add_queue(BlockServer* bs, zx_handle_t* fifo_out, uint32_t* queue_out) {
+    zx::fifo fifo;
+    zx_status_t status = bs->AddQueue(&fifo, queue_out);
+    *fifo_out = fifo.release();
+    return status;
+}
 void blockserver_shutdown(BlockServer* bs) {
     bs->ShutDown();
 }
-void blockserver_free(BlockServer* bs) {
-    delete bs;
+void blockserver_release(BlockServer* bs) {
+    bs->Release();
 }
-zx_status_t blockserver_serve(BlockServer* bs) {
-    return bs->Serve();
+zx_status_t blockserver_serve(BlockServer* bs, uint32_t queue) {
+    return bs->Serve(queue);
 }
 zx_status_t blockserver_attach_vmo(BlockServer* bs, zx_handle_t raw_vmo, vmoid_t* out) {
     zx::vmo vmo(raw_vmo);
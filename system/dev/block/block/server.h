@@ -9,6 +9,7 @@
 #include <stdlib.h>
 
 #include <ddk/protocol/block.h>
+#include <sync/completion.h>
 #include <zircon/device/block.h>
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
@@ -51,10 +52,13 @@ private:
 constexpr uint32_t kTxnFlagRespond = 0x00000001; // Should a reponse be sent when we hit goal?
 
 class BlockTransaction;
+class BlockServer;
 
 typedef struct {
     fbl::RefPtr<BlockTransaction> txn;
-    fbl::RefPtr<IoBuffer> iobuf;
+    fbl::RefPtr<IoBuffer> iobuf; // Null for BLOCKIO_SYNC
+    BlockServer* server;
+    uint32_t queue; // The queue whose fifo the message arrived on
     uint32_t opcode;
     uint32_t len_remaining;
     uint64_t vmo_offset;
@@ -63,54 +67,88 @@ typedef struct {
 
 class BlockTransaction : public fbl::RefCounted<BlockTransaction> {
 public:
-    BlockTransaction(zx_handle_t fifo, txnid_t txnid, block_protocol_t* proto,
-                     uint32_t max_xfer);
+    BlockTransaction(txnid_t txnid, block_protocol_t* proto, uint32_t max_xfer);
     ~BlockTransaction();
 
     // Verifies that the incoming txn does not break the Block IO fifo protocol.
     // If it is successful, sets up the response_ with the registered cookie,
     // and adds to the "goal_" counter of number of Completions that must be
     // received before the transaction is identified as successful.
-    zx_status_t Enqueue(bool do_respond, block_msg_t** msg_out);
+    //
+    // The response is sent on 'fifo', the fifo the first message of the
+    // transaction arrived on.
+    zx_status_t Enqueue(zx_handle_t fifo, bool do_respond, block_msg_t** msg_out);
 
     // Called once the transaction has completed successfully.
     void Complete(block_msg_t* msg, zx_status_t status);
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(BlockTransaction);
 
-    const zx_handle_t fifo_;
     block_protocol_t* proto_;
     const uint32_t max_xfer_;
 
     fbl::Mutex lock_;
+    zx_handle_t fifo_ TA_GUARDED(lock_);
     block_msg_t msgs_[MAX_TXN_MESSAGES] TA_GUARDED(lock_);
     block_fifo_response_t response_ TA_GUARDED(lock_); // The response to be sent back to the client
     uint32_t flags_ TA_GUARDED(lock_);
     uint32_t goal_ TA_GUARDED(lock_); // How many ops does the block device need to complete?
 };
 
+// Serves one or more fifos ("queues") to the same block device. Each queue
+// is served by a thread of its own, and responds on its own fifo; VMOs and
+// txns are shared by all of them.
 class BlockServer {
 public:
-    // Creates a new BlockServer
+    // Creates a new BlockServer with a single queue
     static zx_status_t Create(block_protocol_t* proto, zx::fifo* fifo_out, BlockServer** out);
 
-    // Starts the BlockServer using the current thread
-    zx_status_t Serve();
+    // Adds another queue. Like the first, it must be served by a thread
+    // which holds a reference to the server until it stops serving.
+    zx_status_t AddQueue(zx::fifo* fifo_out, uint32_t* queue_out);
+
+    // Starts serving 'queue' using the current thread
+    zx_status_t Serve(uint32_t queue);
     zx_status_t AttachVmo(zx::vmo vmo, vmoid_t* out);
     zx_status_t AllocateTxn(txnid_t* out);
     void FreeTxn(txnid_t txnid);
 
     void ShutDown();
 
-    ~BlockServer();
+    // Drops the reference held by the thread of one queue. Deletes the
+    // server once every thread has dropped its reference.
+    void Release();
+
+    // Called by the device (through the completion callback) once it has
+    // finished with an operation issued by the server on 'queue'.
+    void OperationCompleted(uint32_t queue);
+
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(BlockServer);
     BlockServer(block_protocol_t* proto);
+    ~BlockServer();
 
-    zx_status_t Read(block_fifo_request_t* requests, uint32_t* count);
+    struct Queue {
+        zx::fifo fifo;
+
+        fbl::Mutex idle_lock;
+        uint32_t in_flight TA_GUARDED(idle_lock); // Operations issued but not completed
+        completion_t idle; // Signalled while 'in_flight' is zero
+    };
+
+    zx_status_t Read(Queue* queue, block_fifo_request_t* requests, uint32_t* count);
     zx_status_t FindVmoIDLocked(vmoid_t* out) TA_REQ(server_lock_);
+    zx_status_t AddQueueLocked(zx::fifo* fifo_out, uint32_t* queue_out) TA_REQ(server_lock_);
+
+    // Accounts for an operation about to be issued to the device.
+    static void OperationStarted(Queue* queue);
+    // Blocks until every operation issued to the device from 'queue' has
+    // completed.
+    static void WaitIdle(Queue* queue);
+    // Implements BLOCKIO_SYNC: drains the queue, flushes the device, and
+    // waits for the flush to complete.
+    void Barrier(Queue* queue, block_msg_t* msg);
 
-    zx::fifo fifo_;
     block_protocol_t* proto_;
     block_info_t info_;
 
@@ -118,6 +156,12 @@ private:
     fbl::WAVLTree<vmoid_t, fbl::RefPtr<IoBuffer>> tree_ TA_GUARDED(server_lock_);
     fbl::RefPtr<BlockTransaction> txns_[MAX_TXN_COUNT] TA_GUARDED(server_lock_);
     vmoid_t last_id_ TA_GUARDED(server_lock_);
+
+    // Queues are only ever added; an entry is set before the thread serving
+    // it starts, and lives as long as the server.
+    fbl::unique_ptr<Queue> queues_[MAX_BLOCK_FIFOS];
+    uint32_t queue_count_ TA_GUARDED(server_lock_);
+    uint32_t refs_ TA_GUARDED(server_lock_); // Threads which may still serve a queue
 };
 
 #else
@@ -129,17 +173,21 @@ typedef struct BlockServer BlockServer;
 
 __BEGIN_CDECLS
 
-// Allocate a new blockserver + FIFO combo
+// Allocate a new blockserver + FIFO combo. The FIFO is queue zero.
 zx_status_t blockserver_create(block_protocol_t* proto, zx_handle_t* fifo_out, BlockServer** out);
 
+// Add another FIFO to the blockserver, identified by 'queue_out'.
+zx_status_t blockserver_add_queue(BlockServer* bs, zx_handle_t* fifo_out, uint32_t* queue_out);
+
 // Shut down the blockserver. It will stop serving requests.
 void blockserver_shutdown(BlockServer* bs);
 
-// Free the memory allocated to the blockserver.
-void blockserver_free(BlockServer* bs);
+// Drop the reference held by the thread serving one queue. The memory
+// allocated to the blockserver is freed along with the last reference.
+void blockserver_release(BlockServer* bs);
 
-// Use the current thread to block on incoming FIFO requests.
-zx_status_t blockserver_serve(BlockServer* bs);
+// Use the current thread to block on incoming requests on one FIFO.
+zx_status_t blockserver_serve(BlockServer* bs, uint32_t queue);
 
 // Attach an IO buffer to the Block Server
 zx_status_t blockserver_attach_vmo(BlockServer* bs, zx_handle_t vmo, vmoid_t* out);
@@ -21,6 +21,7 @@
 #include <ddktl/protocol/block.h>
 #include <fs/mapped-vmo.h>
 #include <fbl/algorithm.h>
+#include <fbl/array.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/mutex.h>
 #include <fbl/unique_ptr.h>
@@ -96,24 +97,29 @@ public:
 
     // Update, hash, and write back the current copy of the FVM metadata.
     // Automatically handles alternating writes to primary / backup copy of FVM.
+    // Only the superblock and the blocks modified since the backup copy was
+    // last written are rehashed and written.
     zx_status_t WriteFvmLocked() TA_REQ(lock_);
 
     // Acquire access to a VPart Entry which has already been modified (and
     // will, as a consequence, not be de-allocated underneath us).
-    vpart_entry_t* GetAllocatedVPartEntry(size_t index) const TA_NO_THREAD_SAFETY_ANALYSIS {
+    const vpart_entry_t* GetAllocatedVPartEntry(size_t index) const
+        TA_NO_THREAD_SAFETY_ANALYSIS {
         auto entry = GetVPartEntryLocked(index);
         ZX_DEBUG_ASSERT(entry->slices > 0);
         return entry;
     }
 
-    slice_entry_t* GetSliceEntryLocked(size_t index) const TA_REQ(lock_) {
-        ZX_DEBUG_ASSERT(index >= 1);
-        uintptr_t metadata_start = reinterpret_cast<uintptr_t>(GetFvmLocked());
-        uintptr_t offset = static_cast<uintptr_t>(kAllocTableOffset +
-                                                  index * sizeof(slice_entry_t));
-        ZX_DEBUG_ASSERT(kAllocTableOffset <= offset);
-        ZX_DEBUG_ASSERT(offset < kAllocTableOffset + AllocTableLength(DiskSize(), SliceSize()));
-        return reinterpret_cast<slice_entry_t*>(metadata_start + offset);
+    const slice_entry_t* GetSliceEntryLocked(size_t index) const TA_REQ(lock_) {
+        return reinterpret_cast<const slice_entry_t*>(GetMetadataLocked() +
+                                                      SliceEntryOffset(index));
+    }
+
+    // Like GetSliceEntryLocked, but for modification; marks the entry dirty.
+    slice_entry_t* MutableSliceEntryLocked(size_t index) TA_REQ(lock_) {
+        size_t offset = SliceEntryOffset(index);
+        MarkDirtyLocked(offset, sizeof(slice_entry_t));
+        return reinterpret_cast<slice_entry_t*>(GetMetadataLocked() + offset);
     }
 
     // Allocate 'count' slices, write back the FVM.
@@ -159,20 +165,53 @@ private:
     zx_status_t FindFreeVPartEntryLocked(size_t* out) const TA_REQ(lock_);
     zx_status_t FindFreeSliceLocked(size_t* out, size_t hint) const TA_REQ(lock_);
 
+    // The superblock is rewritten on every update, so it is never tracked
+    // as dirty.
     fvm_t* GetFvmLocked() const TA_REQ(lock_) {
         return reinterpret_cast<fvm_t*>(metadata_->GetData());
     }
 
-    vpart_entry_t* GetVPartEntryLocked(size_t index) const TA_REQ(lock_) {
+    uint8_t* GetMetadataLocked() const TA_REQ(lock_) {
+        return static_cast<uint8_t*>(metadata_->GetData());
+    }
+
+    size_t SliceEntryOffset(size_t index) const {
+        ZX_DEBUG_ASSERT(index >= 1);
+        size_t offset = kAllocTableOffset + index * sizeof(slice_entry_t);
+        ZX_DEBUG_ASSERT(offset < kAllocTableOffset + AllocTableLength(DiskSize(), SliceSize()));
+        return offset;
+    }
+
+    size_t VPartEntryOffset(size_t index) const {
         ZX_DEBUG_ASSERT(index >= 1);
-        uintptr_t metadata_start = reinterpret_cast<uintptr_t>(GetFvmLocked());
-        uintptr_t offset = static_cast<uintptr_t>(kVPartTableOffset +
-                                                  index * sizeof(vpart_entry_t));
-        ZX_DEBUG_ASSERT(kVPartTableOffset <= offset);
+        size_t offset = kVPartTableOffset + index * sizeof(vpart_entry_t);
         ZX_DEBUG_ASSERT(offset < kVPartTableOffset + kVPartTableLength);
-        return reinterpret_cast<vpart_entry_t*>(metadata_start + offset);
+        return offset;
+    }
+
+    const vpart_entry_t* GetVPartEntryLocked(size_t index) const TA_REQ(lock_) {
+        return reinterpret_cast<const vpart_entry_t*>(GetMetadataLocked() +
+                                                      VPartEntryOffset(index));
+    }
+
+    // Like GetVPartEntryLocked, but for modification; marks the entry dirty.
+    vpart_entry_t* MutableVPartEntryLocked(size_t index) TA_REQ(lock_) {
+        size_t offset = VPartEntryOffset(index);
+        MarkDirtyLocked(offset, sizeof(vpart_entry_t));
+        return reinterpret_cast<vpart_entry_t*>(GetMetadataLocked() + offset);
     }
 
+    // Records that the metadata in [offset, offset + length) is about to
+    // change: neither on-disk copy holds it, and its block digest is stale.
+    void MarkDirtyLocked(size_t offset, size_t length) TA_REQ(lock_);
+
+    // Prepares the dirty-block state of freshly loaded metadata, given the
+    // on-disk contents of both copies.
+    zx_status_t InitDirtyStateLocked(const void* first, const void* second) TA_REQ(lock_);
+
+    // Writes metadata blocks [start, end) to the copy at 'copy_offset'.
+    zx_status_t WriteBlocksLocked(size_t copy_offset, size_t start, size_t end) TA_REQ(lock_);
+
     size_t PrimaryOffsetLocked() const TA_REQ(lock_) {
         return first_metadata_is_primary_ ? 0 : MetadataSize();
     }
@@ -185,9 +224,17 @@ private:
         return metadata_size_;
     }
 
+    // Per metadata block flags.
+    static constexpr uint8_t kBlockStaleFirst = 1 << 0;  // The copy at offset 0 differs
+    static constexpr uint8_t kBlockStaleSecond = 1 << 1; // The copy after it differs
+    static constexpr uint8_t kBlockStaleDigest = 1 << 2; // 'block_digests_' entry is stale
+
     fbl::Mutex lock_;
     fbl::unique_ptr<MappedVmo> metadata_ TA_GUARDED(lock_);
     bool first_metadata_is_primary_ TA_GUARDED(lock_);
+    fbl::Array<uint8_t> block_flags_ TA_GUARDED(lock_);
+    // Digests of metadata blocks 1 and up, as hashed into the superblock.
+    fbl::Array<uint8_t> block_digests_ TA_GUARDED(lock_);
     size_t metadata_size_;
     size_t slice_size_;
 };
@@ -213,6 +260,7 @@ public:
                    uint64_t dev_offset, void* cookie);
     void BlockWrite(zx_handle_t vmo, uint64_t length, uint64_t vmo_offset,
                     uint64_t dev_offset, void* cookie);
+    void BlockFlush(void* cookie);
 
     auto ExtentBegin() TA_REQ(lock_) {
         return slice_map_.begin();
@@ -189,13 +189,19 @@ zx_status_t VPartitionManager::Load() {
         return status;
     }
 
-    if (metadata == mvmo->GetData()) {
-        first_metadata_is_primary_ = true;
+    // Both mappings outlive the dirty state initialization: one is kept as
+    // 'metadata_', the other until the end of Load.
+    const void* first = mvmo->GetData();
+    const void* second = mvmo_backup->GetData();
+    first_metadata_is_primary_ = (metadata == first);
+    if (first_metadata_is_primary_) {
         metadata_ = fbl::move(mvmo);
     } else {
-        first_metadata_is_primary_ = false;
         metadata_ = fbl::move(mvmo_backup);
     }
+    if ((status = InitDirtyStateLocked(first, second)) != ZX_OK) {
+        return status;
+    }
 
     // Begin initializing the underlying partitions
     DdkMakeVisible();
@@ -251,29 +257,98 @@ zx_status_t VPartitionManager::Load() {
     return ZX_OK;
 }
 
-zx_status_t VPartitionManager::WriteFvmLocked() {
-    iotxn_t* txn = nullptr;
+void VPartitionManager::MarkDirtyLocked(size_t offset, size_t length) {
+    ZX_DEBUG_ASSERT(offset >= FVM_BLOCK_SIZE);
+    for (size_t b = offset / FVM_BLOCK_SIZE; b <= (offset + length - 1) / FVM_BLOCK_SIZE; b++) {
+        block_flags_[b] = kBlockStaleFirst | kBlockStaleSecond | kBlockStaleDigest;
+    }
+}
 
-    zx_status_t status = iotxn_alloc_vmo(&txn, IOTXN_ALLOC_POOL,
-                                         metadata_->GetVmo(), 0,
-                                         MetadataSize());
+zx_status_t VPartitionManager::InitDirtyStateLocked(const void* first, const void* second) {
+    const size_t blocks = MetadataSize() / FVM_BLOCK_SIZE;
+    fbl::AllocChecker ac;
+    block_flags_.reset(new (&ac) uint8_t[blocks](), blocks);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    const size_t digests_size = (blocks - 1) * digest::Digest::kLength;
+    block_digests_.reset(new (&ac) uint8_t[digests_size], digests_size);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Either copy may be older than the metadata in use, or torn; only the
+    // blocks which differ need to be written to bring it up to date.
+    const uint8_t* metadata = GetMetadataLocked();
+    for (size_t b = 1; b < blocks; b++) {
+        const size_t offset = b * FVM_BLOCK_SIZE;
+        if (memcmp(metadata + offset, static_cast<const uint8_t*>(first) + offset,
+                   FVM_BLOCK_SIZE)) {
+            block_flags_[b] |= kBlockStaleFirst;
+        }
+        if (memcmp(metadata + offset, static_cast<const uint8_t*>(second) + offset,
+                   FVM_BLOCK_SIZE)) {
+            block_flags_[b] |= kBlockStaleSecond;
+        }
+        fvm_block_digest(metadata, b, &block_digests_[(b - 1) * digest::Digest::kLength]);
+    }
+    return ZX_OK;
+}
+
+zx_status_t VPartitionManager::WriteBlocksLocked(size_t copy_offset, size_t start, size_t end) {
+    iotxn_t* txn = nullptr;
+    const size_t length = (end - start) * FVM_BLOCK_SIZE;
+    zx_status_t status = iotxn_alloc_vmo(&txn, IOTXN_ALLOC_POOL, metadata_->GetVmo(),
+                                         start * FVM_BLOCK_SIZE, length);
     if (status != ZX_OK) {
         return status;
     }
     txn->opcode = IOTXN_OP_WRITE;
-    // If we were reading from the primary, write to the backup.
-    txn->offset = BackupOffsetLocked();
-    txn->length = MetadataSize();
-
-    GetFvmLocked()->generation++;
-    fvm_update_hash(GetFvmLocked(), MetadataSize());
-
+    txn->offset = copy_offset + start * FVM_BLOCK_SIZE;
+    txn->length = length;
     iotxn_synchronous_op(parent_, txn);
     status = txn->status;
     iotxn_release(txn);
+    return status;
+}
+
+zx_status_t VPartitionManager::WriteFvmLocked() {
+    const size_t blocks = MetadataSize() / FVM_BLOCK_SIZE;
+    fvm_t* fvm = GetFvmLocked();
+    fvm->generation++;
+    // Older metadata is upgraded to block digests on its first update.
+    fvm->version = FVM_VERSION;
+    for (size_t b = 1; b < blocks; b++) {
+        if (block_flags_[b] & kBlockStaleDigest) {
+            fvm_block_digest(fvm, b, &block_digests_[(b - 1) * digest::Digest::kLength]);
+            block_flags_[b] &= static_cast<uint8_t>(~kBlockStaleDigest);
+        }
+    }
+    fvm_update_hash_with_digests(fvm, block_digests_.get(), blocks);
+
+    // If we were reading from the primary, write to the backup. The backup
+    // copy is invalid until every stale block has been written, so a torn
+    // update still leaves the primary to fall back on.
+    const uint8_t stale = first_metadata_is_primary_ ? kBlockStaleSecond : kBlockStaleFirst;
+    zx_status_t status = WriteBlocksLocked(BackupOffsetLocked(), 0, 1);
+    for (size_t b = 1; (status == ZX_OK) && (b < blocks);) {
+        if (!(block_flags_[b] & stale)) {
+            b++;
+            continue;
+        }
+        size_t start = b;
+        while ((b < blocks) && (block_flags_[b] & stale)) {
+            b++;
+        }
+        status = WriteBlocksLocked(BackupOffsetLocked(), start, b);
+    }
     if (status != ZX_OK) {
+        // Blocks which were written stay marked; they are rewritten next time.
         return status;
     }
+    for (size_t b = 1; b < blocks; b++) {
+        block_flags_[b] &= static_cast<uint8_t>(~stale);
+    }
 
     // We only allow the switch of "write to the other copy of metadata"
     // once a valid version has been written entirely.
@@ -341,13 +416,13 @@ zx_status_t VPartitionManager::AllocateSlicesLocked(VPartition* vp, size_t vslic
                 ((status = vp->SliceSetLocked(vslice, static_cast<uint32_t>(pslice)) != ZX_OK))) {
                 for (int j = static_cast<int>(i - 1); j >= 0; j--) {
                     vslice = vslice_start + j;
-                    GetSliceEntryLocked(vp->SliceGetLocked(vslice))->vpart = PSLICE_UNALLOCATED;
+                    MutableSliceEntryLocked(vp->SliceGetLocked(vslice))->vpart = PSLICE_UNALLOCATED;
                     vp->SliceFreeLocked(vslice);
                 }
 
                 return status;
             }
-            slice_entry_t* alloc_entry = GetSliceEntryLocked(pslice);
+            slice_entry_t* alloc_entry = MutableSliceEntryLocked(pslice);
             auto vpart = vp->GetEntryIndex();
             ZX_DEBUG_ASSERT(vpart <= VPART_MAX);
             ZX_DEBUG_ASSERT(vslice <= VSLICE_MAX);
@@ -363,7 +438,7 @@ zx_status_t VPartitionManager::AllocateSlicesLocked(VPartition* vp, size_t vslic
         fbl::AutoLock lock(&vp->lock_);
         for (int j = static_cast<int>(count - 1); j >= 0; j--) {
             auto vslice = vslice_start + j;
-            GetSliceEntryLocked(vp->SliceGetLocked(vslice))->vpart = PSLICE_UNALLOCATED;
+            MutableSliceEntryLocked(vp->SliceGetLocked(vslice))->vpart = PSLICE_UNALLOCATED;
             vp->SliceFreeLocked(vslice);
         }
     }
@@ -398,9 +473,9 @@ zx_status_t VPartitionManager::Upgrade(const uint8_t* old_guid, const uint8_t* n
     }
 
     if (old_index) {
-        GetVPartEntryLocked(old_index)->flags |= kVPartFlagInactive;
+        MutableVPartEntryLocked(old_index)->flags |= kVPartFlagInactive;
     }
-    GetVPartEntryLocked(new_index)->flags &= ~kVPartFlagInactive;
+    MutableVPartEntryLocked(new_index)->flags &= ~kVPartFlagInactive;
 
     return WriteFvmLocked();
 }
@@ -436,14 +511,14 @@ zx_status_t VPartitionManager::FreeSlicesLocked(VPartition* vp, size_t vslice_st
             for (auto extent = vp->ExtentBegin(); extent.IsValid(); extent = vp->ExtentBegin()) {
                 while (!extent->is_empty()) {
                     auto vslice = extent->end() - 1;
-                    GetSliceEntryLocked(vp->SliceGetLocked(vslice))->vpart = PSLICE_UNALLOCATED;
+                    MutableSliceEntryLocked(vp->SliceGetLocked(vslice))->vpart = PSLICE_UNALLOCATED;
                     ZX_ASSERT(vp->SliceFreeLocked(vslice));
                 }
             }
 
             // Remove device, VPartition if this was a request to free all slices.
             vp->DdkRemove();
-            auto entry = GetVPartEntryLocked(vp->GetEntryIndex());
+            auto entry = MutableVPartEntryLocked(vp->GetEntryIndex());
             entry->clear();
             vp->KillLocked();
             freed_something = true;
@@ -462,7 +537,7 @@ zx_status_t VPartitionManager::FreeSlicesLocked(VPartition* vp, size_t vslice_st
                     } else {
                         ZX_ASSERT(vp->SliceFreeLocked(vslice));
                     }
-                    GetSliceEntryLocked(pslice)->vpart = 0;
+                    MutableSliceEntryLocked(pslice)->vpart = 0;
                     freed_something = true;
                 }
             }
@@ -505,7 +580,7 @@ zx_status_t VPartitionManager::DdkIoctl(uint32_t op, const void* cmd,
                 return status;
             }
 
-            auto entry = GetVPartEntryLocked(vpart_entry);
+            auto entry = MutableVPartEntryLocked(vpart_entry);
             entry->init(request->type, request->guid,
                         static_cast<uint32_t>(request->slice_count),
                         request->name, request->flags & kVPartAllocateMask);
@@ -878,6 +953,11 @@ static void multi_iotxn_completion(iotxn_t* txn, void* cookie) {
 }
 
 void VPartition::DdkIotxnQueue(iotxn_t* txn) {
+    if (txn->opcode == IOTXN_OP_FLUSH) {
+        // Flushes cover the whole device; nothing to translate.
+        iotxn_queue(GetParent(), txn);
+        return;
+    }
     if (txn->offset % BlockSize()) {
         iotxn_complete(txn, ZX_ERR_INVALID_ARGS, 0);
         return;
@@ -1029,6 +1109,22 @@ void VPartition::BlockWrite(zx_handle_t vmo, uint64_t length, uint64_t vmo_offse
     Txn(IOTXN_OP_WRITE, vmo, length, vmo_offset, dev_offset, cookie);
 }
 
+void VPartition::BlockFlush(void* cookie) {
+    zx_status_t status;
+    iotxn_t* txn;
+    if ((status = iotxn_alloc(&txn, IOTXN_ALLOC_POOL, 0)) != ZX_OK) {
+        callbacks_->complete(cookie, status);
+        return;
+    }
+    txn->opcode = IOTXN_OP_FLUSH;
+    txn->offset = 0;
+    txn->length = 0;
+    txn->complete_cb = vpart_block_complete;
+    txn->cookie = cookie;
+    memcpy(txn->extra, &callbacks_, sizeof(void*));
+    iotxn_queue(zxdev(), txn);
+}
+
 } // namespace fvm
 
 // C-compatibility definitions
@@ -155,6 +155,11 @@ static zx_status_t gpt_ioctl(void* ctx, uint32_t op, const void* cmd, size_t cmd
 
 static void gpt_iotxn_queue(void* ctx, iotxn_t* txn) {
     gptpart_device_t* device = ctx;
+    if (txn->opcode == IOTXN_OP_FLUSH) {
+        // Flushes cover the whole device; nothing to translate.
+        iotxn_queue(device->parent, txn);
+        return;
+    }
     if (txn->offset % device->info.block_size) {
         iotxn_complete(txn, ZX_ERR_INVALID_ARGS, 0);
         return;
@@ -277,11 +282,29 @@ static void gpt_block_write(void* ctx, zx_handle_t vmo, uint64_t length, uint64_
     block_do_txn(ctx, IOTXN_OP_WRITE, vmo, length, vmo_offset, dev_offset, cookie);
 }
 
+static void gpt_block_flush(void* ctx, void* cookie) {
+    gptpart_device_t* dev = ctx;
+    zx_status_t status;
+    iotxn_t* txn;
+    if ((status = iotxn_alloc(&txn, IOTXN_ALLOC_POOL, 0)) != ZX_OK) {
+        dev->callbacks->complete(cookie, status);
+        return;
+    }
+    txn->opcode = IOTXN_OP_FLUSH;
+    txn->offset = 0;
+    txn->length = 0;
+    txn->complete_cb = gpt_block_complete;
+    txn->cookie = cookie;
+    memcpy(txn->extra, &dev, sizeof(gptpart_device_t*));
+    iotxn_queue(dev->parent, txn);
+}
+
 static block_protocol_ops_t gpt_block_ops = {
     .set_callbacks = gpt_block_set_callbacks,
     .get_info = gpt_block_get_info,
     .read = gpt_block_read,
     .write = gpt_block_write,
+    .flush = gpt_block_flush,
 };
 
 static void gpt_read_sync_complete(iotxn_t* txn, void* cookie) {
@@ -142,6 +142,11 @@ static zx_off_t to_parent_offset(mbrpart_device_t* dev, zx_off_t offset) {
 
 static void mbr_iotxn_queue(void* ctx, iotxn_t* txn) {
     mbrpart_device_t* dev = ctx;
+    if (txn->opcode == IOTXN_OP_FLUSH) {
+        // Flushes cover the whole device; nothing to translate.
+        iotxn_queue(dev->parent, txn);
+        return;
+    }
     if (txn->offset % dev->info.block_size) {
         iotxn_complete(txn, ZX_ERR_INVALID_ARGS, 0);
         return;
@@ -257,11 +262,29 @@ static void mbr_block_write(void* ctx, zx_handle_t vmo, uint64_t length, uint64_
     block_do_txn(ctx, IOTXN_OP_WRITE, vmo, length, vmo_offset, dev_offset, cookie);
 }
 
+static void mbr_block_flush(void* ctx, void* cookie) {
+    mbrpart_device_t* dev = ctx;
+    zx_status_t status;
+    iotxn_t* txn;
+    if ((status = iotxn_alloc(&txn, IOTXN_ALLOC_POOL, 0)) != ZX_OK) {
+        dev->callbacks->complete(cookie, status);
+        return;
+    }
+    txn->opcode = IOTXN_OP_FLUSH;
+    txn->offset = 0;
+    txn->length = 0;
+    txn->complete_cb = mbr_block_complete;
+    txn->cookie = cookie;
+    memcpy(txn->extra, &dev, sizeof(mbrpart_device_t*));
+    iotxn_queue(dev->parent, txn);
+}
+
 static block_protocol_ops_t mbr_block_ops = {
     .set_callbacks = mbr_block_set_callbacks,
     .get_info = mbr_block_get_info,
     .read = mbr_block_read,
     .write = mbr_block_write,
+    .flush = mbr_block_flush,
 };
 
 static int mbr_bind_thread(void* arg) {
@@ -22,6 +22,10 @@
 #include <limits.h>
 #include <threads.h>
 
+// Ramdisks are memory-bound; let iotxns for different blocks be copied
+// concurrently.
+#define RAMDISK_WORKER_COUNT 4
+
 typedef struct {
     zx_device_t* zxdev;
 } ramctl_device_t;
@@ -37,11 +41,108 @@ typedef struct ramdisk_device {
 
     mtx_t lock;
     bool dead;
-    thrd_t worker;
+    uint32_t flags;
+    // With RAMDISK_FLAG_VOLATILE_WRITE_CACHE: the contents which would
+    // survive a power loss, and a bitmap of blocks written since the last
+    // flush.
+    zx_handle_t durable_vmo;
+    uint64_t* dirty;
+    // Fifo reads and writes copying to or from the mapping outside 'lock'.
+    // Release waits for them to drain.
+    uint32_t fifo_ops;
+    uint32_t worker_count;
+    thrd_t workers[RAMDISK_WORKER_COUNT];
     cnd_t work_cvar;
     list_node_t txn_list;
 } ramdisk_device_t;
 
+static uint64_t sizebytes(ramdisk_device_t* rdev);
+
+static void ramdisk_mark_dirty_locked(ramdisk_device_t* rdev, uint64_t offset,
+                                      uint64_t length) {
+    if (rdev->dirty == NULL) {
+        return;
+    }
+    for (uint64_t b = offset / rdev->blk_size; b < (offset + length) / rdev->blk_size; b++) {
+        rdev->dirty[b / 64] |= 1ull << (b % 64);
+    }
+}
+
+// Copies every dirty block from the device contents to the durable copy
+// (flush), or from the durable copy back to the contents (power loss).
+static zx_status_t ramdisk_write_back_locked(ramdisk_device_t* rdev, bool flush) {
+    if (rdev->dirty == NULL) {
+        return ZX_OK;
+    }
+    uint64_t b = 0;
+    while (b < rdev->blk_count) {
+        if (!(rdev->dirty[b / 64] & (1ull << (b % 64)))) {
+            b++;
+            continue;
+        }
+        uint64_t start = b;
+        while ((b < rdev->blk_count) && (rdev->dirty[b / 64] & (1ull << (b % 64)))) {
+            rdev->dirty[b / 64] &= ~(1ull << (b % 64));
+            b++;
+        }
+        uint64_t offset = start * rdev->blk_size;
+        uint64_t length = (b - start) * rdev->blk_size;
+        void* addr = (void*)rdev->mapped_addr + offset;
+        size_t actual;
+        zx_status_t status = flush ?
+                zx_vmo_write(rdev->durable_vmo, addr, offset, length, &actual) :
+                zx_vmo_read(rdev->durable_vmo, addr, offset, length, &actual);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+static zx_status_t ramdisk_flush(ramdisk_device_t* rdev) {
+    mtx_lock(&rdev->lock);
+    zx_status_t status = rdev->dead ? ZX_ERR_BAD_STATE : ramdisk_write_back_locked(rdev, true);
+    mtx_unlock(&rdev->lock);
+    return status;
+}
+
+static zx_status_t ramdisk_set_flags(ramdisk_device_t* rdev, uint32_t flags) {
+    if (flags & ~RAMDISK_FLAG_VOLATILE_WRITE_CACHE) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    zx_status_t status = ZX_OK;
+    mtx_lock(&rdev->lock);
+    if ((flags & RAMDISK_FLAG_VOLATILE_WRITE_CACHE) && (rdev->dirty == NULL)) {
+        // Everything written so far is durable; snapshot it. This must be
+        // a copy: a copy-on-write clone would still see later writes to the
+        // pages it has not copied.
+        size_t actual;
+        rdev->dirty = calloc((rdev->blk_count + 63) / 64, sizeof(uint64_t));
+        if (rdev->dirty == NULL) {
+            status = ZX_ERR_NO_MEMORY;
+        } else if ((status = zx_vmo_create(sizebytes(rdev), 0, &rdev->durable_vmo)) != ZX_OK) {
+            free(rdev->dirty);
+            rdev->dirty = NULL;
+        } else if ((status = zx_vmo_write(rdev->durable_vmo, (void*)rdev->mapped_addr, 0,
+                                          sizebytes(rdev), &actual)) != ZX_OK) {
+            free(rdev->dirty);
+            rdev->dirty = NULL;
+            zx_handle_close(rdev->durable_vmo);
+            rdev->durable_vmo = ZX_HANDLE_INVALID;
+        }
+    } else if (!(flags & RAMDISK_FLAG_VOLATILE_WRITE_CACHE) && (rdev->dirty != NULL)) {
+        free(rdev->dirty);
+        rdev->dirty = NULL;
+        zx_handle_close(rdev->durable_vmo);
+        rdev->durable_vmo = ZX_HANDLE_INVALID;
+    }
+    if (status == ZX_OK) {
+        rdev->flags = flags;
+    }
+    mtx_unlock(&rdev->lock);
+    return status;
+}
+
 // The worker thread processes messages from iotxns in the background
 static int worker_thread(void* arg) {
     ramdisk_device_t* dev = (ramdisk_device_t*)arg;
@@ -64,10 +165,19 @@ static int worker_thread(void* arg) {
                 break;
             }
             case IOTXN_OP_WRITE: {
+                // Blocks are marked dirty once they hold the new contents,
+                // so a flush racing with the copy leaves them dirty.
                 iotxn_copyfrom(txn, (void*) dev->mapped_addr + txn->offset, txn->length, 0);
+                mtx_lock(&dev->lock);
+                ramdisk_mark_dirty_locked(dev, txn->offset, txn->length);
+                mtx_unlock(&dev->lock);
                 iotxn_complete(txn, ZX_OK, txn->length);
                 break;
             }
+            case IOTXN_OP_FLUSH: {
+                iotxn_complete(txn, ramdisk_flush(dev), 0);
+                break;
+            }
             default: {
                 iotxn_complete(txn, ZX_ERR_INVALID_ARGS, 0);
             }
@@ -115,6 +225,24 @@ static void ramdisk_fifo_set_callbacks(void* ctx, block_callbacks_t* cb) {
     rdev->cb = cb;
 }
 
+// Accounts for a fifo operation which is about to touch the mapping; fails
+// if the ramdisk is going away.
+static bool ramdisk_fifo_op_begin(ramdisk_device_t* rdev) {
+    mtx_lock(&rdev->lock);
+    bool dead = rdev->dead;
+    if (!dead) {
+        rdev->fifo_ops++;
+    }
+    mtx_unlock(&rdev->lock);
+    return !dead;
+}
+
+static void ramdisk_fifo_op_end_locked(ramdisk_device_t* rdev) {
+    if (--rdev->fifo_ops == 0) {
+        cnd_broadcast(&rdev->work_cvar);
+    }
+}
+
 static void ramdisk_fifo_read(void* ctx, zx_handle_t vmo, uint64_t length,
                               uint64_t vmo_offset, uint64_t dev_offset, void* cookie) {
     ramdisk_device_t* rdev = ctx;
@@ -125,15 +253,16 @@ static void ramdisk_fifo_read(void* ctx, zx_handle_t vmo, uint64_t length,
         return;
     }
 
-    mtx_lock(&rdev->lock);
-    if (rdev->dead) {
-        status = ZX_ERR_BAD_STATE;
-    } else {
-        size_t actual;
-        // Reading from disk --> Write to file VMO
-        status = zx_vmo_write(vmo, (void*)rdev->mapped_addr + dev_offset,
-                              vmo_offset, len, &actual);
+    if (!ramdisk_fifo_op_begin(rdev)) {
+        rdev->cb->complete(cookie, ZX_ERR_BAD_STATE);
+        return;
     }
+    size_t actual;
+    // Reading from disk --> Write to file VMO
+    status = zx_vmo_write(vmo, (void*)rdev->mapped_addr + dev_offset,
+                          vmo_offset, len, &actual);
+    mtx_lock(&rdev->lock);
+    ramdisk_fifo_op_end_locked(rdev);
     mtx_unlock(&rdev->lock);
     rdev->cb->complete(cookie, status);
 }
@@ -148,24 +277,32 @@ static void ramdisk_fifo_write(void* ctx, zx_handle_t vmo, uint64_t length,
         return;
     }
 
-    mtx_lock(&rdev->lock);
-    if (rdev->dead) {
-        status = ZX_ERR_BAD_STATE;
-    } else {
-        size_t actual = 0;
-        // Writing to disk --> Read from file VMO
-        status = zx_vmo_read(vmo, (void*)rdev->mapped_addr + dev_offset,
-                             vmo_offset, len, &actual);
+    if (!ramdisk_fifo_op_begin(rdev)) {
+        rdev->cb->complete(cookie, ZX_ERR_BAD_STATE);
+        return;
     }
+    size_t actual = 0;
+    // Writing to disk --> Read from file VMO
+    status = zx_vmo_read(vmo, (void*)rdev->mapped_addr + dev_offset,
+                         vmo_offset, len, &actual);
+    mtx_lock(&rdev->lock);
+    ramdisk_mark_dirty_locked(rdev, dev_offset, len);
+    ramdisk_fifo_op_end_locked(rdev);
     mtx_unlock(&rdev->lock);
     rdev->cb->complete(cookie, status);
 }
 
+static void ramdisk_fifo_flush(void* ctx, void* cookie) {
+    ramdisk_device_t* rdev = ctx;
+    rdev->cb->complete(cookie, ramdisk_flush(rdev));
+}
+
 static block_protocol_ops_t ramdisk_block_ops = {
     .set_callbacks = ramdisk_fifo_set_callbacks,
     .get_info = ramdisk_get_info,
     .read = ramdisk_fifo_read,
     .write = ramdisk_fifo_write,
+    .flush = ramdisk_fifo_flush,
 };
 
 // implement device protocol:
@@ -190,6 +327,18 @@ static zx_status_t ramdisk_ioctl(void* ctx, uint32_t op, const void* cmd,
         ramdisk_unbind(ramdev);
         return ZX_OK;
     }
+    case IOCTL_RAMDISK_SET_FLAGS: {
+        if (cmdlen < sizeof(uint32_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        return ramdisk_set_flags(ramdev, *(const uint32_t*)cmd);
+    }
+    case IOCTL_RAMDISK_DISCARD_UNFLUSHED: {
+        mtx_lock(&ramdev->lock);
+        zx_status_t status = ramdisk_write_back_locked(ramdev, false);
+        mtx_unlock(&ramdev->lock);
+        return status;
+    }
     // Block Protocol
     case IOCTL_BLOCK_GET_NAME: {
         char* name = reply;
@@ -210,8 +359,8 @@ static zx_status_t ramdisk_ioctl(void* ctx, uint32_t op, const void* cmd,
         return device_rebind(ramdev->zxdev);
     }
     case IOCTL_DEVICE_SYNC: {
-        // Wow, we sync so quickly!
-        return ZX_OK;
+        // Wow, we sync so quickly! (Unless modelling a write cache.)
+        return ramdisk_flush(ramdev);
     }
     default:
         return ZX_ERR_NOT_SUPPORTED;
@@ -243,14 +392,24 @@ static zx_off_t ramdisk_getsize(void* ctx) {
 static void ramdisk_release(void* ctx) {
     ramdisk_device_t* ramdev = ctx;
 
-    // Wake up the worker thread, in case it is sleeping
+    // Wake up the worker threads, in case they are sleeping, and wait for
+    // fifo operations to stop touching the mapping.
     mtx_lock(&ramdev->lock);
     ramdev->dead = true;
-    cnd_signal(&ramdev->work_cvar);
+    cnd_broadcast(&ramdev->work_cvar);
+    while (ramdev->fifo_ops != 0) {
+        cnd_wait(&ramdev->work_cvar, &ramdev->lock);
+    }
     mtx_unlock(&ramdev->lock);
 
-    int r;
-    thrd_join(ramdev->worker, &r);
+    for (uint32_t i = 0; i < ramdev->worker_count; i++) {
+        int r;
+        thrd_join(ramdev->workers[i], &r);
+    }
+    free(ramdev->dirty);
+    if (ramdev->durable_vmo != ZX_HANDLE_INVALID) {
+        zx_handle_close(ramdev->durable_vmo);
+    }
     if (ramdev->vmo != ZX_HANDLE_INVALID) {
         zx_vmar_unmap(zx_vmar_root_self(), ramdev->mapped_addr, sizebytes(ramdev));
         zx_handle_close(ramdev->vmo);
@@ -306,7 +465,13 @@ static zx_status_t ramctl_ioctl(void* ctx, uint32_t op, const void* cmd,
             goto fail_unmap;
         }
         list_initialize(&ramdev->txn_list);
-        if (thrd_create(&ramdev->worker, worker_thread, ramdev) != thrd_success) {
+        for (uint32_t i = 0; i < RAMDISK_WORKER_COUNT; i++) {
+            if (thrd_create(&ramdev->workers[i], worker_thread, ramdev) != thrd_success) {
+                break;
+            }
+            ramdev->worker_count++;
+        }
+        if (ramdev->worker_count == 0) {
             goto fail_cvar_free;
         }
 
@@ -231,6 +231,26 @@ static zx_status_t mmc_decode_csd(sdmmc_t* sdmmc, const uint8_t* raw_csd) {
     return ZX_OK;
 }
 
+// Whether "driver.sdmmc.write-cache" is set on the command line.
+static bool mmc_write_cache_requested(void) {
+    const char* value = getenv("driver.sdmmc.write-cache");
+    if (value == NULL) {
+        return false;
+    }
+    return strcmp(value, "0") != 0 && strcmp(value, "false") != 0 &&
+           strcmp(value, "off") != 0;
+}
+
+zx_status_t mmc_flush_cache(sdmmc_t* sdmmc, iotxn_t* txn) {
+    if (!sdmmc->cache_enabled) {
+        return ZX_OK;
+    }
+    sdmmc_protocol_data_t* pdata = iotxn_pdata(txn, sdmmc_protocol_data_t);
+    pdata->blockcount = 0;
+    pdata->blocksize = 0;
+    return mmc_switch(sdmmc, txn, MMC_EXT_CSD_FLUSH_CACHE, 1);
+}
+
 static zx_status_t mmc_decode_ext_csd(sdmmc_t* sdmmc, const uint8_t* raw_ext_csd) {
     zxlogf(SPEW, "mmc: EXT_CSD version %u CSD version %u\n", raw_ext_csd[192], raw_ext_csd[194]);
 
@@ -414,6 +434,21 @@ zx_status_t sdmmc_probe_mmc(sdmmc_t* sdmmc, iotxn_t* setup_txn) {
         sdmmc->timing = SDMMC_TIMING_LEGACY;
     }
 
+    // Turn on the volatile write cache, if the card has one and it was asked
+    // for. Writes then complete once cached, and are only durable after an
+    // IOTXN_OP_FLUSH, which not every filesystem issues yet.
+    const uint8_t* ext_csd = sdmmc->raw_ext_csd;
+    uint32_t cache_size = (ext_csd[MMC_EXT_CSD_CACHE_SIZE_LSB] << 0) |
+                          (ext_csd[MMC_EXT_CSD_CACHE_SIZE_LSB + 1] << 8) |
+                          (ext_csd[MMC_EXT_CSD_CACHE_SIZE_LSB + 2] << 16) |
+                          (ext_csd[MMC_EXT_CSD_CACHE_SIZE_MSB] << 24);
+    if (cache_size > 0 && mmc_write_cache_requested()) {
+        if (mmc_switch(sdmmc, setup_txn, MMC_EXT_CSD_CACHE_CTRL, 1) == ZX_OK) {
+            sdmmc->cache_enabled = true;
+            zxlogf(TRACE, "mmc: enabled %u KiB write cache\n", cache_size);
+        }
+    }
+
     zxlogf(INFO, "mmc: initialized mmc @ %u mhz, bus width %d, timing %d\n",
             sdmmc->clock_rate, sdmmc->bus_width, sdmmc->timing);
 
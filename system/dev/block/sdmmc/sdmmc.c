@@ -87,7 +87,23 @@ static zx_status_t sdmmc_ioctl(void* ctx, uint32_t op, const void* cmd,
         return ZX_ERR_NOT_SUPPORTED;
     }
     case IOCTL_DEVICE_SYNC: {
-        return ZX_ERR_NOT_SUPPORTED;
+        iotxn_t* txn;
+        zx_status_t status = iotxn_alloc(&txn, 0, 0);
+        if (status != ZX_OK) {
+            return status;
+        }
+        txn->opcode = IOTXN_OP_FLUSH;
+        txn->offset = 0;
+        txn->length = 0;
+        sdmmc_t* sdmmc = ctx;
+        completion_t cplt = COMPLETION_INIT;
+        txn->complete_cb = sdmmc_txn_cplt;
+        txn->cookie = &cplt;
+        iotxn_queue(sdmmc->zxdev, txn);
+        completion_wait(&cplt, ZX_TIME_INFINITE);
+        status = txn->status;
+        iotxn_release(txn);
+        return status;
     }
     default:
         return ZX_ERR_NOT_SUPPORTED;
@@ -230,12 +246,30 @@ static void sdmmc_block_write(void* ctx, zx_handle_t vmo, uint64_t length, uint6
     block_do_txn(ctx, IOTXN_OP_WRITE, vmo, length, vmo_offset, dev_offset, cookie);
 }
 
+static void sdmmc_block_flush(void* ctx, void* cookie) {
+    sdmmc_t* dev = ctx;
+    zx_status_t status;
+    iotxn_t* txn;
+    if ((status = iotxn_alloc(&txn, IOTXN_ALLOC_POOL, 0)) != ZX_OK) {
+        dev->callbacks->complete(cookie, status);
+        return;
+    }
+    txn->opcode = IOTXN_OP_FLUSH;
+    txn->offset = 0;
+    txn->length = 0;
+    txn->complete_cb = sdmmc_block_complete;
+    txn->cookie = cookie;
+    memcpy(txn->extra, &dev, sizeof(sdmmc_t*));
+    iotxn_queue(dev->zxdev, txn);
+}
+
 // Block core protocol
 static block_protocol_ops_t sdmmc_block_ops = {
     .set_callbacks = sdmmc_block_set_callbacks,
     .get_info = sdmmc_block_get_info,
     .read = sdmmc_block_read,
     .write = sdmmc_block_write,
+    .flush = sdmmc_block_flush,
 };
 
 static void sdmmc_do_txn(sdmmc_t* sdmmc, iotxn_t* txn) {
@@ -261,6 +295,14 @@ static void sdmmc_do_txn(sdmmc_t* sdmmc, iotxn_t* txn) {
                 cmd = SDMMC_WRITE_BLOCK;
             }
             break;
+        case IOTXN_OP_FLUSH:
+            // Transactions run one at a time, so every earlier write has
+            // completed; only a card cache can still hold them.
+            if (!sdmmc->cache_enabled) {
+                iotxn_complete(txn, ZX_OK, 0);
+                return;
+            }
+            break;
         default:
             // Invalid opcode?
             zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d\n", txn, ZX_ERR_INVALID_ARGS);
@@ -313,6 +355,13 @@ static void sdmmc_do_txn(sdmmc_t* sdmmc, iotxn_t* txn) {
         goto out;
     }
 
+    if (txn->opcode == IOTXN_OP_FLUSH) {
+        st = mmc_flush_cache(sdmmc, clone);
+        zxlogf(SPEW, "sdmmc: iotxn_complete txn %p status %d (flush)\n", txn, st);
+        iotxn_complete(txn, st, 0);
+        goto out;
+    }
+
     // Issue the data transfer
 
     const uint32_t blkid = clone->offset / SDHC_BLOCK_SIZE;
@@ -34,6 +34,7 @@ typedef struct sdmmc {
 
     unsigned clock_rate;    // Bus clock rate
     uint64_t capacity;      // Card capacity
+    bool cache_enabled;     // Writes land in a volatile cache on the card
 
     uint16_t rca;           // Relative address
 
@@ -58,4 +59,7 @@ zx_status_t sdmmc_do_command(zx_device_t* dev, const uint32_t cmd, const uint32_
 zx_status_t sdmmc_probe_sd(sdmmc_t* sdmmc, iotxn_t* setup_txn);
 zx_status_t sdmmc_probe_mmc(sdmmc_t* sdmmc, iotxn_t* setup_txn);
 
+// Writes back the volatile cache of an MMC card which has it enabled.
+zx_status_t mmc_flush_cache(sdmmc_t* sdmmc, iotxn_t* txn);
+
 __END_CDECLS;
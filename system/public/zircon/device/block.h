@@ -78,6 +78,9 @@
 // since it will allow "activating" updated partitions.
 #define IOCTL_BLOCK_FVM_UPGRADE \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 17)
+// Add another FIFO to the currently running FIFO server; acquire the handle to it
+#define IOCTL_BLOCK_ADD_FIFO \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_BLOCK, 18)
 
 // Block Core ioctls (specific to each block device):
 
@@ -113,6 +116,12 @@ IOCTL_WRAPPER(ioctl_block_rr_part, IOCTL_BLOCK_RR_PART);
 // ssize_t ioctl_block_get_fifos(int fd, zx_handle_t* fifo_out);
 IOCTL_WRAPPER_OUT(ioctl_block_get_fifos, IOCTL_BLOCK_GET_FIFOS, zx_handle_t);
 
+// The number of FIFOs a single FIFO server may have, including the first.
+#define MAX_BLOCK_FIFOS 8
+
+// ssize_t ioctl_block_add_fifo(int fd, zx_handle_t* fifo_out);
+IOCTL_WRAPPER_OUT(ioctl_block_add_fifo, IOCTL_BLOCK_ADD_FIFO, zx_handle_t);
+
 typedef uint16_t vmoid_t;
 
 // Dummy vmoid value reserved for "invalid". Will never be allocated; can be
@@ -252,10 +261,26 @@ IOCTL_WRAPPER_IN(ioctl_block_fvm_upgrade, IOCTL_BLOCK_FVM_UPGRADE, upgrade_req_t
 // 'dev_offset', into the VMO associated with 'vmoid', starting at 'vmo_offset'.
 // If the transaction is out of range, for example if 'length' is too large or if
 // 'dev_offset' is beyond the end of the device, ZX_ERR_OUT_OF_RANGE is returned.
+//
+// BLOCKIO_SYNC is a barrier: it does not start until every request read from the fifo
+// before it has completed, and then flushes any volatile write cache of the device.
+// Requests read after it are not started until the flush completes. Between barriers,
+// the device may reorder and merge requests freely. The 'vmoid', 'length' and offset
+// fields of a BLOCKIO_SYNC request are ignored.
+//
+// A server may have up to MAX_BLOCK_FIFOS FIFOs ("queues"): the one returned by
+// "get_fifos", and more added with "add_fifo". Each is served by a thread of its own,
+// so clients issuing requests from several threads can keep several requests in
+// flight in the device. VMOs and txns belong to the server and may be used on any
+// of its FIFOs, but all the messages of a transaction must be sent on the same FIFO,
+// which is where its response is sent. Requests on different FIFOs are not ordered
+// against each other; a BLOCKIO_SYNC only waits for requests on its own FIFO, though
+// its flush covers writes completed on any of them. Closing any FIFO shuts down the
+// whole server.
 
 #define BLOCKIO_READ 0x0001      // Reads from the Block device into the VMO
 #define BLOCKIO_WRITE 0x0002     // Writes to the Block device from the VMO
-#define BLOCKIO_SYNC 0x0003      // Unimplemented
+#define BLOCKIO_SYNC 0x0003      // Barrier; flushes writes which completed before it
 #define BLOCKIO_CLOSE_VMO 0x0004 // Detaches the VMO from the block device; closes the handle to it.
 #define BLOCKIO_OP_MASK 0x00FF
 
@@ -12,6 +12,18 @@
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_RAMDISK, 1)
 #define IOCTL_RAMDISK_UNLINK \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_RAMDISK, 2)
+// Sets RAMDISK_FLAG_* options on the ramdisk.
+#define IOCTL_RAMDISK_SET_FLAGS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_RAMDISK, 3)
+// Discards every write which has not been flushed, as if the device lost
+// power. Only meaningful with RAMDISK_FLAG_VOLATILE_WRITE_CACHE.
+#define IOCTL_RAMDISK_DISCARD_UNFLUSHED \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_RAMDISK, 4)
+
+// Models a device with a volatile write cache, for testing that clients
+// order their writes with flushes (BLOCKIO_SYNC). Completed writes are
+// visible to reads at once, but only become durable once flushed.
+#define RAMDISK_FLAG_VOLATILE_WRITE_CACHE 0x00000001
 
 typedef struct ramdisk_ioctl_config {
     uint64_t blk_size;
@@ -29,3 +41,9 @@ IOCTL_WRAPPER_INOUT(ioctl_ramdisk_config, IOCTL_RAMDISK_CONFIG, ramdisk_ioctl_co
 
 // ssize_t ioctl_ramdisk_unlink(int fd);
 IOCTL_WRAPPER(ioctl_ramdisk_unlink, IOCTL_RAMDISK_UNLINK);
+
+// ssize_t ioctl_ramdisk_set_flags(int fd, const uint32_t* in);
+IOCTL_WRAPPER_IN(ioctl_ramdisk_set_flags, IOCTL_RAMDISK_SET_FLAGS, uint32_t);
+
+// ssize_t ioctl_ramdisk_discard_unflushed(int fd);
+IOCTL_WRAPPER(ioctl_ramdisk_discard_unflushed, IOCTL_RAMDISK_DISCARD_UNFLUSHED);
@@ -40,6 +40,9 @@
 #define ZX_DEFAULT_LOG_RIGHTS \
   (ZX_RIGHT_TRANSFER | ZX_RIGHT_WRITE | ZX_RIGHT_DUPLICATE | ZX_RIGHT_SIGNAL)
 
+#define ZX_DEFAULT_PAGER_RIGHTS \
+  (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | ZX_RIGHT_READ | ZX_RIGHT_WRITE)
+
 #define ZX_DEFAULT_PCI_DEVICE_RIGHTS \
   (ZX_RIGHT_READ | ZX_RIGHT_WRITE | ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER)
 #define ZX_DEFAULT_PCI_INTERRUPT_RIGHTS \
@@ -74,7 +77,8 @@
   (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | ZX_RIGHT_READ | ZX_RIGHT_WRITE |\
    ZX_RIGHT_EXECUTE | ZX_RIGHT_SIGNAL)
 
-#define ZX_DEFAULT_VMAR_RIGHTS (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER)
+#define ZX_DEFAULT_VMAR_RIGHTS \
+  (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | ZX_RIGHT_GET_PROPERTY | ZX_RIGHT_SET_PROPERTY)
 
 #define ZX_DEFAULT_VMO_RIGHTS                                                \
   (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | ZX_RIGHT_READ | ZX_RIGHT_WRITE | \
@@ -54,6 +54,7 @@ typedef enum {
     ZX_OBJ_TYPE_GUEST               = 20,
     ZX_OBJ_TYPE_VCPU                = 21,
     ZX_OBJ_TYPE_TIMER               = 22,
+    ZX_OBJ_TYPE_PAGER               = 23,
     ZX_OBJ_TYPE_LAST
 } zx_obj_type_t;
 
@@ -148,6 +149,13 @@ typedef struct zx_info_task_stats {
     //
     // This number is strictly smaller than mem_shared_bytes.
     size_t mem_scaled_shared_bytes;
+
+    // The number of page faults taken by the task's threads.
+    uint64_t page_faults;
+
+    // The number of pages mapped ahead of an access by those faults, beside
+    // the faulting page; see ZX_PROP_VMAR_FAULT_AROUND.
+    uint64_t pages_faulted_around;
 } zx_info_task_stats_t;
 
 typedef struct zx_info_vmar {
@@ -375,6 +383,14 @@ typedef struct zx_info_resource {
 // Argument is an zx_job_importance_t value.
 #define ZX_PROP_JOB_IMPORTANCE             7u
 
+// Argument is a uint32_t: the number of pages of a VMAR's mappings, aligned
+// within the mapping, that a page fault maps at once from the pages the VMO
+// already holds. A power of two no larger than ZX_VMAR_FAULT_AROUND_MAX; 0 or
+// 1 maps only the faulting page. Subregions created later inherit the value.
+#define ZX_PROP_VMAR_FAULT_AROUND           8u
+
+#define ZX_VMAR_FAULT_AROUND_MAX            64u
+
 // Describes how important a job is.
 typedef int32_t zx_job_importance_t;
 
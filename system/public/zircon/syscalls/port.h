@@ -12,6 +12,10 @@ __BEGIN_CDECLS
 #define ZX_WAIT_ASYNC_ONCE          0u
 #define ZX_WAIT_ASYNC_REPEATING     1u
 
+// The maximum number of packets which can be passed to a single
+// zx_port_queue() or zx_port_wait_many() call.
+#define ZX_PORT_MAX_BATCH           16u
+
 // packet types.
 #define ZX_PKT_TYPE_USER            0x00u
 #define ZX_PKT_TYPE_SIGNAL_ONE      0x01u
@@ -20,6 +24,7 @@ __BEGIN_CDECLS
 #define ZX_PKT_TYPE_GUEST_MEM       0x04u
 #define ZX_PKT_TYPE_GUEST_IO        0x05u
 #define ZX_PKT_TYPE_EXCEPTION(n)    (0x06u | (((n) & 0xFFu) << 8))
+#define ZX_PKT_TYPE_PAGE_REQUEST    0x07u
 
 #define ZX_PKT_TYPE_MASK            0xFFu
 
@@ -30,6 +35,7 @@ __BEGIN_CDECLS
 #define ZX_PKT_IS_GUEST_MEM(type)   ((type) == ZX_PKT_TYPE_GUEST_MEM)
 #define ZX_PKT_IS_GUEST_IO(type)    ((type) == ZX_PKT_TYPE_GUEST_IO)
 #define ZX_PKT_IS_EXCEPTION(type)   (((type) & ZX_PKT_TYPE_MASK) == ZX_PKT_TYPE_EXCEPTION(0))
+#define ZX_PKT_IS_PAGE_REQUEST(type) ((type) == ZX_PKT_TYPE_PAGE_REQUEST)
 
 // port_packet_t::type ZX_PKT_TYPE_USER.
 typedef union zx_packet_user {
@@ -93,6 +99,14 @@ typedef struct zx_packet_guest_io {
     uint64_t reserved2;
 } zx_packet_guest_io_t;
 
+// port_packet_t::type ZX_PKT_TYPE_PAGE_REQUEST.
+typedef struct zx_packet_page_request {
+    uint64_t offset;
+    uint64_t length;
+    uint64_t reserved0;
+    uint64_t reserved1;
+} zx_packet_page_request_t;
+
 typedef struct zx_port_packet {
     uint64_t key;
     uint32_t type;
@@ -104,6 +118,7 @@ typedef struct zx_port_packet {
         zx_packet_guest_bell_t guest_bell;
         zx_packet_guest_mem_t guest_mem;
         zx_packet_guest_io_t guest_io;
+        zx_packet_page_request_t page_request;
     };
 } zx_port_packet_t;
 
@@ -28,6 +28,7 @@ using digest::Digest;
 namespace blobstore {
 
 VnodeBlob::~VnodeBlob() {
+    ReleasePagedVmo();
     blobstore_->ReleaseBlob(this);
     if (blob_ != nullptr) {
         block_fifo_request_t request;
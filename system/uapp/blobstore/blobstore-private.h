@@ -11,17 +11,22 @@
 #include <bitmap/raw-bitmap.h>
 #include <digest/digest.h>
 #include <fbl/algorithm.h>
+#include <fbl/limits.h>
 #include <fbl/macros.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <fs/block-txn.h>
 #include <fs/trace.h>
 #include <fs/vfs.h>
 #include <fs/vnode.h>
 
 #ifdef __Fuchsia__
+#include <threads.h>
+
 #include <block-client/client.h>
+#include <fbl/mutex.h>
 #include <fs/mapped-vmo.h>
 #include <zx/event.h>
 #include <zx/vmo.h>
@@ -68,9 +73,15 @@ public:
     struct TypeWavlTraits {
         static WAVLTreeNodeState& node_state(VnodeBlob& b) { return b.type_wavl_state_; }
     };
+    struct PagerWavlTraits {
+        static WAVLTreeNodeState& node_state(VnodeBlob& b) { return b.pager_wavl_state_; }
+    };
     const uint8_t* GetKey() const {
         return &digest_[0];
     };
+    uint64_t GetPagerKey() const {
+        return pager_key_;
+    }
 
     BlobFlags GetState() const {
         return flags_ & kBlobStateMask;
@@ -106,6 +117,7 @@ public:
     virtual ~VnodeBlob();
 
 private:
+    friend class Blobstore;
     friend struct TypeWavlTraits;
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VnodeBlob);
@@ -156,13 +168,28 @@ private:
     zx_status_t Sync() final;
 
     // Read both VMOs into memory, if we haven't already.
-    //
-    // TODO(smklein): When we have can register the Blob Store as a pager
-    // service, and it can properly handle pages faults on a vnode's contents,
-    // then we can avoid reading the entire blob up-front. Until then, read
-    // the contents of a VMO into memory when it is opened.
     zx_status_t InitVmos();
 
+    // Creates blob_ and attaches it to the block device, if we haven't
+    // already, without reading anything into it.
+    zx_status_t CreateBlobVmo();
+
+    // Creates the pager-backed VMO handed out by CopyVmo, reading only the
+    // Merkle tree into memory. The blob's data is read and verified one
+    // Merkle node at a time, as its pages are faulted in.
+    zx_status_t InitPagedVmo();
+
+    // Reads, verifies and supplies the pages of the paged VMO covering
+    // [offset, offset + length), rounded out to whole Merkle nodes.
+    // Called with the blobstore's pager lock held; the caller fails the
+    // page requests if this returns an error.
+    zx_status_t SupplyPages(uint64_t offset, uint64_t length);
+
+    // Supplies every remaining page of the paged VMO, which may outlive
+    // this vnode, and releases it. If some pages cannot be supplied, the
+    // VMO is handed to the blobstore so that their requests still fail.
+    void ReleasePagedVmo();
+
     zx_status_t WriteShared(WriteTxn* txn, size_t start, size_t len, uint64_t start_block);
     // Called by Blob once the last write has completed, updating the
     // on-disk metadata.
@@ -182,6 +209,21 @@ private:
     // 2) The Blob itself, aligned to the nearest kBlobstoreBlockSize
     fbl::unique_ptr<MappedVmo> blob_{};
     vmoid_t vmoid_{};
+    // True once the whole blob (not just the Merkle tree) is in blob_.
+    // Both are only changed on the main thread, and under the blobstore's
+    // pager lock once the paged VMO can exist; the pager thread reads them
+    // with the lock held.
+    bool blob_loaded_{};
+
+    // The VMO handed out to clients, whose pages are supplied on demand
+    // from blob_. The fields below are fixed once it is created, so that
+    // the pager thread can use them without touching the node map.
+    WAVLTreeNodeState pager_wavl_state_{};
+    zx_handle_t paged_vmo_ = ZX_HANDLE_INVALID;
+    uint64_t pager_key_{};
+    uint64_t paged_blob_size_{};
+    uint64_t paged_start_block_{};
+    uint64_t paged_merkle_blocks_{};
 
     zx::event readable_event_{};
     uint64_t bytes_written_{};
@@ -245,6 +287,20 @@ public:
     }
     txnid_t TxnId() const { return txnid_; }
 
+    // Issues the pager thread's reads, under its own transaction so that
+    // they may proceed concurrently with those of the main thread.
+    class PagerTxnHandler {
+    public:
+        explicit PagerTxnHandler(Blobstore* bs) : bs_(bs) {}
+        zx_status_t Txn(block_fifo_request_t* requests, size_t count) {
+            return bs_->Txn(requests, count);
+        }
+        txnid_t TxnId() const { return bs_->pager_txnid_; }
+
+    private:
+        Blobstore* bs_;
+    };
+
     // If possible, attempt to resize the blobstore partition.
     // Add one additional slice for inodes.
     zx_status_t AddInodes();
@@ -271,16 +327,38 @@ private:
     // Access the nth inode of the node map
     blobstore_inode_t* GetNode(size_t index) const;
 
+    // Rebuilds the digest index from the node map, sized to hold up to
+    // |inode_count| nodes. On failure, the existing index is left intact.
+    zx_status_t ResetNodeIndex(uint64_t inode_count);
+
+    // Adds or removes an allocated node from the digest index. A node is
+    // indexed once its merkle root has been written to the node map.
+    void NodeIndexInsert(size_t node_index);
+    void NodeIndexRemove(size_t node_index);
+
+    // Finds the allocated node with a merkle root matching |digest|.
+    zx_status_t NodeIndexFind(const Digest& digest, size_t* node_index_out) const;
+    size_t NodeIndexSlot(const uint8_t* merkle_root_hash) const;
+
     // Given a contiguous number of blocks after a starting block,
-    // write out the bitmap to disk for the corresponding blocks.
+    // enqueue a write of the bitmap for the corresponding blocks.
     zx_status_t WriteBitmap(WriteTxn* txn, uint64_t nblocks, uint64_t start_block);
 
-    // Given a node within the node map at an index, write it to disk.
+    // Given a node within the node map at an index, enqueue a write of it.
     zx_status_t WriteNode(WriteTxn* txn, size_t map_index);
 
     // Enqueues an update for allocated inode/block counts
     zx_status_t CountUpdate(WriteTxn* txn);
 
+    // Creates the pager and starts the thread serving its page requests,
+    // if that has not already been done.
+    zx_status_t StartPager();
+    void StopPager();
+    int PagerThread();
+
+    // Creates a VMO whose pages are supplied by |blob|, of |size| bytes.
+    zx_status_t CreatePagedVmo(VnodeBlob* blob, uint64_t size, zx_handle_t* out);
+
     // VnodeBlobs exist in the WAVLTree as long as one or more reference exists;
     // when the Vnode is deleted, it is immediately removed from the WAVL tree.
     using WAVLTreeByMerkle = fbl::WAVLTree<const uint8_t*,
@@ -295,8 +373,42 @@ private:
     vmoid_t block_map_vmoid_{};
     fbl::unique_ptr<MappedVmo> node_map_{};
     vmoid_t node_map_vmoid_{};
+
+    // Open-addressed (linear probing) table of node map indices, keyed by the
+    // merkle root of the referenced node. Holds every allocated node, whether
+    // or not it is currently open, so that a cold lookup does not need to
+    // scan the node map. The table is kept at most half full.
+    static constexpr uint32_t kNodeIndexEmpty = fbl::numeric_limits<uint32_t>::max();
+    fbl::unique_ptr<uint32_t[]> node_index_{};
+    size_t node_index_mask_{};
     fbl::unique_ptr<MappedVmo> info_vmo_{};
     vmoid_t info_vmoid_{};
+
+    // Page requests for the VMOs handed out by VnodeBlob::CopyVmo arrive on
+    // pager_port_, keyed by VnodeBlob::GetPagerKey(), and are served by
+    // pager_thread_.
+    struct PagerKeyTraits {
+        static uint64_t GetKey(const VnodeBlob& obj) { return obj.GetPagerKey(); }
+        static bool LessThan(uint64_t k1, uint64_t k2) { return k1 < k2; }
+        static bool EqualTo(uint64_t k1, uint64_t k2) { return k1 == k2; }
+    };
+    using WAVLTreeByPagerKey = fbl::WAVLTree<uint64_t, VnodeBlob*, PagerKeyTraits,
+                                             VnodeBlob::PagerWavlTraits>;
+    zx_handle_t pager_ = ZX_HANDLE_INVALID;
+    zx_handle_t pager_port_ = ZX_HANDLE_INVALID;
+    thrd_t pager_thread_{};
+    txnid_t pager_txnid_{};
+    uint64_t next_pager_key_{};
+    fbl::Mutex pager_lock_{};
+    WAVLTreeByPagerKey paged_blobs_ __TA_GUARDED(pager_lock_){};
+
+    // Paged VMOs of released vnodes whose pages could not all be supplied,
+    // kept so that the pager thread can fail the remaining requests.
+    struct OrphanedVmo {
+        uint64_t key;
+        zx_handle_t vmo;
+    };
+    fbl::Vector<OrphanedVmo> orphaned_vmos_ __TA_GUARDED(pager_lock_){};
 };
 
 #endif
@@ -10,13 +10,17 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <inttypes.h>
+
 #include <digest/digest.h>
 #include <digest/merkle-tree.h>
 #include <fs/block-txn.h>
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
 #include <fdio/debug.h>
 #include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
 #include <fbl/limits.h>
 #include <fbl/ref_ptr.h>
 
@@ -112,7 +116,7 @@ blobstore_inode_t* Blobstore::GetNode(size_t index) const {
     return &reinterpret_cast<blobstore_inode_t*>(node_map_->GetData())[index];
 }
 
-zx_status_t VnodeBlob::InitVmos() {
+zx_status_t VnodeBlob::CreateBlobVmo() {
     if (blob_ != nullptr) {
         return ZX_OK;
     }
@@ -131,11 +135,133 @@ zx_status_t VnodeBlob::InitVmos() {
         BlobCloseHandles();
         return status;
     }
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::InitVmos() {
+    if (blob_loaded_) {
+        return ZX_OK;
+    }
+
+    zx_status_t status;
+    if ((status = CreateBlobVmo()) != ZX_OK) {
+        return status;
+    }
 
+    blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
     ReadTxn txn(blobstore_.get());
     txn.Enqueue(vmoid_, 0, inode->start_block + DataStartBlock(blobstore_->info_),
                 BlobDataBlocks(*inode) + MerkleTreeBlocks(*inode));
-    return txn.Flush();
+    if ((status = txn.Flush()) != ZX_OK) {
+        return status;
+    }
+    fbl::AutoLock lock(&blobstore_->pager_lock_);
+    blob_loaded_ = true;
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::InitPagedVmo() {
+    if (paged_vmo_ != ZX_HANDLE_INVALID) {
+        return ZX_OK;
+    }
+
+    zx_status_t status;
+    if ((status = CreateBlobVmo()) != ZX_OK) {
+        return status;
+    }
+
+    // Only the Merkle tree is needed up front; the data is read as the
+    // pages of the paged VMO are touched.
+    blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    if (!blob_loaded_) {
+        ReadTxn txn(blobstore_.get());
+        txn.Enqueue(vmoid_, 0, inode->start_block + DataStartBlock(blobstore_->info_),
+                    MerkleTreeBlocks(*inode));
+        if ((status = txn.Flush()) != ZX_OK) {
+            return status;
+        }
+    }
+
+    paged_blob_size_ = inode->blob_size;
+    paged_start_block_ = inode->start_block + DataStartBlock(blobstore_->info_);
+    paged_merkle_blocks_ = MerkleTreeBlocks(*inode);
+    return blobstore_->CreatePagedVmo(this, fbl::round_up(inode->blob_size, static_cast<uint64_t>(PAGE_SIZE)),
+                                      &paged_vmo_);
+}
+
+zx_status_t VnodeBlob::SupplyPages(uint64_t offset, uint64_t length) {
+    static_assert(MerkleTree::kNodeSize == kBlobstoreBlockSize,
+                  "Pages are verified one block at a time");
+    const uint64_t data_end = fbl::round_up(paged_blob_size_, kBlobstoreBlockSize);
+    const uint64_t start = fbl::round_down(offset, kBlobstoreBlockSize);
+    const uint64_t end = fbl::min(fbl::round_up(offset + length, kBlobstoreBlockSize),
+                                  data_end);
+    if (start >= end) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    if (blob_ == nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    zx_status_t status;
+    const uint64_t start_block = paged_merkle_blocks_ + start / kBlobstoreBlockSize;
+    if (!blob_loaded_) {
+        Blobstore::PagerTxnHandler handler(blobstore_.get());
+        fs::ReadTxn<kBlobstoreBlockSize, Blobstore::PagerTxnHandler> txn(&handler);
+        txn.Enqueue(vmoid_, start_block, paged_start_block_ + start_block,
+                    (end - start) / kBlobstoreBlockSize);
+        if ((status = txn.Flush()) != ZX_OK) {
+            return status;
+        }
+    }
+
+    Digest d;
+    d = ((const uint8_t*)&digest_[0]);
+    const void* data = fs::GetBlock<kBlobstoreBlockSize>(blob_->GetData(), paged_merkle_blocks_);
+    status = MerkleTree::Verify(data, paged_blob_size_, blob_->GetData(),
+                                MerkleTree::GetTreeLength(paged_blob_size_), start,
+                                fbl::min(end, paged_blob_size_) - start, d);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    const uint64_t supply_end = fbl::min(end, fbl::round_up(paged_blob_size_, static_cast<uint64_t>(PAGE_SIZE)));
+    return zx_pager_supply_pages(blobstore_->pager_, paged_vmo_, start, supply_end - start,
+                                 blob_->GetVmo(), start_block * kBlobstoreBlockSize);
+}
+
+void VnodeBlob::ReleasePagedVmo() {
+    if (paged_vmo_ == ZX_HANDLE_INVALID) {
+        return;
+    }
+
+    // Clients may still hold the paged VMO, but nothing will be left to
+    // serve its requests, so supply whatever has not been faulted in yet.
+    zx_status_t status = InitVmos();
+    fbl::AutoLock lock(&blobstore_->pager_lock_);
+    blobstore_->paged_blobs_.erase(*this);
+    if (status == ZX_OK) {
+        status = SupplyPages(0, paged_blob_size_);
+    }
+    if (status != ZX_OK) {
+        // Supply the nodes that do verify, and hand the VMO to the pager
+        // thread, which fails the requests for the rest.
+        FS_TRACE_ERROR("blobstore: Failed to supply released blob: %d\n", status);
+        if (blob_loaded_) {
+            for (uint64_t off = 0; off < paged_blob_size_; off += kBlobstoreBlockSize) {
+                SupplyPages(off, kBlobstoreBlockSize);
+            }
+        }
+        fbl::AllocChecker ac;
+        blobstore_->orphaned_vmos_.push_back({pager_key_, paged_vmo_}, &ac);
+        if (ac.check()) {
+            paged_vmo_ = ZX_HANDLE_INVALID;
+            return;
+        }
+    }
+    zx_handle_close(paged_vmo_);
+    paged_vmo_ = ZX_HANDLE_INVALID;
 }
 
 uint64_t VnodeBlob::SizeData() const {
@@ -158,7 +284,11 @@ VnodeBlob::VnodeBlob(fbl::RefPtr<Blobstore> bs)
       flags_(kBlobStateEmpty | kBlobFlagDirectory) {}
 
 void VnodeBlob::BlobCloseHandles() {
-    blob_ = nullptr;
+    {
+        fbl::AutoLock lock(&blobstore_->pager_lock_);
+        blob_ = nullptr;
+        blob_loaded_ = false;
+    }
     readable_event_.reset();
 }
 
@@ -186,6 +316,8 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
     if ((status = MappedVmo::Create(inode->num_blocks * kBlobstoreBlockSize, "blob", &blob_)) != ZX_OK) {
         goto fail;
     }
+    // Everything read from this blob will have been written into blob_.
+    blob_loaded_ = true;
     if ((status = blobstore_->AttachVmo(blob_->GetVmo(), &vmoid_)) != ZX_OK) {
         goto fail;
     }
@@ -249,7 +381,8 @@ zx_status_t VnodeBlob::WriteMetadata() {
     WriteTxn txn(blobstore_.get());
 
     // Write block allocation bitmap
-    if (blobstore_->WriteBitmap(&txn, inode->num_blocks, inode->start_block) != ZX_OK) {
+    blobstore_->WriteBitmap(&txn, inode->num_blocks, inode->start_block);
+    if (txn.Flush() != ZX_OK) {
         return ZX_ERR_IO;
     }
 
@@ -258,13 +391,14 @@ zx_status_t VnodeBlob::WriteMetadata() {
 
     // Update the on-disk hash
     memcpy(inode->merkle_root_hash, &digest_[0], Digest::kLength);
+    blobstore_->NodeIndexInsert(map_index_);
 
-    // Write back the blob node
-    if (blobstore_->WriteNode(&txn, map_index_)) {
+    // Write back the blob node, along with the updated counts
+    blobstore_->WriteNode(&txn, map_index_);
+    blobstore_->CountUpdate(&txn);
+    if (txn.Flush() != ZX_OK) {
         return ZX_ERR_IO;
     }
-
-    blobstore_->CountUpdate(&txn);
     flags_ &= ~kBlobFlagSync;
     return ZX_OK;
 }
@@ -358,41 +492,14 @@ zx_status_t VnodeBlob::CopyVmo(zx_rights_t rights, zx_handle_t* out) {
     if (GetState() != kBlobStateReadable) {
         return ZX_ERR_BAD_STATE;
     }
-    zx_status_t status = InitVmos();
+    zx_status_t status = InitPagedVmo();
     if (status != ZX_OK) {
         return status;
     }
 
-    // TODO(smklein): We could lazily verify more of the VMO if
-    // we could fault in pages on-demand.
-    //
-    // For now, we aggressively verify the entire VMO up front.
-    Digest d;
-    d = ((const uint8_t*)&digest_[0]);
-    auto inode = blobstore_->GetNode(map_index_);
-    uint64_t size_merkle = MerkleTree::GetTreeLength(inode->blob_size);
-    const void* merkle_data = GetMerkle();
-    const void* blob_data = GetData();
-    status = MerkleTree::Verify(blob_data, inode->blob_size, merkle_data,
-                                size_merkle, 0, inode->blob_size, d);
-    if (status != ZX_OK) {
-        return status;
-    }
-
-    // TODO(smklein): Only clone / verify the part of the vmo that
-    // was requested.
-    const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
-    zx_handle_t clone;
-    if ((status = zx_vmo_clone(blob_->GetVmo(), ZX_VMO_CLONE_COPY_ON_WRITE,
-                               data_start, inode->blob_size, &clone)) != ZX_OK) {
-        return status;
-    }
-
-    if ((status = zx_handle_replace(clone, rights, out)) != ZX_OK) {
-        zx_handle_close(clone);
-        return status;
-    }
-    return ZX_OK;
+    // Every client shares the paged VMO; none of them may write to it.
+    // Its pages are read and verified as they are faulted in.
+    return zx_handle_duplicate(paged_vmo_, rights & ~ZX_RIGHT_WRITE, out);
 }
 
 zx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t* actual) {
@@ -492,10 +599,106 @@ zx_status_t Blobstore::AllocateNode(size_t* node_index_out) {
 
 // Frees a node IN MEMORY
 void Blobstore::FreeNode(size_t node_index) {
+    NodeIndexRemove(node_index);
     memset(GetNode(node_index), 0, sizeof(blobstore_inode_t));
     info_.alloc_inode_count--;
 }
 
+zx_status_t Blobstore::ResetNodeIndex(uint64_t inode_count) {
+    size_t slots = 16;
+    while (slots < inode_count * 2) {
+        slots *= 2;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint32_t[]> table(new (&ac) uint32_t[slots]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < slots; i++) {
+        table[i] = kNodeIndexEmpty;
+    }
+
+    fbl::unique_ptr<uint32_t[]> old_table = fbl::move(node_index_);
+    size_t old_slots = old_table ? node_index_mask_ + 1 : 0;
+    node_index_ = fbl::move(table);
+    node_index_mask_ = slots - 1;
+
+    if (old_table) {
+        // Rehash from the old table rather than the node map: nodes which are
+        // still being written have been allocated, but have no merkle root yet.
+        for (size_t i = 0; i < old_slots; i++) {
+            if (old_table[i] != kNodeIndexEmpty) {
+                NodeIndexInsert(old_table[i]);
+            }
+        }
+    } else {
+        for (size_t i = 0; i < info_.inode_count; i++) {
+            if (GetNode(i)->start_block >= kStartBlockMinimum) {
+                NodeIndexInsert(i);
+            }
+        }
+    }
+    return ZX_OK;
+}
+
+size_t Blobstore::NodeIndexSlot(const uint8_t* merkle_root_hash) const {
+    // The merkle root is a cryptographic digest; any of its bits are
+    // uniformly distributed, so the leading bytes make a fine hash.
+    uint64_t hash;
+    memcpy(&hash, merkle_root_hash, sizeof(hash));
+    return static_cast<size_t>(hash) & node_index_mask_;
+}
+
+void Blobstore::NodeIndexInsert(size_t node_index) {
+    ZX_DEBUG_ASSERT(node_index < kNodeIndexEmpty);
+    size_t slot = NodeIndexSlot(GetNode(node_index)->merkle_root_hash);
+    while (node_index_[slot] != kNodeIndexEmpty) {
+        slot = (slot + 1) & node_index_mask_;
+    }
+    node_index_[slot] = static_cast<uint32_t>(node_index);
+}
+
+void Blobstore::NodeIndexRemove(size_t node_index) {
+    size_t slot = NodeIndexSlot(GetNode(node_index)->merkle_root_hash);
+    while (node_index_[slot] != node_index) {
+        if (node_index_[slot] == kNodeIndexEmpty) {
+            // Nodes which never had their merkle root committed are not
+            // indexed.
+            return;
+        }
+        slot = (slot + 1) & node_index_mask_;
+    }
+
+    // Shift later entries of the probe sequence back into the hole, so
+    // lookups never need to skip over tombstones.
+    size_t hole = slot;
+    size_t next = (slot + 1) & node_index_mask_;
+    while (node_index_[next] != kNodeIndexEmpty) {
+        size_t home = NodeIndexSlot(GetNode(node_index_[next])->merkle_root_hash);
+        if (((next - home) & node_index_mask_) >= ((next - hole) & node_index_mask_)) {
+            node_index_[hole] = node_index_[next];
+            hole = next;
+        }
+        next = (next + 1) & node_index_mask_;
+    }
+    node_index_[hole] = kNodeIndexEmpty;
+}
+
+zx_status_t Blobstore::NodeIndexFind(const Digest& digest, size_t* node_index_out) const {
+    size_t slot = NodeIndexSlot(digest.AcquireBytes());
+    digest.ReleaseBytes();
+    for (uint32_t i = node_index_[slot]; i != kNodeIndexEmpty; i = node_index_[slot]) {
+        if (GetNode(i)->start_block >= kStartBlockMinimum &&
+            digest == GetNode(i)->merkle_root_hash) {
+            *node_index_out = i;
+            return ZX_OK;
+        }
+        slot = (slot + 1) & node_index_mask_;
+    }
+    return ZX_ERR_NOT_FOUND;
+}
+
 zx_status_t Blobstore::Unmount() {
     // Explicitly delete this (rather than just letting the memory release when
     // the process exits) to ensure that the block device's fifo has been
@@ -515,13 +718,13 @@ zx_status_t Blobstore::WriteBitmap(WriteTxn* txn, uint64_t nblocks, uint64_t sta
     // Write back the block allocation bitmap
     txn->Enqueue(block_map_vmoid_, bbm_start_block, BlockMapStartBlock(info_) + bbm_start_block,
                  bbm_end_block - bbm_start_block);
-    return txn->Flush();
+    return ZX_OK;
 }
 
 zx_status_t Blobstore::WriteNode(WriteTxn* txn, size_t map_index) {
     uint64_t b = (map_index * sizeof(blobstore_inode_t)) / kBlobstoreBlockSize;
     txn->Enqueue(node_map_vmoid_, b, NodeMapStartBlock(info_) + b, 1);
-    return txn->Flush();
+    return ZX_OK;
 }
 
 zx_status_t Blobstore::NewBlob(const Digest& digest, fbl::RefPtr<VnodeBlob>* out) {
@@ -572,6 +775,8 @@ zx_status_t Blobstore::ReleaseBlob(VnodeBlob* vn) {
         FreeBlocks(nblocks, start_block);
         WriteTxn txn(this);
         WriteNode(&txn, node_index);
+        // The node must be gone before its blocks are marked free.
+        txn.Barrier();
         WriteBitmap(&txn, nblocks, start_block);
         CountUpdate(&txn);
         hash_.erase(*vn);
@@ -636,27 +841,24 @@ zx_status_t Blobstore::LookupBlob(const Digest& digest, fbl::RefPtr<VnodeBlob>*
         return ZX_OK;
     }
 
-    // Look up blob in the slow map
-    for (size_t i = 0; i < info_.inode_count; ++i) {
-        if (GetNode(i)->start_block >= kStartBlockMinimum) {
-            if (digest == GetNode(i)->merkle_root_hash) {
-                if (out != nullptr) {
-                    // Found it. Attempt to wrap the blob in a vnode.
-                    fbl::AllocChecker ac;
-                    fbl::RefPtr<VnodeBlob> vn =
-                        fbl::AdoptRef(new (&ac) VnodeBlob(fbl::RefPtr<Blobstore>(this), digest));
-                    if (!ac.check()) {
-                        return ZX_ERR_NO_MEMORY;
-                    }
-                    vn->SetState(kBlobStateReadable);
-                    vn->SetMapIndex(i);
-                    // Delay reading any data from disk until read.
-                    hash_.insert(vn.get());
-                    *out = fbl::move(vn);
-                }
-                return ZX_OK;
+    // Look up blob in the node index
+    size_t i;
+    if (NodeIndexFind(digest, &i) == ZX_OK) {
+        if (out != nullptr) {
+            // Found it. Attempt to wrap the blob in a vnode.
+            fbl::AllocChecker ac;
+            fbl::RefPtr<VnodeBlob> vn =
+                fbl::AdoptRef(new (&ac) VnodeBlob(fbl::RefPtr<Blobstore>(this), digest));
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
             }
+            vn->SetState(kBlobStateReadable);
+            vn->SetMapIndex(i);
+            // Delay reading any data from disk until read.
+            hash_.insert(vn.get());
+            *out = fbl::move(vn);
         }
+        return ZX_OK;
     }
     return ZX_ERR_NOT_FOUND;
 }
@@ -700,6 +902,9 @@ zx_status_t Blobstore::AddInodes() {
                            / kBlobstoreInodesPerBlock;
     ZX_DEBUG_ASSERT(inoblks_old <= inoblks);
 
+    if (ResetNodeIndex(inodes) != ZX_OK) {
+        return ZX_ERR_NO_MEMORY;
+    }
     if (node_map_->Grow(inoblks * kBlobstoreBlockSize) != ZX_OK) {
         return ZX_ERR_NO_SPACE;
     }
@@ -779,6 +984,7 @@ Blobstore::Blobstore(int fd, const blobstore_info_t* info)
 }
 
 Blobstore::~Blobstore() {
+    StopPager();
     if (fifo_client_ != nullptr) {
         ioctl_block_free_txn(blockfd_, &txnid_);
         ioctl_block_fifo_close(blockfd_);
@@ -787,6 +993,131 @@ Blobstore::~Blobstore() {
     close(blockfd_);
 }
 
+zx_status_t Blobstore::StartPager() {
+    if (pager_ != ZX_HANDLE_INVALID) {
+        return ZX_OK;
+    }
+
+    zx_status_t status;
+    ssize_t r;
+    if ((r = ioctl_block_alloc_txn(blockfd_, &pager_txnid_)) < 0) {
+        return static_cast<zx_status_t>(r);
+    }
+    if ((status = zx_port_create(0, &pager_port_)) != ZX_OK) {
+        goto fail;
+    }
+    if ((status = zx_pager_create(0, &pager_)) != ZX_OK) {
+        goto fail;
+    }
+    if (thrd_create_with_name(&pager_thread_, [](void* arg) {
+            return static_cast<Blobstore*>(arg)->PagerThread();
+        }, this, "blobstore-pager") != thrd_success) {
+        status = ZX_ERR_NO_RESOURCES;
+        goto fail;
+    }
+    return ZX_OK;
+
+fail:
+    zx_handle_close(pager_);
+    zx_handle_close(pager_port_);
+    pager_ = ZX_HANDLE_INVALID;
+    pager_port_ = ZX_HANDLE_INVALID;
+    ioctl_block_free_txn(blockfd_, &pager_txnid_);
+    return status;
+}
+
+void Blobstore::StopPager() {
+    if (pager_ == ZX_HANDLE_INVALID) {
+        return;
+    }
+
+    zx_port_packet_t packet = {};
+    packet.type = ZX_PKT_TYPE_USER;
+    zx_status_t status = zx_port_queue(pager_port_, &packet, 0);
+    ZX_ASSERT(status == ZX_OK);
+    thrd_join(pager_thread_, nullptr);
+
+    {
+        fbl::AutoLock lock(&pager_lock_);
+        for (const auto& orphan : orphaned_vmos_) {
+            zx_handle_close(orphan.vmo);
+        }
+        orphaned_vmos_.reset();
+    }
+
+    // Closing the pager fails any requests left outstanding.
+    zx_handle_close(pager_);
+    zx_handle_close(pager_port_);
+    pager_ = ZX_HANDLE_INVALID;
+    pager_port_ = ZX_HANDLE_INVALID;
+    ioctl_block_free_txn(blockfd_, &pager_txnid_);
+}
+
+int Blobstore::PagerThread() {
+    for (;;) {
+        zx_port_packet_t packet;
+        zx_status_t status = zx_port_wait(pager_port_, ZX_TIME_INFINITE, &packet, 0);
+        if (status != ZX_OK) {
+            FS_TRACE_ERROR("blobstore: Pager port wait failed: %d\n", status);
+            return -1;
+        } else if (packet.type == ZX_PKT_TYPE_USER) {
+            // Queued by StopPager().
+            return 0;
+        } else if (packet.type != ZX_PKT_TYPE_PAGE_REQUEST) {
+            continue;
+        }
+
+        fbl::AutoLock lock(&pager_lock_);
+        zx_handle_t vmo = ZX_HANDLE_INVALID;
+        auto blob = paged_blobs_.find(packet.key);
+        if (blob.IsValid()) {
+            status = blob->SupplyPages(packet.page_request.offset, packet.page_request.length);
+            if (status == ZX_OK) {
+                continue;
+            }
+            vmo = blob->paged_vmo_;
+        } else {
+            // The vnode was released, supplying all of its pages that
+            // verified; requests for the rest are failed.
+            for (const auto& orphan : orphaned_vmos_) {
+                if (orphan.key == packet.key) {
+                    vmo = orphan.vmo;
+                    break;
+                }
+            }
+            if (vmo == ZX_HANDLE_INVALID) {
+                continue;
+            }
+            status = ZX_ERR_IO_DATA_INTEGRITY;
+        }
+
+        // Fail the request rather than leave the faulting threads blocked.
+        FS_TRACE_ERROR("blobstore: Failed to supply pages [%" PRIu64 ", +%" PRIu64 "): %d\n",
+                       packet.page_request.offset, packet.page_request.length, status);
+        if (status != ZX_ERR_IO_DATA_INTEGRITY) {
+            status = ZX_ERR_IO;
+        }
+        zx_pager_fail_pages(pager_, vmo, packet.page_request.offset,
+                            packet.page_request.length, status);
+    }
+}
+
+zx_status_t Blobstore::CreatePagedVmo(VnodeBlob* blob, uint64_t size, zx_handle_t* out) {
+    zx_status_t status;
+    if ((status = StartPager()) != ZX_OK) {
+        return status;
+    }
+
+    fbl::AutoLock lock(&pager_lock_);
+    blob->pager_key_ = next_pager_key_++;
+    if ((status = zx_pager_create_vmo(pager_, pager_port_, blob->pager_key_, size, 0,
+                                      out)) != ZX_OK) {
+        return status;
+    }
+    paged_blobs_.insert(blob);
+    return ZX_OK;
+}
+
 zx_status_t Blobstore::Create(int fd, const blobstore_info_t* info, fbl::RefPtr<Blobstore>* out) {
     zx_status_t status = blobstore_check_info(info, TotalBlocks(*info));
     if (status < 0) {
@@ -836,6 +1167,9 @@ zx_status_t Blobstore::Create(int fd, const blobstore_info_t* info, fbl::RefPtr<
     } else if ((status = fs->LoadBitmaps()) < 0) {
         fprintf(stderr, "blobstore: Failed to load bitmaps: %d\n", status);
         return status;
+    } else if ((status = fs->ResetNodeIndex(fs->info_.inode_count)) != ZX_OK) {
+        fprintf(stderr, "blobstore: Failed to build node index: %d\n", status);
+        return status;
     } else if ((status = MappedVmo::Create(kBlobstoreBlockSize, "blobstore-superblock",
                                            &fs->info_vmo_)) != ZX_OK) {
         fprintf(stderr, "blobstore: Failed to create info vmo: %d\n", status);
@@ -6,11 +6,14 @@
 #include <errno.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <zircon/compiler.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <fbl/algorithm.h>
 #include <fbl/unique_ptr.h>
@@ -112,6 +115,82 @@ void do_test(uint32_t duration, const TestArgs& test_args) {
            test_args.size, test_args.handles, test_args.queue, its_per_second);
 }
 
+// Measures how fast |transfer_size| bytes can be moved through a channel.
+// Transfers larger than ZX_CHANNEL_MAX_MSG_BYTES are split into messages of
+// at most that size, each of which is read before the next is written.
+// Messages are read into a VMO mapping, at a page-aligned address if
+// |aligned| (so the kernel may move whole pages rather than copy them) and
+// just past one otherwise.
+void do_bandwidth_test(uint32_t duration, uint32_t transfer_size, bool aligned) {
+    __UNUSED zx_status_t status;
+
+    uint64_t duration_ns = duration * 1000000000ull;
+
+    zx_handle_t mp[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+    status = zx_channel_create(0u, &mp[0], &mp[1]);
+    assert(status == ZX_OK);
+
+    fbl::unique_ptr<uint8_t[]> src(new uint8_t[transfer_size]);
+    for (uint32_t i = 0; i < transfer_size; i++)
+        src[i] = static_cast<uint8_t>(i);
+
+    const size_t dst_map_size = fbl::round_up(transfer_size, static_cast<uint32_t>(PAGE_SIZE)) +
+                                PAGE_SIZE;
+    zx_handle_t dst_vmo;
+    status = zx_vmo_create(dst_map_size, 0u, &dst_vmo);
+    assert(status == ZX_OK);
+    uintptr_t dst_addr;
+    status = zx_vmar_map(zx_vmar_root_self(), 0u, dst_vmo, 0u, dst_map_size,
+                         ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &dst_addr);
+    assert(status == ZX_OK);
+    uint8_t* dst = reinterpret_cast<uint8_t*>(dst_addr) + (aligned ? 0u : 16u);
+    memset(dst, 0, transfer_size);
+
+    static constexpr uint32_t big_it_size = 16;
+    uint64_t transfers = 0;
+    uint64_t start_ns = zx_time_get(ZX_CLOCK_MONOTONIC);
+    uint64_t end_ns;
+    for (;;) {
+        for (uint32_t i = 0; i < big_it_size; i++) {
+            for (uint32_t offset = 0; offset < transfer_size;) {
+                uint32_t size = fbl::min(transfer_size - offset,
+                                         static_cast<uint32_t>(ZX_CHANNEL_MAX_MSG_BYTES));
+                status = zx_channel_write(mp[0], 0u, src.get() + offset, size, nullptr, 0u);
+                assert(status == ZX_OK);
+
+                uint32_t r_size = size;
+                uint32_t r_handles = 0u;
+                status = zx_channel_read(mp[1], 0u, dst + offset, nullptr, r_size, 0u,
+                                         &r_size, &r_handles);
+                assert(status == ZX_OK);
+                assert(r_size == size);
+                offset += size;
+            }
+        }
+        transfers += big_it_size;
+
+        end_ns = zx_time_get(ZX_CLOCK_MONOTONIC);
+        if ((end_ns - start_ns) >= duration_ns)
+            break;
+    }
+
+    status = zx_handle_close(mp[0]);
+    assert(status == ZX_OK);
+    status = zx_handle_close(mp[1]);
+    assert(status == ZX_OK);
+    status = zx_vmar_unmap(zx_vmar_root_self(), dst_addr, dst_map_size);
+    assert(status == ZX_OK);
+    status = zx_handle_close(dst_vmo);
+    assert(status == ZX_OK);
+
+    double real_duration = static_cast<double>(end_ns - start_ns) / 1000000000.0;
+    double bytes_per_second = static_cast<double>(transfers) * transfer_size / real_duration;
+    printf("write/read %" PRIu32 " bytes in messages of at most %" PRIu32 " bytes, "
+               "%s receive buffer: %.1f MB/second\n",
+           transfer_size, static_cast<uint32_t>(ZX_CHANNEL_MAX_MSG_BYTES),
+           aligned ? "page-aligned" : "unaligned", bytes_per_second / (1024.0 * 1024.0));
+}
+
 }  // namespace
 
 int main(int argc, char** argv) {
@@ -122,6 +201,7 @@ int main(int argc, char** argv) {
         "  -h    show help (this)\n"
         "  -o    run single test (default)\n"
         "  -s    run suite (ignores -S/-H/-Q)\n"
+        "  -b    run bandwidth suite, 4KB to 1MB transfers (ignores -S/-H/-Q)\n"
         "  -n N  set test repetition count to N (default: 1)\n"
         "  -d N  set test duration to N seconds (default: 5)\n"
         "  -S N  set message size to N bytes (default: 10)\n"
@@ -129,6 +209,7 @@ int main(int argc, char** argv) {
         "  -Q N  set message pre-queue count to N messages (default: 0)\n";
 
     bool run_suite = false;  // -o/-s
+    bool run_bandwidth_suite = false;  // -b
     uint32_t duration = 5;   // -d
     uint32_t repeats = 1;    // -n
     // Ignored when running a suite:
@@ -139,7 +220,7 @@ int main(int argc, char** argv) {
     };
 
     int opt;
-    while ((opt = getopt(argc, argv, "+hosn:d:S:H:Q:")) != -1) {
+    while ((opt = getopt(argc, argv, "+hosbn:d:S:H:Q:")) != -1) {
         // Our option values are always unsigned numbers.
         uint32_t value = 0;
         if (optarg) {
@@ -157,10 +238,14 @@ int main(int argc, char** argv) {
                 return EXIT_SUCCESS;
             case 'o':
                 run_suite = false;
+                run_bandwidth_suite = false;
                 break;
             case 's':
                 run_suite = true;
                 break;
+            case 'b':
+                run_bandwidth_suite = true;
+                break;
             case 'n':
                 assert(optarg);
                 repeats = value;
@@ -197,7 +282,12 @@ int main(int argc, char** argv) {
                    repeats);
         }
 
-        if (run_suite) {
+        if (run_bandwidth_suite) {
+            for (uint32_t size = 4096u; size <= 1024u * 1024u; size *= 2u) {
+                do_bandwidth_test(duration, size, false);
+                do_bandwidth_test(duration, size, true);
+            }
+        } else if (run_suite) {
             static constexpr TestArgs suite[] = {
                 {10, 0, 0},
                 {100, 0, 0},
@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <fbl/algorithm.h>
+
 #include "fvm/format.h"
 
 static constexpr char kMinfsName[] = "minfs";
@@ -83,6 +85,15 @@ zx_status_t MinfsFormat::MakeFvmReady(size_t slice_size, uint32_t vpart_index) {
     fvm_info_.block_count = static_cast<uint32_t>(fvm_info_.dat_slices * fvm_info_.slice_size /
                                                   minfs::kMinfsBlockSize);
 
+    // Only the superblock is copied into the first slice; the journal in the
+    // remainder of that slice starts out empty.
+    fvm_info_.jnl_block = minfs::kFVMBlockJournalStart;
+    fvm_info_.jnl_blocks = fbl::min(minfs::kMinfsJournalBlocks,
+                                    static_cast<uint32_t>(kBlocksPerSlice) -
+                                    minfs::kFVMBlockJournalStart);
+    if (fvm_info_.jnl_blocks < 2) {
+        fvm_info_.jnl_blocks = 0;
+    }
     fvm_info_.ibm_block = minfs::kFVMBlockInodeBmStart;
     fvm_info_.abm_block = minfs::kFVMBlockDataBmStart;
     fvm_info_.ino_block = minfs::kFVMBlockInodeStart;
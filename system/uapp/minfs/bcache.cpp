@@ -8,6 +8,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <fs/block-txn.h>
 #include <fs/trace.h>
 
 #include <fbl/alloc_checker.h>
@@ -15,12 +16,47 @@
 #include <fbl/unique_ptr.h>
 #include <zircon/device/device.h>
 
+#ifdef __Fuchsia__
+#include <async/task.h>
+#include <zircon/syscalls.h>
+#endif
+
 #include <minfs/minfs.h>
 #include "minfs-private.h"
 
 namespace minfs {
 
+#ifdef __Fuchsia__
+// Writes delayed by the writeback window, and the task which flushes them.
+struct Bcache::Writeback {
+    // Sends transactions straight to the block device, bypassing the window.
+    struct Device {
+        Bcache* bc;
+
+        txnid_t TxnId() const { return bc->TxnId(); }
+        zx_status_t Txn(block_fifo_request_t* requests, size_t count) {
+            return block_fifo_txn(bc->fifo_client_, requests, count);
+        }
+    };
+
+    explicit Writeback(Bcache* bc) : device{bc}, queue(&device) {}
+
+    Device device;
+    fs::WritebackQueue<Device> queue;
+    async::Task task;
+    async_t* async = nullptr;
+    zx_duration_t window = 0;
+    bool pending = false;
+    bool posted = false;
+    // First error from a flush which had nobody to report to.
+    zx_status_t status = ZX_OK;
+};
+#endif
+
 zx_status_t Bcache::Readblk(blk_t bno, void* data) {
+#ifdef __Fuchsia__
+    FlushWriteback();
+#endif
     off_t off = static_cast<off_t>(bno) * kMinfsBlockSize;
     assert(off / kMinfsBlockSize == bno); // Overflow
     FS_TRACE(IO, "readblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
@@ -39,6 +75,9 @@ zx_status_t Bcache::Readblk(blk_t bno, void* data) {
 }
 
 zx_status_t Bcache::Writeblk(blk_t bno, const void* data) {
+#ifdef __Fuchsia__
+    FlushWriteback();
+#endif
     off_t off = static_cast<off_t>(bno) * kMinfsBlockSize;
     assert(off / kMinfsBlockSize == bno); // Overflow
     FS_TRACE(IO, "writeblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
@@ -57,6 +96,11 @@ zx_status_t Bcache::Writeblk(blk_t bno, const void* data) {
 }
 
 int Bcache::Sync() {
+#ifdef __Fuchsia__
+    if (FlushWriteback() != ZX_OK) {
+        return -1;
+    }
+#endif
     return fsync(fd_.get());
 }
 
@@ -92,6 +136,155 @@ ssize_t Bcache::GetDevicePath(char* out, size_t out_len) {
     return ioctl_device_get_topo_path(fd_.get(), out, out_len);
 }
 
+zx_status_t Bcache::Txn(block_fifo_request_t* requests, size_t count) {
+    if (writeback_ == nullptr || writeback_->window == 0) {
+        return block_fifo_txn(fifo_client_, requests, count);
+    }
+
+    bool writes_only = true;
+    for (size_t i = 0; i < count; i++) {
+        if ((requests[i].opcode & BLOCKIO_OP_MASK) != BLOCKIO_WRITE) {
+            writes_only = false;
+            break;
+        }
+    }
+
+    if (!writes_only) {
+        // Reads (and VMO detaches) must observe every write issued before them.
+        zx_status_t status = FlushWriteback();
+        if (status != ZX_OK) {
+            return status;
+        }
+        return block_fifo_txn(fifo_client_, requests, count);
+    }
+
+    if (journal_ != nullptr) {
+        // Keep the metadata written by one operation within one transaction.
+        size_t meta_blocks = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (journal_->IsMetadata(requests[i])) {
+                meta_blocks += requests[i].length / kMinfsBlockSize;
+            }
+        }
+        if ((meta_blocks > 0) && (journal_->pending() + meta_blocks > journal_->capacity())) {
+            zx_status_t status = FlushWriteback();
+            if (status != ZX_OK) {
+                return status;
+            }
+        }
+    }
+
+    // The data is read out of the VMOs when the window closes, so later
+    // writes to the same blocks are absorbed into a single request.
+    for (size_t i = 0; i < count; i++) {
+        if ((journal_ == nullptr) || !journal_->IsMetadata(requests[i])) {
+            if (journal_ != nullptr) {
+                // A freed metadata block may be reused for file data within
+                // one window; checkpointing its old contents afterwards
+                // would overwrite the data.
+                journal_->Revoke(static_cast<blk_t>(requests[i].dev_offset / kMinfsBlockSize),
+                                 static_cast<blk_t>(requests[i].length / kMinfsBlockSize));
+            }
+            writeback_->queue.Enqueue(&requests[i], 1);
+            continue;
+        }
+        uint64_t vmo_block = requests[i].vmo_offset / kMinfsBlockSize;
+        uint64_t dev_block = requests[i].dev_offset / kMinfsBlockSize;
+        for (uint64_t n = 0; n < requests[i].length / kMinfsBlockSize; n++) {
+            while (!journal_->Enqueue(requests[i].vmoid, vmo_block + n,
+                                      static_cast<blk_t>(dev_block + n))) {
+                // Larger than a whole transaction; this operation is not
+                // atomic.
+                zx_status_t status = FlushWriteback();
+                if (status != ZX_OK) {
+                    return status;
+                }
+            }
+        }
+    }
+    if (journal_ == nullptr) {
+        // Without a journal nothing makes an operation's writes atomic, so
+        // at least keep operations reaching the disk in the order they were
+        // made.
+        writeback_->queue.Barrier();
+    }
+    writeback_->pending = true;
+    if (!writeback_->posted) {
+        writeback_->task.set_deadline(zx_deadline_after(writeback_->window));
+        if (writeback_->task.Post(writeback_->async) == ZX_OK) {
+            writeback_->posted = true;
+        } else {
+            return FlushWriteback();
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t Bcache::SetWritebackWindow(async_t* async, zx_duration_t window) {
+    if (writeback_ == nullptr) {
+        fbl::AllocChecker ac;
+        writeback_.reset(new (&ac) Writeback(this));
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        writeback_->task.set_handler([this](async_t* async, zx_status_t status) {
+            writeback_->posted = false;
+            zx_status_t flush_status = FlushWriteback();
+            if (flush_status != ZX_OK) {
+                FS_TRACE_ERROR("minfs: delayed writeback failed: %d\n", flush_status);
+                if (writeback_->status == ZX_OK) {
+                    writeback_->status = flush_status;
+                }
+            }
+            return ASYNC_TASK_FINISHED;
+        });
+    }
+
+    zx_status_t status = FlushWriteback();
+    if (writeback_->posted) {
+        writeback_->task.Cancel(writeback_->async);
+        writeback_->posted = false;
+    }
+    writeback_->async = async;
+    writeback_->window = window;
+    return status;
+}
+
+zx_status_t Bcache::FlushWriteback() {
+    if (writeback_ == nullptr) {
+        return ZX_OK;
+    }
+    zx_status_t status = ZX_OK;
+    if (writeback_->pending) {
+        writeback_->pending = false;
+        // File data goes first, so that committed metadata never refers to
+        // blocks which were not written.
+        status = writeback_->queue.Flush();
+        if ((status == ZX_OK) && (journal_ != nullptr)) {
+            status = journal_->Commit();
+        }
+    }
+    if (status == ZX_OK) {
+        status = writeback_->status;
+    }
+    writeback_->status = ZX_OK;
+    return status;
+}
+
+zx_status_t Bcache::InitJournal(blk_t start, blk_t count, blk_t meta_end, uint64_t seq) {
+    zx_status_t status = FlushWriteback();
+    if (status != ZX_OK) {
+        return status;
+    }
+    return Journal::Create(this, fifo_client_, start, count, meta_end, seq, &journal_);
+}
+
+void Bcache::SetVmoJournaled(vmoid_t vmoid, bool journaled) {
+    if (journal_ != nullptr) {
+        journal_->SetVmoJournaled(vmoid, journaled);
+    }
+}
+
 zx_status_t Bcache::AttachVmo(zx_handle_t vmo, vmoid_t* out) {
     zx_handle_t xfer_vmo;
     zx_status_t status = zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &xfer_vmo);
@@ -112,6 +305,14 @@ Bcache::Bcache(fbl::unique_fd fd, uint32_t blockmax) :
 
 Bcache::~Bcache() {
 #ifdef __Fuchsia__
+    if (writeback_ != nullptr) {
+        FlushWriteback();
+        if (writeback_->posted) {
+            writeback_->task.Cancel(writeback_->async);
+        }
+        writeback_.reset();
+    }
+    journal_.reset();
     if (fifo_client_ != nullptr) {
         FreeTxnId();
         ioctl_block_fifo_close(fd_.get());
@@ -0,0 +1,136 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <fbl/alloc_checker.h>
+
+#include "minfs-private.h"
+
+namespace minfs {
+
+DirectoryIndex::~DirectoryIndex() {
+    // The name and free trees hold unmanaged pointers to records owned by
+    // 'records_'; they must be emptied first.
+    names_.clear();
+    free_.clear();
+}
+
+uint32_t DirectoryIndex::NameHash(fbl::StringPiece name) {
+    return fnv1a32(name.data(), name.length());
+}
+
+zx_status_t DirectoryIndex::Insert(minfs_dirent_t* de, size_t off) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Record> record(new (&ac) Record());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    record->off = static_cast<uint32_t>(off);
+    record->reclen = static_cast<uint32_t>(MinfsReclen(de, off));
+    record->in_use = (de->ino != 0);
+    uint32_t used = 0;
+    if (record->in_use) {
+        used = static_cast<uint32_t>(DirentSize(de->namelen));
+        record->hash = NameHash(fbl::StringPiece(de->name, de->namelen));
+    } else {
+        record->hash = 0;
+    }
+    record->free = record->reclen > used ? record->reclen - used : 0;
+
+    Record* r = record.get();
+    records_.insert(fbl::move(record));
+    if (r->in_use) {
+        names_.insert(r);
+    }
+    if (r->free > 0) {
+        free_.insert(r);
+    }
+    return ZX_OK;
+}
+
+void DirectoryIndex::Erase(size_t start, size_t end) {
+    auto iter = records_.lower_bound(static_cast<uint32_t>(start));
+    while (iter.IsValid() && iter->off < end) {
+        Record* r = &*iter;
+        ++iter;
+        if (r->in_use) {
+            names_.erase(*r);
+        }
+        if (r->free > 0) {
+            free_.erase(*r);
+        }
+        records_.erase(*r);
+    }
+}
+
+DirectoryIndex::Record* DirectoryIndex::Prev(Record* record) {
+    auto iter = records_.make_iterator(*record);
+    --iter;
+    return iter.IsValid() ? &*iter : nullptr;
+}
+
+DirectoryIndex::Record* DirectoryIndex::Next(Record* record) {
+    auto iter = records_.make_iterator(*record);
+    ++iter;
+    return iter.IsValid() ? &*iter : nullptr;
+}
+
+DirectoryIndex::Record* DirectoryIndex::FirstNamed(fbl::StringPiece name) {
+    uint32_t hash = NameHash(name);
+    auto iter = names_.lower_bound(static_cast<uint64_t>(hash) << 32);
+    if (!iter.IsValid() || iter->hash != hash) {
+        return nullptr;
+    }
+    return &*iter;
+}
+
+DirectoryIndex::Record* DirectoryIndex::NextNamed(Record* record) {
+    auto iter = names_.make_iterator(*record);
+    ++iter;
+    if (!iter.IsValid() || iter->hash != record->hash) {
+        return nullptr;
+    }
+    return &*iter;
+}
+
+DirectoryIndex::Record* DirectoryIndex::FindFree(uint32_t size) {
+    auto iter = free_.lower_bound(static_cast<uint64_t>(size) << 32);
+    return iter.IsValid() ? &*iter : nullptr;
+}
+
+size_t DirectoryIndex::CountDuplicateNames(VnodeMinfs* vn) {
+    // Reads the in-use dirent at 'off' into 'data'.
+    auto read_dirent = [vn](char* data, uint32_t off) -> minfs_dirent_t* {
+        minfs_dirent_t* de = reinterpret_cast<minfs_dirent_t*>(data);
+        size_t actual;
+        if ((vn->ReadInternal(data, kMinfsMaxDirentSize, off, &actual) != ZX_OK) ||
+            (actual < MINFS_DIRENT_SIZE) || (actual < DirentSize(de->namelen))) {
+            return nullptr;
+        }
+        return de;
+    };
+
+    size_t duplicates = 0;
+    for (auto iter = names_.begin(); iter.IsValid(); ++iter) {
+        char data_a[kMinfsMaxDirentSize];
+        minfs_dirent_t* de_a = nullptr;
+        for (Record* b = NextNamed(&*iter); b != nullptr; b = NextNamed(b)) {
+            char data_b[kMinfsMaxDirentSize];
+            minfs_dirent_t* de_b;
+            if ((de_a == nullptr) && ((de_a = read_dirent(data_a, iter->off)) == nullptr)) {
+                break;
+            } else if ((de_b = read_dirent(data_b, b->off)) == nullptr) {
+                continue;
+            }
+            if ((de_a->namelen == de_b->namelen) &&
+                !memcmp(de_a->name, de_b->name, de_a->namelen)) {
+                duplicates++;
+            }
+        }
+    }
+    return duplicates;
+}
+
+} // namespace minfs
@@ -26,6 +26,8 @@
 
 #ifdef __Fuchsia__
 #include <block-client/client.h>
+#include <fbl/unique_ptr.h>
+typedef struct async_dispatcher async_t;
 using RawBitmap = bitmap::RawBitmapGeneric<bitmap::VmoStorage>;
 #else
 #include <fbl/vector.h>
@@ -46,7 +48,7 @@ typedef uint32_t ino_t;
 
 constexpr uint64_t kMinfsMagic0         = (0x002153466e694d21ULL);
 constexpr uint64_t kMinfsMagic1         = (0x385000d3d3d3d304ULL);
-constexpr uint32_t kMinfsVersion        = 0x00000005;
+constexpr uint32_t kMinfsVersion        = 0x00000006;
 
 constexpr ino_t kMinfsRootIno           = 1;
 constexpr uint32_t kMinfsFlagClean      = 0x00000001; // Currently unused
@@ -81,6 +83,12 @@ constexpr size_t kFVMBlockDataBmStart  = 0x20000;
 constexpr size_t kFVMBlockInodeStart   = 0x30000;
 constexpr size_t kFVMBlockDataStart    = 0x40000;
 
+// The metadata journal is placed after the superblock: on FVM, in the rest of
+// the superblock's slice, and otherwise ahead of the inode bitmap.
+constexpr blk_t kFVMBlockJournalStart   = 1;
+constexpr blk_t kMinfsJournalStart      = 8;
+constexpr uint32_t kMinfsJournalBlocks  = 64;
+
 typedef struct {
     uint64_t magic0;
     uint64_t magic1;
@@ -103,6 +111,8 @@ typedef struct {
     uint32_t abm_slices;    // Slices allocated to block bitmap
     uint32_t ino_slices;    // Slices allocated to inode table
     uint32_t dat_slices;    // Slices allocated to file data section
+    blk_t jnl_block;     // first blockno of the metadata journal
+    uint32_t jnl_blocks;    // size of the journal; zero if there is none
 } minfs_info_t;
 
 // Notes:
@@ -118,6 +128,26 @@ typedef struct {
 //     ino_block + ino / kMinfsInodesPerBlock
 //   at offset: ino % kMinfsInodesPerBlock
 // - inode 0 is never used, should be marked allocated but ignored
+// - the journal, if any, lies between the info block and the ibm, and
+//   holds one header block followed by the blocks of transactions; the
+//   header describes the last transaction committed
+
+constexpr uint64_t kMinfsJournalMagic = (0x6c6e724a53666e4dULL);
+
+typedef struct {
+    uint64_t magic;
+    uint64_t seq;                   // bumped for each transaction
+    uint32_t count;                 // number of blocks in the transaction
+    uint32_t checksum;              // fnv1a32 of the header and targets,
+                                    // computed with this field as zero
+    uint32_t start;                 // first block of the transaction,
+                                    // relative to the end of the header
+    uint32_t rsvd;
+    blk_t target[];                 // final location of each journaled block
+} minfs_journal_header_t;
+
+constexpr uint32_t kMinfsJournalMaxEntries =
+    (kMinfsBlockSize - sizeof(minfs_journal_header_t)) / sizeof(blk_t);
 
 typedef struct {
     uint32_t magic;
@@ -195,6 +225,10 @@ static_assert(kMinfsMaxDirectorySize <= kMinfsReclenMask,
 // Block Cache (bcache.c)
 constexpr uint32_t kMinfsHashBits = (8);
 
+#ifdef __Fuchsia__
+class Journal;
+#endif
+
 class Bcache {
 public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Bcache);
@@ -214,9 +248,26 @@ public:
 #ifdef __Fuchsia__
     ssize_t GetDevicePath(char* out, size_t out_len);
     zx_status_t AttachVmo(zx_handle_t vmo, vmoid_t* out);
-    zx_status_t Txn(block_fifo_request_t* requests, size_t count) {
-        return block_fifo_txn(fifo_client_, requests, count);
-    }
+    zx_status_t Txn(block_fifo_request_t* requests, size_t count);
+
+    // Delay writes sent through Txn by up to |window|, so that writes issued
+    // close together reach the block device as fewer, larger requests.
+    // Pending writes are flushed from |async| once the window elapses, and
+    // before any read, Sync, or other non-write transaction.
+    // A window of zero disables the delay.
+    zx_status_t SetWritebackWindow(async_t* async, zx_duration_t window);
+
+    // Issue all delayed writes immediately.
+    // Returns the first error encountered by a delayed write, if any.
+    zx_status_t FlushWriteback();
+
+    // Commit delayed metadata writes through the journal occupying the
+    // |count| blocks at |start|, before writing them in place. Metadata is
+    // anything written below block |meta_end|, or from a VMO marked with
+    // SetVmoJournaled. Only writes delayed by a writeback window are
+    // journaled; each window commits as one transaction.
+    zx_status_t InitJournal(blk_t start, blk_t count, blk_t meta_end, uint64_t seq);
+    void SetVmoJournaled(vmoid_t vmoid, bool journaled);
 
     zx_status_t FVMQuery(fvm_info_t* info) {
         ssize_t r = ioctl_block_fvm_query(fd_.get(), info);
@@ -291,7 +342,11 @@ private:
     Bcache(fbl::unique_fd fd, uint32_t blockmax);
 
 #ifdef __Fuchsia__
+    struct Writeback;
+
     fifo_client_t* fifo_client_{}; // Fast path to interact with block device
+    fbl::unique_ptr<Writeback> writeback_;
+    fbl::unique_ptr<Journal> journal_;
 #else
     off_t offset_{};
 #endif
@@ -302,6 +357,11 @@ private:
 void minfs_dir_init(void* bdata, ino_t ino_self, ino_t ino_parent);
 zx_status_t minfs_check_info(const minfs_info_t* info, Bcache* bc);
 
+// Writes the blocks of a committed journal transaction, if any, to their
+// final locations, and marks the journal empty. Returns the sequence number
+// of the last transaction in |out_seq|.
+zx_status_t minfs_replay_journal(Bcache* bc, const minfs_info_t* info, uint64_t* out_seq);
+
 #ifndef __Fuchsia__
 // Run fsck on a sparse minfs partition
 // |start| indicates where the minfs partition starts within the file (in bytes)
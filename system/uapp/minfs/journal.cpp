@@ -0,0 +1,305 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fbl/alloc_checker.h>
+#include <fs/trace.h>
+
+#include "minfs-private.h"
+
+namespace minfs {
+
+namespace {
+
+uint32_t journal_checksum(minfs_journal_header_t* header) {
+    uint32_t checksum = header->checksum;
+    header->checksum = 0;
+    uint32_t result = fnv1a32(header, sizeof(minfs_journal_header_t) +
+                                      header->count * sizeof(blk_t));
+    header->checksum = checksum;
+    return result;
+}
+
+// The number of blocks a transaction in the journal of |info| may hold.
+uint32_t journal_capacity(const minfs_info_t* info) {
+    return fbl::min(info->jnl_blocks - 1, kMinfsJournalMaxEntries);
+}
+
+} // namespace
+
+zx_status_t minfs_replay_journal(Bcache* bc, const minfs_info_t* info, uint64_t* out_seq) {
+    *out_seq = 0;
+    if (info->jnl_blocks == 0) {
+        return ZX_OK;
+    }
+
+    uint8_t hdr_blk[kMinfsBlockSize];
+    zx_status_t status;
+    if ((status = bc->Readblk(info->jnl_block, hdr_blk)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not read journal header\n");
+        return status;
+    }
+    minfs_journal_header_t* header = reinterpret_cast<minfs_journal_header_t*>(hdr_blk);
+    if ((header->magic != kMinfsJournalMagic) || (header->count > journal_capacity(info)) ||
+        (header->start > journal_capacity(info) - header->count) ||
+        (header->checksum != journal_checksum(header))) {
+        // Never written, or torn while being written: nothing was committed.
+        return ZX_OK;
+    }
+    *out_seq = header->seq;
+    if (header->count == 0) {
+        return ZX_OK;
+    }
+
+    for (uint32_t i = 0; i < header->count; i++) {
+        blk_t target = header->target[i];
+        if ((target >= info->jnl_block && target < info->jnl_block + info->jnl_blocks) ||
+            (target >= info->dat_block + info->block_count)) {
+            FS_TRACE_ERROR("minfs: journal entry %u has bad target %u\n", i, target);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+    uint8_t blk[kMinfsBlockSize];
+    for (uint32_t i = 0; i < header->count; i++) {
+        if ((status = bc->Readblk(info->jnl_block + 1 + header->start + i, blk)) != ZX_OK) {
+            return status;
+        } else if ((status = bc->Writeblk(header->target[i], blk)) != ZX_OK) {
+            return status;
+        }
+    }
+    FS_TRACE_INFO("minfs: replayed %u journaled blocks (transaction %lu)\n",
+                  header->count, header->seq);
+
+    header->count = 0;
+    header->start = 0;
+    header->checksum = journal_checksum(header);
+    return bc->Writeblk(info->jnl_block, hdr_blk);
+}
+
+#ifdef __Fuchsia__
+Journal::Journal(Bcache* bc, fifo_client_t* fifo, blk_t start, blk_t meta_end, uint64_t seq)
+    : bc_(bc), fifo_(fifo), start_(start), meta_end_(meta_end), seq_(seq) {}
+
+Journal::~Journal() {
+    if (header_ != nullptr) {
+        block_fifo_request_t request;
+        request.txnid = bc_->TxnId();
+        request.vmoid = header_vmoid_;
+        request.opcode = BLOCKIO_CLOSE_VMO;
+        block_fifo_txn(fifo_, &request, 1);
+    }
+}
+
+zx_status_t Journal::Create(Bcache* bc, fifo_client_t* fifo, blk_t start, blk_t count,
+                            blk_t meta_end, uint64_t seq, fbl::unique_ptr<Journal>* out) {
+    if (count < 2) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Journal> journal(new (&ac) Journal(bc, fifo, start, meta_end, seq));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    journal->capacity_ = fbl::min(count - 1, kMinfsJournalMaxEntries);
+    journal->entries_.reset(new (&ac) Entry[journal->capacity_]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    journal->requests_.reset(new (&ac) block_fifo_request_t[journal->capacity_]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    zx_status_t status;
+    if ((status = journal->journaled_vmoids_.Reset(1 << (sizeof(vmoid_t) * 8))) != ZX_OK) {
+        return status;
+    }
+    if ((status = MappedVmo::Create(kMinfsBlockSize, "minfs-journal",
+                                    &journal->header_)) != ZX_OK) {
+        return status;
+    }
+    if ((status = bc->AttachVmo(journal->header_->GetVmo(), &journal->header_vmoid_)) != ZX_OK) {
+        journal->header_.reset();
+        return status;
+    }
+
+    *out = fbl::move(journal);
+    return ZX_OK;
+}
+
+void Journal::SetVmoJournaled(vmoid_t vmoid, bool journaled) {
+    if (journaled) {
+        journaled_vmoids_.SetOne(vmoid);
+    } else {
+        journaled_vmoids_.ClearOne(vmoid);
+    }
+}
+
+bool Journal::IsMetadata(const block_fifo_request_t& request) const {
+    return (request.dev_offset < static_cast<uint64_t>(meta_end_) * kMinfsBlockSize) ||
+           journaled_vmoids_.GetOne(request.vmoid);
+}
+
+bool Journal::Enqueue(vmoid_t vmoid, uint64_t vmo_block, blk_t dev_block) {
+    for (size_t i = 0; i < count_; i++) {
+        if (entries_[i].dev_block == dev_block) {
+            entries_[i].vmoid = vmoid;
+            entries_[i].vmo_block = vmo_block;
+            return true;
+        }
+    }
+    if (count_ == capacity_) {
+        return false;
+    }
+    entries_[count_++] = { vmoid, vmo_block, dev_block };
+    return true;
+}
+
+void Journal::Revoke(blk_t dev_block, blk_t count) {
+    size_t out = 0;
+    for (size_t i = 0; i < count_; i++) {
+        if ((entries_[i].dev_block >= dev_block) &&
+            (entries_[i].dev_block - dev_block < count)) {
+            continue;
+        }
+        entries_[out++] = entries_[i];
+    }
+    count_ = out;
+}
+
+zx_status_t Journal::Issue(block_fifo_request_t* requests, size_t count) {
+    size_t out = 0;
+    for (size_t i = 0; i < count; i++) {
+        requests[i].txnid = bc_->TxnId();
+        requests[i].opcode = BLOCKIO_WRITE;
+        if (out > 0) {
+            block_fifo_request_t& prev = requests[out - 1];
+            if ((prev.vmoid == requests[i].vmoid) &&
+                (prev.vmo_offset + prev.length == requests[i].vmo_offset) &&
+                (prev.dev_offset + prev.length == requests[i].dev_offset)) {
+                prev.length += requests[i].length;
+                continue;
+            }
+        }
+        requests[out++] = requests[i];
+    }
+    for (size_t i = 0; i < out; i += MAX_TXN_MESSAGES) {
+        zx_status_t status = block_fifo_txn(fifo_, &requests[i],
+                                            fbl::min(out - i, size_t{MAX_TXN_MESSAGES}));
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t Journal::WriteHeader(uint64_t seq, size_t start, size_t count) {
+    minfs_journal_header_t* header = static_cast<minfs_journal_header_t*>(header_->GetData());
+    memset(header, 0, kMinfsBlockSize);
+    header->magic = kMinfsJournalMagic;
+    header->seq = seq;
+    header->count = static_cast<uint32_t>(count);
+    header->start = static_cast<uint32_t>(start);
+    for (size_t i = 0; i < count; i++) {
+        header->target[i] = entries_[i].dev_block;
+    }
+    header->checksum = journal_checksum(header);
+
+    block_fifo_request_t request;
+    request.vmoid = header_vmoid_;
+    request.vmo_offset = 0;
+    request.dev_offset = static_cast<uint64_t>(start_) * kMinfsBlockSize;
+    request.length = kMinfsBlockSize;
+    return Issue(&request, 1);
+}
+
+zx_status_t Journal::Sync() {
+    block_fifo_request_t request;
+    request.txnid = bc_->TxnId();
+    request.vmoid = header_vmoid_;
+    request.opcode = BLOCKIO_SYNC;
+    return block_fifo_txn(fifo_, &request, 1);
+}
+
+static int compare_dev_offset(const void* a, const void* b) {
+    auto ra = static_cast<const block_fifo_request_t*>(a);
+    auto rb = static_cast<const block_fifo_request_t*>(b);
+    if (ra->dev_offset != rb->dev_offset) {
+        return ra->dev_offset < rb->dev_offset ? -1 : 1;
+    }
+    return 0;
+}
+
+zx_status_t Journal::Commit() {
+    if (count_ == 0) {
+        return ZX_OK;
+    }
+
+    // Place the transaction after the last one, wrapping to the start of the
+    // journal if it does not fit.
+    size_t start = last_start_ + last_count_;
+    if (start + count_ > capacity_) {
+        start = 0;
+    }
+    zx_status_t status;
+    if ((last_count_ > 0) && (start < last_start_ + last_count_) &&
+        (last_start_ < start + count_)) {
+        // Replay must not apply the last transaction once its blocks are
+        // partially overwritten; its checkpoint must be durable before it
+        // is forgotten, and it must be forgotten before it is overwritten.
+        if ((status = Sync()) != ZX_OK) {
+            return status;
+        } else if ((status = WriteHeader(seq_, 0, 0)) != ZX_OK) {
+            return status;
+        } else if ((status = Sync()) != ZX_OK) {
+            return status;
+        }
+        last_count_ = 0;
+    }
+
+    // Copy each block into the journal, straight from the VMO which holds it.
+    for (size_t i = 0; i < count_; i++) {
+        block_fifo_request_t& request = requests_[i];
+        request.vmoid = entries_[i].vmoid;
+        request.vmo_offset = entries_[i].vmo_block * kMinfsBlockSize;
+        request.dev_offset = static_cast<uint64_t>(start_ + 1 + start + i) * kMinfsBlockSize;
+        request.length = kMinfsBlockSize;
+    }
+    if ((status = Issue(requests_.get(), count_)) != ZX_OK) {
+        return status;
+    }
+
+    // The transaction is committed once its header is durable. The payload
+    // must reach the media first, or a torn commit could replay garbage; the
+    // header must reach it before any block is overwritten in place.
+    if ((status = Sync()) != ZX_OK) {
+        return status;
+    } else if ((status = WriteHeader(seq_ + 1, start, count_)) != ZX_OK) {
+        return status;
+    } else if ((status = Sync()) != ZX_OK) {
+        return status;
+    }
+    seq_++;
+    last_start_ = start;
+    last_count_ = count_;
+
+    // Checkpoint: write the blocks in place. Until this completes, the
+    // journal holds the only complete copy of the transaction.
+    for (size_t i = 0; i < count_; i++) {
+        block_fifo_request_t& request = requests_[i];
+        request.vmoid = entries_[i].vmoid;
+        request.vmo_offset = entries_[i].vmo_block * kMinfsBlockSize;
+        request.dev_offset = static_cast<uint64_t>(entries_[i].dev_block) * kMinfsBlockSize;
+        request.length = kMinfsBlockSize;
+    }
+    qsort(requests_.get(), count_, sizeof(block_fifo_request_t), compare_dev_offset);
+    size_t count = count_;
+    count_ = 0;
+    return Issue(requests_.get(), count);
+}
+#endif
+
+} // namespace minfs
@@ -41,7 +41,12 @@ int do_minfs_check(fbl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
 }
 
 #ifdef __Fuchsia__
+// Writes are delayed by up to this long, so bursts of small metadata and data
+// writes can be coalesced before they are sent to the block device.
+constexpr zx_duration_t kWritebackWindow = ZX_MSEC(50);
+
 int do_minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, bool readonly) {
+    minfs::Bcache* bcp = bc.get();
     fbl::RefPtr<minfs::VnodeMinfs> vn;
     if (minfs_mount(&vn, fbl::move(bc)) < 0) {
         return -1;
@@ -57,6 +62,9 @@ int do_minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, bool readonly) {
     fs::Vfs vfs(loop.async());
     vfs.SetReadonly(readonly);
     zx_status_t status;
+    if (!readonly && (status = bcp->SetWritebackWindow(loop.async(), kWritebackWindow)) != ZX_OK) {
+        return status;
+    }
     if ((status = vfs.ServeDirectory(fbl::move(vn), zx::channel(h))) != ZX_OK) {
         return status;
     }
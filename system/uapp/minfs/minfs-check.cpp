@@ -251,6 +251,20 @@ zx_status_t MinfsChecker::CheckDirectory(minfs_inode_t* inode, ino_t ino,
         }
         eno++;
     }
+    if (flags & CD_DUMP) {
+        // Large directories are looked up through a name index, which
+        // resolves each name to the first entry found with it.
+        DirectoryIndex index;
+        if ((status = vn->IndexDirents(&index, 0, kMinfsMaxDirectorySize)) != ZX_OK) {
+            FS_TRACE_ERROR("check: ino#%u: could not index directory: %d\n", ino, status);
+        } else {
+            size_t duplicates = index.CountDuplicateNames(vn.get());
+            if (duplicates) {
+                FS_TRACE_ERROR("check: ino#%u: %zu duplicate name%s\n",
+                      ino, duplicates, duplicates > 1 ? "s" : "");
+            }
+        }
+    }
     if (dirent_count != inode->dirent_count) {
         FS_TRACE_ERROR("check: ino#%u: dirent_count of %u != %u (actual)\n",
               ino, inode->dirent_count, dirent_count);
@@ -322,6 +322,7 @@ zx_status_t VnodeMinfs::InitIndirectVmo() {
         vmo_indirect_ = nullptr;
         return status;
     }
+    fs_->bc_->SetVmoJournaled(vmoid_indirect_, true);
 
     // Load initial set of indirect blocks
     if ((status = LoadIndirectBlocks(inode_.inum, kMinfsIndirect, 0, 0)) != ZX_OK) {
@@ -341,12 +342,8 @@ zx_status_t VnodeMinfs::InitIndirectVmo() {
 }
 
 // Since we cannot yet register the filesystem as a paging service (and cleanly
-// fault on pages when they are actually needed), we currently read an entire
-// file to a VMO when a file's data block are accessed.
-//
-// TODO(smklein): Even this hack can be optimized; a bitmap could be used to
-// track all 'empty/read/dirty' blocks for each vnode, rather than reading
-// the entire file.
+// fault on pages when they are actually needed), file data is read into the
+// VMO by LoadVmoRange() as it is accessed.
 zx_status_t VnodeMinfs::InitVmo() {
     if (vmo_.is_valid()) {
         return ZX_OK;
@@ -365,100 +362,166 @@ zx_status_t VnodeMinfs::InitVmo() {
         vmo_.reset();
         return status;
     }
+    if (IsDirectory()) {
+        // Directory contents are metadata, and are written through the journal.
+        fs_->bc_->SetVmoJournaled(vmoid_, true);
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::LoadVmoRange(blk_t start, blk_t end) {
+    ZX_DEBUG_ASSERT(vmo_.is_valid());
+    ZX_DEBUG_ASSERT(start <= end);
+    if (vmo_resident_.Get(start, end)) {
+        return ZX_OK;
+    }
+
+    // Read in the whole chunk around the request, to keep the number of
+    // resident ranges (and round trips for sequential access) down. Blocks
+    // past the end of the file are holes; only those actually requested
+    // are marked resident.
+    blk_t size_blocks = static_cast<blk_t>(fbl::round_up(inode_.size, kMinfsBlockSize) /
+                                           kMinfsBlockSize);
+    start = fbl::round_down(start, kMinfsVmoChunkBlocks);
+    end = fbl::max(end, fbl::min(fbl::round_up(end, kMinfsVmoChunkBlocks), size_blocks));
+
     ReadTxn txn(fs_->bc_.get());
+    zx_status_t status;
+    blk_t n = start;
+    while (n < end) {
+        size_t first_unset;
+        if (vmo_resident_.Get(n, end, &first_unset)) {
+            break;
+        }
+        n = static_cast<blk_t>(first_unset);
 
-    // Initialize all direct blocks
-    blk_t bno;
-    for (uint32_t d = 0; d < kMinfsDirect; d++) {
-        if ((bno = inode_.dnum[d]) != 0) {
+        blk_t bno;
+        if ((status = GetBno(nullptr, n, &bno)) != ZX_OK) {
+            return status;
+        }
+        if (bno != 0) {
             fs_->ValidateBno(bno);
-            txn.Enqueue(vmoid_, d, bno + fs_->info_.dat_block, 1);
+            txn.Enqueue(vmoid_, n, bno + fs_->info_.dat_block, 1);
         }
+        n++;
     }
 
-    // Initialize all indirect blocks
-    for (uint32_t i = 0; i < kMinfsIndirect; i++) {
-        blk_t ibno;
-        if ((ibno = inode_.inum[i]) != 0) {
-            fs_->ValidateBno(ibno);
-
-            // Only initialize the indirect vmo if it is being used.
-            if ((status = InitIndirectVmo()) != ZX_OK) {
-                vmo_.reset();
-                return status;
-            }
+    if ((status = txn.Flush()) != ZX_OK) {
+        return status;
+    }
+    MarkVmoResident(start, end);
+    return ZX_OK;
+}
 
-            uint32_t* ientry;
-            ReadIndirectVmoBlock(i, &ientry);
+void VnodeMinfs::MarkVmoResident(blk_t start, blk_t end) {
+    // Count the blocks which are not yet resident.
+    uint64_t added = end - start;
+    for (const auto& range : vmo_resident_) {
+        size_t range_start = fbl::max(static_cast<size_t>(start), range.bitoff);
+        size_t range_end = fbl::min(static_cast<size_t>(end), range.bitoff + range.bitlen);
+        if (range_start < range_end) {
+            added -= range_end - range_start;
+        }
+    }
+    if (added == 0) {
+        return;
+    }
+    if (vmo_resident_.Set(start, end) != ZX_OK) {
+        // Without a record of residency we must not trust the VMO; it is
+        // simply reloaded on the next access.
+        return;
+    }
+    vmo_resident_blocks_ += added;
+    fs_->AddResidentBlocks(added);
+}
 
-            for (uint32_t j = 0; j < kMinfsDirectPerIndirect; j++) {
-                if ((bno = ientry[j]) != 0) {
-                    fs_->ValidateBno(bno);
-                    uint32_t n = kMinfsDirect + i * kMinfsDirectPerIndirect + j;
-                    txn.Enqueue(vmoid_, n, bno + fs_->info_.dat_block, 1);
-                }
-            }
+void VnodeMinfs::TruncateVmoResident(blk_t start) {
+    uint64_t removed = 0;
+    for (const auto& range : vmo_resident_) {
+        size_t range_start = fbl::max(static_cast<size_t>(start), range.bitoff);
+        size_t range_end = range.bitoff + range.bitlen;
+        if (range_start < range_end) {
+            removed += range_end - range_start;
         }
     }
+    if (removed == 0) {
+        return;
+    }
+    vmo_resident_.Clear(start, kMinfsMaxFileBlock);
+    vmo_resident_blocks_ -= removed;
+    fs_->RemoveResidentBlocks(removed);
+}
 
-    // Initialize all doubly indirect blocks
-    for (uint32_t i = 0; i < kMinfsDoublyIndirect; i++) {
-        blk_t dibno;
+uint64_t VnodeMinfs::EvictVmo() {
+    if (vmo_resident_blocks_ == 0) {
+        return 0;
+    }
+    for (const auto& range : vmo_resident_) {
+        vmo_.op_range(ZX_VMO_OP_DECOMMIT, range.bitoff * kMinfsBlockSize,
+                      range.bitlen * kMinfsBlockSize, nullptr, 0);
+    }
+    vmo_resident_.ClearAll();
 
-        if ((dibno = inode_.dinum[i]) != 0) {
-            fs_->ValidateBno(dibno);
+    uint64_t evicted = vmo_resident_blocks_;
+    vmo_resident_blocks_ = 0;
+    fs_->RemoveResidentBlocks(evicted);
+    return evicted;
+}
+#endif
 
-            // Only initialize the doubly indirect vmo if it is being used.
-            if ((status = InitIndirectVmo()) != ZX_OK) {
-                vmo_.reset();
-                return status;
-            }
+void VnodeMinfs::ReserveBlocks(blk_t start, blk_t end) {
+    ZX_DEBUG_ASSERT(reserve_count_ == 0);
+    reserve_wanted_ = 0;
+    reserve_hint_ = 0;
+    for (blk_t n = start; n < end; n++) {
+        blk_t bno;
+        if ((GetBno(nullptr, n, &bno) == ZX_OK) && (bno == 0)) {
+            reserve_wanted_++;
+        }
+    }
+    // Continue on from the block preceding the write, if there is one.
+    blk_t bno;
+    if ((start > 0) && (GetBno(nullptr, start - 1, &bno) == ZX_OK) && (bno != 0)) {
+        reserve_hint_ = bno + 1;
+    }
+}
 
-            uint32_t* dientry;
-            ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(i), &dientry);
-
-            for (uint32_t j = 0; j < kMinfsDirectPerIndirect; j++) {
-                blk_t ibno;
-                if ((ibno = dientry[j]) != 0) {
-                    fs_->ValidateBno(ibno);
-
-                    // Only initialize the indirect vmo if it is being used.
-                    if ((status = LoadIndirectWithinDoublyIndirect(i)) != ZX_OK) {
-                        vmo_.reset();
-                        return status;
-                    }
-
-                    uint32_t* ientry;
-                    ReadIndirectVmoBlock(GetVmoOffsetForIndirect(i) + j, &ientry);
-
-                    for (uint32_t k = 0; k < kMinfsDirectPerIndirect; k++) {
-                        if ((bno = ientry[k]) != 0) {
-                            fs_->ValidateBno(bno);
-                            uint32_t n = kMinfsDirect + kMinfsIndirect * kMinfsDirectPerIndirect
-                                         + j * kMinfsDirectPerIndirect + k;
-                            txn.Enqueue(vmoid_, n, bno + fs_->info_.dat_block, 1);
-                        }
-                    }
-                }
-            }
+zx_status_t VnodeMinfs::BlockNewReserved(WriteTxn* txn, blk_t* bno) {
+    if (reserve_count_ == 0) {
+        blk_t count = fbl::max(reserve_wanted_, 1u);
+        zx_status_t status = fs_->BlocksNew(txn, reserve_hint_, count,
+                                            &reserve_bno_, &reserve_count_);
+        if (status != ZX_OK) {
+            return status;
         }
     }
+    *bno = reserve_bno_++;
+    reserve_count_--;
+    if (reserve_wanted_ > 0) {
+        reserve_wanted_--;
+    }
+    reserve_hint_ = reserve_bno_;
+    return ZX_OK;
+}
 
-    return txn.Flush();
+void VnodeMinfs::ReleaseReservedBlocks(WriteTxn* txn) {
+    if (reserve_count_ > 0) {
+        fs_->BlocksFree(txn, reserve_bno_, reserve_count_);
+    }
+    reserve_count_ = 0;
+    reserve_wanted_ = 0;
+    reserve_hint_ = 0;
 }
-#endif
 
 zx_status_t VnodeMinfs::GetBnoDirect(WriteTxn* txn, blk_t* bno, bool* dirty) {
     // direct blocks are simple... is there an entry in dnum[]?
-    blk_t hint = 0;
-
     if (*bno == 0) {
         if (txn == nullptr) {
             *bno = 0;
             return ZX_OK;
         }
         // allocate a new block
-        zx_status_t status = fs_->BlockNew(txn, hint, bno);
+        zx_status_t status = BlockNewReserved(txn, bno);
         if (status != ZX_OK) {
             return status;
         }
@@ -1036,6 +1099,8 @@ zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
         case DIR_CB_SAVE_SYNC:
             inode_.seq_num++;
             InodeSync(args->txn, kMxFsSyncMtime);
+            // Any index of this directory no longer matches it.
+            dir_index_.reset();
             return ZX_OK;
         case DIR_CB_DONE:
         default:
@@ -1045,6 +1110,127 @@ zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
     return ZX_ERR_NOT_FOUND;
 }
 
+DirectoryIndex* VnodeMinfs::GetDirectoryIndex() {
+    if ((dir_index_ != nullptr) || (inode_.size < kMinfsDirectoryIndexMinSize)) {
+        return dir_index_.get();
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirectoryIndex> index(new (&ac) DirectoryIndex());
+    if (!ac.check()) {
+        return nullptr;
+    }
+    if (IndexDirents(index.get(), 0, kMinfsMaxDirectorySize) != ZX_OK) {
+        return nullptr;
+    }
+    dir_index_ = fbl::move(index);
+    return dir_index_.get();
+}
+
+zx_status_t VnodeMinfs::IndexDirents(DirectoryIndex* index, size_t start, size_t end) {
+    char data[kMinfsMaxDirentSize];
+    minfs_dirent_t* de = (minfs_dirent_t*) data;
+    size_t off = start;
+    while ((off < end) && (off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize)) {
+        size_t r;
+        zx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, off, &r);
+        if (status != ZX_OK) {
+            return status;
+        } else if ((status = validate_dirent(de, r, off)) != ZX_OK) {
+            return status;
+        } else if ((status = index->Insert(de, off)) != ZX_OK) {
+            return status;
+        }
+        off += MinfsReclen(de, off);
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::IndexedDirentOp(DirArgs* args, const DirentCallback func,
+                                        DirectoryIndex::Record* record) {
+    char data[kMinfsMaxDirentSize];
+    minfs_dirent_t* de = (minfs_dirent_t*) data;
+    size_t r;
+    zx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, record->off, &r);
+    if (status != ZX_OK) {
+        return status;
+    } else if ((status = validate_dirent(de, r, record->off)) != ZX_OK) {
+        return status;
+    } else if (((de->ino != 0) != record->in_use) ||
+               (MinfsReclen(de, record->off) != record->reclen)) {
+        FS_TRACE_ERROR("vn_dir: dirent at offset %u does not match index\n", record->off);
+        return ZX_ERR_IO;
+    }
+
+    // 'func' may rewrite this record and merge it with its neighbours, so
+    // those are the records re-read into the index afterwards.
+    DirectoryIndex::Record* prev = dir_index_->Prev(record);
+    DirectoryIndex::Record* next = dir_index_->Next(record);
+    size_t start = prev ? prev->off : record->off;
+    size_t end = next ? next->off + next->reclen : record->off + record->reclen;
+    DirectoryOffset offs = {
+        .off = record->off,
+        .off_prev = start,
+    };
+
+    switch ((status = func(fbl::RefPtr<VnodeMinfs>(this), de, args, &offs))) {
+    case DIR_CB_NEXT:
+        return DIR_CB_NEXT;
+    case DIR_CB_SAVE_SYNC:
+        inode_.seq_num++;
+        InodeSync(args->txn, kMxFsSyncMtime);
+        dir_index_->Erase(start, end);
+        if (IndexDirents(dir_index_.get(), start, end) != ZX_OK) {
+            // The directory itself is intact; it will be re-indexed in full
+            // on next use.
+            dir_index_.reset();
+        }
+        return ZX_OK;
+    case DIR_CB_DONE:
+    default:
+        if (status < 0) {
+            // The directory may have been partially modified.
+            dir_index_.reset();
+        }
+        return status;
+    }
+}
+
+zx_status_t VnodeMinfs::ForEachNamedDirent(DirArgs* args, const DirentCallback func) {
+    DirectoryIndex* index = GetDirectoryIndex();
+    if (index == nullptr) {
+        return ForEachDirent(args, func);
+    }
+    DirectoryIndex::Record* record = index->FirstNamed(args->name);
+    while (record != nullptr) {
+        // Names may collide; 'func' skips records with other names.
+        DirectoryIndex::Record* next = index->NextNamed(record);
+        zx_status_t status = IndexedDirentOp(args, func, record);
+        if (status != DIR_CB_NEXT) {
+            return status;
+        }
+        record = next;
+    }
+    return ZX_ERR_NOT_FOUND;
+}
+
+zx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
+    DirectoryIndex* index = GetDirectoryIndex();
+    if (index != nullptr) {
+        DirectoryIndex::Record* record = index->FindFree(args->reclen);
+        if (record == nullptr) {
+            // As ForEachDirent reports a full directory.
+            return ZX_ERR_NOT_FOUND;
+        }
+        zx_status_t status = IndexedDirentOp(args, cb_dir_append, record);
+        if (status != DIR_CB_NEXT) {
+            return status;
+        }
+        FS_TRACE_ERROR("vn_dir: index has no room for dirent at offset %u\n", record->off);
+        dir_index_.reset();
+    }
+    return ForEachDirent(args, cb_dir_append);
+}
+
 VnodeMinfs::~VnodeMinfs() {
     if (inode_.link_count == 0) {
         fs_->InoFree(this);
@@ -1052,17 +1238,21 @@ VnodeMinfs::~VnodeMinfs() {
 
     fs_->VnodeRelease(this);
 #ifdef __Fuchsia__
+    fs_->RemoveResidentBlocks(vmo_resident_blocks_);
+
     // Detach the vmoids from the underlying block device,
     // so the underlying VMO may be released.
     size_t request_count = 0;
     block_fifo_request_t request[2];
     if (vmo_.is_valid()) {
+        fs_->bc_->SetVmoJournaled(vmoid_, false);
         request[request_count].txnid = fs_->bc_->TxnId();
         request[request_count].vmoid = vmoid_;
         request[request_count].opcode = BLOCKIO_CLOSE_VMO;
         request_count++;
     }
     if (vmo_indirect_ != nullptr) {
+        fs_->bc_->SetVmoJournaled(vmoid_indirect_, false);
         request[request_count].txnid = fs_->bc_->TxnId();
         request[request_count].vmoid = vmoid_indirect_;
         request[request_count].opcode = BLOCKIO_CLOSE_VMO;
@@ -1096,6 +1286,9 @@ zx_status_t VnodeMinfs::Read(void* data, size_t len, size_t off, size_t* out_act
     if (IsDirectory()) {
         return ZX_ERR_NOT_FILE;
     }
+#ifdef __Fuchsia__
+    fs_->ReclaimResidentBlocks(this);
+#endif
     zx_status_t status = ReadInternal(data, len, off, out_actual);
     if (status != ZX_OK) {
         return status;
@@ -1116,8 +1309,12 @@ zx_status_t VnodeMinfs::ReadInternal(void* data, size_t len, size_t off, size_t*
 
     zx_status_t status;
 #ifdef __Fuchsia__
+    blk_t start = static_cast<blk_t>(off / kMinfsBlockSize);
+    blk_t end = static_cast<blk_t>(fbl::round_up(off + len, kMinfsBlockSize) / kMinfsBlockSize);
     if ((status = InitVmo()) != ZX_OK) {
         return status;
+    } else if ((status = LoadVmoRange(start, end)) != ZX_OK) {
+        return status;
     } else if ((status = vmo_.read(data, off, len, actual)) != ZX_OK) {
         return status;
     }
@@ -1164,6 +1361,9 @@ zx_status_t VnodeMinfs::Write(const void* data, size_t len, size_t offset, size_
     if (IsDirectory()) {
         return ZX_ERR_NOT_FILE;
     }
+#ifdef __Fuchsia__
+    fs_->ReclaimResidentBlocks(this);
+#endif
     WriteTxn txn(fs_->bc_.get());
     zx_status_t status = WriteInternal(&txn, data, len, offset, out_actual);
     if (status != ZX_OK) {
@@ -1202,6 +1402,11 @@ zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
     uint32_t n = static_cast<uint32_t>(off / kMinfsBlockSize);
     size_t adjust = off % kMinfsBlockSize;
 
+    // Allocate the blocks this write adds to the file as one run, rather than
+    // searching the block bitmap (and writing it back) once per block.
+    uint64_t end_block = (off + len + kMinfsBlockSize - 1) / kMinfsBlockSize;
+    ReserveBlocks(n, static_cast<blk_t>(fbl::min<uint64_t>(end_block, kMinfsMaxFileBlock)));
+
     while ((len > 0) && (n < kMinfsMaxFileBlock)) {
         size_t xfer;
         if (len > (kMinfsBlockSize - adjust)) {
@@ -1219,10 +1424,16 @@ zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
             }
         }
 
+        // A partial write must merge with the block's existing contents
+        if (xfer != kMinfsBlockSize && (status = LoadVmoRange(n, n + 1)) != ZX_OK) {
+            goto done;
+        }
+
         // Update this block of the in-memory VMO
         if ((status = VmoWriteExact(data, xfer_off, xfer)) != ZX_OK) {
             goto done;
         }
+        MarkVmoResident(n, n + 1);
 
         // Update this block on-disk
         blk_t bno;
@@ -1257,6 +1468,7 @@ zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
     }
 
 done:
+    ReleaseReservedBlocks(txn);
     len = (uintptr_t)data - (uintptr_t)start;
     if (len == 0) {
         // If more than zero bytes were requested, but zero bytes were written,
@@ -1290,7 +1502,7 @@ zx_status_t VnodeMinfs::LookupInternal(fbl::RefPtr<fs::Vnode>* out, fbl::StringP
     DirArgs args = DirArgs();
     args.name = name;
     zx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) < 0) {
+    if ((status = ForEachNamedDirent(&args, cb_dir_find)) < 0) {
         return status;
     }
     fbl::RefPtr<VnodeMinfs> vn;
@@ -1467,7 +1679,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     args.name = name;
     // ensure file does not exist
     zx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) != ZX_ERR_NOT_FOUND) {
+    if ((status = ForEachNamedDirent(&args, cb_dir_find)) != ZX_ERR_NOT_FOUND) {
         return ZX_ERR_ALREADY_EXISTS;
     }
 
@@ -1498,7 +1710,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
     args.txn = &txn;
-    if ((status = ForEachDirent(&args, cb_dir_append)) < 0) {
+    if ((status = AppendDirent(&args)) < 0) {
         return status;
     }
 
@@ -1564,7 +1776,7 @@ zx_status_t VnodeMinfs::Unlink(fbl::StringPiece name, bool must_be_dir) {
     args.name = name;
     args.type = must_be_dir ? kMinfsTypeDir : 0;
     args.txn = &txn;
-    return ForEachDirent(&args, cb_dir_unlink);
+    return ForEachNamedDirent(&args, cb_dir_unlink);
 }
 
 zx_status_t VnodeMinfs::Truncate(size_t len) {
@@ -1584,8 +1796,6 @@ zx_status_t VnodeMinfs::Truncate(size_t len) {
 zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
     zx_status_t r = 0;
 #ifdef __Fuchsia__
-    // TODO(smklein): We should only init up to 'len'; no need
-    // to read in the portion of a large file we plan on deleting.
     if (InitVmo() != ZX_OK) {
         return ZX_ERR_IO;
     }
@@ -1607,6 +1817,9 @@ zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
             if (start_bno * kMinfsBlockSize < inode_.size) {
                 inode_.size = start_bno * kMinfsBlockSize;
             }
+#ifdef __Fuchsia__
+            TruncateVmoResident(start_bno);
+#endif
         }
 
         // Write zeroes to the rest of the remaining block, if it exists
@@ -1619,6 +1832,9 @@ zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
             if (bno != 0) {
                 size_t adjust = len % kMinfsBlockSize;
 #ifdef __Fuchsia__
+                if ((r = LoadVmoRange(rel_bno, rel_bno + 1)) != ZX_OK) {
+                    return ZX_ERR_IO;
+                }
                 if ((r = VmoReadExact(bdata, len - adjust, adjust)) != ZX_OK) {
                     return ZX_ERR_IO;
                 }
@@ -1691,7 +1907,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     // acquire the 'oldname' node (it must exist)
     DirArgs args = DirArgs();
     args.name = oldname;
-    if ((status = ForEachDirent(&args, cb_dir_find)) < 0) {
+    if ((status = ForEachNamedDirent(&args, cb_dir_find)) < 0) {
         return status;
     } else if ((status = fs_->VnodeGet(&oldvn, args.ino)) < 0) {
         return status;
@@ -1711,11 +1927,11 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     args.name = newname;
     args.ino = oldvn->ino_;
     args.type = oldvn->IsDirectory() ? kMinfsTypeDir : kMinfsTypeFile;
-    status = newdir->ForEachDirent(&args, cb_dir_attempt_rename);
+    status = newdir->ForEachNamedDirent(&args, cb_dir_attempt_rename);
     if (status == ZX_ERR_NOT_FOUND) {
         // if 'newname' does not exist, create it
         args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(newname.length())));
-        if ((status = newdir->ForEachDirent(&args, cb_dir_append)) < 0) {
+        if ((status = newdir->AppendDirent(&args)) < 0) {
             return status;
         }
     } else if (status != ZX_OK) {
@@ -1732,7 +1948,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
         auto vn = fbl::RefPtr<VnodeMinfs>::Downcast(vn_fs);
         args.name = "..";
         args.ino = newdir->ino_;
-        if ((status = vn->ForEachDirent(&args, cb_dir_update_inode)) < 0) {
+        if ((status = vn->ForEachNamedDirent(&args, cb_dir_update_inode)) < 0) {
             return status;
         }
     }
@@ -1743,7 +1959,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
 
     // finally, remove oldname from its original position
     args.name = oldname;
-    return ForEachDirent(&args, cb_dir_force_unlink);
+    return ForEachNamedDirent(&args, cb_dir_force_unlink);
 }
 
 zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _target) {
@@ -1765,7 +1981,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     DirArgs args = DirArgs();
     args.name = name;
     zx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) != ZX_ERR_NOT_FOUND) {
+    if ((status = ForEachNamedDirent(&args, cb_dir_find)) != ZX_ERR_NOT_FOUND) {
         return (status == ZX_OK) ? ZX_ERR_ALREADY_EXISTS : status;
     }
 
@@ -1774,7 +1990,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
     args.txn = &txn;
-    if ((status = ForEachDirent(&args, cb_dir_append)) < 0) {
+    if ((status = AppendDirent(&args)) < 0) {
         return status;
     }
 
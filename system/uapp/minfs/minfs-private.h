@@ -5,6 +5,7 @@
 #pragma once
 
 #ifdef __Fuchsia__
+#include <bitmap/rle-bitmap.h>
 #include <fs/remote.h>
 #include <fs/watcher.h>
 #include <zx/vmo.h>
@@ -13,6 +14,7 @@
 #include <fbl/algorithm.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/intrusive_single_list.h>
+#include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
@@ -69,6 +71,101 @@ constexpr uint32_t kMxFsSyncCtime = (1 << 1);
 
 constexpr uint32_t kMinfsBlockCacheSize = 64;
 
+// The block bitmap is summarized by the number of free blocks in each group
+// of this many blocks, so that searches for free runs can skip full groups.
+constexpr uint32_t kMinfsBlockGroupBits = 4096;
+
+// Directories at least this large are indexed in memory on first use, rather
+// than scanned dirent by dirent for every lookup and insertion.
+constexpr uint32_t kMinfsDirectoryIndexMinSize = 2 * kMinfsBlockSize;
+
+#ifdef __Fuchsia__
+// File data is read into a vnode's VMO in aligned chunks of this many blocks.
+constexpr uint32_t kMinfsVmoChunkBlocks = 8;
+
+// Once more file data than this is resident in vnode VMOs, clean data of
+// other vnodes is evicted until half of it is left.
+constexpr uint64_t kMinfsResidentBlockLimit = (64 * 1024 * 1024) / kMinfsBlockSize;
+#endif
+
+#ifdef __Fuchsia__
+// The metadata journal (see Bcache::InitJournal).
+//
+// Metadata writes are collected block by block until the writeback window
+// closes. Commit() then writes the blocks into the journal, writes a header
+// naming their final locations, and only then writes them in place. A crash
+// before the header is written loses the transaction as a whole; a crash
+// after it is repaired by minfs_replay_journal at the next mount.
+class Journal {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Journal);
+    ~Journal();
+
+    static zx_status_t Create(Bcache* bc, fifo_client_t* fifo, blk_t start, blk_t count,
+                              blk_t meta_end, uint64_t seq, fbl::unique_ptr<Journal>* out);
+
+    // The number of blocks one transaction may hold, and the number held by
+    // the transaction being built.
+    size_t capacity() const { return capacity_; }
+    size_t pending() const { return count_; }
+
+    void SetVmoJournaled(vmoid_t vmoid, bool journaled);
+
+    // Returns true if |request| (in bytes, as sent to Bcache::Txn) writes
+    // metadata.
+    bool IsMetadata(const block_fifo_request_t& request) const;
+
+    // Adds one block of metadata to the transaction. A later write to the
+    // same block replaces an earlier one. Returns false if the transaction
+    // is full.
+    bool Enqueue(vmoid_t vmoid, uint64_t vmo_block, blk_t dev_block);
+
+    // Drops any block of the transaction in [dev_block, dev_block + count),
+    // which is no longer metadata; the blocks were freed and are being
+    // written as file data instead.
+    void Revoke(blk_t dev_block, blk_t count);
+
+    // Writes the transaction to the journal, then to its final location.
+    zx_status_t Commit();
+
+private:
+    struct Entry {
+        vmoid_t vmoid;
+        uint64_t vmo_block;
+        blk_t dev_block;
+    };
+
+    Journal(Bcache* bc, fifo_client_t* fifo, blk_t start, blk_t meta_end, uint64_t seq);
+
+    // Sends |count| single-block requests, merging neighbours.
+    zx_status_t Issue(block_fifo_request_t* requests, size_t count);
+    // Writes the header for the |count| blocks of the transaction starting
+    // at |start|; a |count| of zero marks the journal empty.
+    zx_status_t WriteHeader(uint64_t seq, size_t start, size_t count);
+    // Waits until every write sent so far is durable.
+    zx_status_t Sync();
+
+    Bcache* bc_;
+    fifo_client_t* fifo_;
+    const blk_t start_;
+    const blk_t meta_end_;
+    uint64_t seq_;
+
+    fbl::unique_ptr<MappedVmo> header_{};
+    vmoid_t header_vmoid_{};
+    bitmap::RawBitmapGeneric<bitmap::DefaultStorage> journaled_vmoids_{};
+
+    size_t capacity_{};
+    size_t count_{};
+    // Where the last committed transaction lies within the journal; replay
+    // would apply it until it is overwritten or marked empty.
+    size_t last_start_{};
+    size_t last_count_{};
+    fbl::unique_ptr<Entry[]> entries_{};
+    fbl::unique_ptr<block_fifo_request_t[]> requests_{};
+};
+#endif
+
 // Used by fsck
 class MinfsChecker;
 
@@ -94,10 +191,24 @@ public:
     void VnodeRelease(VnodeMinfs* vn);
 
     // Allocate a new data block.
-    zx_status_t BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno);
+    zx_status_t BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno) {
+        blk_t count;
+        return BlocksNew(txn, hint, 1, out_bno, &count);
+    }
+
+    // Allocate a run of up to |count| contiguous data blocks, preferring
+    // the full run, and searching from |hint|. On success, the blocks
+    // [*out_bno, *out_bno + *out_count) are allocated, where *out_count >= 1.
+    zx_status_t BlocksNew(WriteTxn* txn, blk_t hint, blk_t count,
+                          blk_t* out_bno, blk_t* out_count);
 
     // free block in block bitmap
-    zx_status_t BlockFree(WriteTxn* txn, blk_t bno);
+    zx_status_t BlockFree(WriteTxn* txn, blk_t bno) {
+        return BlocksFree(txn, bno, 1);
+    }
+
+    // free the run of |count| blocks starting at |bno| in block bitmap
+    zx_status_t BlocksFree(WriteTxn* txn, blk_t bno, blk_t count);
 
     // free ino in inode bitmap, release all blocks held by inode
     zx_status_t InoFree(VnodeMinfs* vn);
@@ -124,6 +235,20 @@ public:
     zx_status_t ReadIno(blk_t bno, void* data);
     zx_status_t ReadDat(blk_t bno, void* data);
 
+#ifdef __Fuchsia__
+    // Accounting for file data blocks held in vnode VMOs.
+    void AddResidentBlocks(uint64_t count) { resident_blocks_ += count; }
+    void RemoveResidentBlocks(uint64_t count) {
+        ZX_DEBUG_ASSERT(resident_blocks_ >= count);
+        resident_blocks_ -= count;
+    }
+
+    // If too many blocks are resident, flushes pending writeback and evicts
+    // the (now clean) data of vnodes other than |active|.
+    // Must not be called while a WriteTxn referencing other vnodes is pending.
+    void ReclaimResidentBlocks(VnodeMinfs* active);
+#endif
+
 private:
     // Fsck can introspect Minfs
     friend class MinfsChecker;
@@ -139,11 +264,24 @@ private:
     zx_status_t AddInodes();
     zx_status_t AddBlocks();
 
+    // Recounts the free blocks of every group of the block bitmap.
+    zx_status_t InitBlockSummary();
+    // Accounts for the blocks [start, end) becoming allocated or free.
+    void UpdateBlockSummary(size_t start, size_t end, bool allocated);
+    // Finds a run of |count| free blocks in [start, end), skipping full groups.
+    zx_status_t FindBlocks(size_t start, size_t end, size_t count, size_t* out) const;
+    // Marks [bno, bno + count) allocated or free, and writes back the
+    // bitmap blocks covering them.
+    void UpdateBlockMap(WriteTxn* txn, blk_t bno, blk_t count, bool allocated);
+
     uint32_t abmblks_{};
     uint32_t ibmblks_{};
     uint32_t inoblks_{};
     RawBitmap inode_map_{};
     RawBitmap block_map_{};
+    // Free blocks in each kMinfsBlockGroupBits-sized group of block_map_.
+    fbl::unique_ptr<uint32_t[]> block_group_free_{};
+    size_t block_groups_{};
 #ifdef __Fuchsia__
     fbl::unique_ptr<MappedVmo> inode_table_{};
     fbl::unique_ptr<MappedVmo> info_vmo_{};
@@ -173,6 +311,10 @@ private:
     // when the Vnode is deleted, it is immediately removed from the map.
     using HashTable = fbl::HashTable<ino_t, VnodeMinfs*>;
     HashTable vnode_hash_{};
+
+#ifdef __Fuchsia__
+    uint64_t resident_blocks_{};
+#endif
 };
 
 struct DirArgs {
@@ -190,6 +332,86 @@ struct DirectoryOffset {
 
 #define INO_HASH(ino) fnv1a_tiny(ino, kMinfsHashBits)
 
+// An in-memory index of the records of a directory, so that name lookups and
+// searches for free space need not read every dirent. It is a cache of the
+// on-disk records: built by reading the whole directory, and patched by
+// re-reading the range of records touched by each modification.
+class DirectoryIndex {
+public:
+    struct Record;
+
+    DirectoryIndex() = default;
+    ~DirectoryIndex();
+    DISALLOW_COPY_ASSIGN_AND_MOVE(DirectoryIndex);
+
+    static uint32_t NameHash(fbl::StringPiece name);
+
+    // Adds the record |de|, which starts at |off|.
+    zx_status_t Insert(minfs_dirent_t* de, size_t off);
+    // Forgets every record starting within [start, end).
+    void Erase(size_t start, size_t end);
+
+    // The records immediately before and after |record|, if any.
+    Record* Prev(Record* record);
+    Record* Next(Record* record);
+
+    // Iterates over the in-use records whose names hash like |name|.
+    Record* FirstNamed(fbl::StringPiece name);
+    Record* NextNamed(Record* record);
+
+    // Returns the record with the least unused space of at least |size| bytes.
+    Record* FindFree(uint32_t size);
+
+    // Returns the number of pairs of in-use records of |vn| with the same
+    // name. Only a corrupt directory has any.
+    size_t CountDuplicateNames(VnodeMinfs* vn);
+
+    struct Record {
+        using OffsetState = fbl::WAVLTreeNodeState<fbl::unique_ptr<Record>>;
+        using IndexState = fbl::WAVLTreeNodeState<Record*>;
+
+        uint32_t off;    // Offset of the record within the directory
+        uint32_t reclen; // Bytes spanned by the record
+        uint32_t free;   // Bytes left over for a new dirent
+        uint32_t hash;   // NameHash() of the name, if in use
+        bool in_use;
+
+        OffsetState offset_state;
+        IndexState name_state;
+        IndexState free_state;
+    };
+
+private:
+    struct OffsetTraits {
+        static Record::OffsetState& node_state(Record& r) { return r.offset_state; }
+        static uint32_t GetKey(const Record& r) { return r.off; }
+        static bool LessThan(uint32_t a, uint32_t b) { return a < b; }
+        static bool EqualTo(uint32_t a, uint32_t b) { return a == b; }
+    };
+    // In-use records by (hash, offset).
+    struct NameTraits {
+        static Record::IndexState& node_state(Record& r) { return r.name_state; }
+        static uint64_t GetKey(const Record& r) {
+            return (static_cast<uint64_t>(r.hash) << 32) | r.off;
+        }
+        static bool LessThan(uint64_t a, uint64_t b) { return a < b; }
+        static bool EqualTo(uint64_t a, uint64_t b) { return a == b; }
+    };
+    // Records with unused space by (free, offset).
+    struct FreeTraits {
+        static Record::IndexState& node_state(Record& r) { return r.free_state; }
+        static uint64_t GetKey(const Record& r) {
+            return (static_cast<uint64_t>(r.free) << 32) | r.off;
+        }
+        static bool LessThan(uint64_t a, uint64_t b) { return a < b; }
+        static bool EqualTo(uint64_t a, uint64_t b) { return a == b; }
+    };
+
+    fbl::WAVLTree<uint32_t, fbl::unique_ptr<Record>, OffsetTraits, OffsetTraits> records_;
+    fbl::WAVLTree<uint64_t, Record*, NameTraits, NameTraits> names_;
+    fbl::WAVLTree<uint64_t, Record*, FreeTraits, FreeTraits> free_;
+};
+
 // clang-format off
 constexpr uint32_t kMinfsFlagDeletedDirectory = 0x00000001;
 // clang-format on
@@ -230,6 +452,12 @@ public:
     ino_t ino_{};
     minfs_inode_t inode_{};
 
+#ifdef __Fuchsia__
+    // Drops all resident file data from the VMO, which must be clean.
+    // Returns the number of blocks evicted.
+    uint64_t EvictVmo();
+#endif
+
     ~VnodeMinfs();
 
 private:
@@ -262,7 +490,16 @@ private:
 
 #ifdef __Fuchsia__
     zx_status_t AttachRemote(fs::MountChannel h) final;
+    // Creates the (initially empty) VMO backing the file's contents.
     zx_status_t InitVmo();
+    // Ensures that blocks [start, end) of the file are resident in the VMO,
+    // reading any missing blocks, and a chunk around them, from disk.
+    zx_status_t LoadVmoRange(blk_t start, blk_t end);
+    // Records that blocks [start, end) of the VMO hold the file's contents.
+    void MarkVmoResident(blk_t start, blk_t end);
+    // Forgets any resident blocks at or past |start|, which have been
+    // truncated away.
+    void TruncateVmoResident(blk_t start);
     zx_status_t InitIndirectVmo();
     // Loads indirect blocks up to and including the doubly indirect block at |index|
     zx_status_t LoadIndirectWithinDoublyIndirect(uint32_t index);
@@ -282,6 +519,14 @@ private:
     // Example call for accessing the 0th direct block in the inode:
     // GetBnoDirect(txn, &inode_.dnum[0], &dirty);
     zx_status_t GetBnoDirect(WriteTxn* txn, blk_t* bno, bool* dirty);
+    // Allocates a data block for the write in progress, from its reserved
+    // run if one remains.
+    zx_status_t BlockNewReserved(WriteTxn* txn, blk_t* bno);
+    // Prepares to allocate, as one contiguous run, the blocks [start, end)
+    // of the file which do not yet exist.
+    void ReserveBlocks(blk_t start, blk_t end);
+    // Frees whatever remains of the reserved run.
+    void ReleaseReservedBlocks(WriteTxn* txn);
     // Acquire (or allocate) a direct block |*bno| contained at index |bindex| within an indirect
     // block |*ibno|, which is allocated if necessary. If allocation of the indirect block occurs,
     // |*dirty| is set to true, and the indirect and inode blocks are written to disk.
@@ -360,6 +605,21 @@ private:
 
     // Directories only
     zx_status_t ForEachDirent(DirArgs* args, const DirentCallback func);
+    // Calls 'func' on the direntries which may be named 'args->name', in the
+    // same manner as ForEachDirent.
+    zx_status_t ForEachNamedDirent(DirArgs* args, const DirentCallback func);
+    // Adds a direntry for 'args', using free space anywhere in the directory.
+    zx_status_t AppendDirent(DirArgs* args);
+
+    // Returns the directory's index, building it if needed, or nullptr if
+    // the directory is small enough to scan.
+    DirectoryIndex* GetDirectoryIndex();
+    // Reads the records starting in [start, end) into 'index'.
+    zx_status_t IndexDirents(DirectoryIndex* index, size_t start, size_t end);
+    // Calls 'func' on 'record', re-reading the records around it into the
+    // index if 'func' modifies the directory.
+    zx_status_t IndexedDirentOp(DirArgs* args, const DirentCallback func,
+                                DirectoryIndex::Record* record);
 
 #ifdef __Fuchsia__
     // The following functionality interacts with handles directly, and are not applicable outside
@@ -368,11 +628,16 @@ private:
     zx_status_t VmoReadExact(void* data, uint64_t offset, size_t len);
     zx_status_t VmoWriteExact(const void* data, uint64_t offset, size_t len);
 
+    // The file's contents. Blocks are read in on demand as ReadInternal and
+    // WriteInternal touch them; |vmo_resident_| tracks which blocks of the
+    // VMO are valid. Everything else reads as zero until it is loaded.
+    //
     // TODO(smklein): When we have can register MinFS as a pager service, and
-    // it can properly handle pages faults on a vnode's contents, then we can
-    // avoid reading the entire file up-front. Until then, read the contents of
-    // a VMO into memory when it is read/written.
+    // it can properly handle pages faults on a vnode's contents, the kernel
+    // could track residency for us.
     zx::vmo vmo_{};
+    bitmap::RleBitmap vmo_resident_{};
+    uint64_t vmo_resident_blocks_{};
 
     // vmo_indirect_ contains all indirect and doubly indirect blocks in the following order:
     // First kMinfsIndirect blocks                                - initial set of indirect blocks
@@ -397,6 +662,16 @@ private:
     fs::RemoteContainer remoter_{};
     fs::WatcherContainer watcher_{};
 #endif
+    fbl::unique_ptr<DirectoryIndex> dir_index_{};
+
+    // Data blocks allocated for, but not yet used by, the write in progress:
+    // [reserve_bno_, reserve_bno_ + reserve_count_). 'reserve_wanted_' is the
+    // number of blocks that write has yet to allocate.
+    blk_t reserve_bno_{};
+    blk_t reserve_count_{};
+    blk_t reserve_wanted_{};
+    blk_t reserve_hint_{};
+
     uint32_t flags_{};
 };
 
@@ -32,6 +32,8 @@ void minfs_dump_info(const minfs_info_t* info) {
     FS_TRACE(MINFS, "minfs: alloc bitmap @ %10u\n", info->abm_block);
     FS_TRACE(MINFS, "minfs: inode table  @ %10u\n", info->ino_block);
     FS_TRACE(MINFS, "minfs: data blocks  @ %10u\n", info->dat_block);
+    FS_TRACE(MINFS, "minfs: journal      @ %10u (%u blocks)\n", info->jnl_block,
+             info->jnl_blocks);
     FS_TRACE(MINFS, "minfs: FVM-aware: %s\n", (info->flags & kMinfsFlagFVM) ? "YES" : "NO");
 }
 
@@ -185,6 +187,20 @@ zx_status_t minfs_check_info(const minfs_info_t* info, Bcache* bc) {
             return ZX_ERR_INVALID_ARGS;
         }
     }
+    if (info->jnl_blocks != 0) {
+        // The journal lives in the otherwise unused blocks between the
+        // superblock and the inode bitmap.
+        if ((info->jnl_blocks < 2) || (info->jnl_block < 1) ||
+            (info->jnl_block + info->jnl_blocks > info->ibm_block)) {
+            FS_TRACE_ERROR("minfs: bad journal location %u (%u blocks)\n", info->jnl_block,
+                           info->jnl_blocks);
+            return ZX_ERR_INVALID_ARGS;
+        } else if ((info->flags & kMinfsFlagFVM) &&
+                   (info->jnl_block + info->jnl_blocks > info->slice_size / kMinfsBlockSize)) {
+            FS_TRACE_ERROR("minfs: journal does not fit in the first slice\n");
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
     //TODO: validate layout
     return 0;
 }
@@ -471,6 +487,9 @@ zx_status_t Minfs::AddBlocks() {
     // Grow before shrinking to ensure the underlying storage is a multiple
     // of kMinfsBlockSize.
     block_map_.Shrink(blocks);
+    if (InitBlockSummary() != ZX_OK) {
+        return ZX_ERR_NO_MEMORY;
+    }
     if (abmblks > abmblks_old) {
         txn.Enqueue(block_map_vmoid_, abmblks_old, info_.abm_block + abmblks_old,
                     abmblks - abmblks_old);
@@ -565,6 +584,29 @@ void Minfs::VnodeRelease(VnodeMinfs* vn) {
     vnode_hash_.erase(*vn);
 }
 
+#ifdef __Fuchsia__
+void Minfs::ReclaimResidentBlocks(VnodeMinfs* active) {
+    if (resident_blocks_ <= kMinfsResidentBlockLimit) {
+        return;
+    }
+
+    // Only data which has reached the disk may be dropped; after the
+    // writeback queue drains, every resident block is clean.
+    if (bc_->FlushWriteback() != ZX_OK) {
+        return;
+    }
+
+    for (auto& vn : vnode_hash_) {
+        if (resident_blocks_ <= kMinfsResidentBlockLimit / 2) {
+            break;
+        }
+        if (&vn != active) {
+            vn.EvictVmo();
+        }
+    }
+}
+#endif
+
 zx_status_t Minfs::VnodeGet(fbl::RefPtr<VnodeMinfs>* out, ino_t ino) {
     if ((ino < 1) || (ino >= info_.inode_count)) {
         return ZX_ERR_OUT_OF_RANGE;
@@ -596,60 +638,161 @@ zx_status_t Minfs::VnodeGet(fbl::RefPtr<VnodeMinfs>* out, ino_t ino) {
     return ZX_OK;
 }
 
-zx_status_t Minfs::BlockFree(WriteTxn* txn, blk_t bno) {
-    ValidateBno(bno);
+zx_status_t Minfs::InitBlockSummary() {
+    size_t groups = (block_map_.size() + kMinfsBlockGroupBits - 1) / kMinfsBlockGroupBits;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint32_t[]> group_free(new (&ac) uint32_t[groups]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (size_t g = 0; g < groups; g++) {
+        size_t bitoff = g * kMinfsBlockGroupBits;
+        size_t bitmax = fbl::min(bitoff + kMinfsBlockGroupBits, block_map_.size());
+        uint32_t free = 0;
+        while (bitoff < bitmax) {
+            size_t first_free = block_map_.Scan(bitoff, bitmax, true);
+            size_t first_used = block_map_.Scan(first_free, bitmax, false);
+            free += static_cast<uint32_t>(first_used - first_free);
+            bitoff = first_used;
+        }
+        group_free[g] = free;
+    }
+    block_group_free_ = fbl::move(group_free);
+    block_groups_ = groups;
+    return ZX_OK;
+}
+
+void Minfs::UpdateBlockSummary(size_t start, size_t end, bool allocated) {
+    while (start < end) {
+        size_t g = start / kMinfsBlockGroupBits;
+        size_t group_end = fbl::min((g + 1) * kMinfsBlockGroupBits, end);
+        uint32_t count = static_cast<uint32_t>(group_end - start);
+        if (allocated) {
+            ZX_DEBUG_ASSERT(block_group_free_[g] >= count);
+            block_group_free_[g] -= count;
+        } else {
+            block_group_free_[g] += count;
+        }
+        start = group_end;
+    }
+}
 
+zx_status_t Minfs::FindBlocks(size_t start, size_t end, size_t count, size_t* out) const {
+    ZX_DEBUG_ASSERT(end <= block_map_.size());
+    size_t g = start / kMinfsBlockGroupBits;
+    while (start < end) {
+        if (block_group_free_[g] == 0) {
+            g++;
+            start = g * kMinfsBlockGroupBits;
+            continue;
+        }
+        // A free run may only span consecutive groups which are not full.
+        size_t free = 0;
+        size_t span_end = start;
+        while ((span_end < end) && (block_group_free_[g] != 0)) {
+            free += block_group_free_[g];
+            g++;
+            span_end = fbl::min(g * kMinfsBlockGroupBits, end);
+        }
+        if ((free >= count) && (block_map_.Find(false, start, span_end, count, out) == ZX_OK)) {
+            return ZX_OK;
+        }
+        start = span_end;
+    }
+    return ZX_ERR_NO_RESOURCES;
+}
+
+void Minfs::UpdateBlockMap(WriteTxn* txn, blk_t bno, blk_t count, bool allocated) {
+    zx_status_t status;
+    if (allocated) {
+        status = block_map_.Set(bno, bno + count);
+        info_.alloc_block_count += count;
+    } else {
+        status = block_map_.Clear(bno, bno + count);
+        info_.alloc_block_count -= count;
+    }
+    assert(status == ZX_OK);
+    UpdateBlockSummary(bno, bno + count, allocated);
+
+    // The bitmap blocks covering the run, relative to the bitmap
+    blk_t bmbno_start = bno / kMinfsBlockBits;
+    blk_t bmbno_end = (bno + count - 1) / kMinfsBlockBits + 1;
+
+// commit the bitmap
 #ifdef __Fuchsia__
-    auto bbm_id = block_map_vmoid_;
+    txn->Enqueue(block_map_vmoid_, bmbno_start, info_.abm_block + bmbno_start,
+                 bmbno_end - bmbno_start);
 #else
-    auto bbm_id = block_map_.StorageUnsafe()->GetData();
+    // Allocations reach the on-disk bitmap immediately; frees are written
+    // with the transaction.
+    if (allocated) {
+        for (blk_t n = bmbno_start; n < bmbno_end; n++) {
+            void* bmdata = fs::GetBlock<kMinfsBlockSize>(block_map_.StorageUnsafe()->GetData(), n);
+            bc_->Writeblk(info_.abm_block + n, bmdata);
+        }
+    } else {
+        txn->Enqueue(block_map_.StorageUnsafe()->GetData(), bmbno_start,
+                     info_.abm_block + bmbno_start, bmbno_end - bmbno_start);
+    }
 #endif
+}
 
-    block_map_.Clear(bno, bno + 1);
-    info_.alloc_block_count--;
-    blk_t bitbno = bno / kMinfsBlockBits;
-    txn->Enqueue(bbm_id, bitbno, info_.abm_block + bitbno, 1);
+zx_status_t Minfs::BlocksFree(WriteTxn* txn, blk_t bno, blk_t count) {
+    ValidateBno(bno);
+    ValidateBno(bno + count - 1);
+
+    UpdateBlockMap(txn, bno, count, false);
     return CountUpdate(txn);
 }
 
-// Allocate a new data block from the block bitmap.
+// Allocate new data blocks from the block bitmap.
 //
 // If hint is nonzero it indicates which block number to start the search for
-// free blocks from.
-zx_status_t Minfs::BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno) {
+// free blocks from. Shorter runs are only considered when no run of 'count'
+// free blocks exists anywhere in the bitmap.
+zx_status_t Minfs::BlocksNew(WriteTxn* txn, blk_t hint, blk_t count,
+                             blk_t* out_bno, blk_t* out_count) {
+    ZX_DEBUG_ASSERT(count > 0);
+    if (hint >= block_map_.size()) {
+        hint = 0;
+    }
+
     size_t bitoff_start;
-    zx_status_t status;
-    if ((status = block_map_.Find(false, hint, block_map_.size(), 1, &bitoff_start)) != ZX_OK) {
-        if ((status = block_map_.Find(false, 0, hint, 1, &bitoff_start)) != ZX_OK) {
-            size_t old_size = block_map_.size();
-            if ((status = AddBlocks()) != ZX_OK) {
-                return status;
-            } else if ((status = block_map_.Find(false, old_size, block_map_.size(),
-                                                 1, &bitoff_start)) != ZX_OK) {
-                return status;
+    zx_status_t status = ZX_ERR_NO_RESOURCES;
+    size_t run = count;
+    for (; run > 0; run /= 2) {
+        if ((status = FindBlocks(hint, block_map_.size(), run, &bitoff_start)) == ZX_OK) {
+            break;
+        }
+        // Runs ending at or past 'hint' were not covered by the search above.
+        size_t wrap_end = fbl::min(static_cast<size_t>(hint) + run - 1, block_map_.size());
+        if ((status = FindBlocks(0, wrap_end, run, &bitoff_start)) == ZX_OK) {
+            break;
+        }
+    }
+    if (status != ZX_OK) {
+        size_t old_size = block_map_.size();
+        if ((status = AddBlocks()) != ZX_OK) {
+            return status;
+        }
+        for (run = count; run > 0; run /= 2) {
+            if ((status = FindBlocks(old_size, block_map_.size(), run, &bitoff_start)) == ZX_OK) {
+                break;
             }
         }
+        if (status != ZX_OK) {
+            return status;
+        }
     }
 
-    status = block_map_.Set(bitoff_start, bitoff_start + 1);
-    assert(status == ZX_OK);
-    info_.alloc_block_count++;
     blk_t bno = static_cast<blk_t>(bitoff_start);
+    blk_t len = static_cast<blk_t>(run);
     ValidateBno(bno);
+    ValidateBno(bno + len - 1);
+    UpdateBlockMap(txn, bno, len, true);
 
-    // obtain the in-memory bitmap block
-    blk_t bmbno_rel = bno / kMinfsBlockBits;       // bmbno relative to bitmap
-    blk_t bmbno_abs = info_.abm_block + bmbno_rel; // bmbno relative to block device
-
-// commit the bitmap
-#ifdef __Fuchsia__
-    txn->Enqueue(block_map_vmoid_, bmbno_rel, bmbno_abs, 1);
-#else
-    void* bmdata = fs::GetBlock<kMinfsBlockSize>(block_map_.StorageUnsafe()->GetData(), bmbno_rel);
-    bc_->Writeblk(bmbno_abs, bmdata);
-#endif
     *out_bno = bno;
-
+    *out_count = len;
     CountUpdate(txn);
     return ZX_OK;
 }
@@ -705,6 +848,31 @@ zx_status_t Minfs::Create(Minfs** out, fbl::unique_ptr<Bcache> bc, const minfs_i
         return ZX_ERR_INVALID_ARGS;
     }
 #endif
+
+    // Apply any transaction left committed in the journal before reading
+    // metadata. The transaction may have rewritten the info block itself.
+    uint64_t jnl_seq = 0;
+    char info_blk[kMinfsBlockSize];
+#ifdef __Fuchsia__
+    bool replay = (info->jnl_blocks != 0);
+#else
+    // Sparse images are produced by the host tools and never journaled.
+    bool replay = (info->jnl_blocks != 0) && (bc->extent_lengths_.size() == 0);
+#endif
+    if (replay) {
+        if ((status = minfs_replay_journal(bc.get(), info, &jnl_seq)) != ZX_OK) {
+            FS_TRACE_ERROR("minfs: failed to replay journal\n");
+            return status;
+        } else if ((status = bc->Readblk(0, info_blk)) != ZX_OK) {
+            FS_TRACE_ERROR("minfs: could not read info block\n");
+            return status;
+        }
+        info = reinterpret_cast<const minfs_info_t*>(info_blk);
+        if ((status = minfs_check_info(info, bc.get())) != ZX_OK) {
+            return status;
+        }
+    }
+
     fbl::AllocChecker ac;
     fbl::unique_ptr<Minfs> fs(new (&ac) Minfs(fbl::move(bc), info));
     if (!ac.check()) {
@@ -775,6 +943,12 @@ zx_status_t Minfs::Create(Minfs** out, fbl::unique_ptr<Bcache> bc, const minfs_i
         return status;
     }
 
+    if (fs->info_.jnl_blocks != 0) {
+        if ((status = fs->bc_->InitJournal(fs->info_.jnl_block, fs->info_.jnl_blocks,
+                                           fs->info_.dat_block, jnl_seq)) != ZX_OK) {
+            return status;
+        }
+    }
 #else
     for (uint32_t n = 0; n < fs->abmblks_; n++) {
         void* bmdata = fs::GetBlock<kMinfsBlockSize>(fs->block_map_.StorageUnsafe()->GetData(), n);
@@ -790,6 +964,10 @@ zx_status_t Minfs::Create(Minfs** out, fbl::unique_ptr<Bcache> bc, const minfs_i
     }
 #endif
 
+    if ((status = fs->InitBlockSummary()) != ZX_OK) {
+        return status;
+    }
+
     *out = fs.release();
     return ZX_OK;
 }
@@ -942,7 +1120,8 @@ int minfs_mkfs(fbl::unique_ptr<Bcache> bc) {
     info.alloc_inode_count = 0;
     if ((info.flags & kMinfsFlagFVM) == 0) {
         // Aligning distinct data areas to 8 block groups.
-        uint32_t non_dat_blocks = (8 + fbl::round_up(ibmblks, 8u) + inoblks);
+        uint32_t non_dat_blocks = (kMinfsJournalStart + fbl::round_up(kMinfsJournalBlocks, 8u) +
+                                   fbl::round_up(ibmblks, 8u) + inoblks);
         if (non_dat_blocks >= blocks) {
             fprintf(stderr, "mkfs: Partition size (%" PRIu64 " bytes) is too small\n",
                     static_cast<uint64_t>(blocks) * kMinfsBlockSize);
@@ -952,13 +1131,22 @@ int minfs_mkfs(fbl::unique_ptr<Bcache> bc) {
         uint32_t dat_block_count = blocks - non_dat_blocks;
         abmblks = (dat_block_count + kMinfsBlockBits - 1) / kMinfsBlockBits;
         info.block_count = dat_block_count - fbl::round_up(abmblks, 8u);
-        info.ibm_block = 8;
+        info.jnl_block = kMinfsJournalStart;
+        info.jnl_blocks = kMinfsJournalBlocks;
+        info.ibm_block = kMinfsJournalStart + fbl::round_up(kMinfsJournalBlocks, 8u);
         info.abm_block = info.ibm_block + fbl::round_up(ibmblks, 8u);
         info.ino_block = info.abm_block + fbl::round_up(abmblks, 8u);
         info.dat_block = info.ino_block + inoblks;
     } else {
         info.block_count = blocks;
         abmblks = (info.block_count + kMinfsBlockBits - 1) / kMinfsBlockBits;
+        // The journal fills the rest of the superblock's slice.
+        const uint32_t kBlocksPerSlice = static_cast<uint32_t>(info.slice_size / kMinfsBlockSize);
+        info.jnl_block = kFVMBlockJournalStart;
+        info.jnl_blocks = fbl::min(kMinfsJournalBlocks, kBlocksPerSlice - kFVMBlockJournalStart);
+        if (info.jnl_blocks < 2) {
+            info.jnl_blocks = 0;
+        }
         info.ibm_block = kFVMBlockInodeBmStart;
         info.abm_block = kFVMBlockDataBmStart;
         info.ino_block = kFVMBlockInodeStart;
@@ -1026,6 +1214,12 @@ int minfs_mkfs(fbl::unique_ptr<Bcache> bc) {
         bc->Writeblk(info.ibm_block + n, blk);
     }
 
+    // write an empty journal header
+    memset(blk, 0, sizeof(blk));
+    if (info.jnl_blocks != 0) {
+        bc->Writeblk(info.jnl_block, blk);
+    }
+
     // write inodes
     memset(blk, 0, sizeof(blk));
     for (uint32_t n = 0; n < inoblks; n++) {
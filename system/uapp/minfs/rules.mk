@@ -22,6 +22,8 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/minfs.cpp \
     $(LOCAL_DIR)/minfs-ops.cpp \
     $(LOCAL_DIR)/minfs-check.cpp \
+    $(LOCAL_DIR)/directory-index.cpp \
+    $(LOCAL_DIR)/journal.cpp \
 
 MODULE_STATIC_LIBS := \
     system/ulib/fs \
@@ -48,6 +50,8 @@ MODULE_HOST_SRCS := \
     $(LOCAL_DIR)/minfs.cpp \
     $(LOCAL_DIR)/minfs-ops.cpp \
     $(LOCAL_DIR)/minfs-check.cpp \
+    $(LOCAL_DIR)/directory-index.cpp \
+    $(LOCAL_DIR)/journal.cpp \
     system/ulib/bitmap/raw-bitmap.cpp \
     system/ulib/fs/vfs.cpp \
     system/ulib/fs/vnode.cpp \
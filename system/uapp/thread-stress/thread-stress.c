@@ -2,13 +2,19 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 
 #include <zircon/syscalls.h>
 
 #define NUM_THREADS 1000
 
+#define WAKEUP_SECONDS 5
+
 static int thread_func(void* arg) {
   return 0;
 }
@@ -27,7 +33,97 @@ static void thread_join(thrd_t thread) {
   }
 }
 
+// A pair of threads which hand a token back and forth through a futex, so
+// every pass is a wakeup of a blocked thread followed by a context switch.
+typedef struct {
+  zx_futex_t turn;
+  atomic_bool* stop;
+} wakeup_pair_t;
+
+typedef struct {
+  wakeup_pair_t* pair;
+  int self;
+  uint64_t passes;
+} wakeup_thread_t;
+
+static int wakeup_func(void* arg) {
+  wakeup_thread_t* w = arg;
+  wakeup_pair_t* pair = w->pair;
+  while (!atomic_load(pair->stop)) {
+    int turn = atomic_load(&pair->turn);
+    if (turn != w->self) {
+      // Time out now and then so a stop request is noticed.
+      zx_futex_wait(&pair->turn, turn, zx_deadline_after(ZX_MSEC(100)));
+      continue;
+    }
+    atomic_store(&pair->turn, !w->self);
+    zx_futex_wake(&pair->turn, 1);
+    w->passes++;
+  }
+  return 0;
+}
+
+// Runs one ping-pong pair per cpu for |seconds| and reports the rate of
+// cross-thread wakeups, each of which costs a context switch on the woken cpu.
+static int run_wakeup_test(int seconds) {
+  uint32_t num_cpus = zx_system_get_num_cpus();
+  uint32_t num_pairs = num_cpus;
+  wakeup_pair_t* pairs = calloc(num_pairs, sizeof(*pairs));
+  wakeup_thread_t* workers = calloc(num_pairs * 2, sizeof(*workers));
+  thrd_t* threads = calloc(num_pairs * 2, sizeof(*threads));
+  if (pairs == NULL || workers == NULL || threads == NULL) {
+    printf("Failed to allocate %u wakeup pairs\n", num_pairs);
+    return 1;
+  }
+
+  printf("Running wakeup test: %u pairs on %u cpus for %ds...\n",
+         num_pairs, num_cpus, seconds);
+
+  atomic_bool stop = false;
+  for (uint32_t i = 0; i < num_pairs; i++) {
+    atomic_store(&pairs[i].turn, 0);
+    pairs[i].stop = &stop;
+    for (int j = 0; j < 2; j++) {
+      workers[i * 2 + j].pair = &pairs[i];
+      workers[i * 2 + j].self = j;
+    }
+  }
+
+  zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+  for (uint32_t i = 0; i < num_pairs * 2; i++) {
+    int ret = thrd_create_with_name(&threads[i], wakeup_func, &workers[i], "wakeup");
+    if (ret != thrd_success) {
+      printf("Failed to create thread: %d\n", ret);
+      return 1;
+    }
+  }
+  zx_nanosleep(zx_deadline_after(ZX_SEC(seconds)));
+  atomic_store(&stop, true);
+  for (uint32_t i = 0; i < num_pairs * 2; i++) {
+    thread_join(threads[i]);
+  }
+  zx_time_t end = zx_time_get(ZX_CLOCK_MONOTONIC);
+
+  uint64_t passes = 0;
+  for (uint32_t i = 0; i < num_pairs * 2; i++) {
+    passes += workers[i].passes;
+  }
+  double elapsed = (end - start) / 1e9;
+  printf("%" PRIu64 " wakeups in %.2fs: %.0f context switches/s, %.0f per cpu\n",
+         passes, elapsed, passes / elapsed, passes / elapsed / num_cpus);
+
+  free(threads);
+  free(workers);
+  free(pairs);
+  return 0;
+}
+
 int main(int argc, char** argv) {
+    if (argc > 1 && !strcmp(argv[1], "wakeup")) {
+        int seconds = argc > 2 ? atoi(argv[2]) : WAKEUP_SECONDS;
+        return run_wakeup_test(seconds > 0 ? seconds : WAKEUP_SECONDS);
+    }
+
     printf("Running thread stress test...\n");
     thrd_t thread[NUM_THREADS];
     while (true) {
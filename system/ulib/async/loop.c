@@ -7,10 +7,12 @@
 #include <assert.h>
 #include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <zircon/assert.h>
 #include <zircon/listnode.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
 
 #include <async/receiver.h>
 #include <async/task.h>
@@ -19,6 +21,9 @@
 // The port wait key associated with the dispatcher's control messages.
 #define KEY_CONTROL (0u)
 
+// The maximum number of packets to dequeue from the port with each wait.
+#define BATCH_SIZE (ZX_PORT_MAX_BATCH)
+
 static zx_status_t async_loop_begin_wait(async_t* async, async_wait_t* wait);
 static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait);
 static zx_status_t async_loop_post_task(async_t* async, async_task_t* task);
@@ -53,9 +58,14 @@ typedef struct async_loop {
     list_node_t task_list; // pending tasks, earliest deadline first
     list_node_t due_list; // due tasks, earliest deadline first
     list_node_t thread_list; // earliest created thread first
+    zx_port_packet_t batch[BATCH_SIZE]; // packets dequeued but not yet dispatched
+    size_t batch_head; // index of the next packet to dispatch in |batch|
+    size_t batch_count; // number of packets remaining in |batch|
 } async_loop_t;
 
 static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline);
+static zx_status_t async_loop_next_packet(async_loop_t* loop, zx_time_t deadline,
+                                          zx_port_packet_t* out_packet);
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal);
 static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop);
@@ -158,6 +168,12 @@ void async_loop_shutdown(async_t* async) {
     async_loop_wake_threads(loop);
     async_loop_join_threads(async);
 
+    // Drop any packets which were dequeued but never dispatched.  Waits which
+    // want to observe shutdown are still on |wait_list| and are notified below.
+    mtx_lock(&loop->lock);
+    loop->batch_count = 0u;
+    mtx_unlock(&loop->lock);
+
     list_node_t* node;
     while ((node = list_remove_head(&loop->wait_list))) {
         async_wait_t* wait = node_to_wait(node);
@@ -202,7 +218,7 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
         return ZX_ERR_CANCELED;
 
     zx_port_packet_t packet;
-    zx_status_t status = zx_port_wait(loop->port, deadline, &packet, 0);
+    zx_status_t status = async_loop_next_packet(loop, deadline, &packet);
     if (status != ZX_OK)
         return status;
 
@@ -234,6 +250,44 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
     return ZX_ERR_INTERNAL;
 }
 
+static zx_status_t async_loop_next_packet(async_loop_t* loop, zx_time_t deadline,
+                                          zx_port_packet_t* out_packet) {
+    // Dispatch packets left over from an earlier batch first.
+    mtx_lock(&loop->lock);
+    if (loop->batch_count != 0u) {
+        *out_packet = loop->batch[loop->batch_head++];
+        loop->batch_count--;
+        mtx_unlock(&loop->lock);
+        return ZX_OK;
+    }
+    mtx_unlock(&loop->lock);
+
+    // Only drain the port in batches while a single thread is servicing the
+    // loop.  Otherwise the other threads would sit idle in |port_wait| while
+    // this one works through the batch.
+    uint32_t n = atomic_load_explicit(&loop->active_threads, memory_order_acquire);
+    if (n > 1u)
+        return zx_port_wait(loop->port, deadline, out_packet, 1u);
+
+    zx_port_packet_t packets[BATCH_SIZE];
+    size_t actual = 0u;
+    zx_status_t status = zx_port_wait_many(loop->port, deadline, packets, BATCH_SIZE, &actual);
+    if (status != ZX_OK)
+        return status;
+    ZX_DEBUG_ASSERT(actual > 0u && actual <= BATCH_SIZE);
+
+    *out_packet = packets[0];
+    if (actual > 1u) {
+        mtx_lock(&loop->lock);
+        ZX_DEBUG_ASSERT(loop->batch_count == 0u);
+        memcpy(loop->batch, &packets[1], (actual - 1u) * sizeof(zx_port_packet_t));
+        loop->batch_head = 0u;
+        loop->batch_count = actual - 1u;
+        mtx_unlock(&loop->lock);
+    }
+    return ZX_OK;
+}
+
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal) {
     // We must dequeue the handler before invoking it since it might destroy itself.
@@ -347,13 +401,18 @@ static void async_loop_wake_threads(async_loop_t* loop) {
     // cannot be less than the number of threads which might be blocked in |port_wait|.
     // Issuing too many packets is also harmless.
     uint32_t n = atomic_load_explicit(&loop->active_threads, memory_order_acquire);
-    for (uint32_t i = 0u; i < n; i++) {
-        zx_port_packet_t packet = {
+    zx_port_packet_t packets[BATCH_SIZE];
+    for (uint32_t i = 0u; i < BATCH_SIZE; i++) {
+        packets[i] = (zx_port_packet_t){
             .key = KEY_CONTROL,
             .type = ZX_PKT_TYPE_USER,
             .status = ZX_OK};
-        zx_status_t status = zx_port_queue(loop->port, &packet, 0u);
+    }
+    while (n > 0u) {
+        uint32_t count = n < BATCH_SIZE ? n : BATCH_SIZE;
+        zx_status_t status = zx_port_queue(loop->port, packets, count);
         ZX_DEBUG_ASSERT_MSG(status == ZX_OK, "status=%d", status);
+        n -= count;
     }
 }
 
@@ -429,6 +488,20 @@ static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait) {
     // invoked again past this point.
     zx_status_t status = zx_port_cancel(loop->port, wait->object,
                                         (uintptr_t)wait);
+    if (status == ZX_ERR_NOT_FOUND) {
+        // The completion packet may already have been dequeued as part of a
+        // batch.  If so, neuter it into a wake-up packet so it is never dispatched.
+        mtx_lock(&loop->lock);
+        for (size_t i = 0u; i < loop->batch_count; i++) {
+            zx_port_packet_t* packet = &loop->batch[loop->batch_head + i];
+            if (packet->key == (uintptr_t)wait && packet->type == ZX_PKT_TYPE_SIGNAL_ONE) {
+                packet->key = KEY_CONTROL;
+                packet->type = ZX_PKT_TYPE_USER;
+                status = ZX_OK;
+            }
+        }
+        mtx_unlock(&loop->lock);
+    }
     if (status == ZX_OK && (wait->flags & ASYNC_FLAG_HANDLE_SHUTDOWN)) {
         mtx_lock(&loop->lock);
         list_delete(wait_to_node(wait));
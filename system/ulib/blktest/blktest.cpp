@@ -518,6 +518,148 @@ bool blkdev_test_fifo_multiple_vmo_multithreaded(void) {
     END_TEST;
 }
 
+bool blkdev_test_fifo_multiple_queues(void) {
+    BEGIN_TEST;
+    uint64_t kBlockSize, blk_count;
+    int fd = get_testdev(&kBlockSize, &blk_count);
+    zx_handle_t fifos[MAX_BLOCK_FIFOS];
+    ssize_t expected = sizeof(zx_handle_t);
+    ASSERT_EQ(ioctl_block_add_fifo(fd, &fifos[0]), ZX_ERR_BAD_STATE,
+              "Added a FIFO without a server");
+    ASSERT_EQ(ioctl_block_get_fifos(fd, &fifos[0]), expected, "Failed to get FIFO");
+    for (size_t i = 1; i < MAX_BLOCK_FIFOS; i++) {
+        ASSERT_EQ(ioctl_block_add_fifo(fd, &fifos[i]), expected, "Failed to add FIFO");
+    }
+    zx_handle_t extra;
+    ASSERT_EQ(ioctl_block_add_fifo(fd, &extra), ZX_ERR_NO_RESOURCES,
+              "Added more FIFOs than allowed");
+
+    // Each thread uses a queue of its own; VMOs and txns are shared by all.
+    fifo_client_t* clients[MAX_BLOCK_FIFOS];
+    test_vmo_object_t objs[MAX_BLOCK_FIFOS];
+    thrd_t threads[MAX_BLOCK_FIFOS];
+    test_thread_arg_t thread_args[MAX_BLOCK_FIFOS];
+    for (size_t i = 0; i < MAX_BLOCK_FIFOS; i++) {
+        ASSERT_EQ(block_fifo_create_client(fifos[i], &clients[i]), ZX_OK, "");
+        thread_args[i].obj = &objs[i];
+        thread_args[i].i = i;
+        thread_args[i].objs = MAX_BLOCK_FIFOS;
+        thread_args[i].fd = fd;
+        thread_args[i].client = clients[i];
+        thread_args[i].kBlockSize = kBlockSize;
+        ASSERT_EQ(thrd_create(&threads[i], fifo_vmo_thread, &thread_args[i]),
+                  thrd_success, "");
+    }
+    for (size_t i = 0; i < MAX_BLOCK_FIFOS; i++) {
+        int res;
+        ASSERT_EQ(thrd_join(threads[i], &res), thrd_success, "");
+        ASSERT_EQ(res, 0, "");
+    }
+
+    for (size_t i = 0; i < MAX_BLOCK_FIFOS; i++) {
+        block_fifo_release_client(clients[i]);
+    }
+    ASSERT_EQ(ioctl_block_fifo_close(fd), ZX_OK, "Failed to close fifo");
+    close(fd);
+    END_TEST;
+}
+
+typedef struct {
+    int fd;
+    fifo_client_t* client;
+    size_t kBlockSize;
+    uint64_t blk_count;
+    size_t ops;
+} queue_iops_arg_t;
+
+// Issues 'ops' single-block reads, scattered over the device, one at a time.
+int queue_iops_thread(void* arg) {
+    queue_iops_arg_t* iopsarg = static_cast<queue_iops_arg_t*>(arg);
+    txnid_t txnid;
+    ssize_t expected = sizeof(txnid_t);
+    ASSERT_EQ(ioctl_block_alloc_txn(iopsarg->fd, &txnid), expected, "Failed to allocate txn");
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(iopsarg->kBlockSize, 0, &vmo), ZX_OK, "Failed to create vmo");
+    zx_handle_t xfer_vmo;
+    ASSERT_EQ(zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &xfer_vmo), ZX_OK, "");
+    vmoid_t vmoid;
+    expected = sizeof(vmoid_t);
+    ASSERT_EQ(ioctl_block_attach_vmo(iopsarg->fd, &xfer_vmo, &vmoid), expected,
+              "Failed to attach vmo");
+
+    block_fifo_request_t request;
+    for (size_t i = 0; i < iopsarg->ops; i++) {
+        request.txnid = txnid;
+        request.vmoid = vmoid;
+        request.opcode = BLOCKIO_READ;
+        request.length = iopsarg->kBlockSize;
+        request.vmo_offset = 0;
+        request.dev_offset = (rand() % iopsarg->blk_count) * iopsarg->kBlockSize;
+        ASSERT_EQ(block_fifo_txn(iopsarg->client, &request, 1), ZX_OK, "");
+    }
+
+    request.txnid = txnid;
+    request.vmoid = vmoid;
+    request.opcode = BLOCKIO_CLOSE_VMO;
+    ASSERT_EQ(block_fifo_txn(iopsarg->client, &request, 1), ZX_OK, "");
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    ASSERT_EQ(ioctl_block_free_txn(iopsarg->fd, &txnid), ZX_OK, "");
+    return 0;
+}
+
+// Measures how small, synchronous reads scale as they are spread over more
+// queues. The result depends on the device, so it is reported rather than
+// checked.
+bool blkdev_test_fifo_queue_scaling(void) {
+    BEGIN_TEST;
+    uint64_t kBlockSize, blk_count;
+    int fd = get_testdev(&kBlockSize, &blk_count);
+    constexpr size_t kOpsPerQueue = 2000;
+
+    printf("\n");
+    for (size_t queues = 1; queues <= MAX_BLOCK_FIFOS; queues *= 2) {
+        zx_handle_t fifo;
+        ssize_t expected = sizeof(zx_handle_t);
+        fifo_client_t* clients[MAX_BLOCK_FIFOS];
+        queue_iops_arg_t args[MAX_BLOCK_FIFOS];
+        thrd_t threads[MAX_BLOCK_FIFOS];
+        for (size_t i = 0; i < queues; i++) {
+            if (i == 0) {
+                ASSERT_EQ(ioctl_block_get_fifos(fd, &fifo), expected, "Failed to get FIFO");
+            } else {
+                ASSERT_EQ(ioctl_block_add_fifo(fd, &fifo), expected, "Failed to add FIFO");
+            }
+            ASSERT_EQ(block_fifo_create_client(fifo, &clients[i]), ZX_OK, "");
+            args[i].fd = fd;
+            args[i].client = clients[i];
+            args[i].kBlockSize = kBlockSize;
+            args[i].blk_count = blk_count;
+            args[i].ops = kOpsPerQueue;
+        }
+
+        zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+        for (size_t i = 0; i < queues; i++) {
+            ASSERT_EQ(thrd_create(&threads[i], queue_iops_thread, &args[i]), thrd_success, "");
+        }
+        for (size_t i = 0; i < queues; i++) {
+            int res;
+            ASSERT_EQ(thrd_join(threads[i], &res), thrd_success, "");
+            ASSERT_EQ(res, 0, "");
+        }
+        zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+        printf("  %zu queue(s): %zu reads in %lu us, %lu IOPS\n", queues,
+               queues * kOpsPerQueue, elapsed / ZX_USEC(1),
+               elapsed ? queues * kOpsPerQueue * ZX_SEC(1) / elapsed : 0);
+
+        for (size_t i = 0; i < queues; i++) {
+            block_fifo_release_client(clients[i]);
+        }
+        ASSERT_EQ(ioctl_block_fifo_close(fd), ZX_OK, "Failed to close fifo");
+    }
+    close(fd);
+    END_TEST;
+}
+
 bool blkdev_test_fifo_unclean_shutdown(void) {
     BEGIN_TEST;
     // Set up the blkdev
@@ -905,6 +1047,8 @@ RUN_TEST(blkdev_test_fifo_basic)
 //RUN_TEST(blkdev_test_fifo_whole_disk)
 RUN_TEST(blkdev_test_fifo_multiple_vmo)
 RUN_TEST(blkdev_test_fifo_multiple_vmo_multithreaded)
+RUN_TEST(blkdev_test_fifo_multiple_queues)
+RUN_TEST(blkdev_test_fifo_queue_scaling)
 // TODO(smklein): Test ops across different vmos
 RUN_TEST(blkdev_test_fifo_unclean_shutdown)
 RUN_TEST(blkdev_test_fifo_large_ops_count)
@@ -38,6 +38,10 @@ typedef struct iotxn iotxn_t;
 // opcodes
 #define IOTXN_OP_READ      1
 #define IOTXN_OP_WRITE     2
+// Flushes the volatile write cache of a block device, so that every write
+// which completed before it is durable. Carries no data. Devices without
+// a volatile write cache complete it once earlier writes have completed.
+#define IOTXN_OP_FLUSH     3
 
 // cache maintenance ops
 #define IOTXN_CACHE_INVALIDATE        ZX_VMO_OP_CACHE_INVALIDATE
@@ -21,6 +21,8 @@ typedef struct block_protocol_ops {
                  uint64_t dev_offset, void* cookie);
     void (*write)(void* ctx, zx_handle_t vmo, uint64_t length, uint64_t vmo_offset,
                   uint64_t dev_offset, void* cookie);
+    // Optional; NULL if the device has no volatile write cache.
+    void (*flush)(void* ctx, void* cookie);
 } block_protocol_ops_t;
 
 typedef struct {
@@ -52,4 +54,11 @@ static inline void block_write(block_protocol_t* block, zx_handle_t vmo, uint64_
     block->ops->write(block->ctx, vmo, length, vmo_offset, dev_offset, cookie);
 }
 
+// Flush the volatile write cache of the block device, so that every write
+// which completed before this call is durable. Completes through the
+// 'complete' callback like a read or write.
+static inline void block_flush(block_protocol_t* block, void* cookie) {
+    block->ops->flush(block->ctx, cookie);
+}
+
 __END_CDECLS;
@@ -108,6 +108,11 @@ __BEGIN_CDECLS;
 #define MMC_CID_SPEC_VRSN_40    3
 
 // EXT_CSD fields (MMC)
+#define MMC_EXT_CSD_FLUSH_CACHE 32
+#define MMC_EXT_CSD_CACHE_CTRL  33
+#define MMC_EXT_CSD_CACHE_SIZE_LSB  249
+#define MMC_EXT_CSD_CACHE_SIZE_MSB  252
+
 #define MMC_EXT_CSD_BUS_WIDTH   183
 #define MMC_EXT_CSD_BUS_WIDTH_8_DDR 6
 #define MMC_EXT_CSD_BUS_WIDTH_4_DDR 5
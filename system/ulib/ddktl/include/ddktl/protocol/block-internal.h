@@ -18,6 +18,7 @@ DECLARE_HAS_MEMBER_FN(has_block_set_callbacks, BlockSetCallbacks);
 DECLARE_HAS_MEMBER_FN(has_block_get_info, BlockGetInfo);
 DECLARE_HAS_MEMBER_FN(has_block_read, BlockRead);
 DECLARE_HAS_MEMBER_FN(has_block_write, BlockWrite);
+DECLARE_HAS_MEMBER_FN(has_block_flush, BlockFlush);
 
 template <typename D>
 constexpr void CheckBlockProtocolSubclass() {
@@ -53,6 +54,12 @@ constexpr void CheckBlockProtocolSubclass() {
                   "'void BlockWrite(zx_handle_t, uint64_t, uint64_t, uint64_t, void*)', and be "
                   "visible to ddk::BlockProtocol<D> (either because they are public, or because of "
                   "friendship).");
+    static_assert(internal::has_block_flush<D>::value,
+                  "BlockProtocol subclasses must implement BlockFlush");
+    static_assert(fbl::is_same<decltype(&D::BlockFlush), void (D::*)(void*)>::value,
+                  "BlockFlush must be a non-static member function with signature "
+                  "'void BlockFlush(void*)', and be visible to ddk::BlockProtocol<D> (either "
+                  "because they are public, or because of friendship).");
 }
 
 }  // namespace internal
@@ -58,6 +58,7 @@ class BlockProtocol : public internal::base_protocol {
         ops_.get_info = GetInfo;
         ops_.read = Read;
         ops_.write = Write;
+        ops_.flush = Flush;
 
         // Can only inherit from one base_protocol implemenation
         ZX_ASSERT(ddk_proto_ops_ == nullptr);
@@ -84,6 +85,10 @@ class BlockProtocol : public internal::base_protocol {
         static_cast<D*>(ctx)->BlockWrite(vmo, length, vmo_offset, dev_offset, cookie);
     }
 
+    static void Flush(void* ctx, void* cookie) {
+        static_cast<D*>(ctx)->BlockFlush(cookie);
+    }
+
     block_protocol_ops_t ops_ = {};
 };
 
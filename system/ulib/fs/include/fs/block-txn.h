@@ -4,9 +4,13 @@
 
 #pragma once
 
+#include <stdlib.h>
+
 #include <zircon/device/block.h>
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/macros.h>
+#include <fbl/vector.h>
 
 #include <fs/vfs.h>
 
@@ -20,15 +24,20 @@ void* GetBlock(const void* data, uint64_t blkno) {
     return (void*)((uintptr_t)(data) + (uintptr_t)(BlockSize * blkno));
 }
 
-// Enqueue multiple writes (or reads) to the underlying block device
-// by shoving them into a simple array, to avoid duplicated ops
-// within a single operation.
+// Enqueue multiple writes (or reads) to the underlying block device,
+// to be issued together when the transaction is flushed.
+//
+// The transaction grows without bound. On Flush, requests are sorted by
+// device offset, and requests from the same VMO which overlap or abut on
+// both the VMO and the device are merged, before being sent to the block
+// device in batches of at most MAX_TXN_MESSAGES.
 //
-// TODO(smklein): This obviously has plenty of room for
-// improvement, including:
-// - Sorting blocks, combining ranges
-// - Writing from multiple buffers (instead of one)
-// - Cross-operation writeback delays
+// Requests are not ordered with respect to each other, except across a
+// Barrier: requests are only sorted and merged with others enqueued between
+// the same barriers, and each such group is sent once the one before it has
+// completed. If a write is enqueued which overlaps a pending write of
+// different data, the pending requests are flushed first, so later writes
+// always win.
 template <typename IdType, bool Write, size_t BlockSize, typename TxnHandler>
 class BlockTxn;
 
@@ -38,7 +47,7 @@ template <bool Write, size_t BlockSize, typename TxnHandler>
 class BlockTxn <vmoid_t, Write, BlockSize, TxnHandler> {
 public:
     DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(BlockTxn);
-    explicit BlockTxn(TxnHandler* handler) : handler_(handler), count_(0) {}
+    explicit BlockTxn(TxnHandler* handler) : handler_(handler) {}
     ~BlockTxn() {
         Flush();
     }
@@ -46,39 +55,56 @@ public:
     // Identify that a block should be written to disk
     // as a later point in time.
     void Enqueue(vmoid_t id, uint64_t relative_block, uint64_t absolute_block, uint64_t nblocks) {
-        for (size_t i = 0; i < count_; i++) {
-            if (requests_[i].vmoid != id) {
-                continue;
-            }
+        if (nblocks == 0) {
+            return;
+        }
 
-            if (requests_[i].vmo_offset == relative_block) {
-                // Take the longer of the operations (if operating on the same
-                // blocks).
-                requests_[i].length = (requests_[i].length > nblocks) ? requests_[i].length : nblocks;
-                return;
-            } else if ((requests_[i].vmo_offset + requests_[i].length == relative_block) &&
-                       (requests_[i].dev_offset + requests_[i].length == absolute_block)) {
-                // Combine with the previous request, if immediately following.
-                requests_[i].length += nblocks;
+        if (Write && Conflicts(id, relative_block, absolute_block, nblocks)) {
+            RecordStatus(Flush());
+        }
+
+        // Fast path: extend the most recent request.
+        if (requests_.size() > GroupStart()) {
+            block_fifo_request_t& last = requests_[requests_.size() - 1];
+            if ((last.vmoid == id) &&
+                (last.vmo_offset + last.length == relative_block) &&
+                (last.dev_offset + last.length == absolute_block)) {
+                last.length += nblocks;
+                ExtendRange(last);
                 return;
             }
         }
 
-        requests_[count_].txnid = handler_->TxnId();
-        requests_[count_].vmoid = id;
         // NOTE: It's easier to compare everything when dealing
         // with blocks (not offsets!) so the following are described in
         // terms of blocks until we Flush().
-        requests_[count_].vmo_offset = relative_block;
-        requests_[count_].dev_offset = absolute_block;
-        requests_[count_].length = nblocks;
-        count_++;
+        block_fifo_request_t request = {};
+        request.txnid = handler_->TxnId();
+        request.vmoid = id;
+        request.vmo_offset = relative_block;
+        request.dev_offset = absolute_block;
+        request.length = nblocks;
 
-        if (count_ == MAX_TXN_MESSAGES) {
-            // TODO(smklein): Maybe panic (on write) instead, for metadata?
-            // TODO(smklein): We could buffer more messages than this -- just
-            // send then in MAX_TXN_MESSAGES increments.
-            Flush();
+        fbl::AllocChecker ac;
+        requests_.push_back(request, &ac);
+        if (!ac.check()) {
+            // Send what we have, and this request on its own.
+            RecordStatus(Flush());
+            RecordStatus(Issue(&request, 1));
+            return;
+        }
+        ExtendRange(request);
+    }
+
+    // Order the requests enqueued so far before any enqueued later.
+    void Barrier() {
+        if (requests_.size() == GroupStart()) {
+            return;
+        }
+        fbl::AllocChecker ac;
+        barriers_.push_back(requests_.size(), &ac);
+        if (!ac.check()) {
+            RecordStatus(Flush());
         }
     }
 
@@ -86,24 +112,134 @@ public:
     zx_status_t Flush();
 
 private:
+    // Index of the first request after the most recent barrier.
+    size_t GroupStart() const {
+        return barriers_.is_empty() ? 0 : barriers_[barriers_.size() - 1];
+    }
+
+    // Widens the range of device blocks touched by |requests_| to cover
+    // |request|, which has just been added or grown.
+    void ExtendRange(const block_fifo_request_t& request) {
+        if (request.dev_offset < dev_start_ || requests_.size() == 1) {
+            dev_start_ = request.dev_offset;
+        }
+        if (request.dev_offset + request.length > dev_end_) {
+            dev_end_ = request.dev_offset + request.length;
+        }
+    }
+
+    // Returns true if a pending request would write different data to any of
+    // the given blocks.
+    bool Conflicts(vmoid_t id, uint64_t relative_block, uint64_t absolute_block,
+                   uint64_t nblocks) const {
+        if (requests_.is_empty() || absolute_block >= dev_end_ ||
+            absolute_block + nblocks <= dev_start_) {
+            return false;
+        }
+        for (size_t i = 0; i < requests_.size(); i++) {
+            const block_fifo_request_t& r = requests_[i];
+            if (r.dev_offset >= absolute_block + nblocks ||
+                r.dev_offset + r.length <= absolute_block) {
+                continue;
+            }
+            if (r.vmoid != id || r.dev_offset - r.vmo_offset != absolute_block - relative_block) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static int CompareRequests(const void* a, const void* b) {
+        auto ra = static_cast<const block_fifo_request_t*>(a);
+        auto rb = static_cast<const block_fifo_request_t*>(b);
+        if (ra->dev_offset != rb->dev_offset) {
+            return ra->dev_offset < rb->dev_offset ? -1 : 1;
+        } else if (ra->vmoid != rb->vmoid) {
+            return ra->vmoid < rb->vmoid ? -1 : 1;
+        } else if (ra->vmo_offset != rb->vmo_offset) {
+            return ra->vmo_offset < rb->vmo_offset ? -1 : 1;
+        }
+        return 0;
+    }
+
+    // Sorts |count| requests by device offset and merges those which overlap
+    // or abut. Returns the number of requests remaining.
+    static size_t Coalesce(block_fifo_request_t* r, size_t count) {
+        qsort(r, count, sizeof(block_fifo_request_t), CompareRequests);
+
+        size_t out = 0;
+        for (size_t i = 1; i < count; i++) {
+            block_fifo_request_t& prev = r[out];
+            if ((prev.vmoid == r[i].vmoid) &&
+                (prev.dev_offset - prev.vmo_offset == r[i].dev_offset - r[i].vmo_offset) &&
+                (r[i].dev_offset <= prev.dev_offset + prev.length)) {
+                uint64_t end = fbl::max(prev.dev_offset + prev.length,
+                                        r[i].dev_offset + r[i].length);
+                prev.length = end - prev.dev_offset;
+            } else {
+                r[++out] = r[i];
+            }
+        }
+        return count == 0 ? 0 : out + 1;
+    }
+
+    // Converts |count| requests from blocks to bytes and sends them to the
+    // block device.
+    zx_status_t Issue(block_fifo_request_t* requests, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            requests[i].opcode = Write ? BLOCKIO_WRITE : BLOCKIO_READ;
+            requests[i].vmo_offset *= BlockSize;
+            requests[i].dev_offset *= BlockSize;
+            requests[i].length *= BlockSize;
+        }
+        for (size_t i = 0; i < count; i += MAX_TXN_MESSAGES) {
+            zx_status_t status = handler_->Txn(&requests[i],
+                                               fbl::min(count - i, size_t{MAX_TXN_MESSAGES}));
+            if (status != ZX_OK) {
+                return status;
+            }
+        }
+        return ZX_OK;
+    }
+
+    void RecordStatus(zx_status_t status) {
+        if (status_ == ZX_OK) {
+            status_ = status;
+        }
+    }
+
     TxnHandler* handler_;
-    size_t count_;
-    block_fifo_request_t requests_[MAX_TXN_MESSAGES];
+    fbl::Vector<block_fifo_request_t> requests_;
+    // Indices into |requests_| at which a barrier was placed.
+    fbl::Vector<size_t> barriers_;
+    // Range of device blocks touched by |requests_|.
+    uint64_t dev_start_ = 0;
+    uint64_t dev_end_ = 0;
+    // First error encountered by a flush which Enqueue had to issue early.
+    zx_status_t status_ = ZX_OK;
 };
 
 template <bool Write, size_t BlockSize, typename TxnHandler>
 inline zx_status_t BlockTxn<vmoid_t, Write, BlockSize, TxnHandler>::Flush() {
-    for (size_t i = 0; i < count_; i++) {
-        requests_[i].opcode = Write ? BLOCKIO_WRITE : BLOCKIO_READ;
-        requests_[i].vmo_offset *= BlockSize;
-        requests_[i].dev_offset *= BlockSize;
-        requests_[i].length *= BlockSize;
-    }
     zx_status_t status = ZX_OK;
-    if (count_ != 0) {
-        status = handler_->Txn(requests_, count_);
+    if (!requests_.is_empty()) {
+        // Each group is issued only after the one before it has completed.
+        block_fifo_request_t* r = requests_.get();
+        size_t start = 0;
+        for (size_t i = 0; (i <= barriers_.size()) && (status == ZX_OK); i++) {
+            size_t end = (i < barriers_.size()) ? barriers_[i] : requests_.size();
+            status = Issue(&r[start], Coalesce(&r[start], end - start));
+            start = end;
+        }
+        requests_.reset();
+        barriers_.reset();
+        dev_start_ = 0;
+        dev_end_ = 0;
+    }
+    if (status_ != ZX_OK) {
+        status = status_;
+        status_ = ZX_OK;
     }
-    count_ = 0;
     return status;
 }
 
@@ -112,6 +248,36 @@ using WriteTxn = BlockTxn<vmoid_t, true, BlockSize, TxnHandler>;
 template <size_t BlockSize, typename TxnHandler>
 using ReadTxn = BlockTxn<vmoid_t, false, BlockSize, TxnHandler>;
 
+// Holds writes already converted to byte offsets (as passed to a
+// TxnHandler's Txn method) for a writeback window, so that the writes of
+// consecutive operations are coalesced into fewer, larger transactions.
+// |Device| issues requests directly to the block device.
+//
+// The owner decides when the window closes; it must Flush before issuing any
+// request which may observe the pending writes, such as a read.
+template <typename Device>
+class WritebackQueue {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(WritebackQueue);
+    explicit WritebackQueue(Device* device) : txn_(device) {}
+
+    void Enqueue(const block_fifo_request_t* requests, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            ZX_DEBUG_ASSERT((requests[i].opcode & BLOCKIO_OP_MASK) == BLOCKIO_WRITE);
+            txn_.Enqueue(requests[i].vmoid, requests[i].vmo_offset, requests[i].dev_offset,
+                         requests[i].length);
+        }
+    }
+
+    // Order the writes enqueued so far before any enqueued later.
+    void Barrier() { txn_.Barrier(); }
+
+    zx_status_t Flush() { return txn_.Flush(); }
+
+private:
+    BlockTxn<vmoid_t, true, 1, Device> txn_;
+};
+
 #else
 
 // To simplify host-side requests, they are written
@@ -136,6 +302,9 @@ public:
         }
     }
 
+    // Requests are issued in order already (do nothing)
+    void Barrier() {}
+
     // Activate the transaction (do nothing)
     zx_status_t Flush() { return ZX_OK; }
 
@@ -42,11 +42,48 @@ bool generation_ge(uint64_t g1, uint64_t g2) {
     return g1 >= g2;
 }
 
+// Hashes the superblock, with an empty hash field, followed by the digests of
+// the remaining blocks of |metadata|. Digests are taken from |digests| if it is
+// non-null, and computed otherwise.
+void fvm_block_digests_hash(const void* metadata, const uint8_t* digests, size_t blocks,
+                            digest::Digest* out) {
+    const fvm::fvm_t* header = static_cast<const fvm::fvm_t*>(metadata);
+    const uint8_t* superblock = static_cast<const uint8_t*>(metadata);
+    uint8_t empty_hash[sizeof(header->hash)];
+    memset(empty_hash, 0, sizeof(empty_hash));
+
+    out->Init();
+    out->Update(superblock, offsetof(fvm::fvm_t, hash));
+    out->Update(empty_hash, sizeof(empty_hash));
+    size_t after_hash = offsetof(fvm::fvm_t, hash) + sizeof(header->hash);
+    out->Update(superblock + after_hash, FVM_BLOCK_SIZE - after_hash);
+    for (size_t i = 1; i < blocks; i++) {
+        uint8_t block_digest[digest::Digest::kLength];
+        if (digests != nullptr) {
+            memcpy(block_digest, digests + (i - 1) * digest::Digest::kLength,
+                   sizeof(block_digest));
+        } else {
+            fvm_block_digest(metadata, i, block_digest);
+        }
+        out->Update(block_digest, sizeof(block_digest));
+    }
+    out->Final();
+}
+
 // Validate the metadata's hash value.
 // Returns 'true' if it matches, 'false' otherwise.
 bool fvm_check_hash(const void* metadata, size_t metadata_size) {
     ZX_DEBUG_ASSERT(metadata_size >= sizeof(fvm::fvm_t));
     const fvm::fvm_t* header = static_cast<const fvm::fvm_t*>(metadata);
+    if (header->version >= FVM_VERSION_BLOCK_DIGESTS) {
+        if (metadata_size % FVM_BLOCK_SIZE) {
+            return false;
+        }
+        digest::Digest digest;
+        fvm_block_digests_hash(metadata, nullptr, metadata_size / FVM_BLOCK_SIZE, &digest);
+        return digest == header->hash;
+    }
+
     const void* metadata_after_hash =
         reinterpret_cast<const void*>(header->hash + sizeof(header->hash));
     uint8_t empty_hash[sizeof(header->hash)];
@@ -95,12 +132,34 @@ constexpr char kBlockDevPath[] = "/dev/class/block/";
 
 void fvm_update_hash(void* metadata, size_t metadata_size) {
     fvm::fvm_t* header = static_cast<fvm::fvm_t*>(metadata);
-    memset(header->hash, 0, sizeof(header->hash));
     digest::Digest digest;
+    if (header->version >= FVM_VERSION_BLOCK_DIGESTS) {
+        ZX_DEBUG_ASSERT(metadata_size % FVM_BLOCK_SIZE == 0);
+        fvm_block_digests_hash(metadata, nullptr, metadata_size / FVM_BLOCK_SIZE, &digest);
+        digest.CopyTo(header->hash, sizeof(header->hash));
+        return;
+    }
+    memset(header->hash, 0, sizeof(header->hash));
     const uint8_t* hash = digest.Hash(metadata, metadata_size);
     memcpy(header->hash, hash, sizeof(header->hash));
 }
 
+void fvm_block_digest(const void* metadata, size_t index, uint8_t* out) {
+    ZX_DEBUG_ASSERT(index != 0);
+    digest::Digest digest;
+    digest.Hash(static_cast<const uint8_t*>(metadata) + index * FVM_BLOCK_SIZE,
+                FVM_BLOCK_SIZE);
+    digest.CopyTo(out, digest::Digest::kLength);
+}
+
+void fvm_update_hash_with_digests(void* metadata, const uint8_t* digests, size_t blocks) {
+    fvm::fvm_t* header = static_cast<fvm::fvm_t*>(metadata);
+    ZX_DEBUG_ASSERT(header->version >= FVM_VERSION_BLOCK_DIGESTS);
+    digest::Digest digest;
+    fvm_block_digests_hash(metadata, digests, blocks, &digest);
+    digest.CopyTo(header->hash, sizeof(header->hash));
+}
+
 zx_status_t fvm_validate_header(const void* metadata, const void* backup,
                                 size_t metadata_size, const void** out) {
     const fvm::fvm_t* primary_header = static_cast<const fvm::fvm_t*>(metadata);
@@ -11,7 +11,10 @@
 #include <string.h>
 
 #define FVM_MAGIC (0x54524150204d5646ull) // 'FVM PART'
-#define FVM_VERSION 0x00000001
+// Version 2 hashes the digests of the metadata blocks instead of the
+// metadata itself (see fvm_update_hash_with_digests).
+#define FVM_VERSION 0x00000002
+#define FVM_VERSION_BLOCK_DIGESTS 0x00000002
 #define FVM_SLICE_FREE 0
 #define FVM_BLOCK_SIZE 8192lu
 #define FVM_GUID_LEN GPT_GUID_LEN
@@ -102,6 +105,10 @@ constexpr size_t MetadataSize(size_t total_size, size_t slice_size) {
     return kAllocTableOffset + AllocTableLength(total_size, slice_size);
 }
 
+constexpr size_t MetadataBlocks(size_t total_size, size_t slice_size) {
+    return MetadataSize(total_size, slice_size) / FVM_BLOCK_SIZE;
+}
+
 constexpr size_t BackupStart(size_t total_size, size_t slice_size) {
     return MetadataSize(total_size, slice_size);
 }
@@ -128,6 +135,18 @@ __BEGIN_CDECLS
 // the contents of metadata.
 void fvm_update_hash(void* metadata, size_t metadata_size);
 
+// From version 2, the hash covers the superblock (with a zeroed hash field)
+// followed by the digest of every other FVM_BLOCK_SIZE block of metadata, in
+// order. Callers which cache those digests only need to rehash the blocks
+// they modify.
+//
+// Writes the digest of metadata block |index| (which must not be zero) to |out|.
+void fvm_block_digest(const void* metadata, size_t index, uint8_t* out);
+
+// Updates the hash field of version 2 |metadata| from the digests of blocks
+// 1 to |blocks| - 1, stored consecutively (starting with block 1) in |digests|.
+void fvm_update_hash_with_digests(void* metadata, const uint8_t* digests, size_t blocks);
+
 // Validate the FVM header information, and identify which
 // copy of metadata (primary or backup) should be used for
 // initial reading, if either.
@@ -0,0 +1,41 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <sync/futex.h>
+#include <zircon/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS;
+
+// A priority-inheriting mutex.  The futex holds the handle of the owning
+// thread, so a thread blocked in sync_mutex_lock() lends its priority to the
+// owner until the mutex is released.  It is not recursive, and must be
+// unlocked by the thread that locked it.
+typedef struct sync_mutex_t {
+    futex_t futex;
+
+#ifdef __cplusplus
+    sync_mutex_t() : futex(0) {}
+#endif
+} sync_mutex_t;
+
+#if !defined(__cplusplus)
+#define SYNC_MUTEX_INIT ((sync_mutex_t){0})
+#endif
+
+void sync_mutex_lock(sync_mutex_t* mutex);
+
+// Returns ZX_OK if the mutex was acquired, or ZX_ERR_BAD_STATE if it is
+// held by another thread.
+zx_status_t sync_mutex_trylock(sync_mutex_t* mutex);
+
+// Returns ZX_ERR_TIMED_OUT if |deadline| passes before the mutex could be
+// acquired, and ZX_OK otherwise.
+zx_status_t sync_mutex_timedlock(sync_mutex_t* mutex, zx_time_t deadline);
+
+void sync_mutex_unlock(sync_mutex_t* mutex);
+
+__END_CDECLS;
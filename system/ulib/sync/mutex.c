@@ -0,0 +1,93 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sync/mutex.h>
+
+#include <stdatomic.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+// The futex value is 0 when the mutex is unlocked, and otherwise the
+// owner's thread handle.  Handle values always have the low bit set, so
+// clearing it marks the mutex as contested: the owner must then wake a
+// waiter when it unlocks.
+enum {
+    UNLOCKED = 0,
+    CONTESTED_BIT = 1,
+};
+
+static inline int owner_value(int value) {
+    return value | CONTESTED_BIT;
+}
+
+static inline int contested_value(int value) {
+    return value & ~CONTESTED_BIT;
+}
+
+zx_status_t sync_mutex_trylock(sync_mutex_t* mutex) {
+    int unlocked = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex.futex, &unlocked,
+                                       (int)zx_thread_self())) {
+        return ZX_OK;
+    }
+    return ZX_ERR_BAD_STATE;
+}
+
+zx_status_t sync_mutex_timedlock(sync_mutex_t* mutex, zx_time_t deadline) {
+    atomic_int* futex = &mutex->futex.futex;
+    const int self = (int)zx_thread_self();
+
+    int value = UNLOCKED;
+    if (atomic_compare_exchange_strong(futex, &value, self))
+        return ZX_OK;
+
+    for (;;) {
+        if (value == UNLOCKED) {
+            // We cannot tell whether other threads are still waiting, so
+            // take the mutex as contested and wake one on unlock.
+            if (atomic_compare_exchange_strong(futex, &value, contested_value(self)))
+                return ZX_OK;
+            continue;
+        }
+
+        if (owner_value(value) == self)
+            __builtin_trap(); // Recursive lock.
+
+        if (value != contested_value(value) &&
+            !atomic_compare_exchange_strong(futex, &value, contested_value(value))) {
+            continue;
+        }
+
+        zx_status_t status = zx_futex_wait_owner(futex, contested_value(value),
+                                                 (zx_handle_t)owner_value(value), deadline);
+        switch (status) {
+        case ZX_OK:
+        case ZX_ERR_BAD_STATE:
+            break;
+        case ZX_ERR_BAD_HANDLE:
+        case ZX_ERR_WRONG_TYPE:
+            // The owner's handle is gone, e.g. the thread exited while
+            // holding the mutex.  Wait without lending our priority.
+            status = zx_futex_wait(futex, contested_value(value), deadline);
+            if (status == ZX_ERR_TIMED_OUT)
+                return status;
+            break;
+        case ZX_ERR_TIMED_OUT:
+            return ZX_ERR_TIMED_OUT;
+        default:
+            __builtin_trap();
+        }
+        value = atomic_load(futex);
+    }
+}
+
+void sync_mutex_lock(sync_mutex_t* mutex) {
+    sync_mutex_timedlock(mutex, ZX_TIME_INFINITE);
+}
+
+void sync_mutex_unlock(sync_mutex_t* mutex) {
+    int old = atomic_exchange(&mutex->futex.futex, UNLOCKED);
+    if (old != owner_value(old))
+        zx_futex_wake(&mutex->futex.futex, 1);
+}
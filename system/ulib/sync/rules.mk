@@ -10,6 +10,7 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/completion.c \
+    $(LOCAL_DIR)/mutex.c \
 
 MODULE_LIBS := \
     system/ulib/zircon \
@@ -36,6 +36,11 @@ public:
         return zx_port_wait(get(), deadline, packet, size);
     }
 
+    zx_status_t wait_many(zx_time_t deadline, zx_port_packet_t* packets, size_t count,
+                          size_t* actual) const {
+        return zx_port_wait_many(get(), deadline, packets, count, actual);
+    }
+
     zx_status_t cancel(zx_handle_t source, uint64_t key) const {
         return zx_port_cancel(get(), source, key);
     }
@@ -156,6 +156,13 @@ bool TestData::run_tests() {
     return true;
 }
 
+bool TestData::run_cold_open_tests() {
+    ASSERT_TRUE(create_blobs());
+    ASSERT_TRUE(cold_open_blobs());
+    ASSERT_TRUE(unlink_blobs());
+    return true;
+}
+
 void TestData::generate_order() {
     size_t max = blob_count - 1;
 
@@ -236,6 +243,9 @@ void TestData::get_name_str(test_name_t name, char* name_str) {
     case UNLINK:
         strcpy(name_str, "unlink");
         break;
+    case OPEN_MISSING:
+        strcpy(name_str, "open_miss");
+        break;
     default:
         strcpy(name_str, "unknown");
         break;
@@ -416,6 +426,37 @@ bool TestData::read_blobs() {
     return true;
 }
 
+// Opens each blob while no other reference to it is held, so the lookup
+// cannot be served by the set of open vnodes and must go to the node map.
+// Also measures lookups of digests which are not present at all.
+bool TestData::cold_open_blobs() {
+    for (size_t i = 0; i < get_max_count(); i++) {
+        size_t index = indices[i];
+        const char* path = paths[index];
+
+        // open
+        zx_time_t start = zx_ticks_get();
+        int fd = open(path, O_RDONLY);
+        sample_end(start, OPEN, i);
+        ASSERT_GT(fd, 0, "Failed to open blob");
+        ASSERT_EQ(close(fd), 0, "Failed to close blob");
+
+        // open a sibling digest which does not exist
+        char missing[PATH_MAX];
+        strcpy(missing, path);
+        size_t len = strlen(missing);
+        missing[len - 1] = (missing[len - 1] == '0') ? '1' : '0';
+        start = zx_ticks_get();
+        fd = open(missing, O_RDONLY);
+        sample_end(start, OPEN_MISSING, i);
+        ASSERT_LT(fd, 0, "Unexpectedly opened missing blob");
+    }
+
+    ASSERT_TRUE(report_test(OPEN));
+    ASSERT_TRUE(report_test(OPEN_MISSING));
+    return true;
+}
+
 bool TestData::unlink_blobs() {
     for (size_t i = 0; i < get_max_count(); i++) {
         size_t index = indices[i];
@@ -479,6 +520,16 @@ static bool benchmark_blob_basic() {
     END_TEST;
 }
 
+template <size_t BlobSize, size_t BlobCount, traversal_order_t Order>
+static bool benchmark_blob_cold_open() {
+    BEGIN_TEST;
+    ASSERT_TRUE(StartBlobstoreBenchmark(BlobSize, BlobCount, Order));
+    TestData data(BlobSize, BlobCount, Order);
+    bool success = data.run_cold_open_tests();
+    ASSERT_TRUE(EndBlobstoreBenchmark()); //clean up
+    ASSERT_TRUE(success);
+    END_TEST;
+}
 
 BEGIN_TEST_CASE(blobstore_benchmarks)
 
@@ -505,6 +556,9 @@ RUN_FOR_ALL_ORDER(benchmark_blob_basic, 512 * KB, 10000);
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, MB, 500);
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, MB, 1000);
 
+RUN_FOR_ALL_ORDER(benchmark_blob_cold_open, 128 * B, 1000);
+RUN_FOR_ALL_ORDER(benchmark_blob_cold_open, 128 * B, 10000);
+
 END_TEST_CASE(blobstore_benchmarks)
 
 int main(int argc, char** argv) {
@@ -25,6 +25,7 @@ typedef enum {
     READ, // read data from blob
     CLOSE, // close blob fd
     UNLINK, // unlink blob
+    OPEN_MISSING, // open fd to a blob which does not exist
     NAME_COUNT // number of name options
 } test_name_t;
 
@@ -42,6 +43,7 @@ public:
     TestData(size_t blob_size, size_t blob_count, traversal_order_t order);
     ~TestData();
     bool run_tests();
+    bool run_cold_open_tests();
 private:
     // setup
     void generate_order();
@@ -57,6 +59,7 @@ private:
     // tests
     bool create_blobs();
     bool read_blobs();
+    bool cold_open_blobs();
     bool unlink_blobs();
 
     // state
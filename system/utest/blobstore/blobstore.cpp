@@ -33,6 +33,7 @@
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/unique_ptr.h>
+#include <fdio/io.h>
 #include <unittest/unittest.h>
 
 #define MOUNT_PATH "/tmp/zircon-blobstore-test"
@@ -718,6 +719,68 @@ static bool EdgeAllocation(void) {
     END_TEST;
 }
 
+// Corrupts the first data block of a blob on disk, and checks that touching
+// it through the blob's VMO fails instead of blocking forever, while the rest
+// of the blob can still be read.
+template <fs_test_type_t TestType>
+static bool CorruptedOnDisk(void) {
+    BEGIN_TEST;
+    char ramdisk_path[PATH_MAX];
+    char fvm_path[PATH_MAX];
+    ASSERT_EQ(StartBlobstoreTest<TestType>(512, 1 << 20, ramdisk_path, fvm_path), 0, "Mounting Blobstore");
+
+    constexpr size_t kBlockSize = 8192;
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateBlob(1 << 16, &info));
+    int fd;
+    ASSERT_TRUE(MakeBlob(info->path, info->merkle.get(), info->size_merkle,
+                         info->data.get(), info->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+
+    // The blob's data is random, so its first block only appears once.
+    int dev_fd = open(ramdisk_path, O_RDWR);
+    ASSERT_GT(dev_fd, 0, "Could not open ramdisk");
+    char block[kBlockSize];
+    off_t off = 0;
+    bool found = false;
+    while (pread(dev_fd, block, sizeof(block), off) == sizeof(block)) {
+        if (memcmp(block, info->data.get(), sizeof(block)) == 0) {
+            found = true;
+            break;
+        }
+        off += sizeof(block);
+    }
+    ASSERT_TRUE(found, "Could not find blob on disk");
+    block[100] ^= 0xff;
+    ASSERT_EQ(pwrite(dev_fd, block, sizeof(block), off), sizeof(block));
+    ASSERT_EQ(close(dev_fd), 0);
+    ASSERT_EQ(MountBlobstore(ramdisk_path), 0, "Could not re-mount blobstore");
+
+    fd = open(info->path, O_RDONLY);
+    ASSERT_GT(fd, 0, "Failed to open blob");
+    zx_handle_t vmo;
+    ASSERT_EQ(fdio_get_vmo(fd, &vmo), ZX_OK);
+
+    char buf[kBlockSize];
+    size_t actual;
+    ASSERT_EQ(zx_vmo_read(vmo, buf, 0, sizeof(buf), &actual), ZX_ERR_IO_DATA_INTEGRITY);
+    ASSERT_EQ(zx_vmo_read(vmo, buf, 2 * kBlockSize, sizeof(buf), &actual), ZX_OK);
+    ASSERT_EQ(memcmp(buf, &info->data[2 * kBlockSize], sizeof(buf)), 0);
+    ASSERT_LT(read(fd, buf, sizeof(buf)), 0, "Read of corrupted blob succeeded");
+
+    // Once the vnode is gone, the bad pages still fail.
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink(info->path), 0);
+    ASSERT_EQ(zx_vmo_read(vmo, buf, 0, sizeof(buf), &actual), ZX_ERR_IO_DATA_INTEGRITY);
+    ASSERT_EQ(zx_vmo_read(vmo, buf, 4 * kBlockSize, sizeof(buf), &actual), ZX_OK);
+    ASSERT_EQ(memcmp(buf, &info->data[4 * kBlockSize], sizeof(buf)), 0);
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    ASSERT_EQ(EndBlobstoreTest<TestType>(ramdisk_path, fvm_path), 0, "unmounting blobstore");
+    END_TEST;
+}
+
 template <fs_test_type_t TestType>
 static bool CreateUmountRemountSmall(void) {
     BEGIN_TEST;
@@ -1535,6 +1598,7 @@ RUN_TEST_FOR_ALL_TYPES(MEDIUM, QueryDevicePath)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, TestReadOnly)
 RUN_TEST_MEDIUM(ResizePartition<FS_TEST_FVM>)
 RUN_TEST_MEDIUM(CorruptAtMount<FS_TEST_FVM>)
+RUN_TEST_MEDIUM(CorruptedOnDisk<FS_TEST_NORMAL>)
 END_TEST_CASE(blobstore_tests)
 
 int main(int argc, char** argv) {
@@ -3,13 +3,16 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <limits.h>
 #include <zircon/compiler.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
 #include <unittest/unittest.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <unistd.h>
 
@@ -855,6 +858,67 @@ static bool channel_disallow_write_to_self(void) {
     END_TEST;
 }
 
+// Large messages read into a page-aligned, committed buffer may have their
+// whole pages moved into the buffer's VMO rather than copied. Either way the
+// reader must see exactly the message, through every mapping of the VMO.
+static bool channel_read_into_vmo_mapping(void) {
+    BEGIN_TEST;
+
+    const size_t map_size = 8 * PAGE_SIZE;
+    const uint32_t msg_size = 5 * PAGE_SIZE + 100;
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(map_size, 0, &vmo), ZX_OK, "");
+    uintptr_t addr, view_addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, map_size,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr), ZX_OK, "");
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, map_size,
+                          ZX_VM_FLAG_PERM_READ, &view_addr), ZX_OK, "");
+    uint8_t* buf = (uint8_t*)addr;
+    const uint8_t* view = (const uint8_t*)view_addr;
+
+    uint8_t* msg = malloc(msg_size);
+    ASSERT_NONNULL(msg, "");
+    for (uint32_t i = 0; i < msg_size; i++)
+        msg[i] = (uint8_t)(i * 7 + 1);
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0, &channel[0], &channel[1]), ZX_OK, "");
+
+    // offset 0 is page aligned; offset 1 must fall back to copying
+    static const size_t offsets[] = {0, 1};
+    for (size_t i = 0; i < countof(offsets); i++) {
+        memset(buf, 0xff, map_size);
+        uint8_t* dst = buf + offsets[i];
+
+        ASSERT_EQ(zx_channel_write(channel[0], 0, msg, msg_size, NULL, 0), ZX_OK, "");
+        uint32_t size;
+        ASSERT_EQ(zx_channel_read(channel[1], 0, dst, NULL, msg_size, 0, &size, NULL),
+                  ZX_OK, "");
+        EXPECT_EQ(size, msg_size, "wrong size");
+
+        EXPECT_EQ(memcmp(dst, msg, msg_size), 0, "wrong data");
+        EXPECT_EQ(memcmp(view + offsets[i], msg, msg_size), 0, "wrong data in second mapping");
+        // the rest of the partial last page is left alone
+        EXPECT_EQ(dst[msg_size], 0xff, "byte past the message was overwritten");
+        EXPECT_EQ(buf[map_size - 1], 0xff, "byte past the message was overwritten");
+    }
+
+    // a read-only destination is still refused
+    ASSERT_EQ(zx_channel_write(channel[0], 0, msg, msg_size, NULL, 0), ZX_OK, "");
+    EXPECT_EQ(zx_channel_read(channel[1], 0, (void*)view, NULL, msg_size, 0, NULL, NULL),
+              ZX_ERR_INVALID_ARGS, "");
+
+    free(msg);
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, map_size), ZX_OK, "");
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), view_addr, map_size), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(channel_tests)
 RUN_TEST(channel_test)
 RUN_TEST(channel_read_error_test)
@@ -863,6 +927,7 @@ RUN_TEST(channel_non_transferable)
 RUN_TEST(channel_duplicate_handles)
 RUN_TEST(channel_multithread_read)
 RUN_TEST(channel_may_discard)
+RUN_TEST(channel_read_into_vmo_mapping)
 RUN_TEST(channel_call)
 RUN_TEST(channel_call2)
 RUN_TEST(bad_channel_call_finish)
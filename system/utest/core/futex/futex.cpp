@@ -4,6 +4,8 @@
 
 #include <inttypes.h>
 #include <limits.h>
+#include <sync/mutex.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <zircon/threads.h>
 #include <unittest/unittest.h>
@@ -526,6 +528,70 @@ static bool test_event_signaling() {
     END_TEST;
 }
 
+static int owner_thread(void* arg) {
+    event.wait();
+    return 0;
+}
+
+static bool test_futex_wait_owner() {
+    BEGIN_TEST;
+    int futex_value = 1;
+
+    // The owner must be another thread in this process.
+    EXPECT_EQ(zx_futex_wait_owner(&futex_value, 1, zx_thread_self(), 0),
+              ZX_ERR_INVALID_ARGS, "owner may not be the waiter");
+    EXPECT_EQ(zx_futex_wait_owner(&futex_value, 1, ZX_HANDLE_INVALID, 0),
+              ZX_ERR_BAD_HANDLE, "owner must be a valid handle");
+    EXPECT_EQ(zx_futex_wait_owner(&futex_value, 1, zx_process_self(), 0),
+              ZX_ERR_WRONG_TYPE, "owner must be a thread");
+
+    thrd_t thread;
+    ASSERT_EQ(thrd_create_with_name(&thread, owner_thread, NULL, "owner"), thrd_success, "");
+    zx_handle_t owner = thrd_get_zx_handle(thread);
+
+    EXPECT_EQ(zx_futex_wait_owner(&futex_value, 2, owner, ZX_TIME_INFINITE),
+              ZX_ERR_BAD_STATE, "value mismatch");
+    EXPECT_EQ(zx_futex_wait_owner(&futex_value, 1, owner, zx_deadline_after(ZX_MSEC(10))),
+              ZX_ERR_TIMED_OUT, "wait should time out");
+
+    event.signal();
+    EXPECT_EQ(thrd_join(thread, NULL), thrd_success, "");
+    END_TEST;
+}
+
+static sync_mutex_t pi_mutex;
+static uint64_t pi_counter;
+constexpr uint64_t kPiIterations = 10000;
+
+static int pi_mutex_thread(void* arg) {
+    for (uint64_t i = 0; i < kPiIterations; i++) {
+        sync_mutex_lock(&pi_mutex);
+        pi_counter++;
+        sync_mutex_unlock(&pi_mutex);
+    }
+    return 0;
+}
+
+static bool test_sync_mutex_contention() {
+    BEGIN_TEST;
+    constexpr int kThreads = 4;
+    thrd_t threads[kThreads];
+
+    for (int i = 0; i < kThreads; i++) {
+        ASSERT_EQ(thrd_create_with_name(&threads[i], pi_mutex_thread, NULL, "pi mutex"),
+                  thrd_success, "");
+    }
+    for (int i = 0; i < kThreads; i++) {
+        EXPECT_EQ(thrd_join(threads[i], NULL), thrd_success, "");
+    }
+
+    EXPECT_EQ(pi_counter, kThreads * kPiIterations, "lost an update");
+    EXPECT_EQ(sync_mutex_trylock(&pi_mutex), ZX_OK, "mutex should be free");
+    EXPECT_EQ(sync_mutex_trylock(&pi_mutex), ZX_ERR_BAD_STATE, "mutex should be held");
+    sync_mutex_unlock(&pi_mutex);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(futex_tests)
 RUN_TEST(test_futex_wait_value_mismatch);
 RUN_TEST(test_futex_wait_timeout);
@@ -545,6 +611,8 @@ RUN_TEST(test_futex_thread_killed);
 RUN_TEST(test_futex_thread_suspended);
 RUN_TEST(test_futex_misaligned);
 RUN_TEST(test_event_signaling);
+RUN_TEST(test_futex_wait_owner);
+RUN_TEST(test_sync_mutex_contention);
 END_TEST_CASE(futex_tests)
 
 #ifndef BUILD_COMBINED_TESTS
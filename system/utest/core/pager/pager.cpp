@@ -0,0 +1,284 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <threads.h>
+
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include <unittest/unittest.h>
+
+namespace {
+
+constexpr uint64_t kKey = 0x1234;
+
+struct Reader {
+    zx_handle_t vmo;
+    uint64_t offset;
+    uint8_t byte;
+    zx_status_t status;
+};
+
+int reader_thread(void* arg) {
+    auto reader = static_cast<Reader*>(arg);
+    size_t actual;
+    reader->status = zx_vmo_read(reader->vmo, &reader->byte, reader->offset, 1, &actual);
+    return 0;
+}
+
+// Supplies the page at |offset| of |vmo| filled with |value|.
+bool supply_page(zx_handle_t pager, zx_handle_t vmo, uint64_t offset, uint8_t value) {
+    BEGIN_HELPER;
+
+    zx_handle_t aux;
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &aux), ZX_OK);
+    uint8_t buf[PAGE_SIZE];
+    memset(buf, value, sizeof(buf));
+    size_t actual;
+    ASSERT_EQ(zx_vmo_write(aux, buf, 0, sizeof(buf), &actual), ZX_OK);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, offset, PAGE_SIZE, aux, 0), ZX_OK);
+    EXPECT_EQ(zx_handle_close(aux), ZX_OK);
+
+    END_HELPER;
+}
+
+bool read_requests_page_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, 4 * PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    // A read of a missing page blocks until the pager supplies it.
+    Reader reader = {vmo, 2 * PAGE_SIZE + 7, 0, ZX_ERR_INTERNAL};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, reader_thread, &reader), thrd_success);
+
+    zx_port_packet_t packet;
+    ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &packet, 0), ZX_OK);
+    EXPECT_EQ(packet.key, kKey);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_PAGE_REQUEST);
+    EXPECT_EQ(packet.page_request.offset, 2 * PAGE_SIZE);
+    EXPECT_EQ(packet.page_request.length, PAGE_SIZE);
+
+    ASSERT_TRUE(supply_page(pager, vmo, 2 * PAGE_SIZE, 0xa5));
+    ASSERT_EQ(thrd_join(thread, nullptr), thrd_success);
+    EXPECT_EQ(reader.status, ZX_OK);
+    EXPECT_EQ(reader.byte, 0xa5);
+
+    // Supplied pages stay; reading again does not raise another request.
+    uint8_t byte;
+    size_t actual;
+    EXPECT_EQ(zx_vmo_read(vmo, &byte, 2 * PAGE_SIZE, 1, &actual), ZX_OK);
+    EXPECT_EQ(byte, 0xa5);
+    EXPECT_EQ(zx_port_wait(port, 0, &packet, 0), ZX_ERR_TIMED_OUT);
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+
+    END_TEST;
+}
+
+bool fault_requests_page_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, PAGE_SIZE,
+                          ZX_VM_FLAG_PERM_READ, &addr), ZX_OK);
+
+    // Supply the page before touching it, so the fault finds it present.
+    ASSERT_TRUE(supply_page(pager, vmo, 0, 0x3c));
+    EXPECT_EQ(*reinterpret_cast<volatile uint8_t*>(addr + 100), 0x3c);
+
+    zx_port_packet_t packet;
+    EXPECT_EQ(zx_port_wait(port, 0, &packet, 0), ZX_ERR_TIMED_OUT);
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, PAGE_SIZE), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+
+    END_TEST;
+}
+
+bool closing_pager_fails_requests_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    Reader reader = {vmo, 0, 0, ZX_ERR_INTERNAL};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, reader_thread, &reader), thrd_success);
+
+    zx_port_packet_t packet;
+    ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &packet, 0), ZX_OK);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_PAGE_REQUEST);
+
+    // With the pager gone, the blocked read fails instead of hanging.
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+    ASSERT_EQ(thrd_join(thread, nullptr), thrd_success);
+    EXPECT_EQ(reader.status, ZX_ERR_BAD_STATE);
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
+bool failing_pages_fails_requests_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    Reader reader = {vmo, 0, 0, ZX_ERR_INTERNAL};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, reader_thread, &reader), thrd_success);
+
+    zx_port_packet_t packet;
+    ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &packet, 0), ZX_OK);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_PAGE_REQUEST);
+
+    // The blocked read sees the pager's error.
+    EXPECT_EQ(zx_pager_fail_pages(pager, vmo, 0, PAGE_SIZE, ZX_ERR_IO_DATA_INTEGRITY), ZX_OK);
+    ASSERT_EQ(thrd_join(thread, nullptr), thrd_success);
+    EXPECT_EQ(reader.status, ZX_ERR_IO_DATA_INTEGRITY);
+
+    // The page is still missing, so the next read asks for it again.
+    reader.status = ZX_ERR_INTERNAL;
+    ASSERT_EQ(thrd_create(&thread, reader_thread, &reader), thrd_success);
+    ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &packet, 0), ZX_OK);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_PAGE_REQUEST);
+    ASSERT_TRUE(supply_page(pager, vmo, 0, 0x77));
+    ASSERT_EQ(thrd_join(thread, nullptr), thrd_success);
+    EXPECT_EQ(reader.status, ZX_OK);
+    EXPECT_EQ(reader.byte, 0x77);
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+
+    END_TEST;
+}
+
+bool clone_requests_page_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo, clone;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, 2 * PAGE_SIZE, 0, &vmo), ZX_OK);
+    ASSERT_EQ(zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, PAGE_SIZE, PAGE_SIZE, &clone),
+              ZX_OK);
+
+    // A read of the clone asks the pager for the page in the parent.
+    Reader reader = {clone, 9, 0, ZX_ERR_INTERNAL};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, reader_thread, &reader), thrd_success);
+
+    zx_port_packet_t packet;
+    ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &packet, 0), ZX_OK);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_PAGE_REQUEST);
+    EXPECT_EQ(packet.page_request.offset, PAGE_SIZE);
+
+    ASSERT_TRUE(supply_page(pager, vmo, PAGE_SIZE, 0x5a));
+    ASSERT_EQ(thrd_join(thread, nullptr), thrd_success);
+    EXPECT_EQ(reader.status, ZX_OK);
+    EXPECT_EQ(reader.byte, 0x5a);
+
+    // Writes to the clone copy the page rather than change the parent's.
+    uint8_t byte = 0x11;
+    size_t actual;
+    EXPECT_EQ(zx_vmo_write(clone, &byte, 9, 1, &actual), ZX_OK);
+    EXPECT_EQ(zx_vmo_read(clone, &byte, 9, 1, &actual), ZX_OK);
+    EXPECT_EQ(byte, 0x11);
+    EXPECT_EQ(zx_vmo_read(vmo, &byte, PAGE_SIZE + 9, 1, &actual), ZX_OK);
+    EXPECT_EQ(byte, 0x5a);
+    EXPECT_EQ(zx_port_wait(port, 0, &packet, 0), ZX_ERR_TIMED_OUT);
+
+    EXPECT_EQ(zx_handle_close(clone), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+
+    END_TEST;
+}
+
+bool invalid_args_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, other_pager, port, vmo, plain_vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_pager_create(0, &other_pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &plain_vmo), ZX_OK);
+
+    EXPECT_EQ(zx_pager_create(1, &vmo), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 1, &vmo), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_create_vmo(port, port, kKey, PAGE_SIZE, 0, &vmo), ZX_ERR_WRONG_TYPE);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, 2 * PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    // Pager vmos have a fixed size.
+    EXPECT_EQ(zx_vmo_set_size(vmo, 4 * PAGE_SIZE), ZX_ERR_NOT_SUPPORTED);
+
+    EXPECT_EQ(zx_pager_supply_pages(other_pager, vmo, 0, PAGE_SIZE, plain_vmo, 0),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(pager, plain_vmo, 0, PAGE_SIZE, plain_vmo, 0),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, vmo, PAGE_SIZE),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 1, PAGE_SIZE, plain_vmo, 0),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 2 * PAGE_SIZE, PAGE_SIZE, plain_vmo, 0),
+              ZX_ERR_OUT_OF_RANGE);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, 2 * PAGE_SIZE, plain_vmo, 0),
+              ZX_ERR_OUT_OF_RANGE);
+
+    EXPECT_EQ(zx_pager_fail_pages(other_pager, vmo, 0, PAGE_SIZE, ZX_ERR_IO),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_fail_pages(pager, vmo, 0, PAGE_SIZE, ZX_ERR_SHOULD_WAIT),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_fail_pages(pager, vmo, 2 * PAGE_SIZE, PAGE_SIZE, ZX_ERR_IO),
+              ZX_ERR_OUT_OF_RANGE);
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(plain_vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+    EXPECT_EQ(zx_handle_close(other_pager), ZX_OK);
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(pager_tests)
+RUN_TEST(read_requests_page_test)
+RUN_TEST(fault_requests_page_test)
+RUN_TEST(closing_pager_fails_requests_test)
+RUN_TEST(failing_pages_fails_requests_test)
+RUN_TEST(clone_requests_page_test)
+RUN_TEST(invalid_args_test)
+END_TEST_CASE(pager_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
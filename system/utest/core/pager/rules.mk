@@ -0,0 +1,23 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+MODULE_USERTEST_GROUP := core
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/pager.cpp \
+
+MODULE_NAME := pager-test
+
+MODULE_LIBS := \
+    system/ulib/unittest system/ulib/fdio system/ulib/zircon system/ulib/c
+
+MODULE_STATIC_LIBS := system/ulib/fbl
+
+include make/module.mk
@@ -57,15 +57,20 @@ static bool queue_count_valid_test() {
     zx_status_t status = zx_port_create(0u, &port);
     EXPECT_EQ(status, ZX_OK);
 
-    // This test relies on only 0 or 1 being a valid count. This might
-    // eventually change. For now, we can stack allocate 1 packet and
-    // know it is sufficient for all instantiations of this test.
-    static_assert(Count <= 1, "");
-    const zx_port_packet_t in = {
+    // A count of 0 is accepted as 1, so always provide at least one packet.
+    static_assert(Count <= ZX_PORT_MAX_BATCH, "");
+    const zx_port_packet_t in[Count ? Count : 1u] = {
     };
-    status = zx_port_queue(port, &in, Count);
+    status = zx_port_queue(port, in, Count);
     EXPECT_EQ(status, ZX_OK);
 
+    zx_port_packet_t out[ZX_PORT_MAX_BATCH] = {
+    };
+    size_t actual = 0u;
+    status = zx_port_wait_many(port, 0ull, out, ZX_PORT_MAX_BATCH, &actual);
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(actual, Count ? Count : 1u);
+
     EXPECT_EQ(zx_handle_close(port), ZX_OK);
 
     END_TEST;
@@ -139,6 +144,68 @@ static bool wait_count_invalid_test() {
     END_TEST;
 }
 
+template <size_t Count>
+static bool wait_many_count_invalid_test() {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    zx_status_t status = zx_port_create(0u, &port);
+    EXPECT_EQ(status, ZX_OK);
+
+    const zx_port_packet_t in = {
+    };
+    status = zx_port_queue(port, &in, 1u);
+    EXPECT_EQ(status, ZX_OK);
+
+    zx_port_packet_t out[Count ? Count : 1u] = {
+    };
+    size_t actual;
+    status = zx_port_wait_many(port, ZX_TIME_INFINITE, out, Count, &actual);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS);
+
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
+static bool batch_fifo_order_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    zx_status_t status = zx_port_create(0u, &port);
+    EXPECT_EQ(status, ZX_OK);
+
+    // Queue two batches, then drain them with waits that straddle the
+    // batch boundaries to check that packets come out in FIFO order.
+    zx_port_packet_t in[ZX_PORT_MAX_BATCH] = {};
+    for (size_t ix = 0; ix != fbl::count_of(in); ++ix)
+        in[ix].key = ix;
+    EXPECT_EQ(zx_port_queue(port, in, 5u), ZX_OK);
+    EXPECT_EQ(zx_port_queue(port, &in[5], 7u), ZX_OK);
+
+    zx_port_packet_t out[ZX_PORT_MAX_BATCH] = {};
+    size_t actual = 0u;
+    status = zx_port_wait_many(port, ZX_TIME_INFINITE, out, 3u, &actual);
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(actual, 3u);
+
+    status = zx_port_wait_many(port, ZX_TIME_INFINITE, &out[3], ZX_PORT_MAX_BATCH - 3u, &actual);
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(actual, 9u);
+
+    for (size_t ix = 0; ix != 12u; ++ix) {
+        EXPECT_EQ(out[ix].key, ix);
+        EXPECT_EQ(out[ix].type, ZX_PKT_TYPE_USER);
+    }
+
+    status = zx_port_wait_many(port, 0ull, out, ZX_PORT_MAX_BATCH, &actual);
+    EXPECT_EQ(status, ZX_ERR_TIMED_OUT);
+
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
 static bool queue_and_close_test(void) {
     BEGIN_TEST;
     zx_status_t status;
@@ -740,12 +807,17 @@ BEGIN_TEST_CASE(port_tests)
 RUN_TEST(basic_test)
 RUN_TEST(queue_count_valid_test<0u>)
 RUN_TEST(queue_count_valid_test<1u>)
-RUN_TEST(queue_count_invalid_test<2u>)
+RUN_TEST(queue_count_valid_test<2u>)
+RUN_TEST(queue_count_valid_test<ZX_PORT_MAX_BATCH>)
+RUN_TEST(queue_count_invalid_test<ZX_PORT_MAX_BATCH + 1u>)
 RUN_TEST(queue_count_invalid_test<23u>)
 RUN_TEST(wait_count_valid_test<0u>)
 RUN_TEST(wait_count_valid_test<1u>)
 RUN_TEST(wait_count_invalid_test<2u>)
 RUN_TEST(wait_count_invalid_test<23u>)
+RUN_TEST(wait_many_count_invalid_test<0u>)
+RUN_TEST(wait_many_count_invalid_test<ZX_PORT_MAX_BATCH + 1u>)
+RUN_TEST(batch_fifo_order_test)
 RUN_TEST(queue_and_close_test)
 RUN_TEST(async_wait_channel_test)
 RUN_TEST(async_wait_event_test_single)
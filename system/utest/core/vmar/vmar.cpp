@@ -6,6 +6,8 @@
 #include <errno.h>
 #include <limits.h>
 #include <stdalign.h>
+#include <stdio.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <zircon/process.h>
@@ -1839,6 +1841,287 @@ bool unmap_large_uncommitted_test() {
     END_TEST;
 }
 
+// Reads a byte of each page of |len| bytes at |base|, and reports the page
+// faults taken and the pages mapped around them meanwhile.
+bool read_pages_counting_faults(uintptr_t base, size_t len,
+                                uint64_t* faults, uint64_t* faulted_around) {
+    zx_info_task_stats_t before, after;
+    ASSERT_EQ(zx_object_get_info(zx_process_self(), ZX_INFO_TASK_STATS,
+                                 &before, sizeof(before), nullptr, nullptr), ZX_OK);
+    for (size_t off = 0; off < len; off += PAGE_SIZE) {
+        (void)*reinterpret_cast<volatile uint8_t*>(base + off);
+    }
+    ASSERT_EQ(zx_object_get_info(zx_process_self(), ZX_INFO_TASK_STATS,
+                                 &after, sizeof(after), nullptr, nullptr), ZX_OK);
+    *faults = after.page_faults - before.page_faults;
+    *faulted_around = after.pages_faulted_around - before.pages_faulted_around;
+    return true;
+}
+
+// Verify that faults map the resident pages around them, per the window set
+// on the VMAR, and that the counters report it.
+bool fault_around_test() {
+    BEGIN_TEST;
+
+    constexpr size_t kPages = 64;
+    const size_t size = kPages * PAGE_SIZE;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(size, 0, &vmo), ZX_OK);
+    ASSERT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_COMMIT, 0, size, nullptr, 0), ZX_OK);
+
+    zx_handle_t vmar;
+    uintptr_t vmar_addr;
+    ASSERT_EQ(zx_vmar_allocate(zx_vmar_root_self(), 0, 4 * size,
+                               ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_CAN_MAP_SPECIFIC,
+                               &vmar, &vmar_addr),
+              ZX_OK);
+
+    uint32_t window;
+    ASSERT_EQ(zx_object_get_property(vmar, ZX_PROP_VMAR_FAULT_AROUND,
+                                     &window, sizeof(window)), ZX_OK);
+    ASSERT_GT(window, 1u);
+    ASSERT_LE(window, kPages);
+    window = 3;
+    EXPECT_EQ(zx_object_set_property(vmar, ZX_PROP_VMAR_FAULT_AROUND,
+                                     &window, sizeof(window)), ZX_ERR_INVALID_ARGS);
+    window = ZX_VMAR_FAULT_AROUND_MAX * 2;
+    EXPECT_EQ(zx_object_set_property(vmar, ZX_PROP_VMAR_FAULT_AROUND,
+                                     &window, sizeof(window)), ZX_ERR_INVALID_ARGS);
+    ASSERT_EQ(zx_object_get_property(vmar, ZX_PROP_VMAR_FAULT_AROUND,
+                                     &window, sizeof(window)), ZX_OK);
+
+    // With the default window, a fault maps the rest of its window.
+    uintptr_t addr;
+    uint64_t faults, faulted_around;
+    ASSERT_EQ(zx_vmar_map(vmar, 0, vmo, 0, size, ZX_VM_FLAG_PERM_READ |
+                          ZX_VM_FLAG_SPECIFIC, &addr), ZX_OK);
+    ASSERT_TRUE(read_pages_counting_faults(addr, size, &faults, &faulted_around));
+    EXPECT_GE(faults, kPages / window);
+    EXPECT_LT(faults, kPages);
+    EXPECT_GE(faulted_around, kPages - kPages / window);
+
+    // Without fault-around, every page faults on its own.
+    const uint32_t kNoFaultAround = 1;
+    ASSERT_EQ(zx_object_set_property(vmar, ZX_PROP_VMAR_FAULT_AROUND,
+                                     &kNoFaultAround, sizeof(kNoFaultAround)), ZX_OK);
+    ASSERT_EQ(zx_vmar_map(vmar, size, vmo, 0, size, ZX_VM_FLAG_PERM_READ |
+                          ZX_VM_FLAG_SPECIFIC, &addr), ZX_OK);
+    ASSERT_TRUE(read_pages_counting_faults(addr, size, &faults, &faulted_around));
+    EXPECT_GE(faults, kPages);
+
+    // Subregions created afterwards inherit the window.
+    zx_handle_t subregion;
+    uintptr_t subregion_addr;
+    ASSERT_EQ(zx_vmar_allocate(vmar, 2 * size, size,
+                               ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_SPECIFIC,
+                               &subregion, &subregion_addr),
+              ZX_OK);
+    ASSERT_EQ(zx_object_get_property(subregion, ZX_PROP_VMAR_FAULT_AROUND,
+                                     &window, sizeof(window)), ZX_OK);
+    EXPECT_EQ(window, kNoFaultAround);
+
+    EXPECT_EQ(zx_handle_close(subregion), ZX_OK);
+    EXPECT_EQ(zx_vmar_destroy(vmar), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmar), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    END_TEST;
+}
+
+struct fault_thread_arg_t {
+    uintptr_t base;
+    size_t size;
+    uint8_t value;
+};
+
+// Write faults in every page of a mapping.
+int fault_thread(void* arg) {
+    fault_thread_arg_t* a = static_cast<fault_thread_arg_t*>(arg);
+    for (size_t off = 0; off < a->size; off += PAGE_SIZE) {
+        *reinterpret_cast<volatile uint8_t*>(a->base + off) = a->value;
+    }
+    return 0;
+}
+
+// Measures how demand faulting scales as more threads of one process fault in
+// pages of their own mappings at the same time. The result depends on the
+// machine, so it is reported rather than checked; the pages are checked.
+bool concurrent_fault_test() {
+    BEGIN_TEST;
+
+    constexpr size_t kMaxThreads = 8;
+    constexpr size_t kMappingSize = 1024 * PAGE_SIZE;
+
+    printf("\n");
+    for (size_t count = 1; count <= kMaxThreads; count *= 2) {
+        fault_thread_arg_t args[kMaxThreads];
+        thrd_t threads[kMaxThreads];
+        for (size_t i = 0; i < count; i++) {
+            zx_handle_t vmo;
+            ASSERT_EQ(zx_vmo_create(kMappingSize, 0, &vmo), ZX_OK);
+            ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, kMappingSize,
+                                  ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
+                                  &args[i].base),
+                      ZX_OK);
+            EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+            args[i].size = kMappingSize;
+            args[i].value = static_cast<uint8_t>(i + 1);
+        }
+
+        zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+        for (size_t i = 0; i < count; i++) {
+            ASSERT_EQ(thrd_create(&threads[i], fault_thread, &args[i]), thrd_success);
+        }
+        for (size_t i = 0; i < count; i++) {
+            int res;
+            ASSERT_EQ(thrd_join(threads[i], &res), thrd_success);
+            ASSERT_EQ(res, 0);
+        }
+        zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+        size_t faults = count * kMappingSize / PAGE_SIZE;
+        printf("  %zu thread(s): %zu faults in %lu us, %lu faults/sec\n", count,
+               faults, elapsed / ZX_USEC(1), elapsed ? faults * ZX_SEC(1) / elapsed : 0);
+
+        for (size_t i = 0; i < count; i++) {
+            const volatile uint8_t* p = reinterpret_cast<const volatile uint8_t*>(args[i].base);
+            for (size_t off = 0; off < kMappingSize; off += PAGE_SIZE) {
+                ASSERT_EQ(p[off], args[i].value);
+            }
+            EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), args[i].base, kMappingSize), ZX_OK);
+        }
+    }
+
+    END_TEST;
+}
+
+// Maps a fresh VMO of |size| bytes at a |size| aligned address in a new
+// sub-region of the root vmar. The first write faults the whole aligned run in
+// at once, so where the architecture has large pages the mapping starts out
+// backed by one. Each page is then stamped with its index.
+bool map_large_aligned(size_t size, zx_handle_t* region, uintptr_t* region_addr,
+                       uintptr_t* mapping_addr) {
+    BEGIN_HELPER;
+
+    ASSERT_EQ(zx_vmar_allocate(zx_vmar_root_self(), 0, 2 * size,
+                               ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_CAN_MAP_WRITE |
+                               ZX_VM_FLAG_CAN_MAP_SPECIFIC,
+                               region, region_addr),
+              ZX_OK);
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(size, 0, &vmo), ZX_OK);
+    ASSERT_EQ(zx_vmar_map(*region, ROUNDUP(*region_addr, size) - *region_addr, vmo, 0, size,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE | ZX_VM_FLAG_SPECIFIC,
+                          mapping_addr),
+              ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    volatile uint8_t* p = reinterpret_cast<volatile uint8_t*>(*mapping_addr);
+    for (size_t i = 0; i < size / PAGE_SIZE; i++) {
+        p[i * PAGE_SIZE] = static_cast<uint8_t>(i + 1);
+    }
+
+    END_HELPER;
+}
+
+// Validate that unmapping one page out of the middle of a mapping backed by a
+// large page leaves the rest of it mapped, with its contents intact.
+bool unmap_large_page_split_test() {
+    BEGIN_TEST;
+
+    const size_t size = 512 * PAGE_SIZE;
+    const size_t hole = 256;
+    zx_handle_t region;
+    uintptr_t region_addr;
+    uintptr_t mapping_addr;
+    ASSERT_TRUE(map_large_aligned(size, &region, &region_addr, &mapping_addr));
+
+    ASSERT_EQ(zx_vmar_unmap(region, mapping_addr + hole * PAGE_SIZE, PAGE_SIZE), ZX_OK);
+
+    EXPECT_TRUE(check_pages_mapped(zx_process_self(), mapping_addr + (hole - 1) * PAGE_SIZE,
+                                   0b101, 3));
+    bool success;
+    EXPECT_EQ(test_local_address(mapping_addr + hole * PAGE_SIZE, false, &success), ZX_OK);
+    EXPECT_FALSE(success, "unmapped page should not be readable");
+    EXPECT_EQ(test_local_address(mapping_addr + (hole - 1) * PAGE_SIZE, true, &success), ZX_OK);
+    EXPECT_TRUE(success, "page below the hole should still be writeable");
+    EXPECT_EQ(test_local_address(mapping_addr + (hole + 1) * PAGE_SIZE, true, &success), ZX_OK);
+    EXPECT_TRUE(success, "page above the hole should still be writeable");
+
+    // Every other page still maps the data it held before the split; the
+    // neighbours hold what test_local_address just wrote.
+    const volatile uint8_t* p = reinterpret_cast<const volatile uint8_t*>(mapping_addr);
+    for (size_t i = 0; i < size / PAGE_SIZE; i++) {
+        if (i == hole) {
+            continue;
+        }
+        const uint8_t expected = (i == hole - 1 || i == hole + 1) ? 5 : static_cast<uint8_t>(i + 1);
+        ASSERT_EQ(p[i * PAGE_SIZE], expected);
+    }
+
+    // The hole is free to be mapped on its own.
+    zx_handle_t vmo;
+    uintptr_t hole_addr;
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &vmo), ZX_OK);
+    EXPECT_EQ(zx_vmar_map(region, mapping_addr + hole * PAGE_SIZE - region_addr, vmo, 0,
+                          PAGE_SIZE, ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_SPECIFIC, &hole_addr),
+              ZX_OK);
+    EXPECT_EQ(hole_addr, mapping_addr + hole * PAGE_SIZE);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    EXPECT_EQ(zx_vmar_destroy(region), ZX_OK);
+    EXPECT_EQ(zx_handle_close(region), ZX_OK);
+
+    END_TEST;
+}
+
+// Validate that protecting a sub-range of a mapping backed by a large page
+// changes the permissions of that range only, and keeps the contents intact.
+bool protect_large_page_split_test() {
+    BEGIN_TEST;
+
+    const size_t size = 512 * PAGE_SIZE;
+    const size_t first = 128;
+    const size_t count = 4;
+    zx_handle_t region;
+    uintptr_t region_addr;
+    uintptr_t mapping_addr;
+    ASSERT_TRUE(map_large_aligned(size, &region, &region_addr, &mapping_addr));
+
+    ASSERT_EQ(zx_vmar_protect(region, mapping_addr + first * PAGE_SIZE, count * PAGE_SIZE,
+                              ZX_VM_FLAG_PERM_READ),
+              ZX_OK);
+
+    bool success;
+    for (size_t i = first; i < first + count; i++) {
+        EXPECT_EQ(test_local_address(mapping_addr + i * PAGE_SIZE, false, &success), ZX_OK);
+        EXPECT_TRUE(success, "protected page should still be readable");
+        EXPECT_EQ(test_local_address(mapping_addr + i * PAGE_SIZE, true, &success), ZX_OK);
+        EXPECT_FALSE(success, "protected page should no longer be writeable");
+    }
+    const size_t writeable[] = { 0, first - 1, first + count, size / PAGE_SIZE - 1 };
+    for (size_t i : writeable) {
+        EXPECT_EQ(test_local_address(mapping_addr + i * PAGE_SIZE, true, &success), ZX_OK);
+        EXPECT_TRUE(success, "page outside the protected range should still be writeable");
+    }
+
+    const volatile uint8_t* p = reinterpret_cast<const volatile uint8_t*>(mapping_addr);
+    for (size_t i = 0; i < size / PAGE_SIZE; i++) {
+        uint8_t expected = static_cast<uint8_t>(i + 1);
+        for (size_t w : writeable) {
+            if (i == w) {
+                expected = 5;
+            }
+        }
+        ASSERT_EQ(p[i * PAGE_SIZE], expected);
+    }
+
+    EXPECT_EQ(zx_vmar_destroy(region), ZX_OK);
+    EXPECT_EQ(zx_handle_close(region), ZX_OK);
+
+    END_TEST;
+}
+
 }
 
 BEGIN_TEST_CASE(vmar_tests)
@@ -1866,6 +2149,10 @@ RUN_TEST(protect_multiple_test);
 RUN_TEST(protect_over_demand_paged_test);
 RUN_TEST(protect_large_uncommitted_test);
 RUN_TEST(unmap_large_uncommitted_test);
+RUN_TEST(fault_around_test);
+RUN_TEST(concurrent_fault_test);
+RUN_TEST(unmap_large_page_split_test);
+RUN_TEST(protect_large_page_split_test);
 END_TEST_CASE(vmar_tests)
 
 #ifndef BUILD_COMBINED_TESTS
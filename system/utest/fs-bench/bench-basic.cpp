@@ -191,6 +191,60 @@ bool benchmark_path_walk(void) {
     END_TEST;
 }
 
+#define WIDE_DIR MOUNT_POINT "/wide"
+
+// Minfs directories are limited to 1MB of dirents, which holds roughly this
+// many of the entries created below.
+constexpr size_t kMinfsMaxWideDirEntries = 40000;
+
+// Measures creating, looking up, and unlinking many files in a single
+// directory, where a per-dirent scan would make each operation linear in the
+// size of the directory.
+template <size_t NumFiles>
+bool benchmark_wide_directory(void) {
+    BEGIN_TEST;
+    ASSERT_EQ(mkdir(WIDE_DIR, 0666), 0, "Could not make directory");
+    int dirfd = open(WIDE_DIR, O_RDONLY | O_DIRECTORY);
+    ASSERT_GT(dirfd, 0);
+    bool banned = NumFiles > kMinfsMaxWideDirEntries && benchmark_banned(dirfd, "minfs");
+    ASSERT_EQ(close(dirfd), 0);
+    if (banned) {
+        ASSERT_EQ(rmdir(WIDE_DIR), 0);
+        return true;
+    }
+    printf("\nBenchmarking Wide directory (%lu files)\n", NumFiles);
+
+    char path[PATH_MAX];
+    uint64_t start;
+
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumFiles; i++) {
+        snprintf(path, sizeof(path), WIDE_DIR "/%05zu", i);
+        int fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0644);
+        ASSERT_GT(fd, 0, "Could not create file");
+        ASSERT_EQ(close(fd), 0);
+    }
+    time_end("create", start);
+
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumFiles; i++) {
+        snprintf(path, sizeof(path), WIDE_DIR "/%05zu", i);
+        struct stat buf;
+        ASSERT_EQ(stat(path, &buf), 0, "Could not stat file");
+    }
+    time_end("lookup", start);
+
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumFiles; i++) {
+        snprintf(path, sizeof(path), WIDE_DIR "/%05zu", i);
+        ASSERT_EQ(unlink(path), 0, "Could not unlink file");
+    }
+    time_end("unlink", start);
+
+    ASSERT_EQ(rmdir(WIDE_DIR), 0);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(basic_benchmarks)
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 1024>))
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 2048>))
@@ -201,4 +255,8 @@ RUN_TEST_PERFORMANCE((benchmark_path_walk<125>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<250>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<500>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<1000>))
+RUN_TEST_PERFORMANCE((benchmark_wide_directory<1000>))
+RUN_TEST_PERFORMANCE((benchmark_wide_directory<10000>))
+RUN_TEST_PERFORMANCE((benchmark_wide_directory<kMinfsMaxWideDirEntries>))
+RUN_TEST_PERFORMANCE((benchmark_wide_directory<100000>))
 END_TEST_CASE(basic_benchmarks)
@@ -0,0 +1,161 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fs/block-txn.h>
+
+#include <fbl/vector.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+// Records the requests sent to it, and the size of each transaction.
+class MockDevice {
+public:
+    txnid_t TxnId() const { return 1; }
+
+    zx_status_t Txn(block_fifo_request_t* requests, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            requests_.push_back(requests[i]);
+        }
+        txns_.push_back(count);
+        return ZX_OK;
+    }
+
+    const fbl::Vector<block_fifo_request_t>& requests() const { return requests_; }
+    const fbl::Vector<size_t>& txns() const { return txns_; }
+
+private:
+    fbl::Vector<block_fifo_request_t> requests_;
+    fbl::Vector<size_t> txns_;
+};
+
+// With a block size of 1, requests reach the device in the same units as
+// they were enqueued.
+using TestTxn = fs::WriteTxn<1, MockDevice>;
+
+bool ExpectRequest(const block_fifo_request_t& request, vmoid_t vmoid, uint64_t vmo_offset,
+                   uint64_t dev_offset, uint64_t length) {
+    BEGIN_HELPER;
+
+    EXPECT_EQ(BLOCKIO_WRITE, request.opcode);
+    EXPECT_EQ(vmoid, request.vmoid);
+    EXPECT_EQ(vmo_offset, request.vmo_offset);
+    EXPECT_EQ(dev_offset, request.dev_offset);
+    EXPECT_EQ(length, request.length);
+
+    END_HELPER;
+}
+
+bool test_merge() {
+    BEGIN_TEST;
+
+    MockDevice device;
+    {
+        TestTxn txn(&device);
+        txn.Enqueue(1, 4, 14, 2);
+        txn.Enqueue(1, 0, 10, 2);
+        txn.Enqueue(1, 2, 12, 2);
+        txn.Enqueue(2, 0, 20, 1);
+        EXPECT_EQ(0u, device.txns().size());
+        EXPECT_EQ(ZX_OK, txn.Flush());
+    }
+
+    ASSERT_EQ(1u, device.txns().size());
+    ASSERT_EQ(2u, device.requests().size());
+    EXPECT_TRUE(ExpectRequest(device.requests()[0], 1, 0, 10, 6));
+    EXPECT_TRUE(ExpectRequest(device.requests()[1], 2, 0, 20, 1));
+
+    END_TEST;
+}
+
+bool test_barrier() {
+    BEGIN_TEST;
+
+    MockDevice device;
+    {
+        TestTxn txn(&device);
+        txn.Enqueue(1, 2, 12, 2);
+        txn.Barrier();
+        txn.Enqueue(1, 0, 10, 2);
+        EXPECT_EQ(ZX_OK, txn.Flush());
+    }
+
+    // Adjacent requests on either side of a barrier are neither merged nor
+    // reordered, and go out in separate transactions.
+    ASSERT_EQ(2u, device.txns().size());
+    ASSERT_EQ(2u, device.requests().size());
+    EXPECT_TRUE(ExpectRequest(device.requests()[0], 1, 2, 12, 2));
+    EXPECT_TRUE(ExpectRequest(device.requests()[1], 1, 0, 10, 2));
+
+    END_TEST;
+}
+
+bool test_conflict() {
+    BEGIN_TEST;
+
+    MockDevice device;
+    {
+        TestTxn txn(&device);
+        txn.Enqueue(1, 0, 10, 2);
+        txn.Enqueue(2, 0, 11, 1);
+
+        // The second write overlaps the first with different data, so the
+        // first must reach the device before the second is queued.
+        ASSERT_EQ(1u, device.requests().size());
+        EXPECT_TRUE(ExpectRequest(device.requests()[0], 1, 0, 10, 2));
+        EXPECT_EQ(ZX_OK, txn.Flush());
+    }
+
+    ASSERT_EQ(2u, device.txns().size());
+    ASSERT_EQ(2u, device.requests().size());
+    EXPECT_TRUE(ExpectRequest(device.requests()[1], 2, 0, 11, 1));
+
+    END_TEST;
+}
+
+bool test_conflict_with_extension() {
+    BEGIN_TEST;
+
+    MockDevice device;
+    {
+        TestTxn txn(&device);
+        txn.Enqueue(1, 0, 10, 2);
+        // Extends the request above in place, to cover blocks 10 to 13.
+        txn.Enqueue(1, 2, 12, 2);
+        EXPECT_EQ(0u, device.txns().size());
+
+        // Writes only into the blocks added by the extension.
+        txn.Enqueue(2, 0, 13, 1);
+        ASSERT_EQ(1u, device.requests().size());
+        EXPECT_TRUE(ExpectRequest(device.requests()[0], 1, 0, 10, 4));
+
+        EXPECT_EQ(ZX_OK, txn.Flush());
+        ASSERT_EQ(2u, device.requests().size());
+        EXPECT_TRUE(ExpectRequest(device.requests()[1], 2, 0, 13, 1));
+
+        // Extending a request into blocks another one is writing conflicts
+        // too.
+        txn.Enqueue(3, 0, 15, 1);
+        txn.Enqueue(2, 0, 13, 1);
+        txn.Enqueue(2, 1, 14, 2);
+        ASSERT_EQ(4u, device.requests().size());
+        EXPECT_TRUE(ExpectRequest(device.requests()[2], 2, 0, 13, 1));
+        EXPECT_TRUE(ExpectRequest(device.requests()[3], 3, 0, 15, 1));
+        EXPECT_EQ(ZX_OK, txn.Flush());
+    }
+
+    ASSERT_EQ(5u, device.requests().size());
+    EXPECT_TRUE(ExpectRequest(device.requests()[4], 2, 1, 14, 2));
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(block_txn_tests)
+RUN_TEST(test_merge)
+RUN_TEST(test_barrier)
+RUN_TEST(test_conflict)
+RUN_TEST(test_conflict_with_extension)
+END_TEST_CASE(block_txn_tests)
@@ -284,6 +284,57 @@ bool test_truncate_partial_block_sparse(void) {
     END_TEST;
 }
 
+// Truncating a file frees its indirect block while the write which filled
+// it may still be waiting to reach the disk. Writing another file straight
+// afterwards can reuse the block for data, which must survive.
+bool test_truncate_reuse_indirect_block(void) {
+    BEGIN_TEST;
+
+    if (strcmp(test_info->name, "minfs")) {
+        fprintf(stderr, "Test is MinFS-Exclusive; ignoring\n");
+        return true;
+    }
+    if (!test_info->can_be_mounted) {
+        fprintf(stderr, "Filesystem cannot be mounted; cannot test persistence\n");
+        return true;
+    }
+
+    constexpr size_t kBlockSize = 8192;
+    constexpr size_t kDirectBlocks = 16;
+    constexpr size_t kDataBlocks = 64;
+
+    uint8_t buf[kBlockSize];
+    memset(buf, 0xAB, sizeof(buf));
+
+    // One block past the direct blocks puts a block pointer in an indirect
+    // block; truncating back frees both.
+    int fd = open("::truncate-indirect", O_CREAT | O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(lseek(fd, kBlockSize * kDirectBlocks, SEEK_SET), kBlockSize * kDirectBlocks);
+    ASSERT_EQ(write(fd, buf, sizeof(buf)), sizeof(buf));
+    ASSERT_EQ(ftruncate(fd, 0), 0);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[kBlockSize * kDataBlocks]);
+    ASSERT_TRUE(ac.check());
+    for (size_t n = 0; n < kBlockSize * kDataBlocks; n++) {
+        data[n] = static_cast<uint8_t>(n / kBlockSize + 1);
+    }
+    int fd2 = open("::truncate-reuse", O_CREAT | O_RDWR, 0644);
+    ASSERT_GT(fd2, 0);
+    ASSERT_STREAM_ALL(write, fd2, data.get(), kBlockSize * kDataBlocks);
+    ASSERT_EQ(close(fd2), 0);
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_TRUE(check_remount(), "Could not remount filesystem");
+    ASSERT_TRUE(check_file_contains("::truncate-reuse", data.get(), kBlockSize * kDataBlocks));
+
+    ASSERT_EQ(unlink("::truncate-reuse"), 0);
+    ASSERT_EQ(unlink("::truncate-indirect"), 0);
+
+    END_TEST;
+}
+
 bool test_truncate_errno(void) {
     BEGIN_TEST;
 
@@ -315,5 +366,6 @@ RUN_FOR_ALL_FILESYSTEMS(truncate_tests,
     RUN_TEST_LARGE((test_truncate_large<1 << 25, 50, Remount>))
     RUN_TEST_MEDIUM((test_truncate_partial_block_sparse<UnlinkThenClose>))
     RUN_TEST_MEDIUM((test_truncate_partial_block_sparse<CloseThenUnlink>))
+    RUN_TEST_MEDIUM(test_truncate_reuse_indirect_block)
     RUN_TEST_MEDIUM(test_truncate_errno)
 )
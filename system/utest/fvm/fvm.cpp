@@ -2276,6 +2276,89 @@ static bool TestCorruptionRegression(void) {
     END_TEST;
 }
 
+// Grows a partition one slice at a time, which only rewrites the metadata
+// blocks that changed. Each copy must still end up complete: losing the
+// newest copy falls back to the one before it.
+static bool TestCorruptionIncremental(void) {
+    BEGIN_TEST;
+    char ramdisk_path[PATH_MAX];
+    char fvm_driver[PATH_MAX];
+    constexpr size_t kSliceSize = 1 << 16;
+    ASSERT_EQ(StartFVMTest(512, 1 << 20, kSliceSize, ramdisk_path, fvm_driver), 0,
+              "error mounting FVM");
+    const size_t kDiskSize = use_real_disk ? test_block_size * test_block_count : 512 * (1 << 20);
+    int ramdisk_fd = open(ramdisk_path, O_RDWR);
+    ASSERT_GT(ramdisk_fd, 0);
+
+    int fd = open(fvm_driver, O_RDWR);
+    ASSERT_GT(fd, 0);
+
+    alloc_req_t request;
+    memset(&request, 0, sizeof(request));
+    request.slice_count = 1;
+    memcpy(request.guid, kTestUniqueGUID, GUID_LEN);
+    strcpy(request.name, kTestPartName1);
+    memcpy(request.type, kTestPartGUIDData, GUID_LEN);
+    int vp_fd = fvm_allocate_partition(fd, &request);
+    ASSERT_GT(vp_fd, 0);
+
+    const partition_entry_t entries[] = {
+        {kTestPartName1, 1},
+    };
+    constexpr size_t kExtends = 16;
+    block_info_t info;
+    for (size_t i = 1; i <= kExtends; i++) {
+        extend_request_t erequest;
+        erequest.offset = i;
+        erequest.length = 1;
+        ASSERT_EQ(ioctl_block_fvm_extend(vp_fd, &erequest), 0);
+        if (i % 4 == 0) {
+            ASSERT_EQ(close(vp_fd), 0);
+            fd = FVMRebind(fd, ramdisk_path, entries, 1);
+            ASSERT_GT(fd, 0, "Failed to rebind FVM driver");
+            vp_fd = open_partition(kTestUniqueGUID, kTestPartGUIDData, 0, nullptr);
+            ASSERT_GT(vp_fd, 0);
+        }
+        ASSERT_GE(ioctl_block_get_info(vp_fd, &info), 0);
+        ASSERT_EQ(info.block_count * info.block_size, kSliceSize * (i + 1));
+    }
+    ASSERT_EQ(close(vp_fd), 0);
+
+    // Corrupt the superblock of whichever copy was written last.
+    fvm::fvm_t headers[2];
+    const off_t offsets[2] = {0, static_cast<off_t>(fvm::BackupStart(kDiskSize, kSliceSize))};
+    for (size_t i = 0; i < 2; i++) {
+        ASSERT_EQ(lseek(ramdisk_fd, offsets[i], SEEK_SET), offsets[i]);
+        ASSERT_EQ(read(ramdisk_fd, &headers[i], sizeof(headers[i])), sizeof(headers[i]));
+    }
+    ASSERT_EQ(headers[0].version, FVM_VERSION);
+    ASSERT_EQ(headers[1].version, FVM_VERSION);
+    off_t off = offsets[headers[0].generation > headers[1].generation ? 0 : 1];
+    uint8_t buf[FVM_BLOCK_SIZE];
+    ASSERT_EQ(lseek(ramdisk_fd, off, SEEK_SET), off);
+    ASSERT_EQ(read(ramdisk_fd, buf, sizeof(buf)), sizeof(buf));
+    buf[128]++;
+    ASSERT_EQ(lseek(ramdisk_fd, off, SEEK_SET), off);
+    ASSERT_EQ(write(ramdisk_fd, buf, sizeof(buf)), sizeof(buf));
+
+    // The previous generation holds every extension but the last.
+    fd = FVMRebind(fd, ramdisk_path, entries, 1);
+    ASSERT_GT(fd, 0, "Failed to rebind FVM driver");
+    vp_fd = open_partition(kTestUniqueGUID, kTestPartGUIDData, 0, nullptr);
+    ASSERT_GT(vp_fd, 0);
+    ASSERT_GE(ioctl_block_get_info(vp_fd, &info), 0);
+    ASSERT_EQ(info.block_count * info.block_size, kSliceSize * kExtends);
+    ASSERT_TRUE(CheckWriteReadBlock(vp_fd, 0, 1));
+    ASSERT_TRUE(CheckNoAccessBlock(vp_fd, kSliceSize * kExtends / info.block_size, 1));
+
+    ASSERT_EQ(close(vp_fd), 0);
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(close(ramdisk_fd), 0);
+    ASSERT_EQ(FVMCheck(fvm_driver, kSliceSize), 0);
+    ASSERT_EQ(EndFVMTest(ramdisk_path), 0, "unmounting FVM");
+    END_TEST;
+}
+
 static bool TestCorruptionUnrecoverable(void) {
     BEGIN_TEST;
     char ramdisk_path[PATH_MAX];
@@ -2698,6 +2781,7 @@ RUN_TEST_LARGE(TestMounting)
 RUN_TEST_MEDIUM(TestCorruptionOk)
 RUN_TEST_MEDIUM(TestCorruptionRegression)
 RUN_TEST_MEDIUM(TestCorruptionUnrecoverable)
+RUN_TEST_MEDIUM(TestCorruptionIncremental)
 RUN_TEST_LARGE((TestRandomOpMultithreaded<1, /* persistent= */ false>))
 RUN_TEST_LARGE((TestRandomOpMultithreaded<3, /* persistent= */ false>))
 RUN_TEST_LARGE((TestRandomOpMultithreaded<5, /* persistent= */ false>))
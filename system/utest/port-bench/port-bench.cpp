@@ -0,0 +1,113 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <threads.h>
+
+#include <fbl/algorithm.h>
+#include <unittest/unittest.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+// Number of packets pushed through the port by each benchmark.
+constexpr size_t kPacketCount = 64 * 1024;
+
+struct Producer {
+    zx_handle_t port;
+    size_t batch;
+    size_t syscalls;
+};
+
+static int producer_thread(void* arg) {
+    auto producer = static_cast<Producer*>(arg);
+
+    zx_port_packet_t packets[ZX_PORT_MAX_BATCH] = {};
+    for (size_t sent = 0; sent < kPacketCount;) {
+        size_t count = fbl::min(producer->batch, kPacketCount - sent);
+        for (size_t ix = 0; ix != count; ++ix)
+            packets[ix].key = sent + ix;
+        zx_status_t status = zx_port_queue(producer->port, packets, count);
+        if (status == ZX_ERR_NO_MEMORY) {
+            // The kernel bounds the number of pending packets; let the
+            // consumer catch up.
+            thrd_yield();
+            continue;
+        }
+        if (status != ZX_OK)
+            return status;
+        sent += count;
+        producer->syscalls++;
+    }
+    return ZX_OK;
+}
+
+// Streams kPacketCount packets from a producer thread to this thread,
+// moving up to |Batch| packets per zx_port_queue() and zx_port_wait_many()
+// call, and reports the syscall and time cost per packet.
+template <size_t Batch>
+static bool benchmark_port_batch() {
+    BEGIN_TEST;
+
+    static_assert(Batch > 0 && Batch <= ZX_PORT_MAX_BATCH, "");
+
+    zx_handle_t port;
+    ASSERT_EQ(zx_port_create(0u, &port), ZX_OK);
+
+    Producer producer = {port, Batch, 0u};
+
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, producer_thread, &producer), thrd_success);
+
+    size_t received = 0u;
+    size_t wait_syscalls = 0u;
+    bool in_order = true;
+    zx_port_packet_t packets[Batch];
+    while (received < kPacketCount) {
+        size_t actual = 0u;
+        zx_status_t status;
+        if (Batch == 1) {
+            status = zx_port_wait(port, ZX_TIME_INFINITE, packets, 1u);
+            actual = 1u;
+        } else {
+            status = zx_port_wait_many(port, ZX_TIME_INFINITE, packets, Batch, &actual);
+        }
+        ASSERT_EQ(status, ZX_OK);
+        for (size_t ix = 0; ix != actual; ++ix)
+            in_order &= (packets[ix].key == received + ix);
+        received += actual;
+        wait_syscalls++;
+    }
+
+    int result;
+    ASSERT_EQ(thrd_join(thread, &result), thrd_success);
+    ASSERT_EQ(result, ZX_OK);
+
+    zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    EXPECT_TRUE(in_order, "packets were received out of order");
+
+    printf("\n\tbatch %2zu: %zu packets, %.3f queue syscalls/packet, "
+           "%.3f wait syscalls/packet, %" PRIu64 " ns/packet\n",
+           Batch, kPacketCount,
+           static_cast<double>(producer.syscalls) / kPacketCount,
+           static_cast<double>(wait_syscalls) / kPacketCount,
+           elapsed / kPacketCount);
+
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(port_benchmarks)
+RUN_TEST_PERFORMANCE(benchmark_port_batch<1>)
+RUN_TEST_PERFORMANCE(benchmark_port_batch<4>)
+RUN_TEST_PERFORMANCE(benchmark_port_batch<ZX_PORT_MAX_BATCH>)
+END_TEST_CASE(port_benchmarks)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
@@ -0,0 +1,24 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+MODULE_NAME := port-bench-test
+
+MODULE_SRCS := \
+    $(LOCAL_DIR)/port-bench.cpp \
+
+MODULE_STATIC_LIBS := \
+    system/ulib/fbl \
+
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/zircon \
+    system/ulib/unittest \
+
+include make/module.mk
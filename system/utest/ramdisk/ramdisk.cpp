@@ -431,6 +431,88 @@ bool ramdisk_test_fifo_basic(void) {
     END_TEST;
 }
 
+// Writes a page through the fifo of a ramdisk modelling a volatile write
+// cache, optionally syncs it, simulates a power loss, and reads the page back.
+// Checks that the data survived only if it was synced.
+static bool discard_unflushed_helper(bool sync) {
+    BEGIN_HELPER;
+    int fd = get_ramdisk(PAGE_SIZE, 512);
+    uint32_t flags = RAMDISK_FLAG_VOLATILE_WRITE_CACHE;
+    ASSERT_GE(ioctl_ramdisk_set_flags(fd, &flags), 0, "Failed to enable write cache");
+
+    zx_handle_t fifo;
+    ssize_t expected = sizeof(fifo);
+    ASSERT_EQ(ioctl_block_get_fifos(fd, &fifo), expected, "Failed to get FIFO");
+    txnid_t txnid;
+    expected = sizeof(txnid_t);
+    ASSERT_EQ(ioctl_block_alloc_txn(fd, &txnid), expected, "Failed to allocate txn");
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &vmo), ZX_OK, "Failed to create VMO");
+    uint8_t buf[PAGE_SIZE];
+    fill_random(buf, sizeof(buf));
+    size_t actual;
+    ASSERT_EQ(zx_vmo_write(vmo, buf, 0, sizeof(buf), &actual), ZX_OK);
+
+    vmoid_t vmoid;
+    expected = sizeof(vmoid_t);
+    zx_handle_t xfer_vmo;
+    ASSERT_EQ(zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &xfer_vmo), ZX_OK);
+    ASSERT_EQ(ioctl_block_attach_vmo(fd, &xfer_vmo, &vmoid), expected,
+              "Failed to attach vmo");
+
+    fifo_client_t* client;
+    ASSERT_EQ(block_fifo_create_client(fifo, &client), ZX_OK);
+    block_fifo_request_t request;
+    request.txnid      = txnid;
+    request.vmoid      = vmoid;
+    request.opcode     = BLOCKIO_WRITE;
+    request.length     = PAGE_SIZE;
+    request.vmo_offset = 0;
+    request.dev_offset = PAGE_SIZE * 10;
+    ASSERT_EQ(block_fifo_txn(client, &request, 1), ZX_OK);
+    if (sync) {
+        request.opcode = BLOCKIO_SYNC;
+        ASSERT_EQ(block_fifo_txn(client, &request, 1), ZX_OK);
+    }
+
+    ASSERT_GE(ioctl_ramdisk_discard_unflushed(fd), 0, "Failed to discard unflushed writes");
+
+    uint8_t out[PAGE_SIZE];
+    memset(out, 0xff, sizeof(out));
+    ASSERT_EQ(zx_vmo_write(vmo, out, 0, sizeof(out), &actual), ZX_OK);
+    request.opcode = BLOCKIO_READ;
+    ASSERT_EQ(block_fifo_txn(client, &request, 1), ZX_OK);
+    ASSERT_EQ(zx_vmo_read(vmo, out, 0, sizeof(out), &actual), ZX_OK);
+    if (sync) {
+        ASSERT_EQ(memcmp(buf, out, sizeof(out)), 0, "Synced write was lost");
+    } else {
+        uint8_t zero[PAGE_SIZE];
+        memset(zero, 0, sizeof(zero));
+        ASSERT_EQ(memcmp(zero, out, sizeof(out)), 0, "Unsynced write survived");
+    }
+
+    request.opcode = BLOCKIO_CLOSE_VMO;
+    ASSERT_EQ(block_fifo_txn(client, &request, 1), ZX_OK);
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    block_fifo_release_client(client);
+    ASSERT_GE(ioctl_ramdisk_unlink(fd), 0, "Could not unlink ramdisk device");
+    ASSERT_EQ(close(fd), 0);
+    END_HELPER;
+}
+
+bool ramdisk_test_fifo_discard_unflushed(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(discard_unflushed_helper(false));
+    END_TEST;
+}
+
+bool ramdisk_test_fifo_sync_survives_discard(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(discard_unflushed_helper(true));
+    END_TEST;
+}
+
 typedef struct {
     uint64_t vmo_size;
     zx_handle_t vmo;
@@ -1039,6 +1121,8 @@ RUN_TEST_SMALL(ramdisk_test_release_during_fifo_access)
 RUN_TEST_SMALL(ramdisk_test_multiple)
 RUN_TEST_SMALL(ramdisk_test_fifo_no_op)
 RUN_TEST_SMALL(ramdisk_test_fifo_basic)
+RUN_TEST_SMALL(ramdisk_test_fifo_discard_unflushed)
+RUN_TEST_SMALL(ramdisk_test_fifo_sync_survives_discard)
 RUN_TEST_SMALL(ramdisk_test_fifo_multiple_vmo)
 RUN_TEST_SMALL(ramdisk_test_fifo_multiple_vmo_multithreaded)
 // TODO(smklein): Test ops across different vmos
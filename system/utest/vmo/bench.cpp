@@ -175,6 +175,64 @@ int vmo_run_benchmark() {
 
     zx_handle_close(vmo);
 
+    // map a vmo twice: once aligned so it may be mapped with large pages and
+    // once a page off alignment so it can't, then touch pages at random
+    // through each to compare the cost of the tlb misses
+    const size_t large_page_size = 2*1024*1024;
+    const size_t tlb_size = 64*1024*1024;
+    zx_handle_t vmar;
+    uintptr_t vmar_addr;
+    zx_vmo_create(tlb_size, 0, &vmo);
+    zx_vmar_allocate(zx_vmar_root_self(), 0, 2 * (tlb_size + large_page_size),
+                     ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_CAN_MAP_WRITE |
+                     ZX_VM_FLAG_CAN_MAP_SPECIFIC, &vmar, &vmar_addr);
+
+    const size_t aligned_offset = fbl::round_up(vmar_addr, large_page_size) - vmar_addr;
+    uintptr_t aligned_ptr;
+    uintptr_t unaligned_ptr;
+    zx_vmar_map(vmar, aligned_offset, vmo, 0, tlb_size,
+                ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE | ZX_VM_FLAG_SPECIFIC, &aligned_ptr);
+    zx_vmar_map(vmar, aligned_offset + tlb_size + large_page_size + PAGE_SIZE, vmo, 0, tlb_size,
+                ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE | ZX_VM_FLAG_SPECIFIC, &unaligned_ptr);
+
+    t = time_it([&](){
+        for (size_t i = 0; i < tlb_size; i += PAGE_SIZE) {
+            ((volatile char *)aligned_ptr)[i] = 99;
+        }
+    });
+    printf("\ttook %" PRIu64 " nsecs to write fault in vmo of size %zu through an aligned mapping\n", t, tlb_size);
+
+    t = time_it([&](){
+        for (size_t i = 0; i < tlb_size; i += PAGE_SIZE) {
+            __UNUSED char a = ((volatile char *)unaligned_ptr)[i];
+        }
+    });
+    printf("\ttook %" PRIu64 " nsecs to read fault in vmo of size %zu through an unaligned mapping\n", t, tlb_size);
+
+    const size_t touches = 4 * tlb_size / PAGE_SIZE;
+    auto touch_random_pages = [&](uintptr_t base) {
+        uint32_t seed = 1;
+        for (size_t i = 0; i < touches; i++) {
+            seed = seed * 1103515245 + 12345;
+            size_t page = seed % (tlb_size / PAGE_SIZE);
+            __UNUSED char a = ((volatile char *)base)[page * PAGE_SIZE];
+        }
+    };
+
+    t = time_it([&](){
+        touch_random_pages(aligned_ptr);
+    });
+    printf("\ttook %" PRIu64 " nsecs to read %zu random pages through an aligned mapping\n", t, touches);
+
+    t = time_it([&](){
+        touch_random_pages(unaligned_ptr);
+    });
+    printf("\ttook %" PRIu64 " nsecs to read %zu random pages through an unaligned mapping\n", t, touches);
+
+    zx_vmar_destroy(vmar);
+    zx_handle_close(vmar);
+    zx_handle_close(vmo);
+
     printf("done with benchmark\n");
 
     return 0;
@@ -1176,6 +1176,130 @@ bool vmo_clone_test_4() {
     END_TEST;
 }
 
+// Builds chains of clones the way repeated fork-like cloning does, each level
+// cloning the last and closing its handle, and checks that every level's
+// writes show through the final clone.  Reports how long read faults
+// through the final clone take at each depth.
+bool vmo_clone_chain_test() {
+    BEGIN_TEST;
+
+    const size_t page_count = 64;
+    const size_t size = PAGE_SIZE * page_count;
+    const size_t depths[] = { 1, 8, 32, 128 };
+
+    for (size_t depth : depths) {
+        size_t expected[page_count];
+        size_t actual;
+
+        // the root holds each page's index
+        zx_handle_t root;
+        ASSERT_EQ(ZX_OK, zx_vmo_create(size, 0, &root), "vm_object_create");
+        for (size_t i = 0; i < page_count; i++) {
+            expected[i] = i;
+            EXPECT_EQ(ZX_OK, zx_vmo_write(root, &expected[i], i * PAGE_SIZE, sizeof(expected[i]),
+                                          &actual), "writing to root");
+        }
+
+        // every level overwrites one page of its own clone
+        zx_handle_t vmo = ZX_HANDLE_INVALID;
+        for (size_t level = 0; level < depth; level++) {
+            zx_handle_t clone;
+            ASSERT_EQ(ZX_OK, zx_vmo_clone(level == 0 ? root : vmo, ZX_VMO_CLONE_COPY_ON_WRITE,
+                                          0, size, &clone), "vm_clone");
+            if (level > 0)
+                EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "handle_close");
+            vmo = clone;
+
+            const size_t page = (level * 7) % page_count;
+            expected[page] = page_count + level;
+            EXPECT_EQ(ZX_OK, zx_vmo_write(vmo, &expected[page], page * PAGE_SIZE,
+                                          sizeof(expected[page]), &actual), "writing to clone");
+        }
+
+        uintptr_t ptr;
+        ASSERT_EQ(ZX_OK, zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, size, ZX_VM_FLAG_PERM_READ,
+                                     &ptr), "map");
+        volatile size_t* p = (volatile size_t*)ptr;
+
+        size_t values[page_count];
+        zx_time_t t = zx_time_get(ZX_CLOCK_MONOTONIC);
+        for (size_t i = 0; i < page_count; i++)
+            values[i] = p[i * PAGE_SIZE / sizeof(*p)];
+        t = zx_time_get(ZX_CLOCK_MONOTONIC) - t;
+        printf("\tdepth %zu: %" PRIu64 " nsecs per read fault\n", depth, t / page_count);
+
+        for (size_t i = 0; i < page_count; i++) {
+            if (values[i] != expected[i]) {
+                EXPECT_EQ(expected[i], values[i], "reading through clone chain");
+                break;
+            }
+        }
+
+        // the root is untouched by the clones
+        for (size_t i = 0; i < page_count; i++) {
+            size_t val;
+            EXPECT_EQ(ZX_OK, zx_vmo_read(root, &val, i * PAGE_SIZE, sizeof(val), &actual),
+                      "reading root");
+            if (val != i) {
+                EXPECT_EQ(i, val, "reading root");
+                break;
+            }
+        }
+
+        EXPECT_EQ(ZX_OK, zx_vmar_unmap(zx_vmar_root_self(), ptr, size), "unmap");
+        EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "handle_close");
+        EXPECT_EQ(ZX_OK, zx_handle_close(root), "handle_close");
+    }
+
+    END_TEST;
+}
+
+bool vmo_clone_collapse_decommit_test() {
+    BEGIN_TEST;
+
+    const size_t size = PAGE_SIZE * 2;
+    const size_t root_val = 1, middle_val = 2, top_val = 3;
+    size_t actual, val;
+
+    zx_handle_t root;
+    ASSERT_EQ(ZX_OK, zx_vmo_create(size, 0, &root), "vm_object_create");
+    EXPECT_EQ(ZX_OK, zx_vmo_write(root, &root_val, 0, sizeof(root_val), &actual), "writing to root");
+    EXPECT_EQ(ZX_OK, zx_vmo_write(root, &root_val, PAGE_SIZE, sizeof(root_val), &actual),
+              "writing to root");
+
+    // a middle clone with its own copy of both pages, hidden once its handle closes
+    zx_handle_t middle;
+    ASSERT_EQ(ZX_OK, zx_vmo_clone(root, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, &middle), "vm_clone");
+    EXPECT_EQ(ZX_OK, zx_vmo_write(middle, &middle_val, 0, sizeof(middle_val), &actual),
+              "writing to clone");
+    EXPECT_EQ(ZX_OK, zx_vmo_write(middle, &middle_val, PAGE_SIZE, sizeof(middle_val), &actual),
+              "writing to clone");
+
+    zx_handle_t vmo;
+    ASSERT_EQ(ZX_OK, zx_vmo_clone(middle, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, &vmo), "vm_clone");
+    EXPECT_EQ(ZX_OK, zx_handle_close(middle), "handle_close");
+
+    // overwrite the first page, merging the middle clone into us
+    EXPECT_EQ(ZX_OK, zx_vmo_write(vmo, &top_val, 0, sizeof(top_val), &actual), "writing to clone");
+    EXPECT_EQ(ZX_OK, zx_vmo_read(vmo, &val, 0, sizeof(val), &actual), "reading clone");
+    EXPECT_EQ(top_val, val, "reading clone");
+
+    // decommitting our copies reveals the merged clone's pages, not the root's
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, size, nullptr, 0), "decommit");
+    EXPECT_EQ(ZX_OK, zx_vmo_read(vmo, &val, 0, sizeof(val), &actual), "reading clone");
+    EXPECT_EQ(middle_val, val, "reading decommitted page");
+    EXPECT_EQ(ZX_OK, zx_vmo_read(vmo, &val, PAGE_SIZE, sizeof(val), &actual), "reading clone");
+    EXPECT_EQ(middle_val, val, "reading untouched page");
+
+    EXPECT_EQ(ZX_OK, zx_vmo_read(root, &val, 0, sizeof(val), &actual), "reading root");
+    EXPECT_EQ(root_val, val, "reading root");
+
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "handle_close");
+    EXPECT_EQ(ZX_OK, zx_handle_close(root), "handle_close");
+
+    END_TEST;
+}
+
 bool vmo_clone_rights_test() {
     BEGIN_TEST;
 
@@ -1253,6 +1377,8 @@ RUN_TEST(vmo_clone_test_3);
 RUN_TEST(vmo_clone_test_4);
 RUN_TEST(vmo_clone_decommit_test);
 RUN_TEST(vmo_clone_commit_test);
+RUN_TEST(vmo_clone_chain_test);
+RUN_TEST(vmo_clone_collapse_decommit_test);
 RUN_TEST(vmo_clone_rights_test);
 END_TEST_CASE(vmo_tests)
 